@@ -0,0 +1,122 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _COLLISION_CHECK_H_
+#define _COLLISION_CHECK_H_
+
+#include "nif_math.h"
+#include "Ref.h"
+#include "dll_export.h"
+#include "nif_basic_types.h"
+#include <vector>
+#include <string>
+#include <iostream>
+
+namespace Niflib {
+
+using namespace std;
+
+class NiObject;
+
+/*! Settings for comparing collision bounds with render bounds. */
+struct CollisionCheckParams {
+	/*!
+	 * How far, in NIF units, a side of the collision bounds may be from the
+	 * same side of the render bounds.
+	 */
+	float tolerance;
+	/*!
+	 * An extra allowance as a fraction of the diagonal of the render bounds.
+	 * The larger of the two allowances is used.
+	 */
+	float relativeTolerance;
+	/*!
+	 * The factor from Havok units to NIF units, or zero to choose it from the
+	 * file version: 69.99 for Skyrim files and 7 for everything else.
+	 */
+	float havokScale;
+	/*! The number of threads to use, zero for one per hardware thread. */
+	unsigned int numThreads;
+
+	/*! Default constructor */
+	NIFLIB_API CollisionCheckParams() : tolerance(1.0f), relativeTolerance(0.05f), havokScale(0.0f), numThreads(0) {}
+};
+
+/*! An object whose collision bounds do not match its render bounds. */
+struct CollisionMismatch {
+	/*! The index of the object in the block list of its file. */
+	unsigned int block;
+	/*! The name of the object. */
+	string name;
+	/*! The world space bounds of the geometry below the object. */
+	Vector3 renderMin, renderMax;
+	/*! The world space bounds of the collision shapes. */
+	Vector3 collisionMin, collisionMax;
+	/*! The largest distance between matching sides of the two bounds. */
+	float gap;
+
+	/*! Default constructor */
+	NIFLIB_API CollisionMismatch() : block(0), gap(0.0f) {}
+};
+
+/*! The outcome of checking one file. */
+struct CollisionCheckResult {
+	/*! The file that was checked. */
+	string file;
+	/*! Why the file could not be read, or empty if it was read. */
+	string error;
+	/*! The number of objects that had both collision and render geometry. */
+	unsigned int checked;
+	/*! The objects that failed the check. */
+	vector<CollisionMismatch> mismatches;
+
+	/*! Default constructor */
+	NIFLIB_API CollisionCheckResult() : checked(0) {}
+};
+
+/*!
+ * Compares the collision of every NiAVObject in a list of objects with its
+ * render geometry.  The render bounds cover the vertices of all NiGeometry
+ * at or below the object, under their world transforms.  Branches that have
+ * collision objects of their own and skinned geometry are left out.  The
+ * collision bounds cover the shape tree of the bhkWorldObject attached
+ * through a bhkNiCollisionObject, as found by ShapeBvh::GetShapeBounds.
+ * They are scaled to NIF units, moved by the translation and rotation of
+ * a bhkRigidBodyT, and placed with the world transform of the object.
+ * Plain bhkRigidBody objects ignore their translation and rotation in game,
+ * so they are ignored here too.  Objects where either side has nothing in
+ * it are not checked.
+ * \param[in] objects The objects of one file, as returned by ReadNifList.
+ * \param[in] info The version of the file, used to pick the Havok scale.
+ * \param[out] mismatches Receives the objects that fail the check.
+ * \param[in] params The tolerances and Havok scale to use.
+ * \return The number of objects that were checked.
+ */
+NIFLIB_API unsigned int CheckCollisionBounds( const vector< Ref<NiObject> > & objects, const NifInfo & info, vector<CollisionMismatch> & mismatches, const CollisionCheckParams & params = CollisionCheckParams() );
+
+/*!
+ * Reads many files with ReadNifList and checks each with
+ * CheckCollisionBounds.  Files are handed to the threads one at a time as
+ * they become free, and each file is released before the next is read.
+ * Files that cannot be read are reported with an error rather than
+ * stopping the batch.
+ * \param[in] file_names The files to check.
+ * \param[out] results Receives one result per file, in the same order.
+ * \param[in] params The tolerances, Havok scale and thread count to use.
+ * \return The number of files that could not be read or have mismatches.
+ */
+NIFLIB_API unsigned int CheckCollisionBounds( const vector<string> & file_names, vector<CollisionCheckResult> & results, const CollisionCheckParams & params = CollisionCheckParams() );
+
+/*!
+ * Writes check results as JSON Lines, one object per file, for example:
+ * {"file":"a.nif","status":"mismatch","checked":2,"mismatches":[{"block":4,
+ * "name":"Rock","gap":12.5,"render":[x0,y0,z0,x1,y1,z1],"collision":[...]}]}
+ * The status is "ok", "mismatch" or "error", and files with errors carry an
+ * "error" string instead of the counts.
+ * \param[out] out The stream to write to.
+ * \param[in] results The results to write.
+ */
+NIFLIB_API void WriteCollisionCheckReport( ostream & out, const vector<CollisionCheckResult> & results );
+
+} //End Niflib namespace
+#endif
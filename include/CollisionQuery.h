@@ -0,0 +1,197 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _COLLISION_QUERY_H_
+#define _COLLISION_QUERY_H_
+
+#include "nif_math.h"
+#include "Ref.h"
+#include "dll_export.h"
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace Niflib {
+
+using namespace std;
+
+class bhkShape;
+
+/*! A line segment to cast against collision. */
+struct CollisionRay {
+	/*! The start of the segment. */
+	Vector3 from;
+	/*! The end of the segment. */
+	Vector3 to;
+};
+
+/*! The result of casting a ray against collision. */
+struct CollisionHit {
+	/*! The position of the hit along the ray, 0 at the start and 1 at the end. */
+	float fraction;
+	/*! The unit surface normal at the hit, facing the start of the ray. */
+	Vector3 normal;
+	/*! The primitive that was hit, or NO_HIT if the ray hit nothing. */
+	unsigned int primitive;
+	/*! The leaf shape that the primitive came from, NULL if nothing was hit. */
+	const bhkShape * shape;
+	/*! The triangle or sphere index of the primitive within its shape. */
+	unsigned int part;
+
+	/*! The primitive value of a ray that hit nothing. */
+	enum { NO_HIT = 0xFFFFFFFF };
+
+	/*! Default constructor */
+	NIFLIB_API CollisionHit() : fraction(1.0f), primitive(NO_HIT), shape(NULL), part(0) {}
+};
+
+/*!
+ * A bounding volume hierarchy over all the triangles and convex primitives
+ * in a tree of collision shapes, used to answer ray casts and box overlap
+ * queries.  The tree is walked through bhkMoppBvTreeShape, bhkListShape,
+ * bhkConvexListShape and bhkTransformShape, and the transforms found on the
+ * way are applied.  Triangles come from bhkPackedNiTriStripsShape,
+ * bhkNiTriStripsShape and bhkCompressedMeshShape, while bhkSphereShape,
+ * bhkMultiSphereShape, bhkCapsuleShape, bhkBoxShape and
+ * bhkConvexVerticesShape add solid primitives.  Other shapes are skipped.
+ * Everything is in the units stored in the shapes, without the Havok scale.
+ *
+ * The hierarchy is built with the surface area heuristic when it is created,
+ * and it does not notice later changes to the shapes.  Queries do not change
+ * the hierarchy, so any number of threads can query it at the same time.
+ */
+class ShapeBvh {
+public:
+	/*!
+	 * Builds the hierarchy.
+	 * \param[in] shape The root of the shape tree.
+	 */
+	NIFLIB_API ShapeBvh( bhkShape * shape );
+
+	/*! Destructor */
+	NIFLIB_API ~ShapeBvh();
+
+	/*!
+	 * Reports the number of triangles and solid primitives in the hierarchy.
+	 * \return The number of primitives.
+	 */
+	NIFLIB_API unsigned int GetPrimitiveCount() const;
+
+	/*!
+	 * Retrieves the bounds of everything in the hierarchy.
+	 * \param[out] min Receives the minimum corner.
+	 * \param[out] max Receives the maximum corner.
+	 */
+	NIFLIB_API void GetBounds( Vector3 & min, Vector3 & max ) const;
+
+	/*!
+	 * Finds the bounds of a shape tree without building a hierarchy.  The
+	 * tree is walked the same way as by the constructor.
+	 * \param[in] shape The root of the shape tree.
+	 * \param[in] transform Applied to everything after the transforms found
+	 * in the tree, for example to place the shape in the world.
+	 * \param[out] min Receives the minimum corner.
+	 * \param[out] max Receives the maximum corner.
+	 * \return False if the tree holds no primitives, in which case both
+	 * corners are set to zero.
+	 */
+	NIFLIB_API static bool GetShapeBounds( bhkShape * shape, const Matrix44 & transform, Vector3 & min, Vector3 & max );
+
+	/*!
+	 * Finds the closest primitive hit by a line segment.  A segment that
+	 * starts inside a solid primitive hits it at fraction zero.
+	 * \param[in] ray The segment to cast.
+	 * \param[out] hit Receives the closest hit.
+	 * \return True if anything was hit.
+	 */
+	NIFLIB_API bool RayCast( const CollisionRay & ray, CollisionHit & hit ) const;
+
+	/*!
+	 * Casts many segments, split across threads.  Each leaf of the hierarchy
+	 * holds up to four triangles, which are tested against a ray together
+	 * with SIMD instructions.
+	 * \param[in] rays The segments to cast.
+	 * \param[out] hits Receives one hit per segment.
+	 * \param[in] num_threads The number of threads to use, zero for one per
+	 * hardware thread.
+	 */
+	NIFLIB_API void RayCast( const vector<CollisionRay> & rays, vector<CollisionHit> & hits, unsigned int num_threads = 0 ) const;
+
+	/*!
+	 * Finds the primitives that overlap a box.  Triangles and spheres are
+	 * tested exactly, other primitives by their bounds.
+	 * \param[in] min The minimum corner of the box.
+	 * \param[in] max The maximum corner of the box.
+	 * \param[out] primitives Receives the ids of the overlapping primitives.
+	 */
+	NIFLIB_API void QueryAabb( const Vector3 & min, const Vector3 & max, vector<unsigned int> & primitives ) const;
+
+	/*!
+	 * Finds where a primitive came from.
+	 * \param[in] primitive The primitive id.
+	 * \param[out] part Receives the triangle or sphere index within the shape.
+	 * \return The leaf shape that holds the primitive.
+	 */
+	NIFLIB_API const bhkShape * GetPrimitiveShape( unsigned int primitive, unsigned int & part ) const;
+
+private:
+	ShapeBvh( const ShapeBvh & );
+	ShapeBvh & operator=( const ShapeBvh & );
+
+	struct Impl;
+	Impl * impl;
+};
+
+/*!
+ * Keeps one ShapeBvh per shape tree so that repeated queries against the
+ * same collision do not rebuild it.  All functions may be called from
+ * several threads at once.  Shapes are held by reference while they are in
+ * the cache.  The cache cannot tell when a shape is edited, so call
+ * Invalidate afterwards.
+ */
+class ShapeBvhCache {
+public:
+	/*! Constructor */
+	NIFLIB_API ShapeBvhCache();
+
+	/*! Destructor */
+	NIFLIB_API ~ShapeBvhCache();
+
+	/*!
+	 * Retrieves the hierarchy for a shape tree, building it on first use.
+	 * \param[in] shape The root of the shape tree.
+	 * \return The hierarchy, which stays valid after it is dropped from the
+	 * cache for as long as the caller holds on to it.
+	 */
+	NIFLIB_API shared_ptr<const ShapeBvh> Get( bhkShape * shape );
+
+	/*!
+	 * Drops the hierarchy of one shape tree.
+	 * \param[in] shape The root of the shape tree.
+	 */
+	NIFLIB_API void Invalidate( bhkShape * shape );
+
+	/*! Drops every hierarchy. */
+	NIFLIB_API void Clear();
+
+	/*!
+	 * Reports the number of cached hierarchies.
+	 * \return The number of shape trees in the cache.
+	 */
+	NIFLIB_API unsigned int GetSize() const;
+
+private:
+	ShapeBvhCache( const ShapeBvhCache & );
+	ShapeBvhCache & operator=( const ShapeBvhCache & );
+
+	struct Entry {
+		Ref<bhkShape> shape;
+		shared_ptr<const ShapeBvh> bvh;
+	};
+	mutable mutex lock;
+	map<bhkShape *, Entry> entries;
+};
+
+} //End Niflib namespace
+#endif
@@ -0,0 +1,82 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _COLLISION_SIMPLIFY_H_
+#define _COLLISION_SIMPLIFY_H_
+
+#include "nif_math.h"
+#include "dll_export.h"
+#include <vector>
+
+namespace Niflib {
+
+using namespace std;
+
+class hkPackedNiTriStripsData;
+class bhkPackedNiTriStripsShape;
+
+/*! Settings that control how far a collision mesh is simplified. */
+struct CollisionSimplifyParams {
+	/*!
+	 * The number of triangles to stop at, or zero for no budget.
+	 */
+	unsigned int targetTriangles;
+	/*!
+	 * The furthest the surface may move, measured as the root of the
+	 * quadric error, or a negative number for no bound.
+	 */
+	float maxError;
+
+	/*! Default constructor */
+	NIFLIB_API CollisionSimplifyParams() : targetTriangles(0), maxError(0.01f) {}
+};
+
+/*!
+ * Simplifies packed collision data in place by collapsing edges in order of
+ * their quadric error, after first welding vertices of the same sub shape
+ * that share a position.  Collapsing stops when the triangle budget is
+ * reached or the next collapse would exceed the error bound, whichever
+ * comes first.
+ *
+ * Edges are only collapsed between vertices of the same sub shape, so every
+ * triangle keeps its material and layer.  Vertices at positions shared by
+ * more than one sub shape are never moved or removed, so the seams between
+ * materials stay closed.  Vertices on other open edges only collapse onto
+ * their neighbors along the edge.  Collapses that would flip a triangle or
+ * make the mesh non-manifold are skipped.  Afterwards the sub shape vertex counts, the
+ * triangle normals and the welding information are rebuilt.  Welding
+ * information holds five bits per edge, in the order v1-v2, v2-v3, v3-v1,
+ * with the signed angle to the neighboring triangle quantized from -pi to
+ * pi into 0 to 30, and 31 for open edges.  Any MOPP code built for the old
+ * triangles must be rebuilt.  Throws a runtime_error if a triangle refers
+ * to a missing vertex.
+ * \param[in] data The collision data to simplify.
+ * \param[in] params The simplification settings.
+ * \return The number of triangles removed.
+ */
+NIFLIB_API unsigned int SimplifyCollisionMesh( hkPackedNiTriStripsData * data, const CollisionSimplifyParams & params = CollisionSimplifyParams() );
+
+/*!
+ * Simplifies the packed collision data of a shape.  Files up to version
+ * 20.0.0.5 keep the sub shapes in the shape rather than the data; when the
+ * data has none, the shape's sub shapes are used and updated instead.
+ * Throws a runtime_error if the shape has no data.
+ * \param[in] shape The shape whose data to simplify.
+ * \param[in] params The simplification settings.
+ * \return The number of triangles removed.
+ */
+NIFLIB_API unsigned int SimplifyCollisionMesh( bhkPackedNiTriStripsShape * shape, const CollisionSimplifyParams & params = CollisionSimplifyParams() );
+
+/*!
+ * Simplifies many pieces of packed collision data, split across threads.
+ * Data listed more than once is only simplified once.
+ * \param[in] data The collision data to simplify.
+ * \param[in] params The simplification settings.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ * \return The total number of triangles removed.
+ */
+NIFLIB_API unsigned int SimplifyCollisionMeshes( const vector<hkPackedNiTriStripsData*> & data, const CollisionSimplifyParams & params = CollisionSimplifyParams(), unsigned int num_threads = 0 );
+
+} //End Niflib namespace
+#endif
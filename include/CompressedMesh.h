@@ -0,0 +1,157 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _COMPRESSED_MESH_H_
+#define _COMPRESSED_MESH_H_
+
+#include "nif_math.h"
+#include "Ref.h"
+#include "dll_export.h"
+#include "gen/enums.h"
+#include <vector>
+
+namespace Niflib {
+
+using namespace std;
+
+class bhkCompressedMeshShapeData;
+struct bhkCMSDChunk;
+
+/*!
+ * A single triangle of a bhkCompressedMeshShapeData, with its corners in
+ * the space of the shape.
+ */
+struct CompressedMeshTriangle {
+	/*! The three corners of the triangle. */
+	Vector3 vertices[3];
+	/*! The chunk that the triangle came from, or 0xFFFFFFFF for big triangles. */
+	unsigned int chunk;
+	/*! The index of the triangle's material in the chunk materials list. */
+	unsigned int materialIndex;
+	/*! The Skyrim material of the triangle. */
+	SkyrimHavokMaterial material;
+};
+
+/*!
+ * Walks the triangles of a bhkCompressedMeshShapeData one at a time without
+ * expanding the mesh into memory first.  Chunk vertices are dequantized as
+ * they are needed, as chunk translation + quantized value * error, then
+ * rotated and moved by the chunk's transform.  Strips are walked first,
+ * followed by the plain triangle list of each chunk, and finally the big
+ * triangles.  Degenerate triangles, as used to join strips, are skipped.
+ *
+ * The iterator keeps a pointer to the shape data, which must outlive it and
+ * must not be changed while it is in use.  Several iterators over disjoint
+ * chunk ranges can be used on different threads at once.
+ */
+class CompressedMeshTriangleIterator {
+public:
+	/*!
+	 * Constructor.
+	 * \param[in] data The shape data to walk.
+	 * \param[in] first_chunk The first chunk to walk.
+	 * \param[in] end_chunk One past the last chunk to walk.  Values larger
+	 * than the number of chunks are clamped.
+	 * \param[in] big_tris Whether to walk the big triangle list after the
+	 * chunks.
+	 */
+	NIFLIB_API CompressedMeshTriangleIterator( const bhkCompressedMeshShapeData * data, unsigned int first_chunk = 0, unsigned int end_chunk = 0xFFFFFFFF, bool big_tris = true );
+
+	/*!
+	 * Decodes the next triangle.  Throws a runtime_error if the shape data
+	 * refers to a vertex, transform or material that does not exist.
+	 * \param[out] tri Receives the triangle.
+	 * \return True if a triangle was decoded, false once all triangles have
+	 * been walked.
+	 */
+	NIFLIB_API bool Next( CompressedMeshTriangle & tri );
+
+	/*! Starts the walk over from the first triangle. */
+	NIFLIB_API void Reset();
+
+private:
+	bool EnterChunk();
+	Vector3 ChunkVertex( unsigned int index ) const;
+
+	const bhkCompressedMeshShapeData * data;
+	unsigned int firstChunk;
+	unsigned int endChunk;
+	bool bigTris;
+
+	unsigned int chunk;
+	bool inChunk;
+	unsigned int strip;
+	unsigned int stripPos;
+	unsigned int index;
+	unsigned int bigTri;
+
+	const bhkCMSDChunk * cur;
+	float rotation[9];
+	Vector3 translation;
+	Vector3 origin;
+	unsigned int materialIndex;
+	SkyrimHavokMaterial material;
+};
+
+/*!
+ * Callback used by ForEachCompressedMeshTriangle.
+ * \param[in] tri The decoded triangle.
+ * \param[in] user The user pointer passed to ForEachCompressedMeshTriangle.
+ */
+typedef void (*CompressedMeshTriangleCallback)( const CompressedMeshTriangle & tri, void * user );
+
+/*!
+ * Calls a function for every triangle of a bhkCompressedMeshShapeData.
+ * Chunks are split across threads, so the callback may be called from
+ * several threads at once and must do its own locking if it writes to shared
+ * state.  Big triangles are reported on the calling thread after all chunks
+ * are done.  No memory is allocated for the triangles.
+ * \param[in] data The shape data to walk.
+ * \param[in] callback The function to call for each triangle.
+ * \param[in] user A pointer passed through to the callback.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ */
+NIFLIB_API void ForEachCompressedMeshTriangle( const bhkCompressedMeshShapeData * data, CompressedMeshTriangleCallback callback, void * user, unsigned int num_threads = 0 );
+
+/*!
+ * Expands a bhkCompressedMeshShapeData into a flat triangle list.  The
+ * vertices of each chunk are written in chunk order, followed by the big
+ * vertices, and triangles index into the combined list.  Chunks are decoded
+ * in parallel.
+ * \param[in] data The shape data to expand.
+ * \param[out] vertices Receives the vertices in the space of the shape.
+ * \param[out] indices Receives three vertex indices per triangle.
+ * \param[out] materials Receives the material of each triangle.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ */
+NIFLIB_API void DecompressMeshShapeData( const bhkCompressedMeshShapeData * data, vector<Vector3> & vertices, vector<unsigned int> & indices, vector<SkyrimHavokMaterial> & materials, unsigned int num_threads = 0 );
+
+/*!
+ * Builds a bhkCompressedMeshShapeData from a triangle soup, the reverse of
+ * DecompressMeshShapeData.  Triangles are grouped by material and split
+ * along the longest axis of their centers until each group fits in the range
+ * a chunk can address with 16 bit quantized offsets (65535 * error on each
+ * axis) and holds no more than 4096 triangles.  Each chunk is placed at the
+ * lowest corner of its bounds and uses a shared identity transform.  Its
+ * triangles are joined into strips where they share edges, with the
+ * remaining triangles stored as a plain list.  Triangles that are too large
+ * to fit in any chunk are stored unquantized in the big triangle list.
+ * Chunks are built in parallel.  Degenerate triangles are dropped.
+ *
+ * Decoding the result gives back every vertex within half the error on each
+ * axis, with the winding of each triangle kept.
+ * \param[in] vertices The vertices of the mesh.
+ * \param[in] indices Three vertex indices per triangle.
+ * \param[in] materials The material of each triangle.
+ * \param[in] error The quantization step, which is also stored as the error
+ * of the shape.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ * \return The new shape data.
+ */
+NIFLIB_API Ref<bhkCompressedMeshShapeData> CompressMeshShapeData( const vector<Vector3> & vertices, const vector<unsigned int> & indices, const vector<SkyrimHavokMaterial> & materials, float error = 0.001f, unsigned int num_threads = 0 );
+
+} //End Niflib namespace
+#endif
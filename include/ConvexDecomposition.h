@@ -0,0 +1,110 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _CONVEX_DECOMPOSITION_H_
+#define _CONVEX_DECOMPOSITION_H_
+
+#include "nif_math.h"
+#include "Ref.h"
+#include "dll_export.h"
+#include "gen/enums.h"
+#include <vector>
+
+namespace Niflib {
+
+using namespace std;
+
+class bhkListShape;
+class bhkConvexVerticesShape;
+class NiTriBasedGeom;
+
+/*! Settings that control how finely a mesh is split into convex pieces. */
+struct ConvexDecompositionParams {
+	/*!
+	 * How deep a point of the mesh surface may lie inside the hull of its
+	 * piece, as a fraction of the diagonal of the mesh bounds.  Pieces that
+	 * are more concave than this are split further.
+	 */
+	float maxConcavity;
+	/*! The most pieces to produce. */
+	unsigned int maxHulls;
+	/*! The most vertices each piece may have, or zero for no limit. */
+	unsigned int maxHullVertices;
+	/*! The material given to the shapes that are created. */
+	HavokMaterial material;
+	/*! The convex radius given to the shapes that are created. */
+	float radius;
+	/*! The number of threads to use, zero for one per hardware thread. */
+	unsigned int numThreads;
+
+	/*! Default constructor */
+	NIFLIB_API ConvexDecompositionParams() : maxConcavity(0.01f), maxHulls(16), maxHullVertices(64), material((HavokMaterial)0), radius(0.0f), numThreads(0) {}
+};
+
+/*! One convex piece of a decomposition, in the form stored by bhkConvexVerticesShape. */
+struct ConvexPiece {
+	/*! The corners of the piece, sorted by x, then y, then z. */
+	vector<Vector3> vertices;
+	/*!
+	 * The face planes of the piece.  The first three components are the
+	 * outward unit normal and the fourth is the negated distance of the plane
+	 * from the origin, so a point p is inside when n * p + w <= 0.
+	 */
+	vector<Vector4> planes;
+};
+
+/*!
+ * Splits a triangle mesh into approximately convex pieces.  The mesh is cut
+ * recursively by axis aligned planes, always cutting the piece whose surface
+ * lies deepest inside its convex hull.  For each cut, up to 15 planes
+ * through the vertices of the piece along every axis are tried on several
+ * threads and the one that leaves the least concavity on both sides is kept.
+ * Triangles are kept whole.  Those that lie wholly on or below the plane go
+ * below it and the rest go above.  Splitting stops when every piece is
+ * within the concavity budget or the hull budget is used up.
+ * Flat pieces are given a small thickness so they still form a solid.  The
+ * function only works on the arrays it is given, so separate meshes may be
+ * decomposed on separate threads.  Throws a runtime_error if a triangle
+ * refers to a missing vertex or the mesh has no triangles with area.
+ * \param[in] vertices The vertices of the mesh.
+ * \param[in] triangles The triangles of the mesh.
+ * \param[out] pieces Receives the convex pieces.
+ * \param[in] params The decomposition settings.
+ */
+NIFLIB_API void DecomposeConvex( const vector<Vector3> & vertices, const vector<Triangle> & triangles, vector<ConvexPiece> & pieces, const ConvexDecompositionParams & params = ConvexDecompositionParams() );
+
+/*!
+ * Creates a bhkConvexVerticesShape from the convex hull of a point cloud,
+ * with its vertices and normals-and-distance planes filled in.
+ * Throws a runtime_error if the points are all on one plane.
+ * \param[in] points The points to wrap.
+ * \param[in] params The hull vertex limit, material and radius to use.
+ * \return The new shape.
+ */
+NIFLIB_API Ref<bhkConvexVerticesShape> CreateConvexVerticesShape( const vector<Vector3> & points, const ConvexDecompositionParams & params = ConvexDecompositionParams() );
+
+/*!
+ * Splits a triangle mesh into convex pieces with DecomposeConvex and wraps
+ * them in a bhkListShape of bhkConvexVerticesShape objects.
+ * \param[in] vertices The vertices of the mesh, in Havok units.
+ * \param[in] triangles The triangles of the mesh.
+ * \param[in] params The decomposition settings.
+ * \return The new list shape.
+ */
+NIFLIB_API Ref<bhkListShape> CreateConvexDecomposition( const vector<Vector3> & vertices, const vector<Triangle> & triangles, const ConvexDecompositionParams & params = ConvexDecompositionParams() );
+
+/*!
+ * Splits the triangles of a shape into convex pieces with DecomposeConvex
+ * and wraps them in a bhkListShape of bhkConvexVerticesShape objects.  The
+ * vertices are taken in the shape's own space.  Throws a runtime_error if
+ * the shape has no triangle data.
+ * \param[in] geom The shape to decompose.
+ * \param[in] params The decomposition settings.
+ * \param[in] scale The factor that converts the shape's units to Havok
+ * units.
+ * \return The new list shape.
+ */
+NIFLIB_API Ref<bhkListShape> CreateConvexDecomposition( NiTriBasedGeom * geom, const ConvexDecompositionParams & params = ConvexDecompositionParams(), float scale = 1.0f );
+
+} //End Niflib namespace
+#endif
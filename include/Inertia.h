@@ -7,6 +7,7 @@ All rights reserved.  Please see niflib.h for license. */
 
 //--Includes--//
 #include "nif_math.h"
+#include "dll_export.h"
 #include <vector>
 
 namespace Niflib {
@@ -45,7 +46,8 @@ public:
 		float density, bool solid,
 		float& mass, float& volume, Vector3& center, InertiaMatrix &inertia);
 
-	/*! Return mass and inertia matrix for a complex polyhedron
+	/*! Return mass and inertia matrix for a complex polyhedron.  If no
+	 *	triangles are given, the convex hull of the vertices is used.
 	 */
 	static void CalcMassPropertiesPolyhedron(
 		const vector<Vector3>& vertices, 
@@ -53,7 +55,23 @@ public:
 		float density, bool solid,
 		float& mass, float& volume, Vector3& center, InertiaMatrix &inertia);
 
-	/*! Combine mass properties for a number of objects */
+	/*! Return mass and inertia matrix for a closed triangle mesh stored in
+	 *	contiguous buffers, without copying them.  Four triangles are
+	 *	integrated at a time with SIMD instructions.  A mesh wound inside
+	 *	out gives the same result as one wound outward.  The volume is the
+	 *	enclosed volume for both solid and hollow bodies.  Throws a
+	 *	runtime_error if a triangle refers to a missing vertex.
+	 */
+	NIFLIB_API static void CalcMassPropertiesPolyhedron(
+		const Vector3 * vertices, unsigned int numVertices,
+		const Triangle * triangles, unsigned int numTriangles,
+		float density, bool solid,
+		float& mass, float& volume, Vector3& center, InertiaMatrix &inertia);
+
+	/*! Combine mass properties for a number of objects.  Each transform
+	 *	takes its object into the common space.  The combined inertia is
+	 *	taken about the combined center.
+	 */
 	static void CombineMassProperties(
 		vector<float> masses, 
 		vector<float> volumes, 
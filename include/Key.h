@@ -116,6 +116,102 @@ vector< Key<T> > ExtractKeySlice( const vector< Key<T> > & keys, float slice_sta
 }
 
 
+/*!
+ * Finds the pair of keys that bracket the given time using a binary search.
+ * \param[in] keys The vector of keys to search.  Keys must be sorted by time.
+ * \param[in] time The time to look up.
+ * \param[out] fraction The normalized position of time between the two keys,
+ * clamped to the range [0, 1].
+ * \return The index of the first key of the bracketing pair.  The second key
+ * is at the returned index + 1, unless the time lies outside of the keyed
+ * range in which case both keys are the same and fraction is zero.
+ */
+template <class T>
+size_t FindKeyInterval( const vector< Key<T> > & keys, float time, float & fraction ) {
+	fraction = 0.0f;
+	if ( keys.size() < 2 || time <= keys[0].time ) {
+		return 0;
+	}
+	size_t last = keys.size() - 1;
+	if ( time >= keys[last].time ) {
+		return last;
+	}
+
+	size_t lo = 0, hi = last;
+	while ( hi - lo > 1 ) {
+		size_t mid = ( lo + hi ) / 2;
+		if ( keys[mid].time <= time ) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+
+	float span = keys[hi].time - keys[lo].time;
+	if ( span > 0.0f ) {
+		fraction = ( time - keys[lo].time ) / span;
+	}
+	return lo;
+}
+
+/*!
+ * Evaluates a vector of keys at the given time.  The type T must support
+ * addition, subtraction and multiplication by a float.  Quaternion keys
+ * need spherical interpolation and are not handled by this function.
+ * \param[in] keys The vector of keys to evaluate.  Keys must be sorted by time.
+ * \param[in] type The type of interpolation stored in the keys.
+ * \param[in] time The time at which to evaluate the keys.
+ * \param[in] default_value The value to return if there are no keys.
+ * \return The interpolated value.  Times outside of the keyed range are
+ * clamped to the first or last key.
+ */
+template <class T>
+T InterpolateKeys( const vector< Key<T> > & keys, KeyType type, float time, const T & default_value ) {
+	if ( keys.empty() ) {
+		return default_value;
+	}
+
+	float t;
+	size_t i = FindKeyInterval( keys, time, t );
+	if ( i + 1 >= keys.size() || t <= 0.0f ) {
+		return keys[i].data;
+	}
+
+	const Key<T> & k0 = keys[i];
+	const Key<T> & k1 = keys[i + 1];
+
+	switch ( type ) {
+		case CONST_KEY:
+			return k0.data;
+		case QUADRATIC_KEY:
+		case TBC_KEY: {
+			//Cubic Hermite spline between the two keys
+			T out_tan = k0.forward_tangent;
+			T in_tan = k1.backward_tangent;
+			if ( type == TBC_KEY ) {
+				//Derive Kochanek-Bartels tangents from the neighbouring keys
+				const Key<T> & kp = ( i > 0 ) ? keys[i - 1] : k0;
+				const Key<T> & kn = ( i + 2 < keys.size() ) ? keys[i + 2] : k1;
+				float a0 = ( 1.0f - k0.tension ) * ( 1.0f + k0.continuity ) * ( 1.0f + k0.bias ) * 0.5f;
+				float b0 = ( 1.0f - k0.tension ) * ( 1.0f - k0.continuity ) * ( 1.0f - k0.bias ) * 0.5f;
+				float a1 = ( 1.0f - k1.tension ) * ( 1.0f - k1.continuity ) * ( 1.0f + k1.bias ) * 0.5f;
+				float b1 = ( 1.0f - k1.tension ) * ( 1.0f + k1.continuity ) * ( 1.0f - k1.bias ) * 0.5f;
+				out_tan = ( k0.data - kp.data ) * a0 + ( k1.data - k0.data ) * b0;
+				in_tan = ( k1.data - k0.data ) * a1 + ( kn.data - k1.data ) * b1;
+			}
+			float t2 = t * t;
+			float t3 = t2 * t;
+			float h00 = 2.0f * t3 - 3.0f * t2 + 1.0f;
+			float h10 = t3 - 2.0f * t2 + t;
+			float h01 = -2.0f * t3 + 3.0f * t2;
+			float h11 = t3 - t2;
+			return k0.data * h00 + out_tan * h10 + k1.data * h01 + in_tan * h11;
+		}
+		default:
+			return k0.data + ( k1.data - k0.data ) * t;
+	}
+}
+
 } //end namespace Niflib
 
 #endif
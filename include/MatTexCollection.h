@@ -8,8 +8,10 @@ All rights reserved.  Please see niflib.h for license. */
 #include "gen/enums.h"
 #include "dll_export.h"
 #include "nif_versions.h"
+#include "nif_basic_types.h"
 #include <vector>
 #include <string>
+#include <unordered_map>
 
 namespace Niflib {
 
@@ -33,6 +35,21 @@ class NiMultiTextureProperty;
 class NiStencilProperty;
 class NiSourceTexture;
 class NiImage;
+class NiPixelData;
+class TextureLibrary;
+
+/*! What MatTexCollection::ShareProperties removed from a scene. */
+struct PropertyShareResult {
+	/*! The number of properties that were replaced by an identical one. */
+	unsigned int propertiesRemoved;
+	/*! The number of BSShaderTextureSet objects that were replaced by an identical one. */
+	unsigned int textureSetsRemoved;
+	/*! The number of bytes of block data the removed objects took up in the file. */
+	unsigned int bytesSaved;
+
+	/*! Default constructor */
+	NIFLIB_API PropertyShareResult() : propertiesRemoved(0), textureSetsRemoved(0), bytesSaved(0) {}
+};
 
 /*!
  * A helper class used to gather and create material and texturing information
@@ -185,11 +202,70 @@ public:
 	 * \return The index of the newly created material.
 	 */
 	NIFLIB_API unsigned int CreateMaterial( bool color, bool texture, bool multi_tex, bool specular, bool translucenty, unsigned int version = VER_4_0_0_2 );
+
+	/*!
+	 * Moves every texture packed into the scene out to a texture library and
+	 * points its NiSourceTexture at the DDS file.  Textures that are already
+	 * external, and old style NiImage textures, are left alone.
+	 * \param[in] library Where to put the textures.
+	 * \return The number of textures that were moved out.
+	 */
+	NIFLIB_API unsigned int ExternalizeTextures( TextureLibrary & library );
+
+	/*!
+	 * Packs every external texture of the scene into the scene, the reverse
+	 * of ExternalizeTextures.  Textures that name the same file share one
+	 * NiPixelData object.  Old style NiImage textures are left alone.  Throws
+	 * a runtime_error if a texture file cannot be read.
+	 * \param[in] library Where to find the textures.
+	 * \return The number of textures that were packed.
+	 */
+	NIFLIB_API unsigned int InternalizeTextures( TextureLibrary & library );
+
+	/*!
+	 * Makes objects in a scene share identical properties, then gathers the
+	 * materials of the scene again, which is usually fewer than before.
+	 * Every NiProperty in the property lists of the scene and in the
+	 * BSProperty slots of its geometry is compared by the data it would write
+	 * to a file of the given version, as are the BSShaderTextureSet objects of
+	 * shader properties.  Links count as equal when they point to the same
+	 * object, so texture sets are shared first.  Properties with controllers
+	 * are left alone, since each controller targets one property.
+	 * \param[in] scene_root The root of the scene to change.
+	 * \param[in] info The version of the file the scene will be written to.
+	 * \param[in] ignore_names If true, properties that only differ by name are
+	 * shared too, and take the name of the first one found.
+	 * \return What was removed from the scene.
+	 */
+	NIFLIB_API PropertyShareResult ShareProperties( NiAVObject * scene_root, const NifInfo & info, bool ignore_names = false );
 private:
+	/*! The properties that make up a material, in the order taken by GetMaterialIndex. */
+	struct MaterialKey {
+		NiProperty * props[7];
+		bool operator==( const MaterialKey & other ) const;
+	};
+	/*! Hashes the property pointers of a MaterialKey. */
+	struct MaterialKeyHash {
+		size_t operator()( const MaterialKey & key ) const;
+	};
+
+	/*! NIFLIB_HIDDEN function.  For internal use only. */
+	NIFLIB_HIDDEN static void CollectObjects( NiAVObject * scene_root, vector<NiAVObject *> & objects );
+	/*! NIFLIB_HIDDEN function.  For internal use only. */
+	NIFLIB_HIDDEN static void SortProperties( const vector< Ref<NiProperty> > & properties, Ref<NiMaterialProperty> & mat, Ref<NiTexturingProperty> & texing, Ref<NiTextureProperty> & tex, Ref<NiMultiTextureProperty> & multi, Ref<NiSpecularProperty> & spec, Ref<NiAlphaProperty> & alpha, Ref<NiStencilProperty> & stencil );
+	/*! NIFLIB_HIDDEN function.  For internal use only. */
+	NIFLIB_HIDDEN unsigned int AddMaterial( const MaterialWrapper & material );
+	/*! NIFLIB_HIDDEN function.  For internal use only. */
+	NIFLIB_HIDDEN unsigned int AddTexture( const TextureWrapper & texture );
+
 	/*! The vector of materials that this collection holds. */
 	vector<MaterialWrapper> materials;
 	/*! The vector of textures that this collection holds. */
 	vector<TextureWrapper> textures;
+	/*! The index of each material, by the properties that make it up. */
+	unordered_map<MaterialKey, unsigned int, MaterialKeyHash> material_index;
+	/*! The index of each texture, by its NiSourceTexture or NiImage object. */
+	unordered_map<const void *, unsigned int> texture_index;
 };
 
 /*
@@ -383,6 +459,23 @@ public:
 	 */
 	NIFLIB_API void SetExternalTexture( const string & file_name );
 
+	/*
+	 * Retrieves the pixel data of a texture that is packed into the NIF file.
+	 * Only NiSourceTexture objects store NiPixelData, so older texture objects
+	 * always return NULL.
+	 * \return The packed pixel data, or NULL if there is none.
+	 */
+	NIFLIB_API Ref<NiPixelData> GetPixelData();
+
+	/*
+	 * Changes the texture mode to internal, packing the given pixel data into
+	 * the NIF file.  The file name is kept as the name of the original file.
+	 * Older texture objects cannot store NiPixelData, so calling this function
+	 * on them throws an exception.
+	 * \param[in] pixel_data The pixel data to pack into the file.
+	 */
+	NIFLIB_API void SetInternalTexture( NiPixelData * pixel_data );
+
 	/*
 	 * Gets the pixel layout of the texture.  This describes the image format
 	 * of the texture, such as palattized, 32-bit, etc.
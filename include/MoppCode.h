@@ -0,0 +1,117 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _MOPP_CODE_H_
+#define _MOPP_CODE_H_
+
+#include "nif_math.h"
+#include "nif_basic_types.h"
+#include "dll_export.h"
+#include <vector>
+
+namespace Niflib {
+
+using namespace std;
+
+class bhkMoppBvTreeShape;
+class hkPackedNiTriStripsData;
+
+/*!
+ * MOPP code together with the frame it was compiled in.  Points are brought
+ * into MOPP space as (point - origin) * scale, which maps the compiled mesh
+ * onto 0 to 256 * 256 * 254 along its largest axis.
+ */
+struct MoppCode {
+	/*! The corner of the MOPP space, the minimum of all vertices minus 0.1. */
+	Vector3 origin;
+	/*! The quantization scale, 256 * 256 * 254 / (size + 0.2). */
+	float scale;
+	/*! The MOPP byte code. */
+	vector<byte> code;
+
+	/*! Default constructor */
+	NIFLIB_API MoppCode() : scale(1.0f) {}
+};
+
+/*!
+ * Compiles a bounding volume tree over a triangle mesh into MOPP code.  The
+ * mesh is split recursively at the median triangle center along the longest
+ * axis, and each split is written as a two plane axis test using the opcodes
+ * known from files written by the Havok tools: 0x26 to 0x28 bound checks
+ * around the whole mesh, 0x10 to 0x12 splits with byte jumps, 0x23 to 0x25
+ * splits with short jumps, and 0x30 to 0x4F, 0x50 and 0x51 triangle leaves.
+ * Throws a runtime_error if a part of the tree would need a jump longer than
+ * 65535 bytes.
+ * \param[in] vertices The vertices of the mesh.
+ * \param[in] triangles The triangles of the mesh.  A triangle's position in
+ * this list is the id reported by queries.
+ * \return The compiled code and its frame.
+ */
+NIFLIB_API MoppCode CompileMopp( const vector<Vector3> & vertices, const vector<Triangle> & triangles );
+
+/*!
+ * Compiles MOPP code for the triangles of packed collision data.  Triangles
+ * that repeat a vertex are left out, but the others keep their index into
+ * hkPackedNiTriStripsData::GetHavokTriangleArray as their id, since that is
+ * what Havok shape keys refer to.
+ * \param[in] data The packed data to compile.
+ * \return The compiled code and its frame.
+ */
+NIFLIB_API MoppCode CompileMopp( const hkPackedNiTriStripsData * data );
+
+/*!
+ * Regenerates the MOPP code, origin and scale of a bhkMoppBvTreeShape from
+ * the hkPackedNiTriStripsData of the bhkPackedNiTriStripsShape it wraps.
+ * Throws a runtime_error if the shape does not wrap packed triangle data.
+ * \param[in] shape The shape to update.
+ */
+NIFLIB_API void UpdateMoppCode( bhkMoppBvTreeShape * shape );
+
+/*!
+ * Reads the MOPP code, origin and scale of a bhkMoppBvTreeShape.
+ * \param[in] shape The shape to read.
+ * \return The shape's code and its frame.
+ */
+NIFLIB_API MoppCode GetMoppCode( const bhkMoppBvTreeShape * shape );
+
+/*!
+ * Runs MOPP code to find the triangles whose bounds may overlap a box.  The
+ * result is conservative: every triangle that overlaps the box is reported,
+ * along with some that only come close.  Code written by other tools may
+ * use rescaling (0x01 to 0x04) and diagonal plane (0x13 to 0x1C) opcodes
+ * whose exact meaning is not known.  Below such an opcode every branch is
+ * followed, so the result stays complete but is less tight.  Throws a
+ * runtime_error on unknown opcodes and truncated code.
+ * \param[in] mopp The code and its frame.
+ * \param[in] box_min The minimum corner of the box, in the space of the mesh.
+ * \param[in] box_max The maximum corner of the box, in the space of the mesh.
+ * \param[out] triangles Receives the ids of the candidate triangles.
+ */
+NIFLIB_API void QueryMoppAabb( const MoppCode & mopp, const Vector3 & box_min, const Vector3 & box_max, vector<unsigned int> & triangles );
+
+/*!
+ * Runs MOPP code to find the triangles that may be hit by a line segment.
+ * The result is conservative in the same way as QueryMoppAabb.
+ * \param[in] mopp The code and its frame.
+ * \param[in] from The start of the segment, in the space of the mesh.
+ * \param[in] to The end of the segment, in the space of the mesh.
+ * \param[out] triangles Receives the ids of the candidate triangles.
+ */
+NIFLIB_API void QueryMoppRay( const MoppCode & mopp, const Vector3 & from, const Vector3 & to, vector<unsigned int> & triangles );
+
+/*!
+ * Casts a line segment against a triangle mesh, using its MOPP code to skip
+ * triangles that cannot be hit.
+ * \param[in] mopp The code compiled for the mesh.
+ * \param[in] vertices The vertices of the mesh.
+ * \param[in] triangles The triangles of the mesh.
+ * \param[in] from The start of the segment.
+ * \param[in] to The end of the segment.
+ * \param[out] fraction Receives the position of the closest hit along the
+ * segment, from 0 at the start to 1 at the end.
+ * \return The id of the closest triangle hit, or -1 if nothing was hit.
+ */
+NIFLIB_API int RayCastMopp( const MoppCode & mopp, const vector<Vector3> & vertices, const vector<Triangle> & triangles, const Vector3 & from, const Vector3 & to, float & fraction );
+
+} //End Niflib namespace
+#endif
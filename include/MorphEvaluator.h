@@ -0,0 +1,113 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _MORPH_EVALUATOR_H_
+#define _MORPH_EVALUATOR_H_
+
+#include "Ref.h"
+#include "Key.h"
+#include "nif_math.h"
+#include "dll_export.h"
+#include <vector>
+
+namespace Niflib {
+
+using namespace std;
+
+class NiMorphData;
+class NiGeomMorpherController;
+
+/*!
+ * Evaluates the blended shape of a morphing mesh.  The morph targets are
+ * copied once on construction into contiguous structure-of-arrays buffers,
+ * so repeated evaluation only touches the targets whose weight is not close
+ * to zero and never copies vertex data out of the NiMorphData object.
+ * Evaluation reuses internal scratch buffers, so a single evaluator must not
+ * be used from several threads at once.
+ */
+class MorphEvaluator {
+public:
+	/*!
+	 * Creates an evaluator which takes its weights from the keys stored in
+	 * the morph data.
+	 * \param[in] data The morph data to evaluate.
+	 */
+	NIFLIB_API MorphEvaluator( NiMorphData * data );
+
+	/*!
+	 * Creates an evaluator for the data attached to a geometry morpher
+	 * controller.  Weights are sampled from the interpolators of the
+	 * controller where they exist, and from the keys in the morph data
+	 * otherwise.
+	 * \param[in] ctrl The controller to evaluate.
+	 */
+	NIFLIB_API MorphEvaluator( NiGeomMorpherController * ctrl );
+
+	/*! Destructor */
+	NIFLIB_API ~MorphEvaluator();
+
+	/*!
+	 * Reports the number of vertices in each morph target.
+	 * \return The vertex count.
+	 */
+	NIFLIB_API unsigned int GetVertexCount() const;
+
+	/*!
+	 * Reports the number of morph targets, including the base shape.
+	 * \return The morph count.
+	 */
+	NIFLIB_API unsigned int GetMorphCount() const;
+
+	/*!
+	 * Sets the weight below which a morph target is skipped entirely.
+	 * \param[in] threshold The absolute weight threshold.  The default is
+	 * 0.0001.
+	 */
+	NIFLIB_API void SetWeightThreshold( float threshold );
+
+	/*!
+	 * Samples the weight of every morph target.
+	 * \param[in] time The time to sample at, in the key time of the morph data.
+	 * \param[out] weights Receives one weight per morph target.  For relative
+	 * targets the weight of the base shape is always one.
+	 */
+	NIFLIB_API void SampleWeights( float time, vector<float> & weights ) const;
+
+	/*!
+	 * Blends the morph targets with the given weights.
+	 * \param[in] weights One weight per morph target, as filled in by
+	 * SampleWeights.  Missing entries count as zero.
+	 * \param[out] out Receives the blended vertex positions.
+	 */
+	NIFLIB_API void Evaluate( const vector<float> & weights, vector<Vector3> & out ) const;
+
+	/*!
+	 * Samples the morph weights and blends the morph targets in one step.
+	 * \param[in] time The time to sample at, in the key time of the morph data.
+	 * \param[out] out Receives the blended vertex positions.
+	 */
+	NIFLIB_API void Evaluate( float time, vector<Vector3> & out ) const;
+
+private:
+	struct WeightChannel {
+		vector< Key<float> > keys;
+		KeyType type;
+		float constant;
+	};
+
+	void Init( NiMorphData * data, NiGeomMorpherController * ctrl );
+
+	unsigned int numVertices;
+	unsigned int paddedVertices;
+	bool relative;
+	float threshold;
+	//Morph targets, one padded block of paddedVertices floats per target
+	vector<float> dx, dy, dz;
+	vector<WeightChannel> channels;
+	//Scratch buffers for the accumulated result
+	mutable vector<float> ax, ay, az;
+	mutable vector<float> scratchWeights;
+};
+
+} //End Niflib namespace
+#endif
@@ -0,0 +1,169 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _NIF_DOCUMENT_H_
+#define _NIF_DOCUMENT_H_
+
+#include "Ref.h"
+#include "dll_export.h"
+#include "nif_basic_types.h"
+#include "ObjectArena.h"
+#include "gen/Header.h"
+#include <vector>
+#include <string>
+#include <fstream>
+
+namespace Niflib {
+
+using namespace std;
+
+class NiObject;
+
+/*!
+ * A NIF file that is read one block at a time, as the blocks are used.
+ * Opening the file reads only the header and finds where each block starts,
+ * from the block sizes in the header for version 20.2.0.7 and later, or by
+ * skimming through the blocks once for older versions.
+ *
+ * A block is read the first time it is asked for with GetBlock, GetRoot or
+ * Materialize.  Its links are fixed straight away and point at the objects
+ * of the blocks they link to, which are placeholders (see
+ * NiObject::IsPlaceholder) until they are read in turn.  Since a block is
+ * read into its placeholder, links that were fixed earlier see the data as
+ * soon as it is read.  Memory use and reading time so grow with the part of
+ * the file that is used.
+ *
+ * The objects of the blocks are allocated from an ObjectArena owned by the
+ * document.  The file is kept open for the life of the document.  Objects
+ * may be kept after the document is destroyed, but placeholders can no
+ * longer be read then.  Files older than version 3.3.0.13 are not supported.
+ *
+ * <b>Example:</b>
+ * \code
+ * NifDocument doc( "tree.nif" );
+ * NiNodeRef root = DynamicCast<NiNode>( doc.GetRoot() );
+ * vector<NiAVObjectRef> children = root->GetChildren();
+ * NiAVObjectRef first = doc.Load( children[0] );
+ * \endcode
+ */
+class NifDocument {
+public:
+	/*!
+	 * Opens a file and reads its header.
+	 * \param[in] file_name The file to open.
+	 */
+	NIFLIB_API NifDocument( const string & file_name );
+
+	/*! Destructor */
+	NIFLIB_API ~NifDocument();
+
+	/*!
+	 * Gets the version and other information from the header of the file.
+	 * \return The information from the header.
+	 */
+	NIFLIB_API const NifInfo & GetInfo() const;
+
+	/*!
+	 * Gets the header of the file.
+	 * \return The header.
+	 */
+	NIFLIB_API const Header & GetHeader() const;
+
+	/*!
+	 * Gets the number of blocks in the file.
+	 * \return The number of blocks.
+	 */
+	NIFLIB_API unsigned int GetBlockCount() const;
+
+	/*!
+	 * Gets the type of a block without reading it.
+	 * \param[in] index The index of the block.
+	 * \return The name of the type of the block.
+	 */
+	NIFLIB_API string GetBlockType( unsigned int index ) const;
+
+	/*!
+	 * Gets the object of a block, reading it if it has not been read yet.
+	 * \param[in] index The index of the block.
+	 * \return The object.
+	 */
+	NIFLIB_API Ref<NiObject> GetBlock( unsigned int index );
+
+	/*!
+	 * Gets the first root object listed at the end of the file, reading it
+	 * if it has not been read yet.
+	 * \return The root object, or the first block if the file lists none.
+	 */
+	NIFLIB_API Ref<NiObject> GetRoot();
+
+	/*!
+	 * Reads the block of an object if it is a placeholder of this document.
+	 * Other objects are left alone.
+	 * \param[in] obj The object to read.
+	 */
+	NIFLIB_API void Materialize( NiObject * obj );
+
+	/*!
+	 * Reads the block of an object, if needed, and returns it.  This is the
+	 * accessor to use while walking links.
+	 * \param[in] obj The object to read.
+	 * \return The same object.
+	 */
+	template <class T>
+	Ref<T> Load( const Ref<T> & obj ) {
+		if ( obj != NULL ) {
+			Materialize( obj );
+		}
+		return obj;
+	}
+
+	/*!
+	 * Reads every block that can be reached through the references of an
+	 * object, such as the whole scene below a node, so that it can be
+	 * written or cloned.
+	 * \param[in] root The object to start from.
+	 */
+	NIFLIB_API void MaterializeTree( NiObject * root );
+
+	/*!
+	 * Reads every block that has not been read yet.
+	 */
+	NIFLIB_API void MaterializeAll();
+
+	/*!
+	 * Gets the number of blocks that have been read.
+	 * \return The number of blocks read.
+	 */
+	NIFLIB_API unsigned int GetMaterializedCount() const;
+
+	/*!
+	 * Gets the arena the objects of the blocks are allocated from.
+	 * \return The arena.
+	 */
+	NIFLIB_API const ObjectArena & GetArena() const;
+
+private:
+	NifDocument( const NifDocument & );
+	NifDocument & operator=( const NifDocument & );
+
+	NiObject * GetPlaceholder( unsigned int index );
+	void ReadBlock( unsigned int index );
+
+	ifstream in;
+	Header header;
+	NifInfo info;
+	/*! The index into type_names of the type of each block. */
+	vector<unsigned int> block_types;
+	vector<string> type_names;
+	/*! Where the data of each block starts in the file. */
+	vector<streampos> offsets;
+	ObjectArena arena;
+	/*! The object of each block, or NULL before it is needed. */
+	vector< Ref<NiObject> > blocks;
+	vector<bool> materialized;
+	unsigned int materialized_count;
+	vector<unsigned int> roots;
+};
+
+} //End Niflib namespace
+#endif
@@ -0,0 +1,81 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _NODE_NAME_INDEX_H_
+#define _NODE_NAME_INDEX_H_
+
+#include "Ref.h"
+#include "dll_export.h"
+#include <string>
+#include <unordered_map>
+
+namespace Niflib {
+
+using namespace std;
+
+class NiNode;
+
+/*!
+ * Maps node names to the NiNode objects of a scene graph, so that repeated
+ * lookups do not need to walk the tree.  The index remembers the hierarchy
+ * revision that NiNode::GetHierarchyRevision reported for its root when it
+ * was built and rebuilds itself on the next lookup after children have been
+ * added to or removed from a node of that tree.  Edits to other trees do
+ * not invalidate it.  Renaming a node is not detected; call Invalidate
+ * after doing so.  If several nodes share a name, the one found last in a
+ * depth first walk of the tree wins, as with the name maps used by
+ * MergeNifTrees.
+ */
+class NodeNameIndex {
+public:
+	/*!
+	 * Constructor.
+	 * \param[in] root The root of the tree to index, or NULL to create an
+	 * empty index.
+	 */
+	NIFLIB_API NodeNameIndex( NiNode * root = NULL );
+
+	/*! Destructor */
+	NIFLIB_API ~NodeNameIndex();
+
+	/*!
+	 * Changes the tree covered by the index.  The tree is walked on the next
+	 * lookup.
+	 * \param[in] root The root of the tree to index.
+	 */
+	NIFLIB_API void SetRoot( NiNode * root );
+
+	/*!
+	 * Retrieves the root of the indexed tree.
+	 * \return The root node.
+	 */
+	NIFLIB_API Ref<NiNode> GetRoot() const;
+
+	/*! Forces the tree to be walked again on the next lookup. */
+	NIFLIB_API void Invalidate();
+
+	/*!
+	 * Looks up a node by name.
+	 * \param[in] name The name of the node.
+	 * \return The node, or NULL if no node in the tree has this name.
+	 */
+	NIFLIB_API Ref<NiNode> Find( const string & name ) const;
+
+	/*!
+	 * Reports the number of distinct node names in the tree.
+	 * \return The number of names.
+	 */
+	NIFLIB_API unsigned int GetNameCount() const;
+
+private:
+	void Update() const;
+	void AddNode( NiNode * node ) const;
+
+	Ref<NiNode> root;
+	mutable unordered_map<string,NiNode*> names;
+	mutable bool valid;
+	mutable unsigned int revision;
+};
+
+} //End Niflib namespace
+#endif
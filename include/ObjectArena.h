@@ -0,0 +1,111 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _OBJECT_ARENA_H_
+#define _OBJECT_ARENA_H_
+
+#include "dll_export.h"
+#include <cstddef>
+
+namespace Niflib {
+
+using namespace std;
+
+class RefObject;
+struct ArenaState;
+
+/*!
+ * Large blocks of memory that objects are carved from while the arena is
+ * active, instead of each object being allocated from the heap by itself.
+ * Loading a big file then takes a few large allocations rather than one per
+ * block, and the memory is given back all at once.
+ *
+ * Objects are still reference counted and destroyed one at a time, but
+ * freeing one only counts it off.  The memory is released when the arena
+ * has been destroyed and the last object carved from it has been deleted,
+ * so objects that outlive the arena, such as ones detached from a document
+ * and kept, remain valid.  Objects created while no arena is active come
+ * from the heap as usual.
+ *
+ * Every object, from an arena or from the heap, is preceded by a header
+ * naming where it came from.  The header is padded to the alignment of
+ * max_align_t, which makes it 16 bytes on x86-64.
+ *
+ * Objects may be created from an arena by one thread at a time, but may be
+ * released on any thread.
+ *
+ * <b>Example:</b>
+ * \code
+ * ObjectArena arena;
+ * vector<NiObjectRef> objects;
+ * {
+ *    ObjectArena::Scope scope( arena );
+ *    objects = ReadNifList( "tree.nif" );
+ * }
+ * \endcode
+ */
+class ObjectArena {
+public:
+	/*!
+	 * Constructor
+	 * \param[in] block_size The size of each block of memory the arena
+	 * allocates.  Objects bigger than this get a block of their own.
+	 */
+	NIFLIB_API ObjectArena( size_t block_size = 256 * 1024 );
+
+	/*!
+	 * Destructor.  The memory is released once every object carved from it
+	 * has been deleted.
+	 */
+	NIFLIB_API ~ObjectArena();
+
+	/*!
+	 * Makes an arena active on the current thread for as long as the scope
+	 * exists.  Scopes can be nested; the innermost one wins.
+	 */
+	class Scope {
+	public:
+		/*!
+		 * Constructor
+		 * \param[in] arena The arena to allocate objects from.
+		 */
+		NIFLIB_API Scope( ObjectArena & arena );
+
+		/*! Destructor.  Makes the previous arena, if any, active again. */
+		NIFLIB_API ~Scope();
+
+	private:
+		Scope( const Scope & );
+		Scope & operator=( const Scope & );
+		ArenaState * previous;
+	};
+
+	/*!
+	 * Gets the number of objects carved from this arena that have not been
+	 * deleted yet.
+	 * \return The number of live objects.
+	 */
+	NIFLIB_API size_t GetObjectCount() const;
+
+	/*!
+	 * Gets the number of bytes of the blocks this arena has allocated.
+	 * \return The number of bytes allocated.
+	 */
+	NIFLIB_API size_t GetBytesAllocated() const;
+
+private:
+	ObjectArena( const ObjectArena & );
+	ObjectArena & operator=( const ObjectArena & );
+
+	friend class RefObject;
+	/*! NIFLIB_HIDDEN function.  Allocates from the active arena, or the heap. */
+	NIFLIB_HIDDEN static void * Allocate( size_t size );
+	/*! NIFLIB_HIDDEN function.  Frees memory from Allocate. */
+	NIFLIB_HIDDEN static void Free( void * p );
+
+	/*! The shared state, which lives until the last object is deleted. */
+	ArenaState * state;
+};
+
+} //End Niflib namespace
+#endif
@@ -0,0 +1,123 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _PIXEL_CODEC_H_
+#define _PIXEL_CODEC_H_
+
+#include "dll_export.h"
+#include "nif_basic_types.h"
+#include "gen/enums.h"
+#include <vector>
+
+namespace Niflib {
+
+using namespace std;
+
+/*!
+ * One image to be converted by DecodePixelImages, EncodePixelImages or
+ * DownsamplePixelImages.
+ * Pixels are stored one row after another, in the same row order as the
+ * pixel data of a NiPixelData object.
+ */
+struct PixelImage {
+	/*! The pixels to convert. */
+	const byte * in;
+	/*! Receives the converted pixels. */
+	byte * out;
+	/*! The width of the image in pixels. */
+	unsigned int width;
+	/*! The height of the image in pixels. */
+	unsigned int height;
+
+	/*! Default constructor */
+	NIFLIB_API PixelImage() : in(NULL), out(NULL), width(0), height(0) {}
+	/*! Constructor */
+	NIFLIB_API PixelImage( const byte * in, byte * out, unsigned int width, unsigned int height ) : in(in), out(out), width(width), height(height) {}
+};
+
+/*! The filters DownsamplePixelImages can use. */
+enum MipmapFilter {
+	MIPMAP_BOX, /*!< Averages the pixels that each new pixel covers. */
+	MIPMAP_KAISER, /*!< A Kaiser windowed sinc reaching three new pixels to each side, which keeps more detail but may ring at hard edges. */
+};
+
+/*!
+ * Returns the number of bytes one image takes up in a pixel format.  The
+ * compressed formats store 4x4 blocks, so partial blocks at the right and
+ * bottom edges are rounded up.  Throws a runtime_error for formats that
+ * are not supported.
+ * \param[in] format The pixel format.
+ * \param[in] width The width of the image in pixels.
+ * \param[in] height The height of the image in pixels.
+ * \return The size of the image in bytes.
+ */
+NIFLIB_API unsigned int GetPixelImageSize( PixelFormat format, unsigned int width, unsigned int height );
+
+/*!
+ * Decodes images in a pixel format to 8-bit RGBA, four bytes per pixel.
+ * Work is split across threads by rows of blocks over all the images, so a
+ * whole mipmap chain can be decoded in one call.  PX_FMT_DXT1 is decoded
+ * as BC1, with the three color mode giving transparent black, and
+ * PX_FMT_DXT5 and PX_FMT_DXT5_ALT are decoded as BC3.  The bump formats
+ * put du and dv in red and green, offset by 128, and the luminance in blue,
+ * or 255 when there is none.  Throws a runtime_error for formats that are
+ * not supported, or for palettized formats without a palette.
+ * \param[in] format The pixel format of the input.
+ * \param[in] images The images to decode.  Each output must have room for
+ * width * height * 4 bytes.
+ * \param[in] palette 256 RGBA entries for the palettized formats, or NULL.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ */
+NIFLIB_API void DecodePixelImages( PixelFormat format, const vector<PixelImage> & images, const byte * palette = NULL, unsigned int num_threads = 0 );
+
+/*!
+ * Encodes 8-bit RGBA images to a pixel format, the reverse of
+ * DecodePixelImages.  BC1 and BC3 blocks are fit along the principal axis
+ * of their colors and refined once by least squares.  PX_FMT_DXT1 blocks
+ * with pixels whose alpha is under 128 use the three color mode, with
+ * those pixels transparent.  Palettized formats pick the nearest palette
+ * entry, comparing alpha only for PX_FMT_PALA8.  Throws a runtime_error for
+ * formats that are not supported, or for palettized formats without a
+ * palette.
+ * \param[in] format The pixel format of the output.
+ * \param[in] images The images to encode.  Each output must have room for
+ * GetPixelImageSize bytes.
+ * \param[in] palette 256 RGBA entries for the palettized formats, or NULL.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ */
+NIFLIB_API void EncodePixelImages( PixelFormat format, const vector<PixelImage> & images, const byte * palette = NULL, unsigned int num_threads = 0 );
+
+/*!
+ * Decodes one image to 8-bit RGBA.
+ * \sa DecodePixelImages
+ */
+NIFLIB_API void DecodePixels( PixelFormat format, const byte * in, unsigned int width, unsigned int height, byte * out, const byte * palette = NULL, unsigned int num_threads = 0 );
+
+/*!
+ * Encodes one 8-bit RGBA image.
+ * \sa EncodePixelImages
+ */
+NIFLIB_API void EncodePixels( PixelFormat format, const byte * in, unsigned int width, unsigned int height, byte * out, const byte * palette = NULL, unsigned int num_threads = 0 );
+
+/*!
+ * Scales 8-bit RGBA images down to the size of their next mipmap, half the
+ * width and height rounded down but no less than one.  Sizes do not need to
+ * be powers of two or square; odd sizes are filtered by how much of each
+ * pixel a new pixel covers.  Pixels beyond the edges repeat the edge.  The
+ * filter runs on four channels at a time, split across threads by rows
+ * over all the images, so all faces of a cube map can be scaled in one
+ * call.  The output must not overlap the input.
+ * \param[in] images The images to scale.  Each output must have room for
+ * four bytes per pixel of the smaller image.
+ * \param[in] filter The filter to use.
+ * \param[in] linear If true, the red, green and blue channels are treated as
+ * sRGB and filtered in linear light.  Alpha is always filtered as it is.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ */
+NIFLIB_API void DownsamplePixelImages( const vector<PixelImage> & images, MipmapFilter filter = MIPMAP_BOX, bool linear = false, unsigned int num_threads = 0 );
+
+} //End Niflib namespace
+#endif
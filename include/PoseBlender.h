@@ -0,0 +1,275 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _POSE_BLENDER_H_
+#define _POSE_BLENDER_H_
+
+#include "Ref.h"
+#include "nif_math.h"
+#include "dll_export.h"
+#include <vector>
+#include <string>
+
+namespace Niflib {
+
+using namespace std;
+
+class NiControllerSequence;
+
+/*!
+ * Stores the local transforms of a fixed list of bones in structure-of-arrays
+ * layout, so that blending can operate on several bones at once.  Array
+ * lengths are padded up to a multiple of four; the padding entries always
+ * carry a weight of zero.
+ */
+struct PoseBuffer {
+	/*! Default constructor.  Creates an empty pose. */
+	NIFLIB_API PoseBuffer();
+
+	/*!
+	 * Constructor which creates a pose of the given size with every bone set
+	 * to the identity transform and a weight of zero.
+	 * \param[in] num_bones The number of bones in the pose.
+	 */
+	NIFLIB_API explicit PoseBuffer( unsigned int num_bones );
+
+	/*!
+	 * Changes the number of bones stored in this pose.  Existing bones keep
+	 * their values, new bones are set to the identity transform with a
+	 * weight of zero.
+	 * \param[in] num_bones The new number of bones.
+	 */
+	NIFLIB_API void Resize( unsigned int num_bones );
+
+	/*!
+	 * Reports the number of bones stored in this pose, not counting padding.
+	 * \return The number of bones.
+	 */
+	NIFLIB_API unsigned int GetNumBones() const;
+
+	/*!
+	 * Sets every bone to the identity transform.
+	 * \param[in] weight The weight to give every bone.
+	 */
+	NIFLIB_API void SetIdentity( float weight = 0.0f );
+
+	/*!
+	 * Sets the local transform of a single bone.
+	 * \param[in] bone The index of the bone to set.
+	 * \param[in] translation The local translation.
+	 * \param[in] rotation The local rotation.
+	 * \param[in] scale The local uniform scale.
+	 * \param[in] weight How much this bone is influenced by the pose.  Bones
+	 * that a sequence does not animate should have a weight of zero.
+	 */
+	NIFLIB_API void SetTransform( unsigned int bone, const Vector3 & translation, const Quaternion & rotation, float scale, float weight = 1.0f );
+
+	/*!
+	 * Retrieves the local translation of a single bone.
+	 * \param[in] bone The index of the bone.
+	 * \return The local translation.
+	 */
+	NIFLIB_API Vector3 GetTranslation( unsigned int bone ) const;
+
+	/*!
+	 * Retrieves the local rotation of a single bone.
+	 * \param[in] bone The index of the bone.
+	 * \return The local rotation.
+	 */
+	NIFLIB_API Quaternion GetRotation( unsigned int bone ) const;
+
+	/*!
+	 * Retrieves the local scale of a single bone.
+	 * \param[in] bone The index of the bone.
+	 * \return The local uniform scale.
+	 */
+	NIFLIB_API float GetScale( unsigned int bone ) const;
+
+	/*!
+	 * Retrieves the weight of a single bone.
+	 * \param[in] bone The index of the bone.
+	 * \return The weight of the bone in this pose.
+	 */
+	NIFLIB_API float GetWeight( unsigned int bone ) const;
+
+	/*!
+	 * Builds the local transform matrix of a single bone.
+	 * \param[in] bone The index of the bone.
+	 * \return The local transform as a matrix.
+	 */
+	NIFLIB_API Matrix44 GetLocalTransform( unsigned int bone ) const;
+
+	/*! Translation X components */
+	vector<float> tx;
+	/*! Translation Y components */
+	vector<float> ty;
+	/*! Translation Z components */
+	vector<float> tz;
+	/*! Rotation W components */
+	vector<float> qw;
+	/*! Rotation X components */
+	vector<float> qx;
+	/*! Rotation Y components */
+	vector<float> qy;
+	/*! Rotation Z components */
+	vector<float> qz;
+	/*! Uniform scale */
+	vector<float> scale;
+	/*! Per bone weight, zero for bones which are not animated. */
+	vector<float> weight;
+
+private:
+	unsigned int numBones;
+};
+
+/*! The quaternion interpolation used to combine rotations. */
+enum PoseBlendMode {
+	POSE_BLEND_NLERP = 0, /*!< Normalized linear interpolation.  Fastest, not constant velocity. */
+	POSE_BLEND_SLERP = 1, /*!< Approximated spherical linear interpolation. */
+};
+
+/*!
+ * Blends any number of sampled poses into a final set of local transforms.
+ * Non-additive layers are resolved by priority in the same manner as a
+ * NiBlendTransformInterpolator: layers of the highest priority claim up to
+ * their combined weight, and lower priorities share whatever weight is
+ * left.  Bones which are not fully covered are filled from the reference
+ * pose, if one is set.  Additive layers are applied afterwards on top of the
+ * blended result.
+ */
+class PoseBlender {
+public:
+	/*!
+	 * Constructor.
+	 * \param[in] mode The quaternion interpolation to use.
+	 */
+	NIFLIB_API PoseBlender( PoseBlendMode mode = POSE_BLEND_NLERP );
+
+	/*! Destructor */
+	NIFLIB_API ~PoseBlender();
+
+	/*!
+	 * Sets the pose used to fill bones which the layers do not fully cover,
+	 * usually the bind pose of the skeleton.  The pose is stored by pointer
+	 * and must remain valid until the next call to Blend.
+	 * \param[in] ref The reference pose, or NULL to renormalize the layer
+	 * weights instead.
+	 */
+	NIFLIB_API void SetReferencePose( const PoseBuffer * ref );
+
+	/*!
+	 * Adds a pose to be blended.  The pose is stored by pointer and must
+	 * remain valid until the next call to Blend, and have the same number
+	 * of bones as the other layers.
+	 * \param[in] pose The sampled pose.  For additive layers this should be
+	 * a delta pose created with MakeAdditive.
+	 * \param[in] weight The weight of the whole layer, usually the weight
+	 * of the controller sequence the pose was sampled from.
+	 * \param[in] priority Higher priority layers override lower ones.
+	 * \param[in] additive Whether the pose is applied on top of the blended
+	 * result instead of being blended with the other layers.
+	 */
+	NIFLIB_API void AddLayer( const PoseBuffer & pose, float weight, int priority = 0, bool additive = false );
+
+	/*! Removes all layers.  The reference pose is kept. */
+	NIFLIB_API void ClearLayers();
+
+	/*!
+	 * Reports the number of layers added since the last call to ClearLayers.
+	 * \return The number of layers.
+	 */
+	NIFLIB_API unsigned int GetNumLayers() const;
+
+	/*!
+	 * Blends all layers into the final pose.
+	 * \param[out] out Receives the blended local transforms.  It is resized
+	 * to the number of bones in the layers.  Bones touched by at least one
+	 * layer or the reference pose get a weight of one.
+	 */
+	NIFLIB_API void Blend( PoseBuffer & out ) const;
+
+	/*!
+	 * Creates the delta pose which, applied additively on top of the
+	 * reference pose, yields the given pose.
+	 * \param[in] pose The full pose.
+	 * \param[in] reference The pose the delta is relative to.
+	 * \param[out] out Receives the delta pose.
+	 */
+	NIFLIB_API static void MakeAdditive( const PoseBuffer & pose, const PoseBuffer & reference, PoseBuffer & out );
+
+private:
+	struct Layer {
+		const PoseBuffer * pose;
+		float weight;
+		int priority;
+		bool additive;
+	};
+
+	PoseBlendMode mode;
+	const PoseBuffer * reference;
+	vector<Layer> layers;
+};
+
+/*!
+ * Samples the transform channels of a NiControllerSequence into a PoseBuffer.
+ * Bone names are resolved and key data is fetched once on construction, so
+ * repeated sampling does no string lookups or key copies.
+ */
+class SequencePoseSampler {
+public:
+	/*!
+	 * Constructor.
+	 * \param[in] seq The sequence to sample.
+	 * \param[in] bone_names The names of the bones in the order used by the
+	 * PoseBuffer.  Channels targeting other nodes are ignored.
+	 */
+	NIFLIB_API SequencePoseSampler( NiControllerSequence * seq, const vector<string> & bone_names );
+
+	/*! Destructor */
+	NIFLIB_API ~SequencePoseSampler();
+
+	/*!
+	 * Samples the sequence.
+	 * \param[in] time The time to sample at, in the key time of the sequence.
+	 * It is wrapped or clamped according to the cycle type of the sequence.
+	 * \param[out] out Receives the local transforms.  Bones animated by the
+	 * sequence get a weight of one, all others get a weight of zero.
+	 */
+	NIFLIB_API void Sample( float time, PoseBuffer & out ) const;
+
+	/*!
+	 * Reports the weight stored in the sequence.
+	 * \return The sequence weight.
+	 */
+	NIFLIB_API float GetWeight() const;
+
+	/*!
+	 * Reports the highest controller priority found in the sequence, for
+	 * use as the layer priority.
+	 * \return The sequence priority.
+	 */
+	NIFLIB_API int GetPriority() const;
+
+	/*!
+	 * Reports the number of bones which are animated by the sequence.
+	 * \return The number of bound channels.
+	 */
+	NIFLIB_API unsigned int GetNumChannels() const;
+
+private:
+	struct Channel;
+
+	vector<Channel*> channels;
+	unsigned int numBones;
+	float weight;
+	int priority;
+	float startTime;
+	float stopTime;
+	int cycleType;
+
+	SequencePoseSampler( const SequencePoseSampler & );
+	SequencePoseSampler & operator=( const SequencePoseSampler & );
+};
+
+} //End Niflib namespace
+#endif
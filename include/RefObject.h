@@ -15,6 +15,7 @@ All rights reserved.  Please see niflib.h for license. */
 #include <list>
 #include <map>
 #include <vector>
+#include <atomic>
 
 namespace Niflib {
 
@@ -105,9 +106,21 @@ public:
 	 */
 	NIFLIB_API unsigned int GetNumRefs();
 
+	/*!
+	 * Allocates memory for an object from the ObjectArena active on this
+	 * thread, or from the heap if there is none.
+	 */
+	NIFLIB_API static void * operator new( size_t size );
+
+	/*!
+	 * Frees memory allocated by operator new.
+	 */
+	NIFLIB_API static void operator delete( void * p );
+
 private:
 	mutable unsigned int _ref_count;
-	static unsigned int objectsInMemory;
+	//Atomic so that separate files can be read on separate threads
+	static atomic<unsigned int> objectsInMemory;
 
 public:
 	/*! NIFLIB_HIDDEN function.  For internal use only. */
@@ -0,0 +1,91 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _TEXTURE_INDEX_H_
+#define _TEXTURE_INDEX_H_
+
+#include "dll_export.h"
+#include <vector>
+#include <string>
+#include <iostream>
+
+namespace Niflib {
+
+using namespace std;
+
+/*!
+ * Lists the texture files that a NIF file refers to, without reading the
+ * whole file.  From version 20.2.0.7 the header gives the type and size of
+ * every block, so only the blocks that can hold a texture path are read and
+ * the rest are skipped.  These are NiSourceTexture, NiImage,
+ * BSShaderTextureSet, BSEffectShaderProperty, BSSkyShaderProperty and the
+ * Fallout 3 shader properties that name a file.  Older files are read in
+ * full.  Textures stored inside the file are not listed.
+ * \param[in] in The stream to read from.
+ * \param[out] blocks_read If not NULL, receives the number of blocks that
+ * were read.
+ * \return The texture paths, in the order they were found, each listed once
+ * regardless of case.
+ */
+NIFLIB_API vector<string> ReadTextureReferences( istream & in, unsigned int * blocks_read = NULL );
+
+/*!
+ * Lists the texture files that a NIF file refers to.
+ * \param[in] file_name The file to read.
+ * \param[out] blocks_read If not NULL, receives the number of blocks that
+ * were read.
+ * \return The texture paths, as for the stream version.
+ */
+NIFLIB_API vector<string> ReadTextureReferences( string const & file_name, unsigned int * blocks_read = NULL );
+
+/*!
+ * Finds the files with a given extension in a directory and all the
+ * directories below it.
+ * \param[in] directory The directory to search.
+ * \param[in] extension The extension to look for, compared without regard to
+ * case.
+ * \return The paths of the files, sorted.
+ */
+NIFLIB_API vector<string> FindNifFiles( const string & directory, const string & extension = ".nif" );
+
+/*! The textures that one file refers to. */
+struct TextureReferences {
+	/*! The file that was read. */
+	string file;
+	/*! Why the file could not be read, or empty if it was. */
+	string error;
+	/*! The texture paths found in the file. */
+	vector<string> textures;
+	/*! The number of blocks that were read, out of blocksTotal. */
+	unsigned int blocksRead;
+	/*! The number of blocks in the file. */
+	unsigned int blocksTotal;
+
+	/*! Default constructor */
+	NIFLIB_API TextureReferences() : blocksRead(0), blocksTotal(0) {}
+};
+
+/*!
+ * Runs ReadTextureReferences over many files.  Files are handed to the
+ * threads one at a time as they become free.  Files that cannot be read are
+ * reported with an error rather than stopping the scan.
+ * \param[in] files The files to read, such as those from FindNifFiles.
+ * \param[out] results Receives one result per file, in the same order.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ * \return The number of files that could not be read.
+ */
+NIFLIB_API unsigned int ScanTextureReferences( const vector<string> & files, vector<TextureReferences> & results, unsigned int num_threads = 0 );
+
+/*!
+ * Writes the results of a scan as a dependency index.  Each reference is
+ * written on its own line as the NIF file name, a tab, and the texture path,
+ * so the index can be sorted or searched either way round with line based
+ * tools.  Files that could not be read are left out.
+ * \param[out] out The stream to write to.
+ * \param[in] results The results of ScanTextureReferences.
+ */
+NIFLIB_API void WriteTextureIndex( ostream & out, const vector<TextureReferences> & results );
+
+} //End Niflib namespace
+#endif
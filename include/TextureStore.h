@@ -0,0 +1,133 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _TEXTURE_STORE_H_
+#define _TEXTURE_STORE_H_
+
+#include "Ref.h"
+#include "dll_export.h"
+#include "nif_basic_types.h"
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <iostream>
+
+namespace Niflib {
+
+using namespace std;
+
+class NiPixelData;
+
+/*!
+ * Writes the pixel data of a texture as a DDS file, with every mipmap and
+ * every cube map face.  RGB8, RGBA8, DXT1 and DXT5 data is copied as it is;
+ * other formats are decoded to 32-bit RGBA first.
+ * \param[out] out The stream to write to.
+ * \param[in] pixel_data The texture to write.
+ */
+NIFLIB_API void WriteDds( ostream & out, NiPixelData * pixel_data );
+
+/*!
+ * Reads a DDS file into new pixel data.  DXT1, DXT5 and 24 or 32-bit RGB
+ * files are supported, including cube maps.  Throws a runtime_error for
+ * anything else.
+ * \param[in] in The stream to read from.
+ * \return The new pixel data.
+ */
+NIFLIB_API Ref<NiPixelData> ReadDds( istream & in );
+
+/*!
+ * A directory of DDS files shared by many NIF files.  Textures added to the
+ * library are named after a hash of their contents, so each unique texture
+ * is written once no matter how many files embed it.  Loaded files are kept
+ * in memory so each is only read once.  All functions may be called from
+ * several threads at once.
+ */
+class TextureLibrary {
+public:
+	/*!
+	 * Constructor
+	 * \param[in] directory The directory that holds the DDS files.
+	 * \param[in] path_prefix Put in front of the DDS file names stored in NIF
+	 * files, such as "textures\\".  It is removed again when loading.
+	 */
+	NIFLIB_API TextureLibrary( const string & directory, const string & path_prefix = string() );
+
+	/*! Destructor */
+	NIFLIB_API ~TextureLibrary();
+
+	/*!
+	 * Adds a texture to the library, writing it as a DDS file unless a texture
+	 * with the same contents is already there.
+	 * \param[in] pixel_data The texture to add.
+	 * \param[in] name_hint The name of the original file, used to make the DDS
+	 * file name readable.  The directory and extension are dropped.
+	 * \return The file name to store in the NIF file, with the path prefix.
+	 */
+	NIFLIB_API string AddTexture( NiPixelData * pixel_data, const string & name_hint = string() );
+
+	/*!
+	 * Reads the DDS file a NIF file refers to.  Back slashes are treated as
+	 * directory separators.
+	 * \param[in] file_name The file name stored in the NIF file.
+	 * \return New pixel data for the texture, owned by the caller.
+	 */
+	NIFLIB_API Ref<NiPixelData> LoadTexture( const string & file_name );
+
+	/*!
+	 * Lists the DDS files that this library has written.
+	 * \return The paths of the files, in the order they were written.
+	 */
+	NIFLIB_API vector<string> GetWrittenFiles() const;
+
+private:
+	TextureLibrary( const TextureLibrary & );
+	TextureLibrary & operator=( const TextureLibrary & );
+
+	string directory;
+	string prefix;
+	mutable mutex lock;
+	/*! The stored file name of each texture added, by content hash. */
+	map<unsigned long long, string> added;
+	/*! The contents of each file loaded, by path. */
+	map< string, shared_ptr<const string> > loaded;
+	vector<string> written;
+};
+
+/*! The outcome of converting one file. */
+struct TextureStoreResult {
+	/*! The file that was read. */
+	string file;
+	/*! Why the file could not be converted, or empty if it was. */
+	string error;
+	/*! The number of textures that were moved. */
+	unsigned int textures;
+
+	/*! Default constructor */
+	NIFLIB_API TextureStoreResult() : textures(0) {}
+};
+
+/*!
+ * Runs MatTexCollection::ExternalizeTextures or
+ * MatTexCollection::InternalizeTextures over the scene of each of many
+ * files.  Files are handed to the threads one at a time as they become free,
+ * and each is read, converted and written before the next is read.  Files
+ * that cannot be converted are reported with an error rather than stopping
+ * the batch.
+ * \param[in] in_files The files to read.
+ * \param[in] out_files Where to write each file, which may be the same as
+ * the file read.  Files that were not changed are not rewritten in place.
+ * \param[in] library The library shared by all the files.
+ * \param[in] externalize True to move textures out of the files, false to
+ * pack them in.
+ * \param[out] results Receives one result per file, in the same order.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ * \return The number of files that could not be converted.
+ */
+NIFLIB_API unsigned int ConvertTextureStorage( const vector<string> & in_files, const vector<string> & out_files, TextureLibrary & library, bool externalize, vector<TextureStoreResult> & results, unsigned int num_threads = 0 );
+
+} //End Niflib namespace
+#endif
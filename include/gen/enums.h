@@ -865,9 +865,12 @@ enum PixelFormat {
 	PX_FMT_RGB8 = 0, /*!< 24-bit color: uses 8 bit to store each red, blue, and green component. */
 	PX_FMT_RGBA8 = 1, /*!< 32-bit color with alpha: uses 8 bits to store each red, blue, green, and alpha component. */
 	PX_FMT_PAL8 = 2, /*!< 8-bit palette index: uses 8 bits to store an index into the palette stored in a NiPalette object. */
+	PX_FMT_PALA8 = 3, /*!< 8-bit palette index with alpha: like PX_FMT_PAL8, but the alpha of the palette entries is used. */
 	PX_FMT_DXT1 = 4, /*!< DXT1 compressed texture. */
 	PX_FMT_DXT5 = 5, /*!< DXT5 compressed texture. */
 	PX_FMT_DXT5_ALT = 6, /*!< DXT5 compressed texture. It is not clear what the difference is with PX_FMT_DXT5. */
+	PX_FMT_BUMP = 8, /*!< 16-bit bump map: uses a signed byte each for the du and dv gradients. */
+	PX_FMT_BUMPLUMA = 9, /*!< 24-bit bump map: uses a signed byte each for the du and dv gradients, followed by an unsigned luminance byte. */
 };
 
 ostream & operator<<( ostream & out, PixelFormat const & val );
@@ -12,6 +12,8 @@ using namespace std;
 
 //Classes used
 class NiObject;
+class NiNode;
+class NiControllerSequence;
 
 //--KFM File Format--//
 
@@ -70,11 +72,139 @@ struct Kfm {
 	NIFLIB_API unsigned int Read( const string & file_name ); // returns Kfm version
 	NIFLIB_API unsigned int Read( istream & in ); // returns Kfm version
 
-	// Reads the NIF file and all KF files referred to in this KFM, and returns the root object of the resulting NIF tree.
+	// Reads the NIF file and all KF files referred to in this KFM, merges every controller sequence into the NIF tree, and returns its root object.
 	NIFLIB_API Ref<NiObject> MergeActions( const string & path );
 	//void Write( string const & file_name, unsigned int version );
 	//void Write( ostream & out, unsigned int version );
 };
 
+/*!
+ * Provides access to the actions of a KFM file without loading all of them.
+ * Actions are indexed by name and by event code when the library is
+ * created, and their KF files are only read the first time a sequence is
+ * requested.  Decoded sequences are kept in a cache which drops the least
+ * recently used actions once a memory budget is exceeded.  KF files can
+ * also be read ahead of time on a background thread; decoding always
+ * happens on the thread that asks for the sequences, since NIF objects are
+ * not reference counted in a thread safe way.
+ */
+class KfmActionLibrary {
+public:
+	/*!
+	 * Creates a library for the actions of a KFM file.  No files are read.
+	 * \param[in] kfm The KFM file, which must have been read already.
+	 * \param[in] path The directory which contains the NIF and KF files.
+	 */
+	NIFLIB_API KfmActionLibrary( const Kfm & kfm, const string & path );
+
+	/*! Destructor.  Waits for any outstanding background reads. */
+	NIFLIB_API ~KfmActionLibrary();
+
+	/*!
+	 * Reports the number of actions listed in the KFM file.
+	 * \return The action count.
+	 */
+	NIFLIB_API unsigned int GetActionCount() const;
+
+	/*!
+	 * Looks up an action by name.
+	 * \param[in] name The action name, as stored in KfmAction::action_name.
+	 * \return The index of the action, or -1 if there is no such action.
+	 */
+	NIFLIB_API int FindAction( const string & name ) const;
+
+	/*!
+	 * Looks up an action by the event code which triggers it, which the KFM
+	 * file stores in KfmAction::unk_int1.
+	 * \param[in] code The event code.
+	 * \return The index of the action, or -1 if there is no such action.
+	 */
+	NIFLIB_API int FindActionByEventCode( unsigned int code ) const;
+
+	/*!
+	 * Retrieves the description of an action from the KFM file.
+	 * \param[in] action The index of the action.
+	 * \return The action.
+	 */
+	NIFLIB_API const KfmAction & GetAction( unsigned int action ) const;
+
+	/*!
+	 * Reads the NIF file of the KFM the first time it is called, and returns
+	 * the same tree on every later call.
+	 * \return The root object of the NIF file.
+	 */
+	NIFLIB_API Ref<NiObject> GetSkeleton();
+
+	/*!
+	 * Retrieves the controller sequences of an action, reading and decoding
+	 * its KF file if it is not already cached.
+	 * \param[in] action The index of the action.
+	 * \return The sequences stored in the KF file, which is empty if the file
+	 * does not exist.
+	 */
+	NIFLIB_API vector< Ref<NiControllerSequence> > GetSequences( unsigned int action );
+
+	/*!
+	 * Retrieves the first controller sequence of a named action.
+	 * \param[in] name The action name.
+	 * \return The sequence, or NULL if the action or its KF file does not
+	 * exist.
+	 */
+	NIFLIB_API Ref<NiControllerSequence> GetSequence( const string & name );
+
+	/*!
+	 * Starts reading the KF file of an action on a background thread, so a
+	 * later call to GetSequences only has to decode it.  Does nothing if the
+	 * action is already cached or being read.
+	 * \param[in] action The index of the action.
+	 */
+	NIFLIB_API void Prefetch( unsigned int action );
+
+	/*!
+	 * Merges the sequences of an action into a scene graph using
+	 * MergeNifTrees.
+	 * \param[in] target The root node to merge into, usually the skeleton.
+	 * \param[in] action The index of the action.
+	 * \param[in] version The NIF version of the target tree.
+	 * \param[in] user_version The user version of the target tree.
+	 */
+	NIFLIB_API void MergeAction( NiNode * target, unsigned int action, unsigned version = 0xFFFFFFFF, unsigned user_version = 0 );
+
+	/*!
+	 * Sets how much memory the cached actions may take before the least
+	 * recently used ones are dropped.  The size of an action is estimated
+	 * from the size of its KF file.
+	 * \param[in] bytes The memory budget in bytes.  Zero means unlimited,
+	 * which is the default.
+	 */
+	NIFLIB_API void SetMemoryBudget( size_t bytes );
+
+	/*!
+	 * Reports the estimated memory taken by the cached actions.
+	 * \return The size in bytes.
+	 */
+	NIFLIB_API size_t GetMemoryUsage() const;
+
+	/*!
+	 * Reports whether the sequences of an action are currently cached.
+	 * \param[in] action The index of the action.
+	 * \return True if GetSequences will not need to decode the KF file.
+	 */
+	NIFLIB_API bool IsCached( unsigned int action ) const;
+
+	/*!
+	 * Drops all cached sequences.  Sequences still referenced elsewhere
+	 * stay alive.
+	 */
+	NIFLIB_API void ClearCache();
+
+private:
+	struct Impl;
+	Impl * impl;
+
+	KfmActionLibrary( const KfmActionLibrary & );
+	KfmActionLibrary & operator=( const KfmActionLibrary & );
+};
+
 }
 #endif
@@ -61,6 +61,8 @@ class NiObject;
 class NiNode;
 class NiAVObject;
 class NiControllerSequence;
+class NodeNameIndex;
+class Type;
 struct Header;
 
 #ifndef NULL
@@ -156,6 +158,44 @@ NIFLIB_API vector< Ref<NiObject> > ReadNifList( string const & file_name, NifInf
  */
 NIFLIB_API vector< Ref<NiObject> > ReadNifList( istream & in, NifInfo * info = NULL );
 
+/*!
+ * Chooses the blocks that a selective read reads.  It is called with the
+ * type of each block in the file and returns true if the block is wanted.
+ */
+typedef function<bool ( const Type & type )> BlockFilter;
+
+/*!
+ * Reads only the blocks of the given input stream that the filter wants.
+ * From version 20.2.0.7 the header gives the size of every block, so
+ * unwanted blocks are skipped without being read.  Each is replaced by a
+ * placeholder of the same type, which links to it resolve to so the objects
+ * that were read can still be navigated.  Placeholders hold only default
+ * values and cannot be written; see NiObject::IsPlaceholder.  Older files
+ * have no block sizes, so every block is read as by ReadNifList.
+ * \param[in] in The input stream to read NIF data from.
+ * \param[in] filter Returns true for the types of the blocks to read.
+ * \param[out] info Optionally, a NifInfo structure pointer can be passed in, and it will be filled with information from the header of the NIF file.
+ * \return All the NIF objects in the stream, in block order, including the placeholders.
+ *
+ * <b>Example:</b>
+ * \code
+ * vector<NiObjectRef> objects = ReadNifList( in, []( const Type & type ) {
+ *    return type.IsDerivedType( NiNode::TYPE );
+ * } );
+ * \endcode
+ */
+NIFLIB_API vector< Ref<NiObject> > ReadNifList( istream & in, const BlockFilter & filter, NifInfo * info = NULL );
+
+/*!
+ * Reads only the blocks of the given file that the filter wants.  See the
+ * stream version for details.
+ * \param[in] file_name The name of the file to load, or the complete path if it is not in the working directory.
+ * \param[in] filter Returns true for the types of the blocks to read.
+ * \param[out] info Optionally, a NifInfo structure pointer can be passed in, and it will be filled with information from the header of the NIF file.
+ * \return All the NIF objects in the file, in block order, including the placeholders.
+ */
+NIFLIB_API vector< Ref<NiObject> > ReadNifList( string const & file_name, const BlockFilter & filter, NifInfo * info = NULL );
+
 /*!
  * Like ReadNifList but returns root.
  */
@@ -237,6 +277,90 @@ NIFLIB_API Ref<NiObject> CloneNifTree( NiObject * root, unsigned version = 0xFFF
 //NIFLIB_API void MergeNifTrees( NiNodeRef target, NiAVObjectRef right, unsigned int version = 0xFFFFFFFF );
 NIFLIB_API void MergeNifTrees( NiNode * target, NiControllerSequence * right, unsigned version = 0xFFFFFFFF, unsigned user_version = 0  );
 
+/*!
+ * Merges a batch of KF sequences into a Nif tree.  The target nodes are
+ * looked up through a name index which is only built once for the whole
+ * batch, and can be kept by the caller to be reused by later merges.
+ * \param[in,out] target The root object of the Nif tree to merge into.
+ * \param[in] sequences The sequences to merge.  NULL entries are skipped.
+ * \param[in,out] index A name index of the target tree, or NULL to build a
+ * temporary one.  An index rooted at a different node is ignored.
+ * \param[in] clone Whether the interpolators and controllers of the
+ * sequences are copied before being attached.  Attaching the originals is
+ * much faster, but leaves them shared between the sequences and the target
+ * tree, so it is best used when the sequences are discarded afterwards.
+ * \param[in] version The version of the nif format to use during the clone operation.
+ * \param[in] user_version The user version to use during the clone operation.
+ */
+NIFLIB_API void MergeNifTrees( NiNode * target, const vector< Ref<NiControllerSequence> > & sequences, NodeNameIndex * index = NULL, bool clone = true, unsigned version = 0xFFFFFFFF, unsigned user_version = 0 );
+
+/*! Counts reported by the tree-wide key timing functions. */
+struct RetimeResult {
+	/*! Number of controllers and controller sequences whose times were changed. */
+	unsigned int controllers;
+	/*! Number of distinct key data objects whose keys were changed. */
+	unsigned int dataBlocks;
+	/*!
+	 * Number of controllers left alone because they share key data with a
+	 * controller that runs on a different time line.
+	 */
+	unsigned int skippedControllers;
+
+	RetimeResult() : controllers(0), dataBlocks(0), skippedControllers(0) {}
+};
+
+/*!
+ * Changes the timing of every animation in a tree of NIF objects in a
+ * single pass.  Every key time t, the start and stop times of every
+ * controller, controller sequence and B-spline interpolator, and the times
+ * of text keys become t * scale + offset.  Key data shared between several
+ * controllers is only changed once.  The key data objects are processed on
+ * several threads.
+ * \param[in] root The root object of the tree.
+ * \param[in] scale The factor to multiply times by.  Must be positive.
+ * \param[in] offset The amount of time to add after scaling.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ * \return The number of objects that were changed.
+ */
+NIFLIB_API RetimeResult RetimeNifTree( NiObject * root, float scale, float offset = 0.0f, unsigned int num_threads = 0 );
+
+/*!
+ * Normalizes the keys of every controller in a tree of NIF objects in a
+ * single pass, so that their phase becomes zero and their frequency one,
+ * without changing how the animations play.  This has the same effect as
+ * calling NiTimeController::NormalizeKeys on each controller, except that
+ * key data shared between controllers is only normalized once.  The start
+ * and stop times of B-spline interpolators are treated as key data.  Groups
+ * of controllers that share key data but disagree on phase or frequency
+ * cannot be normalized and are left unchanged.
+ * \param[in] root The root object of the tree.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ * \return The number of objects that were changed or skipped.
+ */
+NIFLIB_API RetimeResult NormalizeNifTreeKeys( NiObject * root, unsigned int num_threads = 0 );
+
+/*!
+ * Recomputes the mass, center and inertia of every bhkRigidBody in a tree
+ * of NIF objects, as bhkRigidBody::UpdateMassProperties does for one body.
+ * The shape tree of each body is flattened through bhkListShape,
+ * bhkTransformShape and bhkMoppBvTreeShape objects first.  The mass
+ * properties of the leaf shapes are then computed on several threads and
+ * combined per body.  Shapes used by several bodies are measured once for
+ * each body.
+ * \param[in] root The root object of the tree.
+ * \param[in] density The density of the bodies.
+ * \param[in] solid True to treat the shapes as solid, false for hollow.
+ * \param[in] keep_mass True to keep the current mass of each body and only
+ * update its center and inertia, as is wanted after ApplyScale.  The density
+ * is then ignored.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ * \return The number of rigid bodies that were updated.
+ */
+NIFLIB_API unsigned int UpdateMassProperties( NiObject * root, float density = 1.0f, bool solid = true, bool keep_mass = false, unsigned int num_threads = 0 );
+
 /*! 
  * Traverses a tree of NIF objects, attempting to move each skeleton root
  * to the natural bind position where no meshes are distorted by skin
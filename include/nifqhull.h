@@ -7,18 +7,51 @@ All rights reserved.  Please see niflib.h for license. */
 
 //--Includes--//
 #include "nif_math.h"
+#include "dll_export.h"
 #include <vector>
 
 namespace Niflib {
 
+/*!
+ * Convex hull computation for collision shapes and mass properties.  The
+ * hull is built with the quickhull algorithm.  Every call works on its own
+ * data and writes nothing to the console, so hulls can be computed on any
+ * number of threads at once.
+ */
 class NifQHull {
 public:
 
-	static vector<Triangle> compute_convex_hull(const vector<Vector3>& verts);
+	/*!
+	 * Computes the convex hull of a point cloud.  Points that lie within a
+	 * small tolerance of the hull surface are not used as hull vertices.
+	 * Throws a runtime_error if there are more points than a Triangle can
+	 * index.
+	 * \param[in] verts The points to wrap.
+	 * \param[in] max_vertices The most vertices the hull may use, or zero for
+	 * no limit.  With a limit, the points farthest from the hull built so
+	 * far are added first, so the result is a simplified hull that lies
+	 * inside the exact one.  Limits below four are raised to four.
+	 * \return The hull triangles, indexing into verts and wound counter
+	 * clockwise when seen from outside.  Empty if the points are all on one
+	 * plane.
+	 */
+	NIFLIB_API static vector<Triangle> compute_convex_hull(const vector<Vector3>& verts, unsigned int max_vertices = 0);
+
+	/*!
+	 * Computes the convex hulls of many point clouds, split across threads.
+	 * \param[in] point_sets The point clouds to wrap.
+	 * \param[out] hulls Receives one triangle list per point cloud, as
+	 * returned by compute_convex_hull.
+	 * \param[in] max_vertices The most vertices each hull may use, or zero
+	 * for no limit.
+	 * \param[in] num_threads The number of threads to use, zero for one per
+	 * hardware thread.
+	 */
+	NIFLIB_API static void compute_convex_hulls(const vector< vector<Vector3> >& point_sets, vector< vector<Triangle> >& hulls, unsigned int max_vertices = 0, unsigned int num_threads = 0);
 
 private:
 	explicit NifQHull();
 };
 
 }
-#endif
\ No newline at end of file
+#endif
@@ -62,6 +62,18 @@ public:
 
 	//--BEGIN MISC CUSTOM CODE--//
 
+	/*!
+	 * Retrieves the palette used by the palettized pixel formats.
+	 * \return The palette, or NULL if there is none.
+	 */
+	NIFLIB_API Ref<NiPalette> GetPalette() const;
+
+	/*!
+	 * Sets the palette used by the palettized pixel formats.
+	 * \param[in] value The new palette, or NULL to remove it.
+	 */
+	NIFLIB_API void SetPalette( NiPalette * value );
+
 	//--END CUSTOM CODE--//
 protected:
 	/*! The format of the pixels in this internally stored image. */
@@ -55,6 +55,30 @@ public:
 
 	//--BEGIN MISC CUSTOM CODE--//
 
+	/*!
+	 * Gets the external texture the effect draws.
+	 * \return The file name of the texture.
+	 */
+	NIFLIB_API string GetSourceTexture() const;
+
+	/*!
+	 * Sets the external texture the effect draws.
+	 * \param[in] value The file name of the texture.
+	 */
+	NIFLIB_API void SetSourceTexture( const string & value );
+
+	/*!
+	 * Gets the external texture used as a greyscale palette.
+	 * \return The file name of the texture.
+	 */
+	NIFLIB_API string GetGreyscaleTexture() const;
+
+	/*!
+	 * Sets the external texture used as a greyscale palette.
+	 * \param[in] value The file name of the texture.
+	 */
+	NIFLIB_API void SetGreyscaleTexture( const string & value );
+
 	//--END CUSTOM CODE--//
 protected:
 	/*! Unknown. */
@@ -55,6 +55,18 @@ public:
 
 	//--BEGIN MISC CUSTOM CODE--//
 
+	/*!
+	 * Gets the external texture drawn on the sky object.
+	 * \return The file name of the texture.
+	 */
+	NIFLIB_API string GetSourceTexture() const;
+
+	/*!
+	 * Sets the external texture drawn on the sky object.
+	 * \param[in] value The file name of the texture.
+	 */
+	NIFLIB_API void SetSourceTexture( const string & value );
+
 	//--END CUSTOM CODE--//
 protected:
 	/*! Unknown. */
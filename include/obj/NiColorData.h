@@ -81,6 +81,18 @@ public:
 	 */
 	NIFLIB_API void SetKeys( vector< Key<Color4> > const & keys );
 
+	/*!
+	 * This function will adjust the times in all the keys stored in this data
+	 * object such that phase will equal 0 and frequency will equal one.  In
+	 * other words, it will cause the key times to be in seconds starting from
+	 * zero.
+	 * \param[in] frequency The frequency to normalize to 1.0 for any keys
+	 * stored in this object
+	 * \param[in] phase The phase shift to remove from any keys stored in this
+	 * object.
+	 */
+	NIFLIB_API virtual void NormalizeKeys( float phase, float frequency );
+
 	//--END CUSTOM CODE--//
 protected:
 	/*! The color keys. */
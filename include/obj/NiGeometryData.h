@@ -153,6 +153,40 @@ public:
 	 */
 	NIFLIB_API vector<int> GetVertexIndices() const;
 
+	/*!
+	 * Returns the vertices without copying them.  The reference stays valid
+	 * until the vertices are changed or this object is destroyed.
+	 * \return The vertices used by this mesh.
+	 * \sa GetVertices
+	 */
+	NIFLIB_API const vector<Vector3> & GetVertexArray() const;
+
+	/*!
+	 * Returns the normals without copying them.  The reference stays valid
+	 * until the normals are changed or this object is destroyed.
+	 * \return The normals used by this mesh, if any.
+	 * \sa GetNormals
+	 */
+	NIFLIB_API const vector<Vector3> & GetNormalArray() const;
+
+	/*!
+	 * Returns the vertex colors without copying them.  The reference stays
+	 * valid until the colors are changed or this object is destroyed.
+	 * \return The vertex colors used by this mesh, if any.
+	 * \sa GetColors
+	 */
+	NIFLIB_API const vector<Color4> & GetColorArray() const;
+
+	/*!
+	 * Returns the texture coordinates of a texture set without copying them.
+	 * The reference stays valid until the texture sets are changed or this
+	 * object is destroyed.
+	 * \param index The index of the texture coordinate set, which must be smaller than GetUVSetCount.
+	 * \return The texture coordinates of the requested set.
+	 * \sa GetUVSet
+	 */
+	NIFLIB_API const vector<TexCoord> & GetUVSetArray( int index ) const;
+
 	/*! 
 	 * Used to retrive the the NIF index corresponding to the Max map channel. If there isn't one, -1 is returned.
 	 * \param maxMapChannel The max map channel of the desired UV set.
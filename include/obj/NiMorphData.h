@@ -157,6 +157,21 @@ public:
 	*/
 	NIFLIB_API void SetFrameName( int n, string const & key );
 
+	/*!
+	 * Reports whether the morph targets are stored relative to the first
+	 * target, which holds the base shape.  This is the case in all official
+	 * files.
+	 * \return True if targets are offsets from the base shape, false if they
+	 * are absolute positions.
+	 */
+	NIFLIB_API bool GetRelativeTargets() const;
+
+	/*!
+	 * Sets whether the morph targets are stored relative to the first target.
+	 * \param[in] n True if targets are offsets from the base shape.
+	 */
+	NIFLIB_API void SetRelativeTargets( bool n );
+
 	//--END CUSTOM CODE--//
 protected:
 	/*! Number of morphing object. */
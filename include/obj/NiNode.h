@@ -82,6 +82,15 @@ public:
 	 */
 	NIFLIB_API void ClearChildren();
 
+	/*!
+	 * Reports a counter which is increased every time a child is added to or
+	 * removed from this node or any node below it.  Caches of the scene graph
+	 * structure, such as NodeNameIndex, compare the counter of their root to
+	 * find out whether they are stale.  Edits to other trees leave it alone.
+	 * \return The current hierarchy revision of the subtree.
+	 */
+	NIFLIB_API unsigned int GetHierarchyRevision() const;
+
 	/*!
 	 * Retrieves all AV Object children from this node.  These are a sub-leafs in the scene graph contained in a NIF file.  Each AV Object can only be the child of one node.
 	 * \return A list of all the AV Objects that are children of this node in the scene graph.
@@ -162,8 +171,10 @@ public:
 
 private:
 	void RepositionGeom( NiAVObjectRef root );
+	void BumpHierarchyRevision();
 protected:
 	list<NiSkinInstance*> skins;
+	unsigned int hierarchyRevision;
 
 	//--END CUSTOM CODE--//
 protected:
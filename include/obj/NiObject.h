@@ -71,18 +71,31 @@ public:
 	 * but occupies a different part of memory.  The data stored in a NIF file varies
 	 * from version to version.  Usually you are safe with the default option
 	 * (the highest availiable version) but you may need to use an earlier version
-	 * if you need to clone an obsolete piece of information.
+	 * if you need to clone an obsolete piece of information.  Placeholders left by a
+	 * selective read cannot be cloned; a runtime_error is thrown for them.
 	 * \param[in] version The version number to use in the memory streaming operation.  Default is the highest version availiable.
 	 * \param[in] user_version The game-specific version number extention.
 	 * \return A cloned copy of this object as a new object.
 	 */
 	NIFLIB_API Ref<NiObject> Clone( unsigned int version = 0xFFFFFFFF, unsigned int user_version = 0 );
+
+	/*!
+	 * Placeholders stand in for blocks that a selective read skipped.  They
+	 * have the type of the block, so links to them can be followed, but hold
+	 * only default values and cannot be written.
+	 * \return True if this object is a placeholder.
+	 */
+	NIFLIB_API bool IsPlaceholder() const;
 	
 public:
 	/*! Block number in the nif file. Only set when you read
             blocks from the file. */
 	int internal_block_number;
 
+	/*! NIFLIB_HIDDEN member.  Set on objects standing in for blocks that
+	 * were not read. */
+	bool placeholder;
+
 	//--END CUSTOM CODE--//
 public:
 	/*! NIFLIB_HIDDEN function.  For internal use only. */
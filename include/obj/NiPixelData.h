@@ -11,6 +11,7 @@ All rights reserved.  Please see niflib.h for license. */
 #define _NIPIXELDATA_H_
 
 //--BEGIN FILE HEAD CUSTOM CODE--//
+#include "../PixelCodec.h"
 //--END CUSTOM CODE--//
 
 #include "ATextureRenderData.h"
@@ -77,28 +78,87 @@ public:
 
     /*!
 	 * Deletes all image data and sets a new size and format in preparation for new data to be provided.
-	 * \param new_width The width of the new texture image.
-	 * \param new_height The height of the new texture image.
+	 * \param new_width The width of the new texture image.  It does not need to be a power of two.
+	 * \param new_height The height of the new texture image.  It does not need to be a power of two.
 	 * \param px_fmt The pixel format of the new texture image.
-	 * \sa NiPixelData::GetWidth, NiPixelData::GetHeight
+	 * \param num_faces The number of faces, 6 for a cube map.  Files before 20.0.0.4 can only store one.
+	 * \sa NiPixelData::GetWidth, NiPixelData::GetHeight, NiPixelData::GetFaceCount
+	 */
+	NIFLIB_API void Reset( int new_width, int new_height, PixelFormat px_fmt, unsigned int num_faces = 1 );
+
+	/*!
+	 * Retrieves the number of faces of the texture image, 6 for a cube map and 1 otherwise.
+	 * \return The number of faces.
+	 * \sa NiPixelData::Reset
 	 */
-	NIFLIB_API void Reset( int new_width, int new_height, PixelFormat px_fmt );
+	NIFLIB_API unsigned int GetFaceCount() const;
 	
 	/*!
-	 * Retrieves the the pixels of the texture image stored in this object.  This function does not work on palettized textures.
+	 * Retrieves the the pixels of the texture image stored in this object.  Palettized textures need a palette.  Only the first face of a cube map is returned.
 	 * \return A vector containing the colors of each pixel in the texture image stored in this object, one row after another starting from the bottom of the image.  The width of the image must be used to interpret them correctly.
-	 * \sa NiPixelData::SetColors, NiPixelData::GetWidth
+	 * \sa NiPixelData::SetColors, NiPixelData::GetPixels, NiPixelData::GetWidth
 	 */
 	NIFLIB_API vector<Color4> GetColors() const;
 
 	/*!
-	 * Sets the the pixels of the texture image stored in this object and optionally generates mipmaps.  This function does not work for palettized textures.
-	 * \param new_pixels A vector containing the colors of each new pixel to be set in the texture image stored in this object, one row after another starting from the botom of the image.
+	 * Sets the the pixels of the texture image stored in this object and optionally generates mipmaps.  Palettized textures need a palette.
+	 * \param new_pixels A vector containing the colors of each new pixel to be set in the texture image stored in this object, one row after another starting from the botom of the image.  Cube maps take each face in turn.
 	 * \param generate_mipmaps If true, mipmaps will be generated for the new image and stored in the file.
-	 * \sa NiPixelData::GetColors, NiPixelData::GetWidth
+	 * \sa NiPixelData::GetColors, NiPixelData::SetPixels, NiPixelData::GetWidth
 	 */
 	NIFLIB_API void SetColors( const vector<Color4> & new_pixels, bool generate_mipmaps );
 
+	/*!
+	 * Decodes one mipmap of the texture image to 8-bit RGBA, in the same row order as GetColors.  Every pixel format is supported, see DecodePixelImages for how each is decoded.
+	 * \param level The mipmap to decode, zero for the full size image.
+	 * \param face The face to decode, for cube maps.
+	 * \return Four bytes per pixel, red, green, blue and alpha.
+	 * \sa NiPixelData::SetPixels, NiPixelData::GetMipmapPixels
+	 */
+	NIFLIB_API vector<byte> GetPixels( unsigned int level = 0, unsigned int face = 0 ) const;
+
+	/*!
+	 * Decodes every mipmap of one face of the texture image to 8-bit RGBA at once, split across threads.
+	 * \param face The face to decode, for cube maps.
+	 * \param num_threads The number of threads to use, zero for one per hardware thread.
+	 * \return One vector of four bytes per pixel for each mipmap, largest first.
+	 * \sa NiPixelData::GetPixels
+	 */
+	NIFLIB_API vector< vector<byte> > GetMipmapPixels( unsigned int face = 0, unsigned int num_threads = 0 ) const;
+
+	/*!
+	 * Sets the pixels of the texture image from 8-bit RGBA and optionally generates mipmaps, then encodes every mipmap to the pixel format chosen with Reset, split across threads.  Mipmaps halve each side, rounding down, until both sides are one pixel.  RGBA8 mipmaps are filtered straight into the pixel data.
+	 * \param rgba Four bytes per pixel, red, green, blue and alpha, in the same row order as SetColors.  Cube maps take each face in turn.
+	 * \param generate_mipmaps If true, mipmaps will be generated for the new image and stored in the file.
+	 * \param filter The filter used to generate mipmaps.
+	 * \param linear If true, mipmaps are filtered in linear light, treating the colors as sRGB.
+	 * \param num_threads The number of threads to use, zero for one per hardware thread.
+	 * \sa NiPixelData::GetPixels, NiPixelData::Reset, DownsamplePixelImages
+	 */
+	NIFLIB_API void SetPixels( const vector<byte> & rgba, bool generate_mipmaps, MipmapFilter filter = MIPMAP_BOX, bool linear = false, unsigned int num_threads = 0 );
+
+	/*!
+	 * Retrieves the number of mipmaps stored for each face, including the full size image.
+	 * \return The number of mipmaps.
+	 */
+	NIFLIB_API unsigned int GetMipmapCount() const;
+
+	/*!
+	 * Retrieves the pixel data of one face as it is stored in the file, every mipmap one after another in the pixel format of the texture.
+	 * \param face The face to retrieve, for cube maps.
+	 * \return A reference to the pixel data, valid until the texture is changed.
+	 * \sa NiPixelData::SetRawPixels
+	 */
+	NIFLIB_API const vector<byte> & GetRawPixels( unsigned int face = 0 ) const;
+
+	/*!
+	 * Sets the pixel data of every face as it is stored in the file, without any conversion.  Mipmaps halve each side as with SetPixels.
+	 * \param faces The pixel data of each face, every mipmap one after another in the pixel format chosen with Reset.  There must be one for each face.
+	 * \param num_mipmaps The number of mipmaps in each face, including the full size image.
+	 * \sa NiPixelData::GetRawPixels, NiPixelData::Reset
+	 */
+	NIFLIB_API void SetRawPixels( const vector< vector<byte> > & faces, unsigned int num_mipmaps );
+
 	//--END CUSTOM CODE--//
 protected:
 	/*! Total number of pixels */
@@ -96,6 +96,14 @@ public:
 	 */
 	NIFLIB_API vector<SkinWeight> GetBoneWeights( unsigned int bone_index ) const;
 
+	/*!
+	 * Retrieves the skin weights for a particular bone without copying them.  The reference stays valid until the weights of the bones are changed or this object is destroyed.
+	 * \param[in] bone_index The numeric index of the bone that the skin weight data should be returned for.  Must be >= zero and < the number returned by GetBoneCount.
+	 * \return The skin weight data for the specified bone.
+	 * \sa NiSkinData::GetBoneWeights
+	 */
+	NIFLIB_API const vector<SkinWeight> & GetBoneWeightArray( unsigned int bone_index ) const;
+
 	/*!
 	 * Sets the skin weights for a particular bone.  This information includes the vertex index into the geometry data's vertex array, and the percentage weight that defines how much the movement of this bone influences its position.
 	 * \param[in] bone_index The numeric index of the bone that the skin weight data should be set for.  Must be >= zero and < the number returned by GetBoneCount.
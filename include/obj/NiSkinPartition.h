@@ -91,6 +91,14 @@ public:
 	 */
 	NIFLIB_API vector<unsigned short> GetVertexMap( int partition ) const;
 
+	/*!
+	 * Retrieves the the vertex map for a particular partition without copying it.  The reference stays valid until the partitions are changed or this object is destroyed.
+	 * \param[in] partition The index of the skin partition to get the data for.  Must be >= 0 and < the result of NiSkinPartition::GetNumPartitions.
+	 * \return The vertex map for the specified partition.
+	 * \sa NiSkinPartition::GetVertexMap
+	 */
+	NIFLIB_API const vector<unsigned short> & GetVertexMapArray( int partition ) const;
+
 	/*!
 	 * Retrieves the the bone map for a particular partition.  This is a list of bones that affect this partition by index.
 	 * \param[in] partition The index of the skin partition to get the data for.  Must be >= 0 and < the result of NiSkinPartition::GetNumPartitions.
@@ -146,6 +154,15 @@ public:
 	 */
 	NIFLIB_API vector<unsigned short> GetStrip( int partition, int index ) const;
 
+	/*!
+	 * Retrieves a triangle strip of a particular skin partition without copying it.  The reference stays valid until the strips are changed or this object is destroyed.
+	 * \param[in] partition The specific partition to get the strip from.
+	 * \param[in] index The index of the triangle strip.  Must be >= 0 and < the result of NiSkinPartition::GetStripCount.
+	 * \return The vertex indices of the strip.
+	 * \sa NiSkinPartition::GetStrip
+	 */
+	NIFLIB_API const vector<unsigned short> & GetStripArray( int partition, int index ) const;
+
 	/*!
 	 * Retrieves the triangles that make up a particular partition.
 	 * \param[in] partition The index of the skin partition to get the data for.  Must be >= 0 and < the result of NiSkinPartition::GetNumPartitions.
@@ -61,6 +61,18 @@ public:
 	 */
 	NIFLIB_API virtual vector<Triangle> GetTriangles() const;
 
+	/*!
+	 * Returns the triangle faces that make up this mesh without copying them.
+	 * Unlike GetTriangles, the result may contain degenerate triangles that
+	 * repeat a vertex; callers must skip them.  Whether any are present
+	 * depends on the subclass, so do not rely on either behavior.  The
+	 * reference stays valid until the triangles are changed or this object
+	 * is destroyed.
+	 * \return The triangle faces that make up this mesh.
+	 * \sa GetTriangles
+	 */
+	NIFLIB_API virtual const vector<Triangle> & GetTriangleArray() const;
+
 	/*!
 	 * Replaces the triangle face data in this mesh with new data.
 	 * \param in A vector containing the new face data.  Maximum size is 65,535.
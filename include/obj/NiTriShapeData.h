@@ -101,6 +101,14 @@ public:
 	 */
 	NIFLIB_API virtual vector<Triangle> GetTriangles() const;
 
+	/*!
+	 * Returns the triangle faces as they are stored, without copying them.
+	 * Degenerate triangles are included; callers must skip them.
+	 * \return The triangle faces that make up this mesh.
+	 * \sa NiTriBasedGeomData::GetTriangleArray
+	 */
+	NIFLIB_API virtual const vector<Triangle> & GetTriangleArray() const;
+
 	//--Setters--//
 
 	/*! Replaces the triangle face data in this mesh with new data.
@@ -11,6 +11,7 @@ All rights reserved.  Please see niflib.h for license. */
 #define _NITRISTRIPSDATA_H_
 
 //--BEGIN FILE HEAD CUSTOM CODE--//
+#include <mutex>
 //--END CUSTOM CODE--//
 
 #include "NiTriBasedGeomData.h"
@@ -87,6 +88,14 @@ public:
 	 */
 	NIFLIB_API vector<unsigned short> GetStrip( int index ) const;
 
+	/*!
+	 * Used to retrieve a triangle strip without copying it.  The reference stays valid until the strips are changed or this object is destroyed.
+	 * \param index The index of the triangle strip to retrieve.  This is a zero-based index which must be a positive number less than that returned by NiTriStripsData::GetStripCount.
+	 * \return The vertex indices that make up the strip.
+	 * \sa NiTriStripData::GetStrip
+	 */
+	NIFLIB_API const vector<unsigned short> & GetStripArray( int index ) const;
+
 	/*!
 	 * This is a conveniance function which returns all triangle faces in all triangle strips that make up this mesh.  It is similar to the ITriShapeData::GetTriangles function.
 	 * \return A vector containing all the triangle faces from all the triangle strips that make up this mesh.
@@ -94,6 +103,13 @@ public:
 	 */
 	vector<Triangle> GetTriangles() const;
 
+	/*!
+	 * Returns all triangle faces in all triangle strips without copying them.  The list is built from the strips the first time it is needed and kept until the strips change, so repeated calls are cheap.  Several threads may call this at once as long as none of them changes the strips.  Triangles that repeat a vertex are left out, as in GetTriangles.
+	 * \return The triangle faces from all the triangle strips that make up this mesh.
+	 * \sa NiTriStripData::GetTriangles
+	 */
+	NIFLIB_API virtual const vector<Triangle> & GetTriangleArray() const;
+
 	//--Setter--/
 
 	/*!
@@ -116,6 +132,13 @@ private:
 	void SetTSTriangles( const vector<Triangle> & in );
 	unsigned short CalcTriangleCount() const;
 
+	/*! The triangles of the strips, built by GetTriangleArray. */
+	mutable vector<Triangle> triangleCache;
+	/*! Whether triangleCache matches the strips. */
+	mutable bool triangleCacheValid;
+	/*! Guards triangleCache so that it can be built by concurrent readers. */
+	mutable std::mutex triangleCacheLock;
+
 	//--END CUSTOM CODE--//
 protected:
 	/*! Number of OpenGL triangle strips that are present. */
@@ -134,6 +134,50 @@ public:
 	*/
 	NIFLIB_API void SetSubShapes( vector<OblivionSubShape>& value );	
 
+	/*!
+	 * Returns the vertices without copying them.  The reference stays valid
+	 * until the vertices are changed or this object is destroyed.
+	 * \return The vertices used by this mesh.
+	 */
+	NIFLIB_API const vector<Vector3> & GetVertexArray() const;
+
+	/*!
+	 * Returns the triangle data without copying it.  Unlike
+	 * GetHavokTriangles, degenerate triangles are included, so indices match
+	 * the ones used by MOPP code.  The reference stays valid until the
+	 * triangles are changed or this object is destroyed.
+	 * \return The triangle data of this mesh.
+	 */
+	NIFLIB_API const vector<hkTriangle> & GetHavokTriangleArray() const;
+
+	/*!
+	 * Returns the subshape data without copying it.  The reference stays
+	 * valid until the subshapes are changed or this object is destroyed.
+	 * \return The subshape data.
+	 */
+	NIFLIB_API const vector<OblivionSubShape> & GetSubShapeArray() const;
+
+	/*!
+	 * Reports whether the vertices are stored as half precision floats.  This
+	 * is only used from version 20.2.0.7 onward.
+	 * \return True if the vertices are stored compressed.
+	 */
+	NIFLIB_API bool GetCompressed() const;
+
+	/*!
+	 * Sets whether the vertices are stored as half precision floats from
+	 * version 20.2.0.7 onward.  Compressed vertices are rounded to the nearest
+	 * half when the file is written and keep about three significant digits.
+	 * \param[in] value True to store the vertices compressed.
+	 */
+	NIFLIB_API void SetCompressed( bool value );
+
+private:
+	/*! Reads the block from version 20.2.0.7 on, decoding half float vertices. */
+	void ReadCompressible( istream& in, list<unsigned int> & link_stack, const NifInfo & info );
+	/*! Writes the block from version 20.2.0.7 on with half float vertices. */
+	void WriteCompressed( ostream& out, const map<NiObjectRef,unsigned int> & link_map, list<NiObject *> & missing_link_stack, const NifInfo & info ) const;
+
 	//--END CUSTOM CODE--//
 protected:
 	/*! Number of triangles? */
@@ -0,0 +1,262 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/CollisionCheck.h"
+#include "../include/CollisionQuery.h"
+#include "../include/niflib.h"
+#include "../include/obj/NiNode.h"
+#include "../include/obj/NiGeometry.h"
+#include "../include/obj/NiGeometryData.h"
+#include "../include/obj/NiSkinInstance.h"
+#include "../include/obj/bhkNiCollisionObject.h"
+#include "../include/obj/bhkWorldObject.h"
+#include "../include/obj/bhkRigidBodyT.h"
+#include "../include/obj/bhkShape.h"
+#include "NifParallel.h"
+#include <atomic>
+#include <stdexcept>
+#include <cmath>
+
+namespace Niflib {
+
+//Havok units to NIF units
+static const float HAVOK_SCALE = 7.0f;
+static const float SKYRIM_HAVOK_SCALE = 69.99f;
+
+static float HavokScaleFor( const NifInfo & info, const CollisionCheckParams & params ) {
+	if ( params.havokScale > 0.0f ) {
+		return params.havokScale;
+	}
+	if ( info.version >= VER_20_2_0_7 && info.userVersion == 12 && info.userVersion2 >= 83 ) {
+		return SKYRIM_HAVOK_SCALE;
+	}
+	return HAVOK_SCALE;
+}
+
+static void Extend( Vector3 & lo, Vector3 & hi, const Vector3 & p ) {
+	lo.x = p.x < lo.x ? p.x : lo.x;
+	lo.y = p.y < lo.y ? p.y : lo.y;
+	lo.z = p.z < lo.z ? p.z : lo.z;
+	hi.x = p.x > hi.x ? p.x : hi.x;
+	hi.y = p.y > hi.y ? p.y : hi.y;
+	hi.z = p.z > hi.z ? p.z : hi.z;
+}
+
+//The world bounds of the unskinned geometry at or below an object, not
+//counting branches that carry their own collision
+static bool RenderBounds( NiAVObject * root, Vector3 & lo, Vector3 & hi ) {
+	bool found = false;
+	vector<NiAVObject *> stack( 1, root );
+	while ( !stack.empty() ) {
+		NiAVObject * obj = stack.back();
+		stack.pop_back();
+		if ( obj != root && obj->GetCollisionObject() != NULL ) {
+			continue;
+		}
+		if ( obj->IsDerivedType( NiGeometry::TYPE ) ) {
+			NiGeometry * geom = static_cast<NiGeometry *>(obj);
+			Ref<NiGeometryData> data = geom->GetData();
+			if ( data == NULL || geom->GetSkinInstance() != NULL ) {
+				continue;
+			}
+			const vector<Vector3> & verts = data->GetVertexArray();
+			Matrix44 world = geom->GetWorldTransform();
+			for ( size_t i = 0; i < verts.size(); ++i ) {
+				Vector3 p = world * verts[i];
+				if ( !found ) {
+					lo = hi = p;
+					found = true;
+				}
+				Extend( lo, hi, p );
+			}
+		} else if ( obj->IsDerivedType( NiNode::TYPE ) ) {
+			vector< Ref<NiAVObject> > children = static_cast<NiNode *>(obj)->GetChildren();
+			for ( size_t i = 0; i < children.size(); ++i ) {
+				if ( children[i] != NULL ) {
+					stack.push_back( children[i] );
+				}
+			}
+		}
+	}
+	return found;
+}
+
+//The world bounds of the collision attached to an object
+static bool CollisionBounds( NiAVObject * obj, float havok_scale, Vector3 & lo, Vector3 & hi ) {
+	Ref<NiCollisionObject> collision = obj->GetCollisionObject();
+	if ( collision == NULL || !collision->IsDerivedType( bhkNiCollisionObject::TYPE ) ) {
+		return false;
+	}
+	Ref<NiObject> body = static_cast<bhkNiCollisionObject *>(&*collision)->GetBody();
+	if ( body == NULL || !body->IsDerivedType( bhkWorldObject::TYPE ) ) {
+		return false;
+	}
+	Ref<bhkShape> shape = static_cast<bhkWorldObject *>(&*body)->GetShape();
+	if ( shape == NULL ) {
+		return false;
+	}
+
+	//Row vectors, so the body transform comes before the world transform
+	Matrix44 local( Vector3( 0.0f, 0.0f, 0.0f ), Matrix33::IDENTITY, havok_scale );
+	if ( body->IsDerivedType( bhkRigidBodyT::TYPE ) ) {
+		bhkRigidBody * rigid = static_cast<bhkRigidBody *>(&*body);
+		Vector4 t = rigid->GetTranslation();
+		QuaternionXYZW r = rigid->GetRotation();
+		Quaternion q( r.w, r.x, r.y, r.z );
+		local = Matrix44( Vector3( t.x, t.y, t.z ) * havok_scale, q.AsMatrix(), havok_scale );
+	}
+	return ShapeBvh::GetShapeBounds( shape, local * obj->GetWorldTransform(), lo, hi );
+}
+
+unsigned int CheckCollisionBounds( const vector< Ref<NiObject> > & objects, const NifInfo & info, vector<CollisionMismatch> & mismatches, const CollisionCheckParams & params ) {
+	mismatches.clear();
+	float havok_scale = HavokScaleFor( info, params );
+	unsigned int checked = 0;
+	for ( size_t i = 0; i < objects.size(); ++i ) {
+		if ( objects[i] == NULL || !objects[i]->IsDerivedType( NiAVObject::TYPE ) ) {
+			continue;
+		}
+		NiAVObject * obj = static_cast<NiAVObject *>(&*objects[i]);
+		if ( obj->GetCollisionObject() == NULL ) {
+			continue;
+		}
+		CollisionMismatch m;
+		if ( !CollisionBounds( obj, havok_scale, m.collisionMin, m.collisionMax ) ) {
+			continue;
+		}
+		if ( !RenderBounds( obj, m.renderMin, m.renderMax ) ) {
+			continue;
+		}
+		++checked;
+
+		float sides[6] = {
+			m.collisionMin.x - m.renderMin.x, m.collisionMin.y - m.renderMin.y, m.collisionMin.z - m.renderMin.z,
+			m.collisionMax.x - m.renderMax.x, m.collisionMax.y - m.renderMax.y, m.collisionMax.z - m.renderMax.z
+		};
+		for ( int k = 0; k < 6; ++k ) {
+			m.gap = std::max( m.gap, float( fabs( sides[k] ) ) );
+		}
+		float allowed = std::max( params.tolerance, params.relativeTolerance * ( m.renderMax - m.renderMin ).Magnitude() );
+		if ( m.gap > allowed ) {
+			m.block = (unsigned int)i;
+			m.name = obj->GetName();
+			mismatches.push_back( m );
+		}
+	}
+	return checked;
+}
+
+unsigned int CheckCollisionBounds( const vector<string> & file_names, vector<CollisionCheckResult> & results, const CollisionCheckParams & params ) {
+	results.assign( file_names.size(), CollisionCheckResult() );
+
+	//Each thread takes the next unchecked file, so large files do not hold
+	//up a fixed share of the list.  The objects of a file are only touched
+	//by the thread that read it.
+	atomic<size_t> next( 0 );
+	unsigned int threads = ParallelThreadCount( params.numThreads, file_names.size() );
+	ParallelFor( threads, threads, [&]( size_t, size_t ) {
+		for ( size_t i = next++; i < file_names.size(); i = next++ ) {
+			CollisionCheckResult & result = results[i];
+			result.file = file_names[i];
+			try {
+				NifInfo info;
+				vector< Ref<NiObject> > objects = ReadNifList( file_names[i], &info );
+				result.checked = CheckCollisionBounds( objects, info, result.mismatches, params );
+			} catch ( exception & e ) {
+				result.error = e.what();
+				if ( result.error.empty() ) {
+					result.error = "Unknown error";
+				}
+			}
+		}
+	} );
+
+	unsigned int failed = 0;
+	for ( size_t i = 0; i < results.size(); ++i ) {
+		if ( !results[i].error.empty() || !results[i].mismatches.empty() ) {
+			++failed;
+		}
+	}
+	return failed;
+}
+
+//--Report--//
+
+static void WriteJsonString( ostream & out, const string & s ) {
+	static const char hex[] = "0123456789abcdef";
+	out << '"';
+	for ( size_t i = 0; i < s.size(); ++i ) {
+		unsigned char c = (unsigned char)s[i];
+		if ( c == '"' || c == '\\' ) {
+			out << '\\' << char(c);
+		} else if ( c == '\n' ) {
+			out << "\\n";
+		} else if ( c == '\r' ) {
+			out << "\\r";
+		} else if ( c == '\t' ) {
+			out << "\\t";
+		} else if ( c < 0x20 ) {
+			out << "\\u00" << hex[c >> 4] << hex[c & 15];
+		} else {
+			out << char(c);
+		}
+	}
+	out << '"';
+}
+
+//JSON has no infinity or NaN, so those are written as null
+static void WriteJsonNumber( ostream & out, float f ) {
+	if ( f != f || f - f != 0.0f ) {
+		out << "null";
+	} else {
+		out << f;
+	}
+}
+
+static void WriteJsonBox( ostream & out, const Vector3 & lo, const Vector3 & hi ) {
+	float v[6] = { lo.x, lo.y, lo.z, hi.x, hi.y, hi.z };
+	out << '[';
+	for ( int i = 0; i < 6; ++i ) {
+		if ( i > 0 ) {
+			out << ',';
+		}
+		WriteJsonNumber( out, v[i] );
+	}
+	out << ']';
+}
+
+void WriteCollisionCheckReport( ostream & out, const vector<CollisionCheckResult> & results ) {
+	streamsize old_precision = out.precision( 9 );
+	for ( size_t i = 0; i < results.size(); ++i ) {
+		const CollisionCheckResult & r = results[i];
+		out << "{\"file\":";
+		WriteJsonString( out, r.file );
+		if ( !r.error.empty() ) {
+			out << ",\"status\":\"error\",\"error\":";
+			WriteJsonString( out, r.error );
+			out << "}\n";
+			continue;
+		}
+		out << ",\"status\":\"" << ( r.mismatches.empty() ? "ok" : "mismatch" ) << "\"";
+		out << ",\"checked\":" << r.checked << ",\"mismatches\":[";
+		for ( size_t j = 0; j < r.mismatches.size(); ++j ) {
+			const CollisionMismatch & m = r.mismatches[j];
+			if ( j > 0 ) {
+				out << ',';
+			}
+			out << "{\"block\":" << m.block << ",\"name\":";
+			WriteJsonString( out, m.name );
+			out << ",\"gap\":";
+			WriteJsonNumber( out, m.gap );
+			out << ",\"render\":";
+			WriteJsonBox( out, m.renderMin, m.renderMax );
+			out << ",\"collision\":";
+			WriteJsonBox( out, m.collisionMin, m.collisionMax );
+			out << '}';
+		}
+		out << "]}\n";
+	}
+	out.precision( old_precision );
+}
+
+} //End Niflib namespace
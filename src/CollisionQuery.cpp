@@ -0,0 +1,956 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/CollisionQuery.h"
+#include "../include/CompressedMesh.h"
+#include "../include/obj/bhkShape.h"
+#include "../include/obj/bhkMoppBvTreeShape.h"
+#include "../include/obj/bhkListShape.h"
+#include "../include/obj/bhkConvexListShape.h"
+#include "../include/obj/bhkTransformShape.h"
+#include "../include/obj/bhkPackedNiTriStripsShape.h"
+#include "../include/obj/hkPackedNiTriStripsData.h"
+#include "../include/obj/bhkNiTriStripsShape.h"
+#include "../include/obj/NiTriStripsData.h"
+#include "../include/obj/bhkCompressedMeshShape.h"
+#include "../include/obj/bhkCompressedMeshShapeData.h"
+#include "../include/obj/bhkSphereShape.h"
+#include "../include/obj/bhkMultiSphereShape.h"
+#include "../include/obj/bhkCapsuleShape.h"
+#include "../include/obj/bhkBoxShape.h"
+#include "../include/obj/bhkConvexVerticesShape.h"
+#include "NifSimd.h"
+#include "NifParallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+namespace Niflib {
+
+enum PrimitiveKind {
+	PRIM_TRIANGLE,
+	PRIM_SPHERE,
+	PRIM_CAPSULE,
+	PRIM_BOX,
+	PRIM_CONVEX
+};
+
+//A triangle or solid in the space of the root shape.  Triangles use the
+//three corners, spheres the center, capsules the two end points and boxes
+//the center and the three half axes.  Convex solids are a list of planes.
+struct BvhPrimitive {
+	PrimitiveKind kind;
+	Vector3 p[4];
+	float radius;
+	unsigned int firstPlane;
+	unsigned int planeCount;
+	const bhkShape * shape;
+	unsigned int part;
+	Vector3 lo;
+	Vector3 hi;
+};
+
+//Interior nodes have count zero, their first child follows them and the
+//second is at index first.  Leaves hold primitives [first, first + count),
+//with the triangles first, and the triangles also sit in a SIMD block.
+struct BvhNode {
+	Vector3 lo;
+	Vector3 hi;
+	unsigned int first;
+	unsigned int count;
+	unsigned int triangles;
+	unsigned int block;
+};
+
+//Up to four triangles laid out for SIMD testing.  Unused lanes have zero
+//edges and can never be hit.
+struct TriangleBlock {
+	float v0[3][4];
+	float e1[3][4];
+	float e2[3][4];
+};
+
+static const unsigned int LEAF_SIZE = 4;
+static const unsigned int SAH_BINS = 16;
+//Below this depth nodes are split in half by count, which keeps the tree
+//shallow enough for the fixed size traversal stack
+static const unsigned int SAH_MAX_DEPTH = 60;
+static const unsigned int STACK_SIZE = 128;
+
+struct ShapeBvh::Impl {
+	vector<BvhPrimitive> prims;
+	vector<Vector4> planes;
+	vector<BvhNode> nodes;
+	vector<TriangleBlock> blocks;
+
+	void Gather( bhkShape * shape, const Matrix44 & xf );
+	void AddTriangles( const bhkShape * shape, const vector<Vector3> & verts, const vector<Triangle> & tris, const Vector3 & scale, const Matrix44 & xf );
+	void AddTriangles( const bhkShape * shape, const vector<Vector3> & verts, const vector<hkTriangle> & tris, const Vector3 & scale, const Matrix44 & xf );
+	void AddTriangle( const bhkShape * shape, unsigned int part, const Vector3 & a, const Vector3 & b, const Vector3 & c );
+	void AddSolid( BvhPrimitive & prim, const bhkShape * shape, unsigned int part );
+	void Build();
+	unsigned int BuildNode( vector<unsigned int> & order, unsigned int begin, unsigned int end, vector<Vector3> & centers, unsigned int depth );
+
+	bool RayCast( const CollisionRay & ray, CollisionHit & hit ) const;
+};
+
+//--Helpers--//
+
+static inline float Axis( const Vector3 & v, int axis ) {
+	return axis == 0 ? v.x : ( axis == 1 ? v.y : v.z );
+}
+
+static inline Vector3 Min( const Vector3 & a, const Vector3 & b ) {
+	return Vector3( min( a.x, b.x ), min( a.y, b.y ), min( a.z, b.z ) );
+}
+
+static inline Vector3 Max( const Vector3 & a, const Vector3 & b ) {
+	return Vector3( max( a.x, b.x ), max( a.y, b.y ), max( a.z, b.z ) );
+}
+
+static inline float HalfArea( const Vector3 & lo, const Vector3 & hi ) {
+	Vector3 d = hi - lo;
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static inline Vector3 TransformVector( const Matrix44 & xf, const Vector3 & v ) {
+	return xf * v - xf * Vector3( 0.0f, 0.0f, 0.0f );
+}
+
+//--Gathering primitives--//
+
+void ShapeBvh::Impl::AddTriangle( const bhkShape * shape, unsigned int part, const Vector3 & a, const Vector3 & b, const Vector3 & c ) {
+	BvhPrimitive prim;
+	prim.kind = PRIM_TRIANGLE;
+	prim.p[0] = a;
+	prim.p[1] = b;
+	prim.p[2] = c;
+	prim.radius = 0.0f;
+	prim.firstPlane = prim.planeCount = 0;
+	prim.shape = shape;
+	prim.part = part;
+	prim.lo = Min( a, Min( b, c ) );
+	prim.hi = Max( a, Max( b, c ) );
+	prims.push_back( prim );
+}
+
+static void TransformVertices( const vector<Vector3> & verts, const Vector3 & scale, const Matrix44 & xf, vector<Vector3> & world ) {
+	world.resize( verts.size() );
+	for ( size_t i = 0; i < verts.size(); ++i ) {
+		world[i] = xf * Vector3( verts[i].x * scale.x, verts[i].y * scale.y, verts[i].z * scale.z );
+	}
+}
+
+void ShapeBvh::Impl::AddTriangles( const bhkShape * shape, const vector<Vector3> & verts, const vector<Triangle> & tris, const Vector3 & scale, const Matrix44 & xf ) {
+	vector<Vector3> world;
+	TransformVertices( verts, scale, xf, world );
+	for ( size_t i = 0; i < tris.size(); ++i ) {
+		const Triangle & t = tris[i];
+		if ( t.v1 >= world.size() || t.v2 >= world.size() || t.v3 >= world.size() ) {
+			continue;
+		}
+		AddTriangle( shape, (unsigned int)i, world[t.v1], world[t.v2], world[t.v3] );
+	}
+}
+
+void ShapeBvh::Impl::AddTriangles( const bhkShape * shape, const vector<Vector3> & verts, const vector<hkTriangle> & tris, const Vector3 & scale, const Matrix44 & xf ) {
+	vector<Vector3> world;
+	TransformVertices( verts, scale, xf, world );
+	//Degenerate triangles are skipped, but the others keep their index into
+	//the stored array, which is what Havok shape keys refer to
+	for ( size_t i = 0; i < tris.size(); ++i ) {
+		const Triangle & t = tris[i].triangle;
+		if ( t.v1 == t.v2 || t.v2 == t.v3 || t.v1 == t.v3 ) {
+			continue;
+		}
+		if ( t.v1 >= world.size() || t.v2 >= world.size() || t.v3 >= world.size() ) {
+			continue;
+		}
+		AddTriangle( shape, (unsigned int)i, world[t.v1], world[t.v2], world[t.v3] );
+	}
+}
+
+void ShapeBvh::Impl::AddSolid( BvhPrimitive & prim, const bhkShape * shape, unsigned int part ) {
+	prim.shape = shape;
+	prim.part = part;
+	prims.push_back( prim );
+}
+
+void ShapeBvh::Impl::Gather( bhkShape * shape, const Matrix44 & xf ) {
+	if ( shape == NULL ) {
+		return;
+	}
+	float scale = TransformVector( xf, Vector3( 1.0f, 0.0f, 0.0f ) ).Magnitude();
+
+	if ( shape->IsDerivedType( bhkMoppBvTreeShape::TYPE ) ) {
+		Gather( static_cast<bhkMoppBvTreeShape *>(shape)->GetShape(), xf );
+	} else if ( shape->IsDerivedType( bhkTransformShape::TYPE ) ) {
+		bhkTransformShape * t = static_cast<bhkTransformShape *>(shape);
+		//Row vectors, so the inner transform is applied first
+		Gather( t->GetShape(), t->GetTransform() * xf );
+	} else if ( shape->IsDerivedType( bhkListShape::TYPE ) ) {
+		vector<Ref<bhkShape> > subs = static_cast<bhkListShape *>(shape)->GetSubShapes();
+		for ( size_t i = 0; i < subs.size(); ++i ) {
+			Gather( subs[i], xf );
+		}
+	} else if ( shape->IsDerivedType( bhkConvexListShape::TYPE ) ) {
+		vector<Ref<bhkConvexShape> > subs = static_cast<bhkConvexListShape *>(shape)->GetSubShapes();
+		for ( size_t i = 0; i < subs.size(); ++i ) {
+			Gather( StaticCast<bhkShape>( subs[i] ), xf );
+		}
+	} else if ( shape->IsDerivedType( bhkPackedNiTriStripsShape::TYPE ) ) {
+		bhkPackedNiTriStripsShape * packed = static_cast<bhkPackedNiTriStripsShape *>(shape);
+		Ref<hkPackedNiTriStripsData> data = packed->GetData();
+		if ( data != NULL ) {
+			AddTriangles( shape, data->GetVertexArray(), data->GetHavokTriangleArray(), packed->GetScale(), xf );
+		}
+	} else if ( shape->IsDerivedType( bhkNiTriStripsShape::TYPE ) ) {
+		bhkNiTriStripsShape * strips = static_cast<bhkNiTriStripsShape *>(shape);
+		unsigned int base = (unsigned int)(prims.size());
+		for ( int i = 0; i < strips->GetNumStripsData(); ++i ) {
+			Ref<NiTriStripsData> data = strips->GetStripsData( i );
+			if ( data != NULL ) {
+				AddTriangles( shape, data->GetVertexArray(), data->GetTriangleArray(), strips->GetScale(), xf );
+			}
+		}
+		//Number the triangles across all the strips data of the shape
+		for ( size_t i = base; i < prims.size(); ++i ) {
+			prims[i].part = (unsigned int)( i - base );
+		}
+	} else if ( shape->IsDerivedType( bhkCompressedMeshShape::TYPE ) ) {
+		Ref<bhkCompressedMeshShapeData> data = static_cast<bhkCompressedMeshShape *>(shape)->GetData();
+		if ( data != NULL ) {
+			vector<Vector3> verts;
+			vector<unsigned int> indices;
+			vector<SkyrimHavokMaterial> materials;
+			DecompressMeshShapeData( data, verts, indices, materials );
+			for ( size_t i = 0; i < verts.size(); ++i ) {
+				verts[i] = xf * verts[i];
+			}
+			for ( size_t i = 0; i + 2 < indices.size(); i += 3 ) {
+				AddTriangle( shape, (unsigned int)( i / 3 ), verts[indices[i]], verts[indices[i + 1]], verts[indices[i + 2]] );
+			}
+		}
+	} else if ( shape->IsDerivedType( bhkSphereShape::TYPE ) ) {
+		BvhPrimitive prim;
+		prim.kind = PRIM_SPHERE;
+		prim.p[0] = xf * Vector3( 0.0f, 0.0f, 0.0f );
+		prim.radius = static_cast<bhkSphereShape *>(shape)->GetRadius() * scale;
+		Vector3 r( prim.radius, prim.radius, prim.radius );
+		prim.lo = prim.p[0] - r;
+		prim.hi = prim.p[0] + r;
+		AddSolid( prim, shape, 0 );
+	} else if ( shape->IsDerivedType( bhkMultiSphereShape::TYPE ) ) {
+		vector<SphereBV> spheres = static_cast<bhkMultiSphereShape *>(shape)->GetSpheres();
+		for ( size_t i = 0; i < spheres.size(); ++i ) {
+			BvhPrimitive prim;
+			prim.kind = PRIM_SPHERE;
+			prim.p[0] = xf * spheres[i].center;
+			prim.radius = spheres[i].radius * scale;
+			Vector3 r( prim.radius, prim.radius, prim.radius );
+			prim.lo = prim.p[0] - r;
+			prim.hi = prim.p[0] + r;
+			AddSolid( prim, shape, (unsigned int)i );
+		}
+	} else if ( shape->IsDerivedType( bhkCapsuleShape::TYPE ) ) {
+		bhkCapsuleShape * capsule = static_cast<bhkCapsuleShape *>(shape);
+		BvhPrimitive prim;
+		prim.kind = PRIM_CAPSULE;
+		prim.p[0] = xf * capsule->GetFirstPoint();
+		prim.p[1] = xf * capsule->GetSecondPoint();
+		prim.radius = capsule->GetRadius() * scale;
+		Vector3 r( prim.radius, prim.radius, prim.radius );
+		prim.lo = Min( prim.p[0], prim.p[1] ) - r;
+		prim.hi = Max( prim.p[0], prim.p[1] ) + r;
+		AddSolid( prim, shape, 0 );
+	} else if ( shape->IsDerivedType( bhkBoxShape::TYPE ) ) {
+		Vector3 half = static_cast<bhkBoxShape *>(shape)->GetDimensions();
+		BvhPrimitive prim;
+		prim.kind = PRIM_BOX;
+		prim.p[0] = xf * Vector3( 0.0f, 0.0f, 0.0f );
+		prim.p[1] = TransformVector( xf, Vector3( half.x, 0.0f, 0.0f ) );
+		prim.p[2] = TransformVector( xf, Vector3( 0.0f, half.y, 0.0f ) );
+		prim.p[3] = TransformVector( xf, Vector3( 0.0f, 0.0f, half.z ) );
+		Vector3 extent(
+			fabs( prim.p[1].x ) + fabs( prim.p[2].x ) + fabs( prim.p[3].x ),
+			fabs( prim.p[1].y ) + fabs( prim.p[2].y ) + fabs( prim.p[3].y ),
+			fabs( prim.p[1].z ) + fabs( prim.p[2].z ) + fabs( prim.p[3].z )
+		);
+		prim.lo = prim.p[0] - extent;
+		prim.hi = prim.p[0] + extent;
+		prim.radius = 0.0f;
+		AddSolid( prim, shape, 0 );
+	} else if ( shape->IsDerivedType( bhkConvexVerticesShape::TYPE ) ) {
+		bhkConvexVerticesShape * convex = static_cast<bhkConvexVerticesShape *>(shape);
+		vector<Vector3> verts = convex->GetVertices();
+		if ( verts.empty() ) {
+			return;
+		}
+		BvhPrimitive prim;
+		prim.kind = PRIM_CONVEX;
+		prim.radius = 0.0f;
+		prim.lo = prim.hi = xf * verts[0];
+		for ( size_t i = 0; i < verts.size(); ++i ) {
+			Vector3 v = xf * verts[i];
+			prim.lo = Min( prim.lo, v );
+			prim.hi = Max( prim.hi, v );
+		}
+		//Each plane keeps n . p + w <= 0 inside.  Without planes fall back
+		//to the bounds of the vertices.
+		vector<Vector4> local = convex->GetNormalsAndDist();
+		prim.firstPlane = (unsigned int)(planes.size());
+		if ( local.empty() ) {
+			planes.push_back( Vector4( 1.0f, 0.0f, 0.0f, -prim.hi.x ) );
+			planes.push_back( Vector4( -1.0f, 0.0f, 0.0f, prim.lo.x ) );
+			planes.push_back( Vector4( 0.0f, 1.0f, 0.0f, -prim.hi.y ) );
+			planes.push_back( Vector4( 0.0f, -1.0f, 0.0f, prim.lo.y ) );
+			planes.push_back( Vector4( 0.0f, 0.0f, 1.0f, -prim.hi.z ) );
+			planes.push_back( Vector4( 0.0f, 0.0f, -1.0f, prim.lo.z ) );
+		} else {
+			for ( size_t i = 0; i < local.size(); ++i ) {
+				Vector3 n( local[i].x, local[i].y, local[i].z );
+				Vector3 on_plane = xf * ( n * -local[i].w );
+				Vector3 wn = TransformVector( xf, n ).Normalized();
+				planes.push_back( Vector4( wn.x, wn.y, wn.z, -wn.DotProduct( on_plane ) ) );
+			}
+		}
+		prim.planeCount = (unsigned int)( planes.size() - prim.firstPlane );
+		AddSolid( prim, shape, 0 );
+	}
+}
+
+//--Building--//
+
+void ShapeBvh::Impl::Build() {
+	nodes.clear();
+	blocks.clear();
+	if ( prims.empty() ) {
+		return;
+	}
+	vector<unsigned int> order( prims.size() );
+	vector<Vector3> centers( prims.size() );
+	for ( size_t i = 0; i < prims.size(); ++i ) {
+		order[i] = (unsigned int)i;
+		centers[i] = ( prims[i].lo + prims[i].hi ) * 0.5f;
+	}
+	nodes.reserve( prims.size() * 2 / LEAF_SIZE + 1 );
+	BuildNode( order, 0, (unsigned int)(prims.size()), centers, 0 );
+
+	//Put the primitives in leaf order, then fill the triangle blocks
+	vector<BvhPrimitive> sorted( prims.size() );
+	for ( size_t i = 0; i < order.size(); ++i ) {
+		sorted[i] = prims[order[i]];
+	}
+	prims.swap( sorted );
+	for ( size_t n = 0; n < nodes.size(); ++n ) {
+		BvhNode & node = nodes[n];
+		if ( node.count == 0 || node.triangles == 0 ) {
+			continue;
+		}
+		node.block = (unsigned int)(blocks.size());
+		TriangleBlock block;
+		for ( unsigned int lane = 0; lane < 4; ++lane ) {
+			Vector3 v0, e1, e2;
+			if ( lane < node.triangles ) {
+				const BvhPrimitive & p = prims[node.first + lane];
+				v0 = p.p[0];
+				e1 = p.p[1] - p.p[0];
+				e2 = p.p[2] - p.p[0];
+			}
+			for ( int a = 0; a < 3; ++a ) {
+				block.v0[a][lane] = Axis( v0, a );
+				block.e1[a][lane] = Axis( e1, a );
+				block.e2[a][lane] = Axis( e2, a );
+			}
+		}
+		blocks.push_back( block );
+	}
+}
+
+unsigned int ShapeBvh::Impl::BuildNode( vector<unsigned int> & order, unsigned int begin, unsigned int end, vector<Vector3> & centers, unsigned int depth ) {
+	unsigned int index = (unsigned int)(nodes.size());
+	nodes.push_back( BvhNode() );
+	BvhNode node;
+	node.lo = prims[order[begin]].lo;
+	node.hi = prims[order[begin]].hi;
+	Vector3 clo = centers[order[begin]], chi = clo;
+	for ( unsigned int i = begin; i < end; ++i ) {
+		node.lo = Min( node.lo, prims[order[i]].lo );
+		node.hi = Max( node.hi, prims[order[i]].hi );
+		clo = Min( clo, centers[order[i]] );
+		chi = Max( chi, centers[order[i]] );
+	}
+	node.first = begin;
+	node.count = end - begin;
+	node.triangles = 0;
+	node.block = 0;
+
+	unsigned int count = end - begin;
+	unsigned int split = begin;
+	if ( count > LEAF_SIZE && depth < SAH_MAX_DEPTH ) {
+		//Bin the centers along each axis and pick the cheapest split
+		float best_cost = FLT_MAX;
+		int best_axis = -1;
+		unsigned int best_bin = 0;
+		for ( int axis = 0; axis < 3; ++axis ) {
+			float extent = Axis( chi, axis ) - Axis( clo, axis );
+			if ( extent <= 0.0f ) {
+				continue;
+			}
+			unsigned int bin_count[SAH_BINS] = { 0 };
+			Vector3 bin_lo[SAH_BINS], bin_hi[SAH_BINS];
+			for ( unsigned int i = begin; i < end; ++i ) {
+				unsigned int b = (unsigned int)( ( Axis( centers[order[i]], axis ) - Axis( clo, axis ) ) / extent * SAH_BINS );
+				b = b >= SAH_BINS ? SAH_BINS - 1 : b;
+				const BvhPrimitive & p = prims[order[i]];
+				if ( bin_count[b]++ == 0 ) {
+					bin_lo[b] = p.lo;
+					bin_hi[b] = p.hi;
+				} else {
+					bin_lo[b] = Min( bin_lo[b], p.lo );
+					bin_hi[b] = Max( bin_hi[b], p.hi );
+				}
+			}
+			//Sweep from the right to get the cost of every right side
+			float right_area[SAH_BINS];
+			unsigned int right_count[SAH_BINS];
+			Vector3 lo, hi;
+			unsigned int n = 0;
+			for ( int b = SAH_BINS - 1; b > 0; --b ) {
+				if ( bin_count[b] > 0 ) {
+					lo = n == 0 ? bin_lo[b] : Min( lo, bin_lo[b] );
+					hi = n == 0 ? bin_hi[b] : Max( hi, bin_hi[b] );
+					n += bin_count[b];
+				}
+				right_area[b] = n > 0 ? HalfArea( lo, hi ) : 0.0f;
+				right_count[b] = n;
+			}
+			n = 0;
+			for ( unsigned int b = 0; b + 1 < SAH_BINS; ++b ) {
+				if ( bin_count[b] > 0 ) {
+					lo = n == 0 ? bin_lo[b] : Min( lo, bin_lo[b] );
+					hi = n == 0 ? bin_hi[b] : Max( hi, bin_hi[b] );
+					n += bin_count[b];
+				}
+				if ( n == 0 || right_count[b + 1] == 0 ) {
+					continue;
+				}
+				float cost = HalfArea( lo, hi ) * n + right_area[b + 1] * right_count[b + 1];
+				if ( cost < best_cost ) {
+					best_cost = cost;
+					best_axis = axis;
+					best_bin = b;
+				}
+			}
+		}
+
+		if ( best_axis >= 0 ) {
+			float lo_c = Axis( clo, best_axis );
+			float extent = Axis( chi, best_axis ) - lo_c;
+			unsigned int * mid = partition( &order[0] + begin, &order[0] + end, [&]( unsigned int i ) {
+				unsigned int b = (unsigned int)( ( Axis( centers[i], best_axis ) - lo_c ) / extent * SAH_BINS );
+				b = b >= SAH_BINS ? SAH_BINS - 1 : b;
+				return b <= best_bin;
+			} );
+			split = (unsigned int)( mid - &order[0] );
+		}
+	}
+	//All centers in one place or too deep, split by count
+	if ( count > LEAF_SIZE && ( split <= begin || split >= end ) ) {
+		split = begin + count / 2;
+	}
+
+	if ( count <= LEAF_SIZE ) {
+		//Triangles go first in a leaf so they fill the SIMD block
+		unsigned int * tri_end = stable_partition( &order[0] + begin, &order[0] + end, [this]( unsigned int i ) {
+			return prims[i].kind == PRIM_TRIANGLE;
+		} );
+		node.triangles = (unsigned int)( tri_end - ( &order[0] + begin ) );
+		nodes[index] = node;
+		return index;
+	}
+
+	node.count = 0;
+	nodes[index] = node;
+	BuildNode( order, begin, split, centers, depth + 1 );
+	unsigned int right = BuildNode( order, split, end, centers, depth + 1 );
+	nodes[index].first = right;
+	return index;
+}
+
+//--Ray casting--//
+
+static bool RaySphere( const Vector3 & from, const Vector3 & dir, const Vector3 & center, float radius, float max_t, float & t, Vector3 & normal ) {
+	Vector3 m = from - center;
+	float c = m.DotProduct( m ) - radius * radius;
+	if ( c <= 0.0f ) {
+		t = 0.0f;
+		normal = dir.Magnitude() > 0.0f ? ( dir * -1.0f ).Normalized() : Vector3( 0.0f, 0.0f, 1.0f );
+		return true;
+	}
+	float a = dir.DotProduct( dir );
+	float b = m.DotProduct( dir );
+	if ( a <= 0.0f || b >= 0.0f ) {
+		return false;
+	}
+	float disc = b * b - a * c;
+	if ( disc < 0.0f ) {
+		return false;
+	}
+	float hit = ( -b - sqrt( disc ) ) / a;
+	if ( hit < 0.0f || hit > max_t ) {
+		return false;
+	}
+	t = hit;
+	normal = ( m + dir * hit ) / radius;
+	return true;
+}
+
+static bool RayCapsule( const Vector3 & from, const Vector3 & dir, const BvhPrimitive & prim, float max_t, float & t, Vector3 & normal ) {
+	const Vector3 & a = prim.p[0];
+	Vector3 ba = prim.p[1] - a;
+	Vector3 oa = from - a;
+	float baba = ba.DotProduct( ba );
+	float r = prim.radius;
+
+	//Starting inside
+	float s = baba > 0.0f ? min( 1.0f, max( 0.0f, oa.DotProduct( ba ) / baba ) ) : 0.0f;
+	Vector3 to_axis = oa - ba * s;
+	if ( to_axis.DotProduct( to_axis ) <= r * r ) {
+		t = 0.0f;
+		normal = dir.Magnitude() > 0.0f ? ( dir * -1.0f ).Normalized() : Vector3( 0.0f, 0.0f, 1.0f );
+		return true;
+	}
+
+	bool found = false;
+	float best = max_t;
+	float ht;
+	Vector3 hn;
+	if ( RaySphere( from, dir, prim.p[0], r, best, ht, hn ) ) {
+		best = ht;
+		normal = hn;
+		found = true;
+	}
+	if ( RaySphere( from, dir, prim.p[1], r, best, ht, hn ) ) {
+		best = ht;
+		normal = hn;
+		found = true;
+	}
+
+	//The side of the cylinder between the end caps
+	float bard = ba.DotProduct( dir );
+	float baoa = ba.DotProduct( oa );
+	float k2 = baba * dir.DotProduct( dir ) - bard * bard;
+	float k1 = baba * oa.DotProduct( dir ) - baoa * bard;
+	float k0 = baba * oa.DotProduct( oa ) - baoa * baoa - r * r * baba;
+	if ( k2 > 1e-12f ) {
+		float h = k1 * k1 - k2 * k0;
+		if ( h >= 0.0f ) {
+			float hit = ( -k1 - sqrt( h ) ) / k2;
+			float y = baoa + hit * bard;
+			if ( hit >= 0.0f && hit <= best && y > 0.0f && y < baba ) {
+				best = hit;
+				normal = ( oa + dir * hit - ba * ( y / baba ) ) / r;
+				found = true;
+			}
+		}
+	}
+	t = best;
+	return found;
+}
+
+static bool RayBox( const Vector3 & from, const Vector3 & dir, const BvhPrimitive & prim, float max_t, float & t, Vector3 & normal ) {
+	float t0 = 0.0f, t1 = max_t;
+	Vector3 n0 = dir.Magnitude() > 0.0f ? ( dir * -1.0f ).Normalized() : Vector3( 0.0f, 0.0f, 1.0f );
+	Vector3 rel = from - prim.p[0];
+	for ( int i = 1; i <= 3; ++i ) {
+		float half = prim.p[i].Magnitude();
+		if ( half <= 0.0f ) {
+			return false;
+		}
+		Vector3 axis = prim.p[i] / half;
+		float o = rel.DotProduct( axis );
+		float d = dir.DotProduct( axis );
+		if ( fabs( d ) < 1e-12f ) {
+			if ( o < -half || o > half ) {
+				return false;
+			}
+			continue;
+		}
+		float ta = ( -half - o ) / d;
+		float tb = ( half - o ) / d;
+		Vector3 na = axis * -1.0f;
+		if ( ta > tb ) {
+			swap( ta, tb );
+			na = axis;
+		}
+		if ( ta > t0 ) {
+			t0 = ta;
+			n0 = na;
+		}
+		t1 = min( t1, tb );
+		if ( t0 > t1 ) {
+			return false;
+		}
+	}
+	t = t0;
+	normal = n0;
+	return true;
+}
+
+static bool RayConvex( const Vector3 & from, const Vector3 & dir, const Vector4 * planes, unsigned int count, float max_t, float & t, Vector3 & normal ) {
+	float t0 = 0.0f, t1 = max_t;
+	Vector3 n0 = dir.Magnitude() > 0.0f ? ( dir * -1.0f ).Normalized() : Vector3( 0.0f, 0.0f, 1.0f );
+	for ( unsigned int i = 0; i < count; ++i ) {
+		Vector3 n( planes[i].x, planes[i].y, planes[i].z );
+		float dist = n.DotProduct( from ) + planes[i].w;
+		float denom = n.DotProduct( dir );
+		if ( fabs( denom ) < 1e-12f ) {
+			if ( dist > 0.0f ) {
+				return false;
+			}
+			continue;
+		}
+		float hit = -dist / denom;
+		if ( denom < 0.0f ) {
+			if ( hit > t0 ) {
+				t0 = hit;
+				n0 = n;
+			}
+		} else {
+			t1 = min( t1, hit );
+		}
+		if ( t0 > t1 ) {
+			return false;
+		}
+	}
+	t = t0;
+	normal = n0;
+	return true;
+}
+
+static inline bool RayNode( const BvhNode & node, const Vector3 & from, const Vector3 & inv, float max_t, float & enter ) {
+	float tx0 = ( node.lo.x - from.x ) * inv.x, tx1 = ( node.hi.x - from.x ) * inv.x;
+	float ty0 = ( node.lo.y - from.y ) * inv.y, ty1 = ( node.hi.y - from.y ) * inv.y;
+	float tz0 = ( node.lo.z - from.z ) * inv.z, tz1 = ( node.hi.z - from.z ) * inv.z;
+	float t0 = max( max( min( tx0, tx1 ), min( ty0, ty1 ) ), max( min( tz0, tz1 ), 0.0f ) );
+	float t1 = min( min( max( tx0, tx1 ), max( ty0, ty1 ) ), min( max( tz0, tz1 ), max_t ) );
+	enter = t0;
+	return t0 <= t1;
+}
+
+static inline float SafeInverse( float d ) {
+	if ( fabs( d ) < 1e-30f ) {
+		return d < 0.0f ? -1e30f : 1e30f;
+	}
+	return 1.0f / d;
+}
+
+bool ShapeBvh::Impl::RayCast( const CollisionRay & ray, CollisionHit & hit ) const {
+	hit = CollisionHit();
+	if ( nodes.empty() ) {
+		return false;
+	}
+	Vector3 from = ray.from;
+	Vector3 dir = ray.to - ray.from;
+	Vector3 inv( SafeInverse( dir.x ), SafeInverse( dir.y ), SafeInverse( dir.z ) );
+	float best = 1.0f;
+	unsigned int best_prim = CollisionHit::NO_HIT;
+	Vector3 best_normal;
+
+	simd4f ox = SimdSplat( from.x ), oy = SimdSplat( from.y ), oz = SimdSplat( from.z );
+	simd4f dx = SimdSplat( dir.x ), dy = SimdSplat( dir.y ), dz = SimdSplat( dir.z );
+
+	unsigned int stack[STACK_SIZE];
+	unsigned int depth = 0;
+	float enter;
+	if ( !RayNode( nodes[0], from, inv, best, enter ) ) {
+		return false;
+	}
+	stack[depth++] = 0;
+	while ( depth > 0 ) {
+		const BvhNode & node = nodes[stack[--depth]];
+		if ( node.count == 0 ) {
+			//Visit the nearer child first
+			unsigned int left = (unsigned int)( &node - &nodes[0] ) + 1;
+			unsigned int right = node.first;
+			float el, er;
+			bool hl = RayNode( nodes[left], from, inv, best, el );
+			bool hr = RayNode( nodes[right], from, inv, best, er );
+			if ( hl && hr ) {
+				if ( el < er ) {
+					stack[depth++] = right;
+					stack[depth++] = left;
+				} else {
+					stack[depth++] = left;
+					stack[depth++] = right;
+				}
+			} else if ( hl ) {
+				stack[depth++] = left;
+			} else if ( hr ) {
+				stack[depth++] = right;
+			}
+			continue;
+		}
+
+		if ( node.triangles > 0 ) {
+			//Moller-Trumbore on four triangles at once, either side hits
+			const TriangleBlock & b = blocks[node.block];
+			simd4f e1x = SimdLoad( b.e1[0] ), e1y = SimdLoad( b.e1[1] ), e1z = SimdLoad( b.e1[2] );
+			simd4f e2x = SimdLoad( b.e2[0] ), e2y = SimdLoad( b.e2[1] ), e2z = SimdLoad( b.e2[2] );
+			simd4f px = SimdSub( SimdMul( dy, e2z ), SimdMul( dz, e2y ) );
+			simd4f py = SimdSub( SimdMul( dz, e2x ), SimdMul( dx, e2z ) );
+			simd4f pz = SimdSub( SimdMul( dx, e2y ), SimdMul( dy, e2x ) );
+			simd4f det = SimdDot3( e1x, e1y, e1z, px, py, pz );
+			simd4f sx = SimdSub( ox, SimdLoad( b.v0[0] ) );
+			simd4f sy = SimdSub( oy, SimdLoad( b.v0[1] ) );
+			simd4f sz = SimdSub( oz, SimdLoad( b.v0[2] ) );
+			simd4f u = SimdDot3( sx, sy, sz, px, py, pz );
+			simd4f qx = SimdSub( SimdMul( sy, e1z ), SimdMul( sz, e1y ) );
+			simd4f qy = SimdSub( SimdMul( sz, e1x ), SimdMul( sx, e1z ) );
+			simd4f qz = SimdSub( SimdMul( sx, e1y ), SimdMul( sy, e1x ) );
+			simd4f v = SimdDot3( dx, dy, dz, qx, qy, qz );
+			simd4f t = SimdDot3( e2x, e2y, e2z, qx, qy, qz );
+			float fdet[4], fu[4], fv[4], ft[4];
+			SimdStore( fdet, det );
+			SimdStore( fu, u );
+			SimdStore( fv, v );
+			SimdStore( ft, t );
+			for ( unsigned int lane = 0; lane < node.triangles; ++lane ) {
+				if ( fabs( fdet[lane] ) < 1e-20f ) {
+					continue;
+				}
+				float id = 1.0f / fdet[lane];
+				float lu = fu[lane] * id, lv = fv[lane] * id, lt = ft[lane] * id;
+				if ( lu < 0.0f || lv < 0.0f || lu + lv > 1.0f || lt < 0.0f || lt > best ) {
+					continue;
+				}
+				best = lt;
+				best_prim = node.first + lane;
+				const BvhPrimitive & p = prims[best_prim];
+				best_normal = ( p.p[1] - p.p[0] ).CrossProduct( p.p[2] - p.p[0] ).Normalized();
+				if ( best_normal.DotProduct( dir ) > 0.0f ) {
+					best_normal = best_normal * -1.0f;
+				}
+			}
+		}
+
+		for ( unsigned int i = node.first + node.triangles; i < node.first + node.count; ++i ) {
+			const BvhPrimitive & p = prims[i];
+			float t;
+			Vector3 n;
+			bool found = false;
+			switch ( p.kind ) {
+				case PRIM_SPHERE:
+					found = RaySphere( from, dir, p.p[0], p.radius, best, t, n );
+					break;
+				case PRIM_CAPSULE:
+					found = RayCapsule( from, dir, p, best, t, n );
+					break;
+				case PRIM_BOX:
+					found = RayBox( from, dir, p, best, t, n );
+					break;
+				case PRIM_CONVEX:
+					found = RayConvex( from, dir, &planes[p.firstPlane], p.planeCount, best, t, n );
+					break;
+				default:
+					break;
+			}
+			if ( found && t <= best ) {
+				best = t;
+				best_prim = i;
+				best_normal = n;
+			}
+		}
+	}
+
+	if ( best_prim == CollisionHit::NO_HIT ) {
+		return false;
+	}
+	hit.fraction = best;
+	hit.normal = best_normal;
+	hit.primitive = best_prim;
+	hit.shape = prims[best_prim].shape;
+	hit.part = prims[best_prim].part;
+	return true;
+}
+
+//--Box overlap--//
+
+//Separating axis test of a triangle against a box, after Akenine-Moller
+static bool TriangleOverlapsBox( const BvhPrimitive & p, const Vector3 & center, const Vector3 & half ) {
+	Vector3 v[3] = { p.p[0] - center, p.p[1] - center, p.p[2] - center };
+	Vector3 e[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+	for ( int i = 0; i < 3; ++i ) {
+		for ( int a = 0; a < 3; ++a ) {
+			//Cross product of the box axis a with edge i
+			Vector3 axis;
+			if ( a == 0 ) {
+				axis = Vector3( 0.0f, -e[i].z, e[i].y );
+			} else if ( a == 1 ) {
+				axis = Vector3( e[i].z, 0.0f, -e[i].x );
+			} else {
+				axis = Vector3( -e[i].y, e[i].x, 0.0f );
+			}
+			float p0 = v[0].DotProduct( axis ), p1 = v[1].DotProduct( axis ), p2 = v[2].DotProduct( axis );
+			float r = half.x * fabs( axis.x ) + half.y * fabs( axis.y ) + half.z * fabs( axis.z );
+			if ( min( p0, min( p1, p2 ) ) > r || max( p0, max( p1, p2 ) ) < -r ) {
+				return false;
+			}
+		}
+	}
+	Vector3 n = e[0].CrossProduct( e[1] );
+	float d = n.DotProduct( v[0] );
+	float r = half.x * fabs( n.x ) + half.y * fabs( n.y ) + half.z * fabs( n.z );
+	return fabs( d ) <= r;
+}
+
+static bool SphereOverlapsBox( const BvhPrimitive & p, const Vector3 & lo, const Vector3 & hi ) {
+	Vector3 closest = Min( Max( p.p[0], lo ), hi );
+	Vector3 d = closest - p.p[0];
+	return d.DotProduct( d ) <= p.radius * p.radius;
+}
+
+static inline bool BoundsOverlap( const Vector3 & alo, const Vector3 & ahi, const Vector3 & blo, const Vector3 & bhi ) {
+	return alo.x <= bhi.x && ahi.x >= blo.x && alo.y <= bhi.y && ahi.y >= blo.y && alo.z <= bhi.z && ahi.z >= blo.z;
+}
+
+//--ShapeBvh--//
+
+ShapeBvh::ShapeBvh( bhkShape * shape ) : impl( new Impl ) {
+	Matrix44 identity;
+	impl->Gather( shape, identity );
+	impl->Build();
+}
+
+ShapeBvh::~ShapeBvh() {
+	delete impl;
+}
+
+unsigned int ShapeBvh::GetPrimitiveCount() const {
+	return (unsigned int)(impl->prims.size());
+}
+
+void ShapeBvh::GetBounds( Vector3 & min, Vector3 & max ) const {
+	if ( impl->nodes.empty() ) {
+		min = max = Vector3( 0.0f, 0.0f, 0.0f );
+		return;
+	}
+	min = impl->nodes[0].lo;
+	max = impl->nodes[0].hi;
+}
+
+bool ShapeBvh::GetShapeBounds( bhkShape * shape, const Matrix44 & transform, Vector3 & min, Vector3 & max ) {
+	Impl impl;
+	impl.Gather( shape, transform );
+	if ( impl.prims.empty() ) {
+		min = max = Vector3( 0.0f, 0.0f, 0.0f );
+		return false;
+	}
+	min = impl.prims[0].lo;
+	max = impl.prims[0].hi;
+	for ( size_t i = 1; i < impl.prims.size(); ++i ) {
+		min = Min( min, impl.prims[i].lo );
+		max = Max( max, impl.prims[i].hi );
+	}
+	return true;
+}
+
+bool ShapeBvh::RayCast( const CollisionRay & ray, CollisionHit & hit ) const {
+	return impl->RayCast( ray, hit );
+}
+
+void ShapeBvh::RayCast( const vector<CollisionRay> & rays, vector<CollisionHit> & hits, unsigned int num_threads ) const {
+	hits.resize( rays.size() );
+	const Impl * data = impl;
+	CollisionHit * out = hits.empty() ? NULL : &hits[0];
+	ParallelFor( rays.size(), num_threads, [data, &rays, out]( size_t begin, size_t end ) {
+		for ( size_t i = begin; i < end; ++i ) {
+			data->RayCast( rays[i], out[i] );
+		}
+	} );
+}
+
+void ShapeBvh::QueryAabb( const Vector3 & min, const Vector3 & max, vector<unsigned int> & primitives ) const {
+	primitives.clear();
+	if ( impl->nodes.empty() ) {
+		return;
+	}
+	Vector3 center = ( min + max ) * 0.5f;
+	Vector3 half = ( max - min ) * 0.5f;
+	vector<unsigned int> stack;
+	stack.push_back( 0 );
+	while ( !stack.empty() ) {
+		unsigned int index = stack.back();
+		stack.pop_back();
+		const BvhNode & node = impl->nodes[index];
+		if ( !BoundsOverlap( node.lo, node.hi, min, max ) ) {
+			continue;
+		}
+		if ( node.count == 0 ) {
+			stack.push_back( node.first );
+			stack.push_back( index + 1 );
+			continue;
+		}
+		for ( unsigned int i = node.first; i < node.first + node.count; ++i ) {
+			const BvhPrimitive & p = impl->prims[i];
+			if ( !BoundsOverlap( p.lo, p.hi, min, max ) ) {
+				continue;
+			}
+			if ( p.kind == PRIM_TRIANGLE && !TriangleOverlapsBox( p, center, half ) ) {
+				continue;
+			}
+			if ( p.kind == PRIM_SPHERE && !SphereOverlapsBox( p, min, max ) ) {
+				continue;
+			}
+			primitives.push_back( i );
+		}
+	}
+	sort( primitives.begin(), primitives.end() );
+}
+
+const bhkShape * ShapeBvh::GetPrimitiveShape( unsigned int primitive, unsigned int & part ) const {
+	if ( primitive >= impl->prims.size() ) {
+		throw runtime_error("Collision primitive index is out of range.");
+	}
+	part = impl->prims[primitive].part;
+	return impl->prims[primitive].shape;
+}
+
+//--ShapeBvhCache--//
+
+ShapeBvhCache::ShapeBvhCache() {}
+
+ShapeBvhCache::~ShapeBvhCache() {}
+
+shared_ptr<const ShapeBvh> ShapeBvhCache::Get( bhkShape * shape ) {
+	lock_guard<mutex> guard( lock );
+	map<bhkShape *, Entry>::iterator it = entries.find( shape );
+	if ( it != entries.end() ) {
+		return it->second.bvh;
+	}
+	//Built while holding the lock, since walking the shapes touches their
+	//reference counts
+	shared_ptr<const ShapeBvh> bvh( new ShapeBvh( shape ) );
+	Entry & entry = entries[shape];
+	entry.shape = shape;
+	entry.bvh = bvh;
+	return bvh;
+}
+
+void ShapeBvhCache::Invalidate( bhkShape * shape ) {
+	lock_guard<mutex> guard( lock );
+	entries.erase( shape );
+}
+
+void ShapeBvhCache::Clear() {
+	lock_guard<mutex> guard( lock );
+	entries.clear();
+}
+
+unsigned int ShapeBvhCache::GetSize() const {
+	lock_guard<mutex> guard( lock );
+	return (unsigned int)(entries.size());
+}
+
+} //End Niflib namespace
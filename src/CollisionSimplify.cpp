@@ -0,0 +1,712 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/CollisionSimplify.h"
+#include "../include/obj/hkPackedNiTriStripsData.h"
+#include "../include/obj/bhkPackedNiTriStripsShape.h"
+#include "NifParallel.h"
+#include <stdexcept>
+#include <algorithm>
+#include <queue>
+#include <set>
+#include <cmath>
+
+namespace Niflib {
+
+//How strongly open edges resist being moved, relative to the surface
+static const double BOUNDARY_WEIGHT = 100.0;
+//The smallest cosine allowed between a triangle's normal before and after a collapse
+static const double MIN_NORMAL_COSINE = 0.3;
+//How far a vertex may move in a collapse
+enum VertexLock {
+	VERTEX_FREE = 0,
+	VERTEX_BORDER = 1,
+	VERTEX_SEAM = 2
+};
+//The welding code of an edge with no single neighbor
+static const unsigned short OPEN_EDGE_WELDING = 31;
+
+//A symmetric 4x4 error matrix, stored as its upper triangle
+struct Quadric {
+	double m[10];
+
+	Quadric() {
+		for ( int i = 0; i < 10; ++i ) {
+			m[i] = 0.0;
+		}
+	}
+
+	//Adds the squared distance to the plane a*x + b*y + c*z + d = 0
+	void AddPlane( double a, double b, double c, double d, double w ) {
+		m[0] += w * a * a; m[1] += w * a * b; m[2] += w * a * c; m[3] += w * a * d;
+		m[4] += w * b * b; m[5] += w * b * c; m[6] += w * b * d;
+		m[7] += w * c * c; m[8] += w * c * d;
+		m[9] += w * d * d;
+	}
+
+	Quadric & operator+=( const Quadric & rh ) {
+		for ( int i = 0; i < 10; ++i ) {
+			m[i] += rh.m[i];
+		}
+		return *this;
+	}
+
+	double Error( const double p[3] ) const {
+		double x = p[0], y = p[1], z = p[2];
+		return m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+			+ m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+			+ m[7] * z * z + 2.0 * m[8] * z
+			+ m[9];
+	}
+
+	//Finds the point of least error, returns false if there is no single one
+	bool Optimum( double p[3] ) const {
+		double a = m[0], b = m[1], c = m[2];
+		double e = m[4], f = m[5], h = m[7];
+		double c0 = e * h - f * f;
+		double c1 = c * f - b * h;
+		double c2 = b * f - c * e;
+		double det = a * c0 + b * c1 + c * c2;
+		double scale = a + e + h;
+		if ( scale <= 0.0 || std::fabs(det) <= 1e-9 * scale * scale * scale ) {
+			return false;
+		}
+		double rx = -m[3], ry = -m[6], rz = -m[8];
+		p[0] = ( c0 * rx + c1 * ry + c2 * rz ) / det;
+		p[1] = ( c1 * rx + ( a * h - c * c ) * ry + ( b * c - a * f ) * rz ) / det;
+		p[2] = ( c2 * rx + ( b * c - a * f ) * ry + ( a * e - b * b ) * rz ) / det;
+		return true;
+	}
+};
+
+//A possible edge collapse, stamped with the versions of its two vertices
+struct Collapse {
+	double cost;
+	unsigned int keep;
+	unsigned int drop;
+	unsigned int keepStamp;
+	unsigned int dropStamp;
+	double pos[3];
+
+	bool operator<( const Collapse & rh ) const {
+		//Reversed so the priority queue yields the cheapest collapse first
+		return cost > rh.cost;
+	}
+};
+
+//The working state of one simplification
+struct SimplifyMesh {
+	vector<double> pos;
+	vector<unsigned int> group;
+	vector<unsigned char> lock;
+	vector<unsigned int> tris;
+	vector<bool> triLive;
+	vector< vector<unsigned int> > vertTris;
+	vector<Quadric> quadrics;
+	vector<double> weights;
+	vector<unsigned int> stamps;
+	unsigned int liveTris;
+};
+
+static void Cross( const double a[3], const double b[3], double out[3] ) {
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static double Dot( const double a[3], const double b[3] ) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+//The unnormalized normal of the triangle through three points
+static void FaceNormal( const double * p0, const double * p1, const double * p2, double out[3] ) {
+	double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	Cross( e1, e2, out );
+}
+
+//Collects the live triangles around a vertex, dropping dead ones from its list
+static void PruneVertex( SimplifyMesh & mesh, unsigned int v ) {
+	vector<unsigned int> & list = mesh.vertTris[v];
+	size_t n = 0;
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		if ( mesh.triLive[list[i]] ) {
+			list[n++] = list[i];
+		}
+	}
+	list.resize(n);
+}
+
+static void Neighbors( const SimplifyMesh & mesh, unsigned int v, vector<unsigned int> & out ) {
+	out.clear();
+	const vector<unsigned int> & list = mesh.vertTris[v];
+	for ( size_t i = 0; i < list.size(); ++i ) {
+		if ( !mesh.triLive[list[i]] ) {
+			continue;
+		}
+		const unsigned int * t = &mesh.tris[list[i] * 3];
+		for ( int k = 0; k < 3; ++k ) {
+			if ( t[k] != v ) {
+				out.push_back( t[k] );
+			}
+		}
+	}
+	sort( out.begin(), out.end() );
+	out.erase( unique( out.begin(), out.end() ), out.end() );
+}
+
+//Works out where the two vertices of an edge would meet and what it costs
+static bool PlanCollapse( const SimplifyMesh & mesh, unsigned int a, unsigned int b, Collapse & out ) {
+	if ( mesh.lock[a] == VERTEX_SEAM || mesh.lock[b] == VERTEX_SEAM ) {
+		return false;
+	}
+	Quadric q = mesh.quadrics[a];
+	q += mesh.quadrics[b];
+	double w = mesh.weights[a] + mesh.weights[b];
+	if ( w <= 0.0 ) {
+		return false;
+	}
+	const double * pa = &mesh.pos[a * 3];
+	const double * pb = &mesh.pos[b * 3];
+	double mid[3] = { ( pa[0] + pb[0] ) * 0.5, ( pa[1] + pb[1] ) * 0.5, ( pa[2] + pb[2] ) * 0.5 };
+	double len2 = ( pa[0] - pb[0] ) * ( pa[0] - pb[0] ) + ( pa[1] - pb[1] ) * ( pa[1] - pb[1] ) + ( pa[2] - pb[2] ) * ( pa[2] - pb[2] );
+
+	//Border vertices stay where they are, so only the ends of the edge are tried
+	bool borderA = mesh.lock[a] == VERTEX_BORDER, borderB = mesh.lock[b] == VERTEX_BORDER;
+	const double * cands[3] = { pa, pb, mid };
+	double best = -1.0;
+	const double * bestPos = NULL;
+	for ( int i = 0; i < 3; ++i ) {
+		if ( ( borderA || borderB ) && ( i == 2 || ( i == 0 && !borderA ) || ( i == 1 && !borderB ) ) ) {
+			continue;
+		}
+		double e = q.Error( cands[i] );
+		if ( bestPos == NULL || e < best ) {
+			best = e;
+			bestPos = cands[i];
+		}
+	}
+	double opt[3];
+	if ( !borderA && !borderB && q.Optimum( opt ) ) {
+		//Nearly flat neighborhoods can put the optimum far away; keep it close
+		double d[3] = { opt[0] - mid[0], opt[1] - mid[1], opt[2] - mid[2] };
+		if ( Dot( d, d ) <= len2 ) {
+			double e = q.Error( opt );
+			if ( e < best ) {
+				best = e;
+				bestPos = opt;
+			}
+		}
+	}
+
+	out.cost = std::max( best, 0.0 ) / w;
+	out.keep = a;
+	out.drop = b;
+	out.keepStamp = mesh.stamps[a];
+	out.dropStamp = mesh.stamps[b];
+	out.pos[0] = bestPos[0];
+	out.pos[1] = bestPos[1];
+	out.pos[2] = bestPos[2];
+	return true;
+}
+
+static void PushEdges( const SimplifyMesh & mesh, unsigned int v, priority_queue<Collapse> & heap, vector<unsigned int> & scratch ) {
+	Neighbors( mesh, v, scratch );
+	for ( size_t i = 0; i < scratch.size(); ++i ) {
+		unsigned int n = scratch[i];
+		if ( mesh.group[n] != mesh.group[v] ) {
+			continue;
+		}
+		Collapse c;
+		if ( PlanCollapse( mesh, std::min( v, n ), std::max( v, n ), c ) ) {
+			heap.push( c );
+		}
+	}
+}
+
+//Checks that a collapse keeps the mesh manifold and does not fold it over
+static bool CanCollapse( const SimplifyMesh & mesh, const Collapse & c, vector<unsigned int> & na, vector<unsigned int> & nb ) {
+	unsigned int a = c.keep, b = c.drop;
+
+	//The only neighbors the two vertices may share are those across the edge
+	unsigned int shared = 0;
+	const vector<unsigned int> & listB = mesh.vertTris[b];
+	for ( size_t i = 0; i < listB.size(); ++i ) {
+		if ( !mesh.triLive[listB[i]] ) {
+			continue;
+		}
+		const unsigned int * t = &mesh.tris[listB[i] * 3];
+		if ( t[0] == a || t[1] == a || t[2] == a ) {
+			++shared;
+		}
+	}
+	if ( shared == 0 ) {
+		return false;
+	}
+	//Two border vertices may only meet along the border
+	if ( mesh.lock[a] == VERTEX_BORDER && mesh.lock[b] == VERTEX_BORDER && shared != 1 ) {
+		return false;
+	}
+	Neighbors( mesh, a, na );
+	Neighbors( mesh, b, nb );
+	unsigned int common = 0;
+	for ( size_t i = 0, j = 0; i < na.size() && j < nb.size(); ) {
+		if ( na[i] < nb[j] ) {
+			++i;
+		} else if ( nb[j] < na[i] ) {
+			++j;
+		} else {
+			++common;
+			++i;
+			++j;
+		}
+	}
+	if ( common != shared ) {
+		return false;
+	}
+
+	for ( int side = 0; side < 2; ++side ) {
+		unsigned int moved = side ? b : a;
+		unsigned int other = side ? a : b;
+		const vector<unsigned int> & list = mesh.vertTris[moved];
+		for ( size_t i = 0; i < list.size(); ++i ) {
+			if ( !mesh.triLive[list[i]] ) {
+				continue;
+			}
+			const unsigned int * t = &mesh.tris[list[i] * 3];
+			if ( t[0] == other || t[1] == other || t[2] == other ) {
+				continue;
+			}
+			const double * p[3];
+			const double * q[3];
+			for ( int k = 0; k < 3; ++k ) {
+				p[k] = &mesh.pos[t[k] * 3];
+				q[k] = t[k] == moved ? c.pos : p[k];
+			}
+			double before[3], after[3];
+			FaceNormal( p[0], p[1], p[2], before );
+			FaceNormal( q[0], q[1], q[2], after );
+			double lb = Dot( before, before ), la = Dot( after, after );
+			if ( la <= 0.0 || Dot( before, after ) < MIN_NORMAL_COSINE * std::sqrt( lb * la ) ) {
+				return false;
+			}
+
+			//A triangle of the dropped vertex must not land on one the kept vertex already has
+			if ( side == 1 ) {
+				unsigned int x = t[0] == b ? t[1] : t[0];
+				unsigned int y = t[2] == b ? t[1] : t[2];
+				const vector<unsigned int> & listA = mesh.vertTris[a];
+				for ( size_t j = 0; j < listA.size(); ++j ) {
+					if ( !mesh.triLive[listA[j]] ) {
+						continue;
+					}
+					const unsigned int * s = &mesh.tris[listA[j] * 3];
+					bool hasX = s[0] == x || s[1] == x || s[2] == x;
+					bool hasY = s[0] == y || s[1] == y || s[2] == y;
+					if ( hasX && hasY ) {
+						return false;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+static void DoCollapse( SimplifyMesh & mesh, const Collapse & c ) {
+	unsigned int a = c.keep, b = c.drop;
+	mesh.pos[a * 3] = c.pos[0];
+	mesh.pos[a * 3 + 1] = c.pos[1];
+	mesh.pos[a * 3 + 2] = c.pos[2];
+	mesh.quadrics[a] += mesh.quadrics[b];
+	mesh.weights[a] += mesh.weights[b];
+	mesh.lock[a] = std::max( mesh.lock[a], mesh.lock[b] );
+
+	vector<unsigned int> & listB = mesh.vertTris[b];
+	for ( size_t i = 0; i < listB.size(); ++i ) {
+		unsigned int ti = listB[i];
+		if ( !mesh.triLive[ti] ) {
+			continue;
+		}
+		unsigned int * t = &mesh.tris[ti * 3];
+		if ( t[0] == a || t[1] == a || t[2] == a ) {
+			mesh.triLive[ti] = false;
+			--mesh.liveTris;
+		} else {
+			for ( int k = 0; k < 3; ++k ) {
+				if ( t[k] == b ) {
+					t[k] = a;
+				}
+			}
+			mesh.vertTris[a].push_back( ti );
+		}
+	}
+	listB.clear();
+	PruneVertex( mesh, a );
+	++mesh.stamps[a];
+	++mesh.stamps[b];
+}
+
+//Runs the collapses on a mesh whose triangles are already checked
+static void RunCollapses( SimplifyMesh & mesh, const CollisionSimplifyParams & params ) {
+	size_t numVerts = mesh.group.size();
+	size_t numTris = mesh.triLive.size();
+	mesh.vertTris.assign( numVerts, vector<unsigned int>() );
+	mesh.quadrics.assign( numVerts, Quadric() );
+	mesh.weights.assign( numVerts, 0.0 );
+	mesh.stamps.assign( numVerts, 0 );
+
+	//Surface quadrics, weighted by area
+	for ( unsigned int i = 0; i < numTris; ++i ) {
+		const unsigned int * t = &mesh.tris[i * 3];
+		double n[3];
+		FaceNormal( &mesh.pos[t[0] * 3], &mesh.pos[t[1] * 3], &mesh.pos[t[2] * 3], n );
+		double len = std::sqrt( Dot( n, n ) );
+		for ( int k = 0; k < 3; ++k ) {
+			mesh.vertTris[t[k]].push_back( i );
+		}
+		if ( len <= 0.0 ) {
+			continue;
+		}
+		double area = len * 0.5;
+		n[0] /= len; n[1] /= len; n[2] /= len;
+		double d = -Dot( n, &mesh.pos[t[0] * 3] );
+		for ( int k = 0; k < 3; ++k ) {
+			mesh.quadrics[t[k]].AddPlane( n[0], n[1], n[2], d, area );
+			mesh.weights[t[k]] += area;
+		}
+	}
+
+	//Open edges get a plane through them, square to the surface
+	for ( unsigned int i = 0; i < numTris; ++i ) {
+		const unsigned int * t = &mesh.tris[i * 3];
+		for ( int k = 0; k < 3; ++k ) {
+			unsigned int u = t[k], v = t[( k + 1 ) % 3];
+			unsigned int uses = 0;
+			const vector<unsigned int> & list = mesh.vertTris[u];
+			for ( size_t j = 0; j < list.size(); ++j ) {
+				const unsigned int * s = &mesh.tris[list[j] * 3];
+				if ( s[0] == v || s[1] == v || s[2] == v ) {
+					++uses;
+				}
+			}
+			if ( uses != 1 ) {
+				continue;
+			}
+			const double * pu = &mesh.pos[u * 3];
+			const double * pv = &mesh.pos[v * 3];
+			double e[3] = { pv[0] - pu[0], pv[1] - pu[1], pv[2] - pu[2] };
+			double n[3], side[3];
+			FaceNormal( &mesh.pos[t[0] * 3], &mesh.pos[t[1] * 3], &mesh.pos[t[2] * 3], n );
+			Cross( e, n, side );
+			double len = std::sqrt( Dot( side, side ) );
+			if ( len <= 0.0 ) {
+				continue;
+			}
+			side[0] /= len; side[1] /= len; side[2] /= len;
+			double d = -Dot( side, pu );
+			double w = BOUNDARY_WEIGHT * Dot( e, e );
+			mesh.quadrics[u].AddPlane( side[0], side[1], side[2], d, w );
+			mesh.quadrics[v].AddPlane( side[0], side[1], side[2], d, w );
+			mesh.lock[u] = std::max( mesh.lock[u], (unsigned char)VERTEX_BORDER );
+			mesh.lock[v] = std::max( mesh.lock[v], (unsigned char)VERTEX_BORDER );
+		}
+	}
+
+	if ( params.targetTriangles == 0 && params.maxError < 0.0f ) {
+		return;
+	}
+	double maxCost = params.maxError < 0.0f ? -1.0 : double(params.maxError) * double(params.maxError);
+
+	priority_queue<Collapse> heap;
+	vector<unsigned int> scratch, na, nb;
+	for ( unsigned int v = 0; v < numVerts; ++v ) {
+		Neighbors( mesh, v, scratch );
+		for ( size_t i = 0; i < scratch.size(); ++i ) {
+			unsigned int n = scratch[i];
+			if ( n <= v || mesh.group[n] != mesh.group[v] ) {
+				continue;
+			}
+			Collapse c;
+			if ( PlanCollapse( mesh, v, n, c ) ) {
+				heap.push( c );
+			}
+		}
+	}
+
+	while ( !heap.empty() && mesh.liveTris > params.targetTriangles ) {
+		Collapse c = heap.top();
+		heap.pop();
+		if ( c.keepStamp != mesh.stamps[c.keep] || c.dropStamp != mesh.stamps[c.drop] ) {
+			continue;
+		}
+		if ( maxCost >= 0.0 && c.cost > maxCost ) {
+			break;
+		}
+		if ( !CanCollapse( mesh, c, na, nb ) ) {
+			continue;
+		}
+		DoCollapse( mesh, c );
+		PushEdges( mesh, c.keep, heap, scratch );
+	}
+}
+
+//Rebuilds the normal and welding information of each triangle
+static void RebuildTriangleInfo( const vector<Vector3> & verts, vector<hkTriangle> & tris ) {
+	vector<Vector3> normals( tris.size() );
+	for ( size_t i = 0; i < tris.size(); ++i ) {
+		const Triangle & t = tris[i].triangle;
+		Vector3 n = ( verts[t.v2] - verts[t.v1] ).CrossProduct( verts[t.v3] - verts[t.v1] );
+		normals[i] = n.Magnitude() > 0.0f ? n.Normalized() : Vector3();
+		tris[i].normal = normals[i];
+	}
+
+	//Each undirected edge, with the triangle corners that use it
+	vector< pair< pair<unsigned int, unsigned int>, unsigned int > > edges;
+	edges.reserve( tris.size() * 3 );
+	for ( size_t i = 0; i < tris.size(); ++i ) {
+		const Triangle & t = tris[i].triangle;
+		unsigned short v[3] = { t.v1, t.v2, t.v3 };
+		for ( unsigned int k = 0; k < 3; ++k ) {
+			unsigned int a = v[k], b = v[( k + 1 ) % 3];
+			edges.push_back( make_pair( make_pair( std::min( a, b ), std::max( a, b ) ), (unsigned int)( i * 3 + k ) ) );
+		}
+	}
+	sort( edges.begin(), edges.end() );
+
+	vector<unsigned short> codes( tris.size() * 3, OPEN_EDGE_WELDING );
+	for ( size_t i = 0; i < edges.size(); ) {
+		size_t j = i + 1;
+		while ( j < edges.size() && edges[j].first == edges[i].first ) {
+			++j;
+		}
+		if ( j - i == 2 ) {
+			for ( int s = 0; s < 2; ++s ) {
+				unsigned int corner = edges[i + s].second;
+				unsigned int other = edges[i + 1 - s].second / 3;
+				unsigned int ti = corner / 3, k = corner % 3;
+				const Triangle & t = tris[ti].triangle;
+				unsigned short v[3] = { t.v1, t.v2, t.v3 };
+				Vector3 e = verts[v[( k + 1 ) % 3]] - verts[v[k]];
+				const Vector3 & n1 = normals[ti];
+				const Vector3 & n2 = normals[other];
+				if ( e.Magnitude() <= 0.0f || n1.Magnitude() <= 0.0f || n2.Magnitude() <= 0.0f ) {
+					continue;
+				}
+				double angle = atan2( double( n1.CrossProduct( n2 ).DotProduct( e.Normalized() ) ), double( n1.DotProduct( n2 ) ) );
+				int code = int( floor( ( angle + 3.14159265358979 ) / ( 2.0 * 3.14159265358979 ) * 30.0 + 0.5 ) );
+				codes[corner] = (unsigned short)std::min( std::max( code, 0 ), 30 );
+			}
+		}
+		i = j;
+	}
+	for ( size_t i = 0; i < tris.size(); ++i ) {
+		tris[i].weldingInfo = (unsigned short)( codes[i * 3] | ( codes[i * 3 + 1] << 5 ) | ( codes[i * 3 + 2] << 10 ) );
+	}
+}
+
+//Simplifies the arrays of one piece of packed data
+static unsigned int SimplifyPacked( vector<Vector3> & verts, vector<hkTriangle> & tris, vector<OblivionSubShape> & subShapes, const CollisionSimplifyParams & params ) {
+	size_t numVerts = verts.size();
+	SimplifyMesh mesh;
+
+	//Vertices past the last sub shape form a group of their own
+	mesh.group.resize( numVerts );
+	size_t next = 0;
+	for ( size_t s = 0; s < subShapes.size(); ++s ) {
+		size_t end = std::min( numVerts, next + subShapes[s].numVertices );
+		for ( ; next < end; ++next ) {
+			mesh.group[next] = (unsigned int)s;
+		}
+	}
+	for ( ; next < numVerts; ++next ) {
+		mesh.group[next] = (unsigned int)subShapes.size();
+	}
+
+	//Weld matching positions within each group onto the first of them
+	vector<unsigned int> order( numVerts ), weld( numVerts );
+	for ( unsigned int i = 0; i < numVerts; ++i ) {
+		order[i] = i;
+		weld[i] = i;
+	}
+	struct WeldLess {
+		const vector<Vector3> * verts;
+		const vector<unsigned int> * group;
+		bool operator()( unsigned int a, unsigned int b ) const {
+			if ( (*group)[a] != (*group)[b] ) return (*group)[a] < (*group)[b];
+			const Vector3 & pa = (*verts)[a];
+			const Vector3 & pb = (*verts)[b];
+			if ( pa.x != pb.x ) return pa.x < pb.x;
+			if ( pa.y != pb.y ) return pa.y < pb.y;
+			if ( pa.z != pb.z ) return pa.z < pb.z;
+			return a < b;
+		}
+	} less = { &verts, &mesh.group };
+	sort( order.begin(), order.end(), less );
+	for ( size_t i = 1; i < numVerts; ++i ) {
+		unsigned int a = order[i - 1], b = order[i];
+		if ( mesh.group[a] == mesh.group[b] && verts[a] == verts[b] ) {
+			weld[b] = weld[a];
+		}
+	}
+
+	//Positions that more than one sub shape uses are where materials meet
+	mesh.lock.assign( numVerts, VERTEX_FREE );
+	struct PositionLess {
+		const vector<Vector3> * verts;
+		bool operator()( unsigned int a, unsigned int b ) const {
+			const Vector3 & pa = (*verts)[a];
+			const Vector3 & pb = (*verts)[b];
+			if ( pa.x != pb.x ) return pa.x < pb.x;
+			if ( pa.y != pb.y ) return pa.y < pb.y;
+			return pa.z < pb.z;
+		}
+	} byPosition = { &verts };
+	sort( order.begin(), order.end(), byPosition );
+	for ( size_t i = 0; i < numVerts; ) {
+		size_t j = i + 1;
+		bool mixed = false;
+		while ( j < numVerts && verts[order[j]] == verts[order[i]] ) {
+			mixed = mixed || mesh.group[order[j]] != mesh.group[order[i]];
+			++j;
+		}
+		if ( mixed ) {
+			for ( size_t k = i; k < j; ++k ) {
+				mesh.lock[order[k]] = VERTEX_SEAM;
+			}
+		}
+		i = j;
+	}
+
+	mesh.pos.resize( numVerts * 3 );
+	for ( size_t i = 0; i < numVerts; ++i ) {
+		mesh.pos[i * 3] = verts[i].x;
+		mesh.pos[i * 3 + 1] = verts[i].y;
+		mesh.pos[i * 3 + 2] = verts[i].z;
+	}
+
+	mesh.tris.reserve( tris.size() * 3 );
+	for ( size_t i = 0; i < tris.size(); ++i ) {
+		const Triangle & t = tris[i].triangle;
+		if ( t.v1 >= numVerts || t.v2 >= numVerts || t.v3 >= numVerts ) {
+			throw runtime_error("A collision triangle refers to a vertex that does not exist.");
+		}
+		unsigned int a = weld[t.v1], b = weld[t.v2], c = weld[t.v3];
+		if ( a == b || b == c || a == c ) {
+			continue;
+		}
+		mesh.tris.push_back( a );
+		mesh.tris.push_back( b );
+		mesh.tris.push_back( c );
+	}
+	mesh.triLive.assign( mesh.tris.size() / 3, true );
+	mesh.liveTris = (unsigned int)mesh.triLive.size();
+
+	RunCollapses( mesh, params );
+
+	//Keep the vertices still in use, in their old order so sub shape ranges hold
+	vector<unsigned int> remap( numVerts, 0xFFFFFFFF );
+	for ( size_t i = 0; i < mesh.triLive.size(); ++i ) {
+		if ( mesh.triLive[i] ) {
+			for ( int k = 0; k < 3; ++k ) {
+				remap[mesh.tris[i * 3 + k]] = 0;
+			}
+		}
+	}
+	vector<Vector3> newVerts;
+	vector<unsigned int> counts( subShapes.size() + 1, 0 );
+	for ( size_t i = 0; i < numVerts; ++i ) {
+		if ( remap[i] == 0xFFFFFFFF ) {
+			continue;
+		}
+		remap[i] = (unsigned int)newVerts.size();
+		newVerts.push_back( Vector3( float(mesh.pos[i * 3]), float(mesh.pos[i * 3 + 1]), float(mesh.pos[i * 3 + 2]) ) );
+		++counts[mesh.group[i]];
+	}
+
+	vector<hkTriangle> newTris;
+	newTris.reserve( mesh.liveTris );
+	for ( size_t i = 0; i < mesh.triLive.size(); ++i ) {
+		if ( !mesh.triLive[i] ) {
+			continue;
+		}
+		hkTriangle t;
+		t.triangle.v1 = (unsigned short)remap[mesh.tris[i * 3]];
+		t.triangle.v2 = (unsigned short)remap[mesh.tris[i * 3 + 1]];
+		t.triangle.v3 = (unsigned short)remap[mesh.tris[i * 3 + 2]];
+		newTris.push_back( t );
+	}
+	RebuildTriangleInfo( newVerts, newTris );
+
+	for ( size_t s = 0; s < subShapes.size(); ++s ) {
+		subShapes[s].numVertices = counts[s];
+	}
+	unsigned int removed = (unsigned int)( tris.size() - newTris.size() );
+	verts.swap( newVerts );
+	tris.swap( newTris );
+	return removed;
+}
+
+unsigned int SimplifyCollisionMesh( hkPackedNiTriStripsData * data, const CollisionSimplifyParams & params ) {
+	if ( data == NULL ) {
+		throw runtime_error("No collision data was given to simplify.");
+	}
+	vector<Vector3> verts = data->GetVertices();
+	vector<hkTriangle> tris = data->GetHavokTriangles();
+	vector<OblivionSubShape> subShapes = data->GetSubShapes();
+	unsigned int removed = SimplifyPacked( verts, tris, subShapes, params );
+	data->SetVertices( verts );
+	data->SetHavokTriangles( tris );
+	data->SetSubShapes( subShapes );
+	return removed;
+}
+
+unsigned int SimplifyCollisionMesh( bhkPackedNiTriStripsShape * shape, const CollisionSimplifyParams & params ) {
+	if ( shape == NULL ) {
+		throw runtime_error("No collision shape was given to simplify.");
+	}
+	Ref<hkPackedNiTriStripsData> data = shape->GetData();
+	if ( data == NULL ) {
+		throw runtime_error("The collision shape has no data to simplify.");
+	}
+	if ( !data->GetSubShapeArray().empty() ) {
+		return SimplifyCollisionMesh( data, params );
+	}
+	vector<Vector3> verts = data->GetVertices();
+	vector<hkTriangle> tris = data->GetHavokTriangles();
+	vector<OblivionSubShape> subShapes = shape->GetSubShapes();
+	unsigned int removed = SimplifyPacked( verts, tris, subShapes, params );
+	data->SetVertices( verts );
+	data->SetHavokTriangles( tris );
+	shape->SetSubShapes( subShapes );
+	return removed;
+}
+
+unsigned int SimplifyCollisionMeshes( const vector<hkPackedNiTriStripsData*> & data, const CollisionSimplifyParams & params, unsigned int num_threads ) {
+	vector<hkPackedNiTriStripsData*> jobs;
+	set<hkPackedNiTriStripsData*> seen;
+	for ( size_t i = 0; i < data.size(); ++i ) {
+		if ( data[i] == NULL ) {
+			throw runtime_error("No collision data was given to simplify.");
+		}
+		if ( seen.insert( data[i] ).second ) {
+			jobs.push_back( data[i] );
+		}
+	}
+
+	//Each job only touches its own data, so no reference counts change
+	vector<unsigned int> removed( jobs.size(), 0 );
+	ParallelFor( jobs.size(), num_threads, [&]( size_t begin, size_t end ) {
+		for ( size_t i = begin; i < end; ++i ) {
+			removed[i] = SimplifyCollisionMesh( jobs[i], params );
+		}
+	} );
+
+	unsigned int total = 0;
+	for ( size_t i = 0; i < removed.size(); ++i ) {
+		total += removed[i];
+	}
+	return total;
+}
+
+} //End Niflib namespace
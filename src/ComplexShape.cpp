@@ -277,28 +277,28 @@ void ComplexShape::Merge( NiAVObject * root ) {
 		}
 
 		//Get Data
-		vector<Vector3> shapeVerts;	
-		vector<Vector3> shapeNorms;
+		vector<Vector3> skinVerts;
+		vector<Vector3> skinNorms;
+		bool skinned = ( (*geom)->GetSkinInstance() != NULL );
 		//If this is a skin influenced mesh, get vertices from niGeom
-		if ( (*geom)->GetSkinInstance() != NULL ) {
-			(*geom)->GetSkinDeformation( shapeVerts, shapeNorms );
+		if ( skinned ) {
+			(*geom)->GetSkinDeformation( skinVerts, skinNorms );
 
 			if((*geom)->GetSkinInstance()->GetType().IsSameType(BSDismemberSkinInstance::TYPE)) {
 				BSDismemberSkinInstanceRef dismember_skin =  DynamicCast<BSDismemberSkinInstance>((*geom)->GetSkinInstance());
 				NiSkinPartitionRef skin_partition = dismember_skin->GetSkinPartition();
 			}
-		} else {
-			shapeVerts = geomData->GetVertices();
-			shapeNorms = geomData->GetNormals();
 		}
+		const vector<Vector3> & shapeVerts = skinned ? skinVerts : geomData->GetVertexArray();
+		const vector<Vector3> & shapeNorms = skinned ? skinNorms : geomData->GetNormalArray();
 
 		
-		vector<Color4> shapeColors = geomData->GetColors();
-		vector< vector<TexCoord> > shapeUVs( geomData->GetUVSetCount() );
+		const vector<Color4> & shapeColors = geomData->GetColorArray();
+		vector< const vector<TexCoord> * > shapeUVs( geomData->GetUVSetCount() );
 		for ( unsigned int i = 0; i < shapeUVs.size(); ++i ) {
-			shapeUVs[i] = geomData->GetUVSet(i);
+			shapeUVs[i] = &geomData->GetUVSetArray(i);
 		}
-		vector<Triangle> shapeTris= geomData->GetTriangles();
+		const vector<Triangle> & shapeTris = geomData->GetTriangleArray();
 
 		//Lookup table
 		vector<MergeLookUp> lookUp( geomData->GetVertexCount() );
@@ -464,10 +464,10 @@ void ComplexShape::Merge( NiAVObject * root ) {
 				if ( set >= shapeUVs.size() || set < 0 ) {
 					throw runtime_error("One of the UV sets specified in the NiTexturingProperty did not exist in the NiTriBasedGeomData.");
 				}
-				for ( unsigned int v = 0; v < shapeUVs[set].size(); ++v ) {
+				for ( unsigned int v = 0; v < shapeUVs[set]->size(); ++v ) {
 					TexCoord newCoord;
 
-					newCoord = shapeUVs[set][v];
+					newCoord = (*shapeUVs[set])[v];
 
 					//Search for matching texture coordinate
 					bool match_found = false;
@@ -492,12 +492,16 @@ void ComplexShape::Merge( NiAVObject * root ) {
 			}
 		}
 
-		//Use look up table to build list of faces
+		//Use look up table to build list of faces, skipping any that repeat a vertex
+		unsigned int shapeFaceCount = 0;
 		for ( unsigned int t = 0; t < shapeTris.size(); ++t ) {
+			const Triangle & tri = shapeTris[t];
+			if ( tri.v1 == tri.v2 || tri.v2 == tri.v3 || tri.v1 == tri.v3 ) {
+				continue;
+			}
 			ComplexFace newFace;
 			newFace.propGroupIndex = prop_group_index;
 			newFace.points.resize(3);
-			const Triangle & tri = shapeTris[t];
 			for ( unsigned int p = 0; p < 3; ++p ) {
 				if ( shapeVerts.size() != 0 ) {
 					newFace.points[p].vertexIndex = lookUp[ tri[p] ].vertIndex;
@@ -516,6 +520,7 @@ void ComplexShape::Merge( NiAVObject * root ) {
 				}
 			}
 			faces.push_back(newFace);
+			++shapeFaceCount;
 		}
 
 		//Use look up table to set vertex weights, if any
@@ -530,9 +535,8 @@ void ComplexShape::Merge( NiAVObject * root ) {
 				vector<NiNodeRef> shapeBones = skinInst->GetBones();
 
 				//Get weights
-				vector<SkinWeight> shapeWeights;
 				for ( unsigned int b = 0; b < shapeBones.size(); ++b ) {
-					shapeWeights = skinData->GetBoneWeights(b);
+					const vector<SkinWeight> & shapeWeights = skinData->GetBoneWeightArray(b);
 					for ( unsigned int w = 0; w < shapeWeights.size(); ++w ) {
 						unsigned int vn_index = lookUp[ shapeWeights[w].index ].vertIndex;
 						NiNodeRef boneRef = shapeBones[b];
@@ -556,13 +560,13 @@ void ComplexShape::Merge( NiAVObject * root ) {
 					current_body_parts.push_back(dismember_skin->GetPartitions().at(y));
 				}
 
-				for(unsigned int y = 0; y < shapeTris.size(); y++) {
+				for(unsigned int y = 0; y < shapeFaceCount; y++) {
 					current_body_parts_faces.push_back(0);
 				}
 
 				for(int y = 0; y < skin_partition->GetNumPartitions(); y++) {
 					vector<Triangle> partition_triangles = skin_partition->GetTriangles(y);
-					vector<unsigned short> partition_vertex_map = skin_partition->GetVertexMap(y);
+					const vector<unsigned short> & partition_vertex_map = skin_partition->GetVertexMapArray(y);
 					bool has_vertex_map = false;
 
 					if(partition_vertex_map.size() > 0) {
@@ -570,7 +574,7 @@ void ComplexShape::Merge( NiAVObject * root ) {
 					}
 
 					for(unsigned int z = 0; z < partition_triangles.size(); z++) {
-						unsigned int w = faces.size() - shapeTris.size();
+						unsigned int w = faces.size() - shapeFaceCount;
 
 						int merged_x;
 						int merged_y;
@@ -622,8 +626,8 @@ void ComplexShape::Merge( NiAVObject * root ) {
 							}
 						}
 						
-						if(w - (faces.size() - shapeTris.size()) < shapeTris.size()) {
-							current_body_parts_faces[w - (faces.size() - shapeTris.size())] = y;
+						if(w - (faces.size() - shapeFaceCount) < shapeFaceCount) {
+							current_body_parts_faces[w - (faces.size() - shapeFaceCount)] = y;
 						} 
 					}
 				}
@@ -0,0 +1,713 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/CompressedMesh.h"
+#include "../include/obj/bhkCompressedMeshShapeData.h"
+#include "NifParallel.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+namespace Niflib {
+
+//Builds a column rotation matrix from a unit quaternion
+static void QuaternionToMatrix( const QuaternionXYZW & q, float m[9] ) {
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+	m[0] = 1.0f - 2.0f * (yy + zz); m[1] = 2.0f * (xy - wz);        m[2] = 2.0f * (xz + wy);
+	m[3] = 2.0f * (xy + wz);        m[4] = 1.0f - 2.0f * (xx + zz); m[5] = 2.0f * (yz - wx);
+	m[6] = 2.0f * (xz - wy);        m[7] = 2.0f * (yz + wx);        m[8] = 1.0f - 2.0f * (xx + yy);
+}
+
+//Everything needed to dequantize the vertices of one chunk
+struct ChunkFrame {
+	float rotation[9];
+	Vector3 translation;
+	Vector3 origin;
+	float error;
+	unsigned int materialIndex;
+	SkyrimHavokMaterial material;
+};
+
+static SkyrimHavokMaterial LookUpMaterial( const bhkCompressedMeshShapeData * data, unsigned int index ) {
+	const vector<bhkCMSDMaterial> & materials = data->GetChunkMaterials();
+	if ( index >= materials.size() ) {
+		throw runtime_error("bhkCompressedMeshShapeData material index is out of range.");
+	}
+	return materials[index].skyrimMaterial;
+}
+
+static void MakeChunkFrame( const bhkCompressedMeshShapeData * data, const bhkCMSDChunk & chunk, ChunkFrame & frame ) {
+	const vector<bhkCMSDTransform> & transforms = data->GetChunkTransforms();
+	if ( chunk.transformIndex >= transforms.size() ) {
+		throw runtime_error("bhkCompressedMeshShapeData chunk transform index is out of range.");
+	}
+	const bhkCMSDTransform & t = transforms[chunk.transformIndex];
+	QuaternionToMatrix( t.rotation, frame.rotation );
+	frame.translation = Vector3( t.translation.x, t.translation.y, t.translation.z );
+	frame.origin = Vector3( chunk.translation.x, chunk.translation.y, chunk.translation.z );
+	frame.error = data->GetError();
+	frame.materialIndex = chunk.materialIndex;
+	frame.material = LookUpMaterial( data, chunk.materialIndex );
+}
+
+static inline Vector3 DecodeVertex( const float r[9], const Vector3 & translation, const Vector3 & origin, float error, const unsigned short * q ) {
+	float x = origin.x + float(q[0]) * error;
+	float y = origin.y + float(q[1]) * error;
+	float z = origin.z + float(q[2]) * error;
+	return Vector3(
+		r[0] * x + r[1] * y + r[2] * z + translation.x,
+		r[3] * x + r[4] * y + r[5] * z + translation.y,
+		r[6] * x + r[7] * y + r[8] * z + translation.z
+	);
+}
+
+static inline bool IsDegenerate( unsigned int a, unsigned int b, unsigned int c ) {
+	return a == b || b == c || a == c;
+}
+
+//Checks that the strips fit in the index list and every index names a vertex
+static void ValidateChunk( const bhkCMSDChunk & chunk ) {
+	size_t strip_total = 0;
+	for ( size_t i = 0; i < chunk.strips.size(); ++i ) {
+		strip_total += chunk.strips[i];
+	}
+	if ( strip_total > chunk.indices.size() ) {
+		throw runtime_error("bhkCompressedMeshShapeData chunk strips are longer than its index list.");
+	}
+	size_t vertex_count = chunk.vertices.size() / 3;
+	for ( size_t i = 0; i < chunk.indices.size(); ++i ) {
+		if ( chunk.indices[i] >= vertex_count ) {
+			throw runtime_error("bhkCompressedMeshShapeData chunk index is out of range.");
+		}
+	}
+}
+
+//Calls func( a, b, c ) for each non degenerate triangle of a validated chunk
+template <class Func>
+static void VisitChunkTriangles( const bhkCMSDChunk & chunk, Func func ) {
+	const vector<unsigned short> & idx = chunk.indices;
+	size_t start = 0;
+	for ( size_t s = 0; s < chunk.strips.size(); ++s ) {
+		size_t len = chunk.strips[s];
+		for ( size_t k = 0; k + 2 < len; ++k ) {
+			unsigned int a = idx[start + k];
+			unsigned int b = idx[start + k + 1];
+			unsigned int c = idx[start + k + 2];
+			if ( IsDegenerate( a, b, c ) ) {
+				continue;
+			}
+			//Every other strip triangle has reversed winding
+			if ( k & 1 ) {
+				func( a, c, b );
+			} else {
+				func( a, b, c );
+			}
+		}
+		start += len;
+	}
+	for ( ; start + 2 < idx.size(); start += 3 ) {
+		unsigned int a = idx[start], b = idx[start + 1], c = idx[start + 2];
+		if ( !IsDegenerate( a, b, c ) ) {
+			func( a, b, c );
+		}
+	}
+}
+
+CompressedMeshTriangleIterator::CompressedMeshTriangleIterator( const bhkCompressedMeshShapeData * data, unsigned int first_chunk, unsigned int end_chunk, bool big_tris ) : data(data), firstChunk(first_chunk), endChunk(end_chunk), bigTris(big_tris) {
+	if ( data == NULL ) {
+		throw runtime_error("Cannot walk the triangles of a NULL bhkCompressedMeshShapeData.");
+	}
+	unsigned int chunk_count = (unsigned int)(data->GetChunks().size());
+	if ( endChunk > chunk_count ) {
+		endChunk = chunk_count;
+	}
+	if ( firstChunk > endChunk ) {
+		firstChunk = endChunk;
+	}
+	Reset();
+}
+
+void CompressedMeshTriangleIterator::Reset() {
+	chunk = firstChunk;
+	inChunk = false;
+	strip = 0;
+	stripPos = 0;
+	index = 0;
+	bigTri = 0;
+	cur = NULL;
+	materialIndex = 0;
+	material = SkyrimHavokMaterial(0);
+}
+
+bool CompressedMeshTriangleIterator::EnterChunk() {
+	if ( chunk >= endChunk ) {
+		return false;
+	}
+	cur = &data->GetChunks()[chunk];
+	ValidateChunk( *cur );
+	ChunkFrame frame;
+	MakeChunkFrame( data, *cur, frame );
+	for ( int i = 0; i < 9; ++i ) {
+		rotation[i] = frame.rotation[i];
+	}
+	translation = frame.translation;
+	origin = frame.origin;
+	materialIndex = frame.materialIndex;
+	material = frame.material;
+	strip = 0;
+	stripPos = 0;
+	index = 0;
+	inChunk = true;
+	return true;
+}
+
+Vector3 CompressedMeshTriangleIterator::ChunkVertex( unsigned int i ) const {
+	return DecodeVertex( rotation, translation, origin, data->GetError(), &cur->vertices[i * 3] );
+}
+
+bool CompressedMeshTriangleIterator::Next( CompressedMeshTriangle & tri ) {
+	while ( inChunk || EnterChunk() ) {
+		const vector<unsigned short> & idx = cur->indices;
+		unsigned int a = 0, b = 0, c = 0;
+		bool found = false;
+
+		//Strips come first in the index list
+		while ( !found && strip < cur->strips.size() ) {
+			unsigned int len = cur->strips[strip];
+			if ( stripPos + 2 < len ) {
+				unsigned int k = stripPos++;
+				a = idx[index + k];
+				b = idx[index + k + 1];
+				c = idx[index + k + 2];
+				if ( IsDegenerate( a, b, c ) ) {
+					continue;
+				}
+				if ( k & 1 ) {
+					unsigned int t = b;
+					b = c;
+					c = t;
+				}
+				found = true;
+			} else {
+				index += len;
+				++strip;
+				stripPos = 0;
+			}
+		}
+
+		//Then the plain triangle list
+		while ( !found && index + 2 < idx.size() ) {
+			a = idx[index];
+			b = idx[index + 1];
+			c = idx[index + 2];
+			index += 3;
+			found = !IsDegenerate( a, b, c );
+		}
+
+		if ( found ) {
+			tri.vertices[0] = ChunkVertex( a );
+			tri.vertices[1] = ChunkVertex( b );
+			tri.vertices[2] = ChunkVertex( c );
+			tri.chunk = chunk;
+			tri.materialIndex = materialIndex;
+			tri.material = material;
+			return true;
+		}
+
+		inChunk = false;
+		++chunk;
+	}
+
+	if ( !bigTris ) {
+		return false;
+	}
+	const vector<bhkCMSDBigTris> & big_tris = data->GetBigTris();
+	const vector<Vector4> & big_verts = data->GetBigVerts();
+	while ( bigTri < big_tris.size() ) {
+		const bhkCMSDBigTris & t = big_tris[bigTri++];
+		if ( t.triangle1 >= big_verts.size() || t.triangle2 >= big_verts.size() || t.triangle3 >= big_verts.size() ) {
+			throw runtime_error("bhkCompressedMeshShapeData big triangle index is out of range.");
+		}
+		if ( IsDegenerate( t.triangle1, t.triangle2, t.triangle3 ) ) {
+			continue;
+		}
+		const Vector4 & v1 = big_verts[t.triangle1];
+		const Vector4 & v2 = big_verts[t.triangle2];
+		const Vector4 & v3 = big_verts[t.triangle3];
+		tri.vertices[0] = Vector3( v1.x, v1.y, v1.z );
+		tri.vertices[1] = Vector3( v2.x, v2.y, v2.z );
+		tri.vertices[2] = Vector3( v3.x, v3.y, v3.z );
+		tri.chunk = 0xFFFFFFFF;
+		tri.materialIndex = t.unknownInt1;
+		tri.material = LookUpMaterial( data, t.unknownInt1 );
+		return true;
+	}
+	return false;
+}
+
+void ForEachCompressedMeshTriangle( const bhkCompressedMeshShapeData * data, CompressedMeshTriangleCallback callback, void * user, unsigned int num_threads ) {
+	if ( data == NULL ) {
+		throw runtime_error("Cannot walk the triangles of a NULL bhkCompressedMeshShapeData.");
+	}
+	unsigned int chunk_count = (unsigned int)(data->GetChunks().size());
+	ParallelFor( chunk_count, num_threads, [data, callback, user]( size_t begin, size_t end ) {
+		CompressedMeshTriangleIterator it( data, (unsigned int)begin, (unsigned int)end, false );
+		CompressedMeshTriangle tri;
+		while ( it.Next( tri ) ) {
+			callback( tri, user );
+		}
+	} );
+
+	CompressedMeshTriangleIterator it( data, chunk_count, chunk_count, true );
+	CompressedMeshTriangle tri;
+	while ( it.Next( tri ) ) {
+		callback( tri, user );
+	}
+}
+
+void DecompressMeshShapeData( const bhkCompressedMeshShapeData * data, vector<Vector3> & vertices, vector<unsigned int> & indices, vector<SkyrimHavokMaterial> & materials, unsigned int num_threads ) {
+	if ( data == NULL ) {
+		throw runtime_error("Cannot decompress a NULL bhkCompressedMeshShapeData.");
+	}
+	const vector<bhkCMSDChunk> & chunks = data->GetChunks();
+	const vector<Vector4> & big_verts = data->GetBigVerts();
+	const vector<bhkCMSDBigTris> & big_tris = data->GetBigTris();
+	size_t chunk_count = chunks.size();
+
+	//Resolve transforms and materials up front, they are shared by chunks
+	vector<ChunkFrame> frames( chunk_count );
+	vector<size_t> vertex_offsets( chunk_count + 1, 0 );
+	for ( size_t i = 0; i < chunk_count; ++i ) {
+		MakeChunkFrame( data, chunks[i], frames[i] );
+		vertex_offsets[i + 1] = vertex_offsets[i] + chunks[i].vertices.size() / 3;
+	}
+
+	//Count the triangles of each chunk so every chunk knows where to write
+	vector<size_t> tri_offsets( chunk_count + 1, 0 );
+	ParallelFor( chunk_count, num_threads, [&chunks, &tri_offsets]( size_t begin, size_t end ) {
+		for ( size_t i = begin; i < end; ++i ) {
+			ValidateChunk( chunks[i] );
+			size_t count = 0;
+			VisitChunkTriangles( chunks[i], [&count]( unsigned int, unsigned int, unsigned int ) {
+				++count;
+			} );
+			tri_offsets[i + 1] = count;
+		}
+	} );
+	for ( size_t i = 0; i < chunk_count; ++i ) {
+		tri_offsets[i + 1] += tri_offsets[i];
+	}
+
+	size_t big_base = vertex_offsets[chunk_count];
+	size_t big_tri_count = 0;
+	for ( size_t i = 0; i < big_tris.size(); ++i ) {
+		const bhkCMSDBigTris & t = big_tris[i];
+		if ( t.triangle1 >= big_verts.size() || t.triangle2 >= big_verts.size() || t.triangle3 >= big_verts.size() ) {
+			throw runtime_error("bhkCompressedMeshShapeData big triangle index is out of range.");
+		}
+		if ( !IsDegenerate( t.triangle1, t.triangle2, t.triangle3 ) ) {
+			++big_tri_count;
+		}
+	}
+
+	vertices.resize( big_base + big_verts.size() );
+	indices.resize( ( tri_offsets[chunk_count] + big_tri_count ) * 3 );
+	materials.resize( tri_offsets[chunk_count] + big_tri_count );
+
+	Vector3 * out_verts = vertices.empty() ? NULL : &vertices[0];
+	unsigned int * out_indices = indices.empty() ? NULL : &indices[0];
+	SkyrimHavokMaterial * out_materials = materials.empty() ? NULL : &materials[0];
+	ParallelFor( chunk_count, num_threads, [&]( size_t begin, size_t end ) {
+		for ( size_t i = begin; i < end; ++i ) {
+			const bhkCMSDChunk & chunk = chunks[i];
+			const ChunkFrame & f = frames[i];
+			size_t base = vertex_offsets[i];
+			size_t count = vertex_offsets[i + 1] - base;
+			for ( size_t v = 0; v < count; ++v ) {
+				out_verts[base + v] = DecodeVertex( f.rotation, f.translation, f.origin, f.error, &chunk.vertices[v * 3] );
+			}
+			size_t tri = tri_offsets[i];
+			VisitChunkTriangles( chunk, [&]( unsigned int a, unsigned int b, unsigned int c ) {
+				out_indices[tri * 3] = (unsigned int)(base + a);
+				out_indices[tri * 3 + 1] = (unsigned int)(base + b);
+				out_indices[tri * 3 + 2] = (unsigned int)(base + c);
+				out_materials[tri] = f.material;
+				++tri;
+			} );
+		}
+	} );
+
+	for ( size_t i = 0; i < big_verts.size(); ++i ) {
+		vertices[big_base + i] = Vector3( big_verts[i].x, big_verts[i].y, big_verts[i].z );
+	}
+	size_t tri = tri_offsets[chunk_count];
+	for ( size_t i = 0; i < big_tris.size(); ++i ) {
+		const bhkCMSDBigTris & t = big_tris[i];
+		if ( IsDegenerate( t.triangle1, t.triangle2, t.triangle3 ) ) {
+			continue;
+		}
+		indices[tri * 3] = (unsigned int)(big_base + t.triangle1);
+		indices[tri * 3 + 1] = (unsigned int)(big_base + t.triangle2);
+		indices[tri * 3 + 2] = (unsigned int)(big_base + t.triangle3);
+		materials[tri] = LookUpMaterial( data, t.unknownInt1 );
+		++tri;
+	}
+}
+
+//Limits used when splitting a mesh into chunks
+static const unsigned int MAX_CHUNK_TRIANGLES = 4096;
+static const float QUANTIZED_RANGE = 65535.0f;
+
+//A group of triangles with one material that will become one chunk
+struct ChunkRange {
+	unsigned int material;
+	size_t begin;
+	size_t end;
+};
+
+static void TriangleBounds( const vector<Vector3> & vertices, const vector<unsigned int> & indices, const unsigned int * tris, size_t count, Vector3 & lo, Vector3 & hi ) {
+	lo = hi = vertices[indices[tris[0] * 3]];
+	for ( size_t i = 0; i < count; ++i ) {
+		for ( int j = 0; j < 3; ++j ) {
+			const Vector3 & v = vertices[indices[tris[i] * 3 + j]];
+			lo.x = min( lo.x, v.x ); lo.y = min( lo.y, v.y ); lo.z = min( lo.z, v.z );
+			hi.x = max( hi.x, v.x ); hi.y = max( hi.y, v.y ); hi.z = max( hi.z, v.z );
+		}
+	}
+}
+
+static bool FitsChunk( const Vector3 & lo, const Vector3 & hi, float range ) {
+	return hi.x - lo.x <= range && hi.y - lo.y <= range && hi.z - lo.z <= range;
+}
+
+//Orders triangles by the position of their centers along one axis
+struct CenterLess {
+	const vector<Vector3> * centers;
+	int axis;
+	bool operator()( unsigned int a, unsigned int b ) const {
+		const Vector3 & ca = (*centers)[a];
+		const Vector3 & cb = (*centers)[b];
+		return axis == 0 ? ca.x < cb.x : ( axis == 1 ? ca.y < cb.y : ca.z < cb.z );
+	}
+};
+
+//Splits tris[begin, end) at the median center until every part fits a chunk
+static void SplitChunks( const vector<Vector3> & vertices, const vector<unsigned int> & indices, const vector<Vector3> & centers, vector<unsigned int> & tris, unsigned int material, size_t begin, size_t end, float range, vector<ChunkRange> & out ) {
+	vector< pair<size_t,size_t> > stack;
+	stack.push_back( pair<size_t,size_t>( begin, end ) );
+	while ( !stack.empty() ) {
+		size_t b = stack.back().first;
+		size_t e = stack.back().second;
+		stack.pop_back();
+
+		Vector3 lo, hi;
+		TriangleBounds( vertices, indices, &tris[b], e - b, lo, hi );
+		if ( e - b == 1 || ( e - b <= MAX_CHUNK_TRIANGLES && FitsChunk( lo, hi, range ) ) ) {
+			ChunkRange r = { material, b, e };
+			out.push_back( r );
+			continue;
+		}
+
+		Vector3 clo = centers[tris[b]], chi = centers[tris[b]];
+		for ( size_t i = b; i < e; ++i ) {
+			const Vector3 & c = centers[tris[i]];
+			clo.x = min( clo.x, c.x ); clo.y = min( clo.y, c.y ); clo.z = min( clo.z, c.z );
+			chi.x = max( chi.x, c.x ); chi.y = max( chi.y, c.y ); chi.z = max( chi.z, c.z );
+		}
+		CenterLess less;
+		less.centers = &centers;
+		less.axis = 0;
+		if ( chi.y - clo.y > chi.x - clo.x ) {
+			less.axis = 1;
+		}
+		if ( chi.z - clo.z > max( chi.x - clo.x, chi.y - clo.y ) ) {
+			less.axis = 2;
+		}
+		size_t mid = b + ( e - b ) / 2;
+		nth_element( tris.begin() + b, tris.begin() + mid, tris.begin() + e, less );
+		stack.push_back( pair<size_t,size_t>( b, mid ) );
+		stack.push_back( pair<size_t,size_t>( mid, e ) );
+	}
+}
+
+//Directed edges of the triangles of one chunk, sorted for lookup
+typedef pair<unsigned int, unsigned int> EdgeEntry;
+
+static inline unsigned int EdgeKey( unsigned int from, unsigned int to ) {
+	return ( from << 16 ) | to;
+}
+
+static const unsigned int STRIP_USED = 0xFFFFFFFF;
+
+//Grows a strip from one corner of a seed triangle.  Triangles taken by the
+//strip are marked with id, or STRIP_USED for the strip that is kept.
+static size_t WalkStrip( const vector<unsigned short> & tris, const vector<EdgeEntry> & edges, vector<unsigned int> & marks, unsigned int id, unsigned int seed, unsigned int corner, vector<unsigned short> * out ) {
+	unsigned short a = tris[seed * 3 + ( corner + 1 ) % 3];
+	unsigned short b = tris[seed * 3 + ( corner + 2 ) % 3];
+	marks[seed] = id;
+	if ( out ) {
+		out->push_back( tris[seed * 3 + corner] );
+		out->push_back( a );
+		out->push_back( b );
+	}
+	size_t count = 1;
+	for ( size_t k = 1; ; ++k ) {
+		//The decoder flips every other triangle, so the shared edge has to
+		//run the other way on odd triangles
+		unsigned int from = ( k & 1 ) ? b : a;
+		unsigned int to = ( k & 1 ) ? a : b;
+		vector<EdgeEntry>::const_iterator it = lower_bound( edges.begin(), edges.end(), EdgeEntry( EdgeKey( from, to ), 0 ) );
+		unsigned int next = STRIP_USED;
+		for ( ; it != edges.end() && it->first == EdgeKey( from, to ); ++it ) {
+			if ( marks[it->second] != STRIP_USED && marks[it->second] != id ) {
+				next = it->second;
+				break;
+			}
+		}
+		if ( next == STRIP_USED ) {
+			return count;
+		}
+		//The new vertex is the one that follows the shared edge
+		unsigned short x = 0;
+		for ( int j = 0; j < 3; ++j ) {
+			if ( tris[next * 3 + j] == to ) {
+				x = tris[next * 3 + ( j + 1 ) % 3];
+			}
+		}
+		marks[next] = id;
+		if ( out ) {
+			out->push_back( x );
+		}
+		a = b;
+		b = x;
+		++count;
+	}
+}
+
+//Fills in the strips and triangle list of a chunk from chunk local triangles
+static void StripChunk( const vector<unsigned short> & tris, bhkCMSDChunk & chunk ) {
+	unsigned int count = (unsigned int)(tris.size() / 3);
+	vector<EdgeEntry> edges;
+	edges.reserve( tris.size() );
+	for ( unsigned int t = 0; t < count; ++t ) {
+		for ( int j = 0; j < 3; ++j ) {
+			edges.push_back( EdgeEntry( EdgeKey( tris[t * 3 + j], tris[t * 3 + ( j + 1 ) % 3] ), t ) );
+		}
+	}
+	sort( edges.begin(), edges.end() );
+
+	vector<unsigned int> marks( count, 0 );
+	vector<unsigned short> strip, list;
+	unsigned int id = 0;
+	for ( unsigned int t = 0; t < count; ++t ) {
+		if ( marks[t] == STRIP_USED ) {
+			continue;
+		}
+		//Try each corner of the seed and keep the longest strip
+		size_t best = 0;
+		unsigned int best_corner = 0;
+		for ( unsigned int corner = 0; corner < 3; ++corner ) {
+			size_t len = WalkStrip( tris, edges, marks, ++id, t, corner, NULL );
+			if ( len > best ) {
+				best = len;
+				best_corner = corner;
+			}
+		}
+		strip.clear();
+		WalkStrip( tris, edges, marks, STRIP_USED, t, best_corner, &strip );
+		if ( strip.size() > 3 ) {
+			chunk.strips.push_back( (unsigned short)(strip.size()) );
+			chunk.indices.insert( chunk.indices.end(), strip.begin(), strip.end() );
+		} else {
+			list.insert( list.end(), strip.begin(), strip.end() );
+		}
+	}
+	chunk.indices.insert( chunk.indices.end(), list.begin(), list.end() );
+	//No welding information
+	chunk.indices2.assign( count, 0 );
+}
+
+//Quantizes the vertices of one chunk and strips its triangles
+static void BuildChunk( const vector<Vector3> & vertices, const vector<unsigned int> & indices, const unsigned int * tris, size_t count, float error, bhkCMSDChunk & chunk ) {
+	vector<unsigned int> used;
+	used.reserve( count * 3 );
+	for ( size_t i = 0; i < count; ++i ) {
+		for ( int j = 0; j < 3; ++j ) {
+			used.push_back( indices[tris[i] * 3 + j] );
+		}
+	}
+	sort( used.begin(), used.end() );
+	used.erase( unique( used.begin(), used.end() ), used.end() );
+
+	Vector3 lo, hi;
+	TriangleBounds( vertices, indices, tris, count, lo, hi );
+	chunk.translation = Vector4( lo.x, lo.y, lo.z, 0.0f );
+	chunk.vertices.resize( used.size() * 3 );
+	for ( size_t i = 0; i < used.size(); ++i ) {
+		const Vector3 & v = vertices[used[i]];
+		float q[3] = { ( v.x - lo.x ) / error, ( v.y - lo.y ) / error, ( v.z - lo.z ) / error };
+		for ( int j = 0; j < 3; ++j ) {
+			float r = floor( q[j] + 0.5f );
+			chunk.vertices[i * 3 + j] = (unsigned short)( r < 0.0f ? 0.0f : ( r > QUANTIZED_RANGE ? QUANTIZED_RANGE : r ) );
+		}
+	}
+
+	vector<unsigned short> local( count * 3 );
+	for ( size_t i = 0; i < count; ++i ) {
+		for ( int j = 0; j < 3; ++j ) {
+			unsigned int v = indices[tris[i] * 3 + j];
+			local[i * 3 + j] = (unsigned short)( lower_bound( used.begin(), used.end(), v ) - used.begin() );
+		}
+	}
+	StripChunk( local, chunk );
+}
+
+Ref<bhkCompressedMeshShapeData> CompressMeshShapeData( const vector<Vector3> & vertices, const vector<unsigned int> & indices, const vector<SkyrimHavokMaterial> & materials, float error, unsigned int num_threads ) {
+	if ( indices.size() % 3 != 0 ) {
+		throw runtime_error("The number of triangle indices must be a multiple of three.");
+	}
+	if ( materials.size() != indices.size() / 3 ) {
+		throw runtime_error("There must be one material per triangle.");
+	}
+	if ( !( error > 0.0f ) ) {
+		throw runtime_error("The quantization error must be greater than zero.");
+	}
+	for ( size_t i = 0; i < indices.size(); ++i ) {
+		if ( indices[i] >= vertices.size() ) {
+			throw runtime_error("Triangle vertex index is out of range.");
+		}
+	}
+
+	//Material table, in order of first use
+	vector<SkyrimHavokMaterial> table;
+	vector<unsigned int> tri_materials( materials.size() );
+	for ( size_t i = 0; i < materials.size(); ++i ) {
+		vector<SkyrimHavokMaterial>::iterator it = find( table.begin(), table.end(), materials[i] );
+		tri_materials[i] = (unsigned int)( it - table.begin() );
+		if ( it == table.end() ) {
+			table.push_back( materials[i] );
+		}
+	}
+
+	//Sort out degenerate triangles and those too big for any chunk
+	float range = QUANTIZED_RANGE * error;
+	vector<unsigned int> tris, big;
+	vector<Vector3> centers( materials.size() );
+	for ( unsigned int t = 0; t < (unsigned int)(materials.size()); ++t ) {
+		unsigned int a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+		if ( IsDegenerate( a, b, c ) ) {
+			continue;
+		}
+		Vector3 lo, hi;
+		TriangleBounds( vertices, indices, &t, 1, lo, hi );
+		if ( FitsChunk( lo, hi, range ) ) {
+			tris.push_back( t );
+			centers[t] = ( vertices[a] + vertices[b] + vertices[c] ) / 3.0f;
+		} else {
+			big.push_back( t );
+		}
+	}
+
+	//Split each material's triangles into chunks
+	vector<ChunkRange> ranges;
+	{
+		vector< vector<unsigned int> > by_material( table.size() );
+		for ( size_t i = 0; i < tris.size(); ++i ) {
+			by_material[tri_materials[tris[i]]].push_back( tris[i] );
+		}
+		tris.clear();
+		for ( unsigned int m = 0; m < (unsigned int)(table.size()); ++m ) {
+			size_t begin = tris.size();
+			tris.insert( tris.end(), by_material[m].begin(), by_material[m].end() );
+			if ( tris.size() > begin ) {
+				SplitChunks( vertices, indices, centers, tris, m, begin, tris.size(), range, ranges );
+			}
+		}
+	}
+
+	vector<bhkCMSDChunk> chunks( ranges.size() );
+	ParallelFor( ranges.size(), num_threads, [&]( size_t begin, size_t end ) {
+		for ( size_t i = begin; i < end; ++i ) {
+			const ChunkRange & r = ranges[i];
+			bhkCMSDChunk & chunk = chunks[i];
+			chunk.materialIndex = r.material;
+			chunk.unknownShort1 = 0xFFFF;
+			chunk.transformIndex = 0;
+			BuildChunk( vertices, indices, &tris[r.begin], r.end - r.begin, error, chunk );
+		}
+	} );
+
+	//Big triangles keep their own copies of the vertices they use
+	vector<unsigned int> big_map( vertices.size(), 0xFFFFFFFF );
+	vector<Vector4> big_verts;
+	vector<bhkCMSDBigTris> big_tris( big.size() );
+	for ( size_t i = 0; i < big.size(); ++i ) {
+		unsigned short corners[3];
+		for ( int j = 0; j < 3; ++j ) {
+			unsigned int v = indices[big[i] * 3 + j];
+			if ( big_map[v] == 0xFFFFFFFF ) {
+				if ( big_verts.size() > 0xFFFF ) {
+					throw runtime_error("Too many big triangle vertices for a bhkCompressedMeshShapeData.");
+				}
+				big_map[v] = (unsigned int)(big_verts.size());
+				big_verts.push_back( Vector4( vertices[v].x, vertices[v].y, vertices[v].z, 0.0f ) );
+			}
+			corners[j] = (unsigned short)(big_map[v]);
+		}
+		big_tris[i].triangle1 = corners[0];
+		big_tris[i].triangle2 = corners[1];
+		big_tris[i].triangle3 = corners[2];
+		big_tris[i].unknownInt1 = tri_materials[big[i]];
+		big_tris[i].unknownShort1 = 0;
+	}
+
+	//Triangle keys hold the chunk index above the triangle index and winding
+	size_t max_tris = big_tris.size();
+	for ( size_t i = 0; i < ranges.size(); ++i ) {
+		max_tris = max( max_tris, ranges[i].end - ranges[i].begin );
+	}
+	unsigned int bits = 17;
+	while ( ( size_t(1) << bits ) < max_tris ) {
+		++bits;
+	}
+	if ( bits + 1 >= 32 || chunks.size() >= ( size_t(1) << ( 31 - bits ) ) ) {
+		throw runtime_error("The mesh has too many chunks for a bhkCompressedMeshShapeData.");
+	}
+
+	Vector3 lo, hi;
+	for ( size_t i = 0; i < indices.size(); ++i ) {
+		const Vector3 & v = vertices[indices[i]];
+		if ( i == 0 ) {
+			lo = hi = v;
+		}
+		lo.x = min( lo.x, v.x ); lo.y = min( lo.y, v.y ); lo.z = min( lo.z, v.z );
+		hi.x = max( hi.x, v.x ); hi.y = max( hi.y, v.y ); hi.z = max( hi.z, v.z );
+	}
+
+	vector<bhkCMSDMaterial> chunk_materials( table.size() );
+	for ( size_t i = 0; i < table.size(); ++i ) {
+		chunk_materials[i].skyrimMaterial = table[i];
+		chunk_materials[i].unknownInteger = 1;
+	}
+	vector<bhkCMSDTransform> transforms( 1 );
+	transforms[0].translation = Vector4( 0.0f, 0.0f, 0.0f, 0.0f );
+
+	Ref<bhkCompressedMeshShapeData> data = new bhkCompressedMeshShapeData;
+	data->SetBitsPerIndex( bits );
+	data->SetBitsPerWIndex( bits + 1 );
+	data->SetMaskIndex( ( 1u << bits ) - 1 );
+	data->SetMaskWIndex( ( 1u << ( bits + 1 ) ) - 1 );
+	data->SetError( error );
+	data->SetBoundsMin( Vector4( lo.x, lo.y, lo.z, 0.0f ) );
+	data->SetBoundsMax( Vector4( hi.x, hi.y, hi.z, 0.0f ) );
+	data->SetChunkMaterials( chunk_materials );
+	data->SetChunkTransforms( transforms );
+	data->SetBigVerts( big_verts );
+	data->SetBigTris( big_tris );
+	data->SetChunks( chunks );
+	return data;
+}
+
+} //End Niflib namespace
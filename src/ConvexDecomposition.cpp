@@ -0,0 +1,379 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/ConvexDecomposition.h"
+#include "../include/nifqhull.h"
+#include "../include/obj/bhkListShape.h"
+#include "../include/obj/bhkConvexVerticesShape.h"
+#include "../include/obj/NiTriBasedGeom.h"
+#include "../include/obj/NiTriBasedGeomData.h"
+#include "NifParallel.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+namespace Niflib {
+
+//The most cuts tried along each axis when looking for a cut
+static const unsigned int SPLIT_CANDIDATES = 15;
+
+//The mesh being decomposed, shared read only by all threads
+struct DecompMesh {
+	const vector<Vector3> * vertices;
+	vector<Triangle> triangles;
+	vector<Vector3> centers;
+	vector<Vector3> uppers;
+	vector<Vector3> normals;
+	vector<float> areas;
+	float thickness;
+};
+
+//A group of mesh triangles that will become one convex piece
+struct DecompPart {
+	vector<unsigned int> triangles;
+	float concavity;
+	bool splittable;
+};
+
+//One candidate cut of a part and what it leads to
+struct DecompSplit {
+	unsigned int axis;
+	float position;
+	float concavity[2];
+	float cost;
+	bool valid;
+};
+
+static float AxisValue( const Vector3 & v, unsigned int axis ) {
+	return axis == 0 ? v.x : ( axis == 1 ? v.y : v.z );
+}
+
+//Collects the distinct vertices used by a group of triangles
+static void GatherPoints( const DecompMesh & mesh, const vector<unsigned int> & tris, vector<Vector3> & points ) {
+	vector<unsigned int> ids;
+	ids.reserve( tris.size() * 3 );
+	for ( size_t i = 0; i < tris.size(); ++i ) {
+		const Triangle & t = mesh.triangles[tris[i]];
+		ids.push_back( t.v1 );
+		ids.push_back( t.v2 );
+		ids.push_back( t.v3 );
+	}
+	sort( ids.begin(), ids.end() );
+	ids.erase( unique( ids.begin(), ids.end() ), ids.end() );
+	points.resize( ids.size() );
+	for ( size_t i = 0; i < ids.size(); ++i ) {
+		points[i] = (*mesh.vertices)[ids[i]];
+	}
+}
+
+//Finds the planes of a hull, merging the triangles that share a plane
+static void HullPlanes( const vector<Vector3> & points, const vector<Triangle> & hull, vector<Vector4> & planes ) {
+	float scale = 0.0f;
+	for ( size_t i = 0; i < points.size(); ++i ) {
+		scale = max( scale, fabs( points[i].x ) + fabs( points[i].y ) + fabs( points[i].z ) );
+	}
+	float tolerance = max( scale * 1e-5f, 1e-6f );
+
+	planes.clear();
+	for ( size_t i = 0; i < hull.size(); ++i ) {
+		const Vector3 & a = points[hull[i].v1];
+		Vector3 n = ( points[hull[i].v2] - a ) ^ ( points[hull[i].v3] - a );
+		float len = n.Magnitude();
+		if ( len <= 0.0f ) {
+			continue;
+		}
+		n = n / len;
+		float w = -( n * a );
+		bool found = false;
+		for ( size_t j = 0; j < planes.size() && !found; ++j ) {
+			const Vector4 & p = planes[j];
+			found = n.x * p.x + n.y * p.y + n.z * p.z > 0.9999f && fabs( p.w - w ) < tolerance;
+		}
+		if ( !found ) {
+			planes.push_back( Vector4( n.x, n.y, n.z, w ) );
+		}
+	}
+}
+
+//Wraps a group of triangles in a hull.  Flat groups are pushed out to both
+//sides along the normal of their largest triangle so the hull has volume.
+static void PartHull( const DecompMesh & mesh, const vector<unsigned int> & tris, unsigned int max_vertices, vector<Vector3> & points, vector<Triangle> & hull ) {
+	GatherPoints( mesh, tris, points );
+	hull = NifQHull::compute_convex_hull( points, max_vertices );
+	if ( !hull.empty() ) {
+		return;
+	}
+
+	unsigned int largest = tris[0];
+	for ( size_t i = 1; i < tris.size(); ++i ) {
+		if ( mesh.areas[tris[i]] > mesh.areas[largest] ) {
+			largest = tris[i];
+		}
+	}
+	Vector3 offset = mesh.normals[largest] * ( 0.5f * mesh.thickness );
+	size_t count = points.size();
+	for ( size_t i = 0; i < count; ++i ) {
+		points.push_back( points[i] - offset );
+		points[i] += offset;
+	}
+	hull = NifQHull::compute_convex_hull( points, max_vertices );
+}
+
+//Finds how deep the surface of a group of triangles reaches into its hull,
+//sampling the vertices and the triangle centers.  Flat groups count as convex.
+static float PartConcavity( const DecompMesh & mesh, const vector<unsigned int> & tris ) {
+	vector<Vector3> points;
+	GatherPoints( mesh, tris, points );
+	vector<Triangle> hull = NifQHull::compute_convex_hull( points );
+	if ( hull.empty() ) {
+		return 0.0f;
+	}
+	vector<Vector4> planes;
+	HullPlanes( points, hull, planes );
+
+	float concavity = 0.0f;
+	size_t sample_count = points.size() + tris.size();
+	for ( size_t i = 0; i < sample_count; ++i ) {
+		const Vector3 & p = i < points.size() ? points[i] : mesh.centers[tris[i - points.size()]];
+		float depth = 3.4e38f;
+		for ( size_t j = 0; j < planes.size() && depth > concavity; ++j ) {
+			const Vector4 & pl = planes[j];
+			depth = min( depth, -( pl.x * p.x + pl.y * p.y + pl.z * p.z + pl.w ) );
+		}
+		concavity = max( concavity, depth );
+	}
+	return concavity;
+}
+
+//Triangles that lie wholly on or below the cut go below, the rest above.
+//Faces that lie in the cut plane stay with the side they close off.
+static void SplitPart( const DecompMesh & mesh, const vector<unsigned int> & tris, unsigned int axis, float position, vector<unsigned int> & below, vector<unsigned int> & above ) {
+	below.clear();
+	above.clear();
+	for ( size_t i = 0; i < tris.size(); ++i ) {
+		if ( AxisValue( mesh.uppers[tris[i]], axis ) <= position ) {
+			below.push_back( tris[i] );
+		} else {
+			above.push_back( tris[i] );
+		}
+	}
+}
+
+//Tries cuts through the vertices of a part along each axis on several
+//threads and returns the one that leaves the least concavity behind
+static DecompSplit FindSplit( const DecompMesh & mesh, const DecompPart & part, float diagonal, unsigned int num_threads ) {
+	vector<DecompSplit> candidates;
+	vector<float> values( part.triangles.size() );
+	for ( unsigned int axis = 0; axis < 3; ++axis ) {
+		for ( size_t i = 0; i < part.triangles.size(); ++i ) {
+			values[i] = AxisValue( mesh.uppers[part.triangles[i]], axis );
+		}
+		sort( values.begin(), values.end() );
+		vector<float> positions( values.begin(), unique( values.begin(), values.end() ) );
+		//Cutting at the top would leave nothing above
+		positions.pop_back();
+		size_t count = min( positions.size(), (size_t)SPLIT_CANDIDATES );
+		for ( size_t k = 0; k < count; ++k ) {
+			DecompSplit split;
+			split.axis = axis;
+			split.position = positions[( 2 * k + 1 ) * positions.size() / ( 2 * count )];
+			split.concavity[0] = split.concavity[1] = 0.0f;
+			split.cost = 0.0f;
+			split.valid = false;
+			candidates.push_back( split );
+		}
+	}
+
+	ParallelFor( candidates.size(), num_threads, [&]( size_t begin, size_t end ) {
+		vector<unsigned int> sides[2];
+		for ( size_t i = begin; i < end; ++i ) {
+			DecompSplit & split = candidates[i];
+			SplitPart( mesh, part.triangles, split.axis, split.position, sides[0], sides[1] );
+			if ( sides[0].empty() || sides[1].empty() ) {
+				continue;
+			}
+			split.concavity[0] = PartConcavity( mesh, sides[0] );
+			split.concavity[1] = PartConcavity( mesh, sides[1] );
+			//Prefer even cuts between ones that are equally good
+			float balance = fabs( float(sides[0].size()) - float(sides[1].size()) ) / float(part.triangles.size());
+			split.cost = split.concavity[0] + split.concavity[1] + 1e-3f * diagonal * balance;
+			split.valid = true;
+		}
+	} );
+
+	DecompSplit best;
+	best.valid = false;
+	for ( size_t i = 0; i < candidates.size(); ++i ) {
+		if ( candidates[i].valid && ( !best.valid || candidates[i].cost < best.cost ) ) {
+			best = candidates[i];
+		}
+	}
+	return best;
+}
+
+static bool VertexLess( const Vector3 & a, const Vector3 & b ) {
+	if ( a.x != b.x ) return a.x < b.x;
+	if ( a.y != b.y ) return a.y < b.y;
+	return a.z < b.z;
+}
+
+//Turns a hull into the vertex and plane lists of a piece
+static void MakePiece( const vector<Vector3> & points, const vector<Triangle> & hull, ConvexPiece & piece ) {
+	vector<unsigned short> ids;
+	for ( size_t i = 0; i < hull.size(); ++i ) {
+		ids.push_back( hull[i].v1 );
+		ids.push_back( hull[i].v2 );
+		ids.push_back( hull[i].v3 );
+	}
+	sort( ids.begin(), ids.end() );
+	ids.erase( unique( ids.begin(), ids.end() ), ids.end() );
+	piece.vertices.resize( ids.size() );
+	for ( size_t i = 0; i < ids.size(); ++i ) {
+		piece.vertices[i] = points[ids[i]];
+	}
+	sort( piece.vertices.begin(), piece.vertices.end(), VertexLess );
+	HullPlanes( points, hull, piece.planes );
+}
+
+void DecomposeConvex( const vector<Vector3> & vertices, const vector<Triangle> & triangles, vector<ConvexPiece> & pieces, const ConvexDecompositionParams & params ) {
+	DecompMesh mesh;
+	mesh.vertices = &vertices;
+	Vector3 lo, hi;
+	for ( size_t i = 0; i < triangles.size(); ++i ) {
+		const Triangle & t = triangles[i];
+		if ( t.v1 >= vertices.size() || t.v2 >= vertices.size() || t.v3 >= vertices.size() ) {
+			throw runtime_error("A triangle refers to a vertex that does not exist.");
+		}
+		const Vector3 & a = vertices[t.v1];
+		const Vector3 & b = vertices[t.v2];
+		const Vector3 & c = vertices[t.v3];
+		Vector3 n = ( b - a ) ^ ( c - a );
+		float len = n.Magnitude();
+		if ( len <= 0.0f ) {
+			continue;
+		}
+		if ( mesh.triangles.empty() ) {
+			lo = hi = a;
+		}
+		for ( int k = 0; k < 3; ++k ) {
+			const Vector3 & v = vertices[t[k]];
+			lo = Vector3( min( lo.x, v.x ), min( lo.y, v.y ), min( lo.z, v.z ) );
+			hi = Vector3( max( hi.x, v.x ), max( hi.y, v.y ), max( hi.z, v.z ) );
+		}
+		mesh.triangles.push_back( t );
+		mesh.centers.push_back( ( a + b + c ) / 3.0f );
+		mesh.uppers.push_back( Vector3( max( a.x, max( b.x, c.x ) ), max( a.y, max( b.y, c.y ) ), max( a.z, max( b.z, c.z ) ) ) );
+		mesh.normals.push_back( n / len );
+		mesh.areas.push_back( 0.5f * len );
+	}
+	if ( mesh.triangles.empty() ) {
+		throw runtime_error("Cannot decompose a mesh that has no triangles with area.");
+	}
+	float diagonal = ( hi - lo ).Magnitude();
+	mesh.thickness = 1e-3f * diagonal;
+	float threshold = params.maxConcavity * diagonal;
+	unsigned int max_hulls = max( params.maxHulls, 1u );
+
+	vector<DecompPart> parts( 1 );
+	parts[0].triangles.resize( mesh.triangles.size() );
+	for ( size_t i = 0; i < mesh.triangles.size(); ++i ) {
+		parts[0].triangles[i] = (unsigned int)i;
+	}
+	parts[0].concavity = PartConcavity( mesh, parts[0].triangles );
+	parts[0].splittable = true;
+
+	//Always cut the most concave piece next
+	while ( parts.size() < max_hulls ) {
+		size_t worst = parts.size();
+		for ( size_t i = 0; i < parts.size(); ++i ) {
+			if ( parts[i].splittable && parts[i].concavity > threshold && ( worst == parts.size() || parts[i].concavity > parts[worst].concavity ) ) {
+				worst = i;
+			}
+		}
+		if ( worst == parts.size() ) {
+			break;
+		}
+
+		DecompSplit split = FindSplit( mesh, parts[worst], diagonal, params.numThreads );
+		if ( !split.valid ) {
+			parts[worst].splittable = false;
+			continue;
+		}
+		DecompPart above;
+		above.concavity = split.concavity[1];
+		above.splittable = true;
+		vector<unsigned int> below;
+		SplitPart( mesh, parts[worst].triangles, split.axis, split.position, below, above.triangles );
+		parts[worst].triangles.swap( below );
+		parts[worst].concavity = split.concavity[0];
+		parts.push_back( above );
+	}
+
+	pieces.clear();
+	pieces.resize( parts.size() );
+	ParallelFor( parts.size(), params.numThreads, [&]( size_t begin, size_t end ) {
+		vector<Vector3> points;
+		vector<Triangle> hull;
+		for ( size_t i = begin; i < end; ++i ) {
+			PartHull( mesh, parts[i].triangles, params.maxHullVertices, points, hull );
+			MakePiece( points, hull, pieces[i] );
+		}
+	} );
+}
+
+static Ref<bhkConvexVerticesShape> CreatePieceShape( const ConvexPiece & piece, const ConvexDecompositionParams & params ) {
+	Ref<bhkConvexVerticesShape> shape = new bhkConvexVerticesShape;
+	shape->SetVertices( piece.vertices );
+	shape->SetNormalsAndDist( piece.planes );
+	shape->SetMaterial( params.material );
+	shape->SetRadius( params.radius );
+	return shape;
+}
+
+Ref<bhkConvexVerticesShape> CreateConvexVerticesShape( const vector<Vector3> & points, const ConvexDecompositionParams & params ) {
+	vector<Triangle> hull = NifQHull::compute_convex_hull( points, params.maxHullVertices );
+	if ( hull.empty() ) {
+		throw runtime_error("Cannot create a convex shape from points that are all on one plane.");
+	}
+	ConvexPiece piece;
+	MakePiece( points, hull, piece );
+	return CreatePieceShape( piece, params );
+}
+
+Ref<bhkListShape> CreateConvexDecomposition( const vector<Vector3> & vertices, const vector<Triangle> & triangles, const ConvexDecompositionParams & params ) {
+	vector<ConvexPiece> pieces;
+	DecomposeConvex( vertices, triangles, pieces, params );
+
+	vector< Ref<bhkShape> > shapes;
+	for ( size_t i = 0; i < pieces.size(); ++i ) {
+		Ref<bhkConvexVerticesShape> shape = CreatePieceShape( pieces[i], params );
+		shapes.push_back( StaticCast<bhkShape>( shape ) );
+	}
+	Ref<bhkListShape> list = new bhkListShape;
+	list->SetSubShapes( shapes );
+	list->SetMaterial( params.material );
+	return list;
+}
+
+Ref<bhkListShape> CreateConvexDecomposition( NiTriBasedGeom * geom, const ConvexDecompositionParams & params, float scale ) {
+	if ( geom == NULL ) {
+		throw runtime_error("Cannot decompose a NULL shape.");
+	}
+	Ref<NiTriBasedGeomData> data = DynamicCast<NiTriBasedGeomData>( geom->GetData() );
+	if ( data == NULL ) {
+		throw runtime_error("The shape has no triangle data to decompose.");
+	}
+	//Triangles without area are skipped by the decomposition itself, so the
+	//stored triangles can be used without filtering them into a copy
+	const vector<Triangle> & triangles = data->GetTriangleArray();
+	if ( scale == 1.0f ) {
+		return CreateConvexDecomposition( data->GetVertexArray(), triangles, params );
+	}
+	vector<Vector3> vertices = data->GetVertices();
+	for ( size_t i = 0; i < vertices.size(); ++i ) {
+		vertices[i] *= scale;
+	}
+	return CreateConvexDecomposition( vertices, triangles, params );
+}
+
+} //End Niflib namespace
@@ -3,7 +3,9 @@ All rights reserved.  Please see niflib.h for license. */
 
 #include "../include/Inertia.h"
 #include "../include/nifqhull.h"
+#include "NifSimd.h"
 #include <vector>
+#include <stdexcept>
 #include <algorithm>
 #include <functional>
 #include <numeric>
@@ -162,17 +164,151 @@ void Inertia::CalcMassPropertiesCapsule(Vector3 startAxis, Vector3 endAxis, floa
 // References
 // ----------
 //
-// Jonathan Blow, Atman J Binstock
-// "How to find the inertia tensor (or other mass properties) of a 3D solid body represented by a triangle mesh"
-// http://number-none.com/blow/inertia/bb_inertia.doc
-//
 // David Eberly
 // "Polyhedral Mass Properties (Revisited)"
 // http://www.geometrictools.com//LibPhysics/RigidBody/Wm4PolyhedralMassProperties.pdf
 //
-// The function is an implementation of the Blow and Binstock algorithm,
-// extended for the case where the polygon is a surface (set parameter
-// solid = False).
+// Solid bodies use Eberly's closed form integrals of 1, x, y, z, x^2, y^2,
+// z^2, xy, yz and zx over the volume.  Hollow bodies use the same moments
+// taken over the surface, which for a triangle with area A and corners
+// v0, v1, v2 are A, A s / 3 and A / 12 (v0 v0^T + v1 v1^T + v2 v2^T + s s^T)
+// with s = v0 + v1 + v2.
+
+//The number of triangle quads summed in single precision before the running
+//totals are moved into double precision
+static const unsigned int INTEGRAL_FLUSH = 64;
+
+enum {
+	INT_ONE, INT_X, INT_Y, INT_Z, INT_XX, INT_YY, INT_ZZ, INT_XY, INT_YZ, INT_ZX,
+	INT_VOLUME, INT_COUNT
+};
+
+static inline void PolyhedronSubexpressions( simd4f w0, simd4f w1, simd4f w2,
+											simd4f & f1, simd4f & f2, simd4f & f3,
+											simd4f & g0, simd4f & g1, simd4f & g2 )
+{
+	simd4f temp0 = SimdAdd( w0, w1 );
+	f1 = SimdAdd( temp0, w2 );
+	simd4f temp1 = SimdMul( w0, w0 );
+	simd4f temp2 = SimdMadd( w1, temp0, temp1 );
+	f2 = SimdMadd( w2, f1, temp2 );
+	f3 = SimdAdd( SimdMul( w0, temp1 ), SimdAdd( SimdMul( w1, temp2 ), SimdMul( w2, f2 ) ) );
+	g0 = SimdMadd( w0, SimdAdd( f1, w0 ), f2 );
+	g1 = SimdMadd( w1, SimdAdd( f1, w1 ), f2 );
+	g2 = SimdMadd( w2, SimdAdd( f1, w2 ), f2 );
+}
+
+//Sums the integrals of a mesh relative to origin, four triangles at a time
+static void IntegratePolyhedron( const Vector3 * vertices, unsigned int numVertices,
+								 const Triangle * triangles, unsigned int numTriangles,
+								 const Vector3 & origin, bool solid, double integrals[INT_COUNT] )
+{
+	for ( int i = 0; i < INT_COUNT; ++i ) {
+		integrals[i] = 0.0;
+	}
+
+	simd4f sums[INT_COUNT];
+	for ( int i = 0; i < INT_COUNT; ++i ) {
+		sums[i] = SimdZero();
+	}
+	const simd4f half = SimdSplat( 0.5f );
+	const simd4f third = SimdSplat( 1.0f / 3.0f );
+	const simd4f twelfth = SimdSplat( 1.0f / 12.0f );
+
+	unsigned int quads = 0;
+	for ( unsigned int first = 0; first < numTriangles; first += 4 ) {
+		//Gather up to four triangles into structure of arrays form.  Unused
+		//lanes stay at the origin, where they add nothing.
+		float px[3][4], py[3][4], pz[3][4];
+		for ( int lane = 0; lane < 4; ++lane ) {
+			unsigned int t = first + lane;
+			for ( int k = 0; k < 3; ++k ) {
+				if ( t < numTriangles ) {
+					unsigned short index = triangles[t][k];
+					if ( index >= numVertices ) {
+						throw runtime_error("A triangle refers to a vertex that does not exist.");
+					}
+					const Vector3 & v = vertices[index];
+					px[k][lane] = v.x - origin.x;
+					py[k][lane] = v.y - origin.y;
+					pz[k][lane] = v.z - origin.z;
+				} else {
+					px[k][lane] = py[k][lane] = pz[k][lane] = 0.0f;
+				}
+			}
+		}
+		simd4f x0 = SimdLoad( px[0] ), x1 = SimdLoad( px[1] ), x2 = SimdLoad( px[2] );
+		simd4f y0 = SimdLoad( py[0] ), y1 = SimdLoad( py[1] ), y2 = SimdLoad( py[2] );
+		simd4f z0 = SimdLoad( pz[0] ), z1 = SimdLoad( pz[1] ), z2 = SimdLoad( pz[2] );
+
+		//Edge cross product, twice the area weighted normal
+		simd4f a1 = SimdSub( x1, x0 ), b1 = SimdSub( y1, y0 ), c1 = SimdSub( z1, z0 );
+		simd4f a2 = SimdSub( x2, x0 ), b2 = SimdSub( y2, y0 ), c2 = SimdSub( z2, z0 );
+		simd4f d0 = SimdSub( SimdMul( b1, c2 ), SimdMul( b2, c1 ) );
+		simd4f d1 = SimdSub( SimdMul( a2, c1 ), SimdMul( a1, c2 ) );
+		simd4f d2 = SimdSub( SimdMul( a1, b2 ), SimdMul( a2, b1 ) );
+
+		simd4f f1x, f2x, f3x, g0x, g1x, g2x;
+		PolyhedronSubexpressions( x0, x1, x2, f1x, f2x, f3x, g0x, g1x, g2x );
+		sums[INT_VOLUME] = SimdMadd( d0, f1x, sums[INT_VOLUME] );
+
+		if ( solid ) {
+			simd4f f1y, f2y, f3y, g0y, g1y, g2y;
+			simd4f f1z, f2z, f3z, g0z, g1z, g2z;
+			PolyhedronSubexpressions( y0, y1, y2, f1y, f2y, f3y, g0y, g1y, g2y );
+			PolyhedronSubexpressions( z0, z1, z2, f1z, f2z, f3z, g0z, g1z, g2z );
+			sums[INT_ONE] = SimdMadd( d0, f1x, sums[INT_ONE] );
+			sums[INT_X] = SimdMadd( d0, f2x, sums[INT_X] );
+			sums[INT_Y] = SimdMadd( d1, f2y, sums[INT_Y] );
+			sums[INT_Z] = SimdMadd( d2, f2z, sums[INT_Z] );
+			sums[INT_XX] = SimdMadd( d0, f3x, sums[INT_XX] );
+			sums[INT_YY] = SimdMadd( d1, f3y, sums[INT_YY] );
+			sums[INT_ZZ] = SimdMadd( d2, f3z, sums[INT_ZZ] );
+			sums[INT_XY] = SimdMadd( d0, SimdAdd( SimdMul( y0, g0x ), SimdAdd( SimdMul( y1, g1x ), SimdMul( y2, g2x ) ) ), sums[INT_XY] );
+			sums[INT_YZ] = SimdMadd( d1, SimdAdd( SimdMul( z0, g0y ), SimdAdd( SimdMul( z1, g1y ), SimdMul( z2, g2y ) ) ), sums[INT_YZ] );
+			sums[INT_ZX] = SimdMadd( d2, SimdAdd( SimdMul( x0, g0z ), SimdAdd( SimdMul( x1, g1z ), SimdMul( x2, g2z ) ) ), sums[INT_ZX] );
+		} else {
+			simd4f area = SimdMul( half, SimdSqrt( SimdDot3( d0, d1, d2, d0, d1, d2 ) ) );
+			simd4f sx = SimdAdd( x0, SimdAdd( x1, x2 ) );
+			simd4f sy = SimdAdd( y0, SimdAdd( y1, y2 ) );
+			simd4f sz = SimdAdd( z0, SimdAdd( z1, z2 ) );
+			simd4f w = SimdMul( area, twelfth );
+			sums[INT_ONE] = SimdAdd( area, sums[INT_ONE] );
+			sums[INT_X] = SimdMadd( SimdMul( area, third ), sx, sums[INT_X] );
+			sums[INT_Y] = SimdMadd( SimdMul( area, third ), sy, sums[INT_Y] );
+			sums[INT_Z] = SimdMadd( SimdMul( area, third ), sz, sums[INT_Z] );
+			sums[INT_XX] = SimdMadd( w, SimdAdd( SimdDot3( x0, x1, x2, x0, x1, x2 ), SimdMul( sx, sx ) ), sums[INT_XX] );
+			sums[INT_YY] = SimdMadd( w, SimdAdd( SimdDot3( y0, y1, y2, y0, y1, y2 ), SimdMul( sy, sy ) ), sums[INT_YY] );
+			sums[INT_ZZ] = SimdMadd( w, SimdAdd( SimdDot3( z0, z1, z2, z0, z1, z2 ), SimdMul( sz, sz ) ), sums[INT_ZZ] );
+			sums[INT_XY] = SimdMadd( w, SimdAdd( SimdDot3( x0, x1, x2, y0, y1, y2 ), SimdMul( sx, sy ) ), sums[INT_XY] );
+			sums[INT_YZ] = SimdMadd( w, SimdAdd( SimdDot3( y0, y1, y2, z0, z1, z2 ), SimdMul( sy, sz ) ), sums[INT_YZ] );
+			sums[INT_ZX] = SimdMadd( w, SimdAdd( SimdDot3( z0, z1, z2, x0, x1, x2 ), SimdMul( sz, sx ) ), sums[INT_ZX] );
+		}
+
+		if ( ++quads == INTEGRAL_FLUSH || first + 4 >= numTriangles ) {
+			quads = 0;
+			for ( int i = 0; i < INT_COUNT; ++i ) {
+				float lanes[4];
+				SimdStore( lanes, sums[i] );
+				integrals[i] += double(lanes[0]) + double(lanes[1]) + double(lanes[2]) + double(lanes[3]);
+				sums[i] = SimdZero();
+			}
+		}
+	}
+
+	integrals[INT_VOLUME] /= 6.0;
+	if ( solid ) {
+		static const double scale[INT_VOLUME] = {
+			1.0 / 6.0, 1.0 / 24.0, 1.0 / 24.0, 1.0 / 24.0,
+			1.0 / 60.0, 1.0 / 60.0, 1.0 / 60.0,
+			1.0 / 120.0, 1.0 / 120.0, 1.0 / 120.0
+		};
+		for ( int i = 0; i < INT_VOLUME; ++i ) {
+			integrals[i] *= scale[i];
+		}
+	}
+}
+
 void Inertia::CalcMassPropertiesPolyhedron(const vector<Vector3>& vertices, 
 											 const vector<Triangle>& triangles, 
 											 float density, bool solid,
@@ -180,144 +316,82 @@ void Inertia::CalcMassPropertiesPolyhedron(const vector<Vector3>& vertices,
 {
 	if (extCalcMassPropertiesPolyhedronRoutine) {
 		extCalcMassPropertiesPolyhedronRoutine(
-			int(vertices.size()), &vertices[0],
+			int(vertices.size()), vertices.empty() ? NULL : &vertices[0],
 			int(triangles.size()), triangles.empty() ? NULL : &triangles[0],
 			density, solid, mass, volume, center, inertia);
 		return;
 	}
 
-	vector<Triangle>::const_iterator triBegin, triEnd;
-	vector<Triangle> tris;
 	if (triangles.size() == 0)
 	{
-		tris = NifQHull::compute_convex_hull(vertices);
-		triBegin = tris.begin();
-		triEnd = tris.end();
+		vector<Triangle> tris = NifQHull::compute_convex_hull(vertices);
+		CalcMassPropertiesPolyhedron(
+			vertices.empty() ? NULL : &vertices[0], (unsigned int)vertices.size(),
+			tris.empty() ? NULL : &tris[0], (unsigned int)tris.size(),
+			density, solid, mass, volume, center, inertia);
 	}
 	else
 	{
-		triBegin = triangles.begin();
-		triEnd = triangles.end();
+		CalcMassPropertiesPolyhedron(
+			&vertices[0], (unsigned int)vertices.size(),
+			&triangles[0], (unsigned int)triangles.size(),
+			density, solid, mass, volume, center, inertia);
+	}
+}
+
+void Inertia::CalcMassPropertiesPolyhedron(const Vector3 * vertices, unsigned int numVertices,
+											 const Triangle * triangles, unsigned int numTriangles,
+											 float density, bool solid,
+											 float& mass, float& volume, Vector3& center, InertiaMatrix &inertia)
+{
+	if (extCalcMassPropertiesPolyhedronRoutine) {
+		extCalcMassPropertiesPolyhedronRoutine(
+			int(numVertices), vertices, int(numTriangles), triangles,
+			density, solid, mass, volume, center, inertia);
+		return;
 	}
 
-    // 120 times the covariance matrix of the canonical tetrahedron
-    // (0,0,0),(1,0,0),(0,1,0),(0,0,1)
-    // integrate(integrate(integrate(z*z, x=0..1-y-z), y=0..1-z), z=0..1) = 1/120
-    // integrate(integrate(integrate(y*z, x=0..1-y-z), y=0..1-z), z=0..1) = 1/60
-    Matrix33 covariance_canonical(	2.0f, 1.0f, 1.0f, 
-									1.0f, 2.0f, 1.0f, 
-									1.0f, 1.0f, 2.0f );
-    vector<Matrix44> covariances;
-    vector<float> masses;
-    vector<Vector3> centers;
-
-    // for each triangle
-    // construct a tetrahedron from triangle + (0,0,0)
-    // find its matrix, mass, and center (for density = 1, will be corrected at
-    // the end of the algorithm)
-	for (vector<Triangle>::const_iterator itr=triBegin, end=triEnd; itr != end; ++itr)
+	// integrate relative to a vertex of the mesh, which keeps the single
+	// precision sums accurate for meshes far from the origin
+	Vector3 origin;
+	if (numTriangles > 0 && triangles[0].v1 < numVertices)
+		origin = vertices[triangles[0].v1];
+
+	double in[INT_COUNT];
+	IntegratePolyhedron(vertices, numVertices, triangles, numTriangles, origin, solid, in);
+
+	// a mesh wound inside out has negative volume
+	if (in[INT_VOLUME] < 0.0)
 	{
-        // Calc vertices
-        const Vector3& vert0 = vertices[ (*itr)[0] ];
-		const Vector3& vert1 = vertices[ (*itr)[1] ];
-		const Vector3& vert2 = vertices[ (*itr)[2] ];
-
-        // construct a transform matrix that converts the canonical tetrahedron
-        // into (0,0,0),vert0,vert1,vert2
-		Matrix44 transform_transposed(Matrix33(
-			vert0[0], vert0[1], vert0[2],
-			vert1[0], vert1[1], vert1[2],
-			vert2[0], vert2[1], vert2[2]));
-		Matrix44 transform = transform_transposed.Transpose();
-
-        // find the covariance matrix of the transformed tetrahedron/triangle
-        if (solid)
-		{
-            // we shall be needing the determinant more than once, so
-            // precalculate it
-			float determinant = transform.Determinant();
-
-            // C' = det(A) * A * C * A^T
-			covariances.push_back( transform * covariance_canonical * transform_transposed * determinant );
-            // m = det(A) / 6.0
-            masses.push_back(determinant / 6.0f);
-            // find center of gravity of the tetrahedron
-			centers.push_back(
-				Vector3(0.25f * (vert0[0] + vert1[0] + vert2[0]),
-						0.25f * (vert0[1] + vert1[1] + vert2[1]),
-						0.25f * (vert0[2] + vert1[2] + vert2[2]))
-				);
-		} else {
-            // find center of gravity of the triangle
-			Vector3 com( (vert0[0] + vert1[0] + vert2[0]) / 3.0f,
-						 (vert0[1] + vert1[1] + vert2[1]) / 3.0f,
-						 (vert0[2] + vert1[2] + vert2[2]) / 3.0f);
-			centers.push_back( com );
-
-            // find mass of triangle
-            // mass is surface, which is half the norm of cross product
-            // of two edges
-			float calc_mass = ((vert1 - vert0) ^ (vert2 - vert0)).Magnitude() / 2.0f;
-			masses.push_back( calc_mass );
-
-            // find covariance at center of this triangle
-            // (this is approximate only as it replaces triangle with point mass
-            // TODO: find better way)
-			Matrix33 calc_c( com[0]*com[0], com[0]*com[1], com[0]*com[2],
-							 com[1]*com[0], com[1]*com[1], com[1]*com[2],
-							 com[2]*com[0], com[2]*com[1], com[2]*com[2]);
-            covariances.push_back( Matrix44(calc_c) );
-		}
+		in[INT_VOLUME] = -in[INT_VOLUME];
+		if (solid)
+			for (int i = 0; i < INT_VOLUME; ++i)
+				in[i] = -in[i];
 	}
-    // accumulate the results
-	mass = std::accumulate(masses.begin(), masses.end(), 0.0f);
-    if (mass < 0.0001f)
+	volume = float(in[INT_VOLUME]);
+
+	double m = in[INT_ONE];
+	if (m < 0.0001)
 	{
         // dimension is probably badly chosen
-        //raise ZeroDivisionError("mass is zero (consider calculating inertia with a lower dimension)")
-        //printf("WARNING: mass is zero");
 		mass = 0.0f, volume = 0.0f;
 		center = Vector3();
 		inertia = InertiaMatrix::IDENTITY;
 		return;
 	}
 
-    // weighed average of centers with masses
-	center = Vector3();
-	for (size_t i = 0; i<masses.size(); ++i)
-		center += (centers[i] * (masses[i] / mass) );
-
-    // add covariances, and correct the values
-	Matrix44 total_covariance;
-	if (solid)
-	{
-		for (size_t i = 0; i<covariances.size(); ++i)
-			total_covariance *= covariances[i];
-	}
-
+	double cx = in[INT_X] / m, cy = in[INT_Y] / m, cz = in[INT_Z] / m;
+	center = origin + Vector3(float(cx), float(cy), float(cz));
 
-    // translate covariance to center of gravity:
-    // C' = C - m * ( x dx^T + dx x^T + dx dx^T )
-    // with x the translation vector and dx the center of gravity
-
-	Matrix44 translate_correction(
-		Matrix33( center[0]*center[0], center[0]*center[1], center[0]*center[2],
-				 center[1]*center[0], center[1]*center[1], center[1]*center[2],
-				 center[2]*center[0], center[2]*center[1], center[2]*center[2]
-				) 
-		);
-	translate_correction *= mass;
-
-    total_covariance = total_covariance - translate_correction;
-
-    // convert covariance matrix into inertia tensor
-	float trace = total_covariance[0][0] + total_covariance[1][1] + total_covariance[2][2];
-	Matrix44 trace_matrix;
-	trace_matrix[0][0] = trace_matrix[1][1] = trace_matrix[2][2] = trace;
-		
-	// correct for given density
-    inertia = InertiaMatrix((trace_matrix - total_covariance).GetRotation()) * density;
-    mass *= density;
+	// inertia tensor about the center of mass
+	inertia = InertiaMatrix::IDENTITY;
+	inertia[0][0] = float(density * (in[INT_YY] + in[INT_ZZ] - m * (cy * cy + cz * cz)));
+	inertia[1][1] = float(density * (in[INT_ZZ] + in[INT_XX] - m * (cz * cz + cx * cx)));
+	inertia[2][2] = float(density * (in[INT_XX] + in[INT_YY] - m * (cx * cx + cy * cy)));
+	inertia[0][1] = inertia[1][0] = float(-density * (in[INT_XY] - m * cx * cy));
+	inertia[1][2] = inertia[2][1] = float(-density * (in[INT_YZ] - m * cy * cz));
+	inertia[0][2] = inertia[2][0] = float(-density * (in[INT_ZX] - m * cz * cx));
+	mass = float(m * density);
 }
 
 void Inertia::CombineMassProperties( 
@@ -336,13 +410,44 @@ void Inertia::CombineMassProperties(
 		return;
 	}
 
+	mass = 0.0f;
+	volume = 0.0f;
+	center = Vector3();
+	inertia = InertiaMatrix::IDENTITY;
+
+	// move every center into the common space
+	vector<Vector3> moved(masses.size());
 	for (size_t i=0; i < masses.size(); ++i) {
+		moved[i] = transforms[i] * centers[i];
 		mass += masses[i];
+		volume += volumes[i];
+		center += moved[i] * masses[i];
 	}
-	// TODO: doubt this inertia calculation is even remotely close
-	for (size_t i=0; i < masses.size(); ++i) {
-		center += centers[i] * (masses[i] / mass);
-		inertia *= inertias[i];
+	if (mass <= 0.0f) {
+		center = Vector3();
+		return;
 	}
+	center = center / mass;
 
+	// rotate each inertia tensor into the common space and shift it to the
+	// combined center with the parallel axis theorem
+	double sum[3][3] = { { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+	for (size_t i=0; i < masses.size(); ++i) {
+		const Matrix44 & t = transforms[i];
+		const InertiaMatrix & in = inertias[i];
+		Vector3 d = moved[i] - center;
+		float dd = d * d;
+		for (int r = 0; r < 3; ++r) {
+			for (int c = 0; c < 3; ++c) {
+				double rotated = 0.0;
+				for (int j = 0; j < 3; ++j)
+					for (int k = 0; k < 3; ++k)
+						rotated += t[j][r] * in[j][k] * t[k][c];
+				sum[r][c] += rotated + masses[i] * ((r == c ? dd : 0.0f) - d[r] * d[c]);
+			}
+		}
+	}
+	for (int r = 0; r < 3; ++r)
+		for (int c = 0; c < 3; ++c)
+			inertia[r][c] = float(sum[r][c]);
 }
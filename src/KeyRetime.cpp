@@ -0,0 +1,313 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/niflib.h"
+#include "../include/obj/NiObject.h"
+#include "../include/obj/NiObjectNET.h"
+#include "../include/obj/NiTimeController.h"
+#include "../include/obj/NiSequence.h"
+#include "../include/obj/NiControllerSequence.h"
+#include "../include/obj/NiKeyframeData.h"
+#include "../include/obj/NiFloatData.h"
+#include "../include/obj/NiPosData.h"
+#include "../include/obj/NiBoolData.h"
+#include "../include/obj/NiVisData.h"
+#include "../include/obj/NiMorphData.h"
+#include "../include/obj/NiColorData.h"
+#include "../include/obj/NiUVData.h"
+#include "../include/obj/NiTextKeyExtraData.h"
+#include "../include/obj/NiBSplineInterpolator.h"
+#include "NifParallel.h"
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Niflib {
+
+//The kinds of objects which store keys
+enum KeyDataKind {
+	KEY_DATA_NONE,
+	KEY_DATA_KEYFRAME,
+	KEY_DATA_FLOAT,
+	KEY_DATA_POS,
+	KEY_DATA_BOOL,
+	KEY_DATA_VIS,
+	KEY_DATA_MORPH,
+	KEY_DATA_COLOR,
+	KEY_DATA_UV,
+	KEY_DATA_TEXT,
+	KEY_DATA_BSPLINE
+};
+
+static KeyDataKind GetKeyDataKind( const NiObject * obj ) {
+	if ( obj->IsDerivedType( NiKeyframeData::TYPE ) ) return KEY_DATA_KEYFRAME;
+	if ( obj->IsDerivedType( NiFloatData::TYPE ) ) return KEY_DATA_FLOAT;
+	if ( obj->IsDerivedType( NiPosData::TYPE ) ) return KEY_DATA_POS;
+	if ( obj->IsDerivedType( NiBoolData::TYPE ) ) return KEY_DATA_BOOL;
+	if ( obj->IsDerivedType( NiVisData::TYPE ) ) return KEY_DATA_VIS;
+	if ( obj->IsDerivedType( NiMorphData::TYPE ) ) return KEY_DATA_MORPH;
+	if ( obj->IsDerivedType( NiColorData::TYPE ) ) return KEY_DATA_COLOR;
+	if ( obj->IsDerivedType( NiUVData::TYPE ) ) return KEY_DATA_UV;
+	if ( obj->IsDerivedType( NiTextKeyExtraData::TYPE ) ) return KEY_DATA_TEXT;
+	if ( obj->IsDerivedType( NiBSplineInterpolator::TYPE ) ) return KEY_DATA_BSPLINE;
+	return KEY_DATA_NONE;
+}
+
+//A key data object together with the time line change to apply to it.
+//Only plain pointers are used so that jobs can run on worker threads.
+struct KeyDataJob {
+	NiObject * obj;
+	KeyDataKind kind;
+	float phase;
+	float frequency;
+};
+
+static void RunKeyDataJob( const KeyDataJob & job ) {
+	float p = job.phase;
+	float f = job.frequency;
+	switch ( job.kind ) {
+		case KEY_DATA_KEYFRAME: static_cast<NiKeyframeData*>(job.obj)->NormalizeKeys( p, f ); break;
+		case KEY_DATA_FLOAT: static_cast<NiFloatData*>(job.obj)->NormalizeKeys( p, f ); break;
+		case KEY_DATA_POS: static_cast<NiPosData*>(job.obj)->NormalizeKeys( p, f ); break;
+		case KEY_DATA_BOOL: static_cast<NiBoolData*>(job.obj)->NormalizeKeys( p, f ); break;
+		case KEY_DATA_VIS: static_cast<NiVisData*>(job.obj)->NormalizeKeys( p, f ); break;
+		case KEY_DATA_MORPH: static_cast<NiMorphData*>(job.obj)->NormalizeKeys( p, f ); break;
+		case KEY_DATA_COLOR: static_cast<NiColorData*>(job.obj)->NormalizeKeys( p, f ); break;
+		case KEY_DATA_UV: static_cast<NiUVData*>(job.obj)->NormalizeKeys( p, f ); break;
+		case KEY_DATA_TEXT: static_cast<NiTextKeyExtraData*>(job.obj)->NormalizeKeys( p, f ); break;
+		case KEY_DATA_BSPLINE: {
+			//The control points are spread evenly between the start and stop
+			//times, so moving those retimes the whole curve
+			NiBSplineInterpolator * interp = static_cast<NiBSplineInterpolator*>(job.obj);
+			interp->SetStartTime( ( interp->GetStartTime() - p ) / f );
+			interp->SetStopTime( ( interp->GetStopTime() - p ) / f );
+			break;
+		}
+		default: break;
+	}
+}
+
+static void RunKeyDataJobs( const vector<KeyDataJob> & jobs, unsigned int num_threads ) {
+	const KeyDataJob * first = jobs.empty() ? NULL : &jobs[0];
+	ParallelFor( jobs.size(), num_threads, [first]( size_t begin, size_t end ) {
+		for ( size_t i = begin; i < end; ++i ) {
+			RunKeyDataJob( first[i] );
+		}
+	} );
+}
+
+//Everything in a tree that has a time line, each object listed once
+struct TimelineScan {
+	vector<NiTimeController*> controllers;
+	vector<NiControllerSequence*> sequences;
+	vector<NiObject*> data;
+	vector<KeyDataKind> dataKinds;
+	unordered_map<NiObject*,unsigned int> dataIndex;
+};
+
+static void ScanTimelines( NiObject * root, TimelineScan & scan ) {
+	unordered_set<NiObject*> visited;
+	vector<NiObject*> stack;
+	stack.push_back( root );
+	visited.insert( root );
+	while ( !stack.empty() ) {
+		NiObject * obj = stack.back();
+		stack.pop_back();
+
+		if ( obj->IsDerivedType( NiTimeController::TYPE ) ) {
+			scan.controllers.push_back( static_cast<NiTimeController*>(obj) );
+		} else if ( obj->IsDerivedType( NiControllerSequence::TYPE ) ) {
+			scan.sequences.push_back( static_cast<NiControllerSequence*>(obj) );
+		} else {
+			KeyDataKind kind = GetKeyDataKind( obj );
+			if ( kind != KEY_DATA_NONE ) {
+				scan.dataIndex[obj] = (unsigned int)(scan.data.size());
+				scan.data.push_back( obj );
+				scan.dataKinds.push_back( kind );
+			}
+		}
+
+		list<NiObjectRef> refs = obj->GetRefs();
+		for ( list<NiObjectRef>::iterator it = refs.begin(); it != refs.end(); ++it ) {
+			NiObject * child = *it;
+			if ( child != NULL && visited.insert( child ).second ) {
+				stack.push_back( child );
+			}
+		}
+	}
+}
+
+//Finds the key data driven by a controller, without crossing into other
+//controllers, sequences or scene graph objects
+static void FindControllerData( NiTimeController * ctlr, const TimelineScan & scan, vector<unsigned int> & out ) {
+	unordered_set<NiObject*> visited;
+	vector<NiObject*> stack;
+	stack.push_back( ctlr );
+	visited.insert( ctlr );
+	while ( !stack.empty() ) {
+		NiObject * obj = stack.back();
+		stack.pop_back();
+
+		unordered_map<NiObject*,unsigned int>::const_iterator found = scan.dataIndex.find( obj );
+		if ( found != scan.dataIndex.end() ) {
+			out.push_back( found->second );
+		}
+
+		list<NiObjectRef> refs = obj->GetRefs();
+		for ( list<NiObjectRef>::iterator it = refs.begin(); it != refs.end(); ++it ) {
+			NiObject * child = *it;
+			if ( child == NULL || !visited.insert( child ).second ) {
+				continue;
+			}
+			if ( child->IsDerivedType( NiTimeController::TYPE ) ||
+			     child->IsDerivedType( NiSequence::TYPE ) ||
+			     child->IsDerivedType( NiObjectNET::TYPE ) ) {
+				continue;
+			}
+			stack.push_back( child );
+		}
+	}
+}
+
+static unsigned int FindSet( vector<unsigned int> & parent, unsigned int i ) {
+	while ( parent[i] != i ) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+RetimeResult RetimeNifTree( NiObject * root, float scale, float offset, unsigned int num_threads ) {
+	if ( root == NULL ) {
+		throw runtime_error("Attempted to retime a NULL tree.");
+	}
+	if ( !( scale > 0.0f ) ) {
+		throw runtime_error("The retime scale must be positive.");
+	}
+
+	TimelineScan scan;
+	ScanTimelines( root, scan );
+
+	//t * scale + offset, expressed as the phase and frequency removed by
+	//NormalizeKeys
+	float phase = -offset / scale;
+	float frequency = 1.0f / scale;
+
+	vector<KeyDataJob> jobs( scan.data.size() );
+	for ( size_t i = 0; i < scan.data.size(); ++i ) {
+		jobs[i].obj = scan.data[i];
+		jobs[i].kind = scan.dataKinds[i];
+		jobs[i].phase = phase;
+		jobs[i].frequency = frequency;
+	}
+	RunKeyDataJobs( jobs, num_threads );
+
+	for ( size_t i = 0; i < scan.controllers.size(); ++i ) {
+		NiTimeController * ctlr = scan.controllers[i];
+		ctlr->SetStartTime( ctlr->GetStartTime() * scale + offset );
+		ctlr->SetStopTime( ctlr->GetStopTime() * scale + offset );
+	}
+	for ( size_t i = 0; i < scan.sequences.size(); ++i ) {
+		NiControllerSequence * seq = scan.sequences[i];
+		seq->SetStartTime( seq->GetStartTime() * scale + offset );
+		seq->SetStopTime( seq->GetStopTime() * scale + offset );
+	}
+
+	RetimeResult result;
+	result.controllers = (unsigned int)(scan.controllers.size() + scan.sequences.size());
+	result.dataBlocks = (unsigned int)(scan.data.size());
+	return result;
+}
+
+RetimeResult NormalizeNifTreeKeys( NiObject * root, unsigned int num_threads ) {
+	if ( root == NULL ) {
+		throw runtime_error("Attempted to normalize the keys of a NULL tree.");
+	}
+
+	TimelineScan scan;
+	ScanTimelines( root, scan );
+
+	//Group controllers with the key data they drive.  Sets are numbered with
+	//the controllers first, followed by the key data objects.
+	unsigned int num_ctlrs = (unsigned int)(scan.controllers.size());
+	vector<unsigned int> parent( num_ctlrs + scan.data.size() );
+	for ( unsigned int i = 0; i < parent.size(); ++i ) {
+		parent[i] = i;
+	}
+	vector<unsigned int> data_ids;
+	for ( unsigned int c = 0; c < num_ctlrs; ++c ) {
+		data_ids.clear();
+		FindControllerData( scan.controllers[c], scan, data_ids );
+		for ( size_t i = 0; i < data_ids.size(); ++i ) {
+			unsigned int a = FindSet( parent, c );
+			unsigned int b = FindSet( parent, num_ctlrs + data_ids[i] );
+			if ( a != b ) {
+				parent[b] = a;
+			}
+		}
+	}
+
+	//A group can be normalized if all of its controllers agree on the time line
+	struct Group {
+		Group() : hasController(false), valid(true), phase(0.0f), frequency(1.0f) {}
+		bool hasController;
+		bool valid;
+		float phase;
+		float frequency;
+	};
+	vector<Group> groups( parent.size() );
+	for ( unsigned int c = 0; c < num_ctlrs; ++c ) {
+		Group & g = groups[FindSet( parent, c )];
+		float p = scan.controllers[c]->GetPhase();
+		float f = scan.controllers[c]->GetFrequency();
+		if ( f == 0.0f ) {
+			g.valid = false;
+		} else if ( !g.hasController ) {
+			g.phase = p;
+			g.frequency = f;
+		} else if ( g.phase != p || g.frequency != f ) {
+			g.valid = false;
+		}
+		g.hasController = true;
+	}
+
+	RetimeResult result;
+
+	vector<KeyDataJob> jobs;
+	for ( unsigned int d = 0; d < scan.data.size(); ++d ) {
+		const Group & g = groups[FindSet( parent, num_ctlrs + d )];
+		//Leave data that no controller drives, such as the data of
+		//controller sequences, on its own time line
+		if ( !g.hasController || !g.valid || ( g.phase == 0.0f && g.frequency == 1.0f ) ) {
+			continue;
+		}
+		KeyDataJob job;
+		job.obj = scan.data[d];
+		job.kind = scan.dataKinds[d];
+		job.phase = g.phase;
+		job.frequency = g.frequency;
+		jobs.push_back( job );
+	}
+	RunKeyDataJobs( jobs, num_threads );
+	result.dataBlocks = (unsigned int)(jobs.size());
+
+	for ( unsigned int c = 0; c < num_ctlrs; ++c ) {
+		const Group & g = groups[FindSet( parent, c )];
+		if ( !g.valid ) {
+			++result.skippedControllers;
+			continue;
+		}
+		NiTimeController * ctlr = scan.controllers[c];
+		if ( g.phase == 0.0f && g.frequency == 1.0f ) {
+			continue;
+		}
+		ctlr->SetStartTime( ( ctlr->GetStartTime() - g.phase ) / g.frequency );
+		ctlr->SetStopTime( ( ctlr->GetStopTime() - g.phase ) / g.frequency );
+		ctlr->SetPhase( 0.0f );
+		ctlr->SetFrequency( 1.0f );
+		++result.controllers;
+	}
+
+	return result;
+}
+
+} //End Niflib namespace
@@ -0,0 +1,133 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/niflib.h"
+#include "../include/Inertia.h"
+#include "../include/obj/NiObject.h"
+#include "../include/obj/bhkRigidBody.h"
+#include "../include/obj/bhkShape.h"
+#include "../include/obj/bhkListShape.h"
+#include "../include/obj/bhkTransformShape.h"
+#include "../include/obj/bhkMoppBvTreeShape.h"
+#include "NifParallel.h"
+#include <unordered_set>
+
+namespace Niflib {
+
+//A leaf shape of a rigid body together with its place in the body.
+//Only plain pointers are used so that jobs can run on worker threads.
+struct MassJob {
+	bhkShape * shape;
+	Matrix44 transform;
+	float mass;
+	float volume;
+	Vector3 center;
+	InertiaMatrix inertia;
+};
+
+//Walks a shape tree on the calling thread, recording each leaf shape with
+//the transform that takes it into the space of the body
+static void FlattenShape( bhkShape * shape, const Matrix44 & transform, vector<MassJob> & jobs ) {
+	if ( shape == NULL ) {
+		return;
+	}
+	if ( shape->IsDerivedType( bhkListShape::TYPE ) ) {
+		vector< Ref<bhkShape> > subs = static_cast<bhkListShape*>(shape)->GetSubShapes();
+		for ( size_t i = 0; i < subs.size(); ++i ) {
+			FlattenShape( subs[i], transform, jobs );
+		}
+	} else if ( shape->IsDerivedType( bhkTransformShape::TYPE ) ) {
+		bhkTransformShape * xform = static_cast<bhkTransformShape*>(shape);
+		FlattenShape( xform->GetShape(), xform->GetTransform() * transform, jobs );
+	} else if ( shape->IsDerivedType( bhkMoppBvTreeShape::TYPE ) ) {
+		FlattenShape( static_cast<bhkMoppBvTreeShape*>(shape)->GetShape(), transform, jobs );
+	} else {
+		MassJob job;
+		job.shape = shape;
+		job.transform = transform;
+		job.mass = job.volume = 0.0f;
+		jobs.push_back( job );
+	}
+}
+
+unsigned int UpdateMassProperties( NiObject * root, float density, bool solid, bool keep_mass, unsigned int num_threads ) {
+	if ( root == NULL ) {
+		throw runtime_error("Attempted to update the mass properties of a NULL tree.");
+	}
+
+	//Find every rigid body once
+	vector<bhkRigidBody*> bodies;
+	unordered_set<NiObject*> visited;
+	vector<NiObject*> stack;
+	stack.push_back( root );
+	visited.insert( root );
+	while ( !stack.empty() ) {
+		NiObject * obj = stack.back();
+		stack.pop_back();
+		if ( obj->IsDerivedType( bhkRigidBody::TYPE ) ) {
+			bodies.push_back( static_cast<bhkRigidBody*>(obj) );
+		}
+		list<NiObjectRef> refs = obj->GetRefs();
+		for ( list<NiObjectRef>::iterator it = refs.begin(); it != refs.end(); ++it ) {
+			NiObject * child = *it;
+			if ( child != NULL && visited.insert( child ).second ) {
+				stack.push_back( child );
+			}
+		}
+	}
+
+	//Jobs of body i are jobs[first[i]] to jobs[first[i + 1]]
+	vector<MassJob> jobs;
+	vector<size_t> first( bodies.size() + 1, 0 );
+	for ( size_t i = 0; i < bodies.size(); ++i ) {
+		FlattenShape( bodies[i]->GetShape(), Matrix44::IDENTITY, jobs );
+		first[i + 1] = jobs.size();
+	}
+
+	float job_density = keep_mass ? 1.0f : density;
+	MassJob * job_list = jobs.empty() ? NULL : &jobs[0];
+	ParallelFor( jobs.size(), num_threads, [job_list, job_density, solid]( size_t begin, size_t end ) {
+		for ( size_t i = begin; i < end; ++i ) {
+			MassJob & job = job_list[i];
+			job.shape->CalcMassProperties( job_density, solid, job.mass, job.volume, job.center, job.inertia );
+		}
+	} );
+
+	unsigned int updated = 0;
+	for ( size_t i = 0; i < bodies.size(); ++i ) {
+		if ( first[i] == first[i + 1] ) {
+			continue;
+		}
+		vector<float> masses, volumes;
+		vector<Vector3> centers;
+		vector<InertiaMatrix> inertias;
+		vector<Matrix44> transforms;
+		for ( size_t j = first[i]; j < first[i + 1]; ++j ) {
+			masses.push_back( jobs[j].mass );
+			volumes.push_back( jobs[j].volume );
+			centers.push_back( jobs[j].center );
+			inertias.push_back( jobs[j].inertia );
+			transforms.push_back( jobs[j].transform );
+		}
+		float mass, volume;
+		Vector3 center;
+		InertiaMatrix inertia;
+		Inertia::CombineMassProperties( masses, volumes, centers, inertias, transforms, mass, volume, center, inertia );
+
+		bhkRigidBody * body = bodies[i];
+		if ( keep_mass ) {
+			float target = body->GetMass();
+			if ( mass != 0.0f ) {
+				inertia *= target / mass;
+			}
+			mass = target;
+		}
+		body->SetMass( mass );
+		body->SetCenter( Vector4( center.x, center.y, center.z, 0.0f ) );
+		body->SetInertia( inertia );
+		++updated;
+	}
+	return updated;
+}
+
+} //End Niflib namespace
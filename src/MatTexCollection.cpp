@@ -13,7 +13,19 @@ All rights reserved.  Please see niflib.h for license. */
 #include "../include/obj/NiAlphaProperty.h"
 #include "../include/obj/NiSourceTexture.h"
 #include "../include/obj/NiImage.h"
+#include "../include/obj/NiPixelData.h"
 #include "../include/obj/NiStencilProperty.h"
+#include "../include/obj/NiTimeController.h"
+#include "../include/obj/BSLightingShaderProperty.h"
+#include "../include/obj/BSShaderPPLightingProperty.h"
+#include "../include/obj/BSShaderTextureSet.h"
+#include "../include/gen/Header.h"
+#include "../include/NIF_IO.h"
+#include "../include/TextureStore.h"
+#include <cctype>
+#include <functional>
+#include <sstream>
+#include <set>
 
 namespace Niflib {
 
@@ -30,32 +42,32 @@ void MatTexCollection::GatherMaterials( NiAVObject * scene_root ) {
 		throw runtime_error( "MatTexCollection::GatherMaterials was called on a NULL scene root." );
 	}
 
-	//Check and see if this object is a geometry object
-	if ( scene_root->IsDerivedType( NiGeometry::TYPE ) ) {
+	vector<NiAVObject *> objects;
+	CollectObjects( scene_root, objects );
+	for ( size_t n = 0; n < objects.size(); ++n ) {
+		NiAVObject * obj = objects[n];
+
+		//Only geometry objects have materials
+		if ( !obj->IsDerivedType( NiGeometry::TYPE ) ) {
+			continue;
+		}
+
+		//Sort the properties once, both to look the material up and to create it
+		NiMaterialPropertyRef matC;
+		NiTexturingPropertyRef texingC;
+		NiTexturePropertyRef texC;
+		NiMultiTexturePropertyRef multiC;
+		NiSpecularPropertyRef specC;
+		NiAlphaPropertyRef alphaC;
+		NiStencilPropertyRef stencilC;
+		SortProperties( obj->GetProperties(), matC, texingC, texC, multiC, specC, alphaC, stencilC );
 
 		//Check and see if this geometry's unique combination of material and texture properties has already been found
-		if ( GetMaterialIndex( scene_root ) == NO_MATERIAL ) {
-			//Material was not already found.  Look for material/texture related properties.
-			NiPropertyRef mat = scene_root->GetPropertyByType( NiMaterialProperty::TYPE );
-			NiPropertyRef texing = scene_root->GetPropertyByType( NiTexturingProperty::TYPE );
-			NiPropertyRef tex = scene_root->GetPropertyByType( NiTextureProperty::TYPE );
-			NiPropertyRef multi = scene_root->GetPropertyByType( NiMultiTextureProperty::TYPE );
-			NiPropertyRef spec = scene_root->GetPropertyByType( NiSpecularProperty::TYPE );
-			NiPropertyRef alpha = scene_root->GetPropertyByType( NiAlphaProperty::TYPE );
-			NiPropertyRef stencil = scene_root->GetPropertyByType( NiStencilProperty::TYPE);
-
-			//Make sure at least one isn't NULL
-			if ( mat != NULL || texing != NULL || tex != NULL || multi != NULL || stencil != NULL) {
+		if ( GetMaterialIndex( matC, texingC, texC, multiC, specC, alphaC, stencilC ) == NO_MATERIAL ) {
+			//Material was not already found.  Make sure at least one of the material/texture related properties isn't NULL
+			if ( matC != NULL || texingC != NULL || texC != NULL || multiC != NULL || stencilC != NULL) {
 				//One isn't NULL, so create a new Material
 
-				NiMaterialPropertyRef matC = DynamicCast<NiMaterialProperty>(mat);
-				NiTexturingPropertyRef texingC = DynamicCast<NiTexturingProperty>(texing);
-				NiTexturePropertyRef texC = DynamicCast<NiTextureProperty>(tex);
-				NiMultiTexturePropertyRef multiC = DynamicCast<NiMultiTextureProperty>(multi);
-				NiSpecularPropertyRef specC = DynamicCast<NiSpecularProperty>(spec);
-				NiAlphaPropertyRef alphaC = DynamicCast<NiAlphaProperty>(alpha);
-				NiStencilPropertyRef stencilC = DynamicCast<NiStencilProperty>(stencil);
-
 				//First, check if the material's textures have been found yet
 
 				if ( texingC != NULL ) {
@@ -66,7 +78,7 @@ void MatTexCollection::GatherMaterials( NiAVObject * scene_root ) {
 								unsigned int index = GetTextureIndex( td.source );
 								if ( index == NO_TEXTURE ) {
 									//Texture has not yet been found.  Create a new one.
-									textures.push_back( TextureWrapper( td.source ) );
+									AddTexture( TextureWrapper( td.source ) );
 								}
 							}
 						}
@@ -77,7 +89,7 @@ void MatTexCollection::GatherMaterials( NiAVObject * scene_root ) {
 						unsigned int index = GetTextureIndex( image );
 						if ( index == NO_TEXTURE ) {
 							//Texture has not yet been found.  Create a new one.
-							textures.push_back( TextureWrapper( image ) );
+							AddTexture( TextureWrapper( image ) );
 						}
 					}
 				}
@@ -85,28 +97,37 @@ void MatTexCollection::GatherMaterials( NiAVObject * scene_root ) {
 				//TODO: Implement this for NiMultiTextureProperty as well
 
 
-				materials.push_back( MaterialWrapper( matC, texingC, texC, multiC, specC, alphaC, stencilC, this ) );
+				AddMaterial( MaterialWrapper( matC, texingC, texC, multiC, specC, alphaC, stencilC, this ) );
 			}
 		}
-		//Done with this branch, so return.
-		return;
 	}
+}
 
-	//If this object is a NiNode, then call this function on its children
-	NiNodeRef node = DynamicCast<NiNode>(scene_root);
-	if ( node != NULL ) {
-		vector<NiAVObjectRef> children = node->GetChildren();
+//Walks the scene depth first, listing each object before its children
+void MatTexCollection::CollectObjects( NiAVObject * scene_root, vector<NiAVObject *> & objects ) {
+	vector<NiAVObject *> stack( 1, scene_root );
+	while ( !stack.empty() ) {
+		NiAVObject * obj = stack.back();
+		stack.pop_back();
+		objects.push_back( obj );
 
-		for ( size_t i = 0; i < children.size(); ++i ) {
-			GatherMaterials( children[i] );
+		//If this object is a NiNode, then visit its children in order
+		if ( obj->IsDerivedType( NiNode::TYPE ) ) {
+			vector<NiAVObjectRef> children = static_cast<NiNode *>(obj)->GetChildren();
+			for ( size_t i = children.size(); i > 0; --i ) {
+				if ( children[i - 1] != NULL ) {
+					stack.push_back( children[i - 1] );
+				}
+			}
 		}
 	}
-
 }
 
 void MatTexCollection::Clear() {
 	materials.clear();
 	textures.clear();
+	material_index.clear();
+	texture_index.clear();
 }
 
 unsigned int MatTexCollection::GetNumMaterials() {
@@ -141,17 +162,11 @@ unsigned int MatTexCollection::GetMaterialIndex( NiAVObject * obj ) {
 }
 
 unsigned int MatTexCollection::GetMaterialIndex( NiMaterialProperty * mat, NiTexturingProperty * texing, NiTextureProperty * tex, NiMultiTextureProperty * multi, NiSpecularProperty * spec, NiAlphaProperty * alpha, NiStencilProperty * stencil ) {
-	for( size_t i = 0; i < materials.size(); ++i ) {
-		if ( materials[i].mat_prop == mat &&
-			 materials[i].texing_prop == texing &&
-			 materials[i].tex_prop == tex &&
-			 materials[i].multi_prop == multi &&
-			 materials[i].spec_prop == spec &&
-			 materials[i].alpha_prop == alpha &&
-			 materials[i].stencil_prop == stencil) {
-				 //Match found, return its index
-				 return i;
-		}
+	MaterialKey key = { { mat, texing, tex, multi, spec, alpha, stencil } };
+	unordered_map<MaterialKey, unsigned int, MaterialKeyHash>::const_iterator it = material_index.find( key );
+	if ( it != material_index.end() ) {
+		//Match found, return its index
+		return it->second;
 	}
 
 	//No match was found, return NO_MATERIAL
@@ -159,26 +174,24 @@ unsigned int MatTexCollection::GetMaterialIndex( NiMaterialProperty * mat, NiTex
 }
 
 unsigned int MatTexCollection::GetTextureIndex( NiSourceTexture * src_tex ) {
-	for( size_t i = 0; i < textures.size(); ++i ) {
-		if ( textures[i].src_tex == src_tex  ) {
-				 //Match found, return its index
-				 return i;
-		}
+	unordered_map<const void *, unsigned int>::const_iterator it = texture_index.find( src_tex );
+	if ( src_tex != NULL && it != texture_index.end() ) {
+		//Match found, return its index
+		return it->second;
 	}
 
-	//No match was found, return NO_MATERIAL
+	//No match was found, return NO_TEXTURE
 	return NO_TEXTURE;
 }
 
 unsigned int MatTexCollection::GetTextureIndex( NiImage * image ) {
-	for( size_t i = 0; i < textures.size(); ++i ) {
-		if ( textures[i].image == image  ) {
-				 //Match found, return its index
-				 return i;
-		}
+	unordered_map<const void *, unsigned int>::const_iterator it = texture_index.find( image );
+	if ( image != NULL && it != texture_index.end() ) {
+		//Match found, return its index
+		return it->second;
 	}
 
-	//No match was found, return NO_MATERIAL
+	//No match was found, return NO_TEXTURE
 	return NO_TEXTURE;
 }
 
@@ -191,7 +204,13 @@ unsigned int MatTexCollection::GetMaterialIndex( const vector< Ref<NiProperty> >
 	NiSpecularPropertyRef spec = NULL;
 	NiAlphaPropertyRef alpha = NULL;
 	NiStencilPropertyRef stencil = NULL;
+	SortProperties( properties, mat, texing, tex, multi, spec, alpha, stencil );
 
+	//Do the search
+	return GetMaterialIndex( mat, texing, tex, multi, spec, alpha, stencil );
+}
+
+void MatTexCollection::SortProperties( const vector< Ref<NiProperty> > & properties, Ref<NiMaterialProperty> & mat, Ref<NiTexturingProperty> & texing, Ref<NiTextureProperty> & tex, Ref<NiMultiTextureProperty> & multi, Ref<NiSpecularProperty> & spec, Ref<NiAlphaProperty> & alpha, Ref<NiStencilProperty> & stencil ) {
 	for ( unsigned i = 0; i < properties.size(); ++i ) {
 		if ( properties[i] == NULL ) {
 			continue;
@@ -212,9 +231,45 @@ unsigned int MatTexCollection::GetMaterialIndex( const vector< Ref<NiProperty> >
 			stencil = DynamicCast<NiStencilProperty>( properties[i] );
 		}
 	}
+}
 
-	//Do the search
-	return GetMaterialIndex( mat, texing, tex, multi, spec, alpha, stencil );
+unsigned int MatTexCollection::AddMaterial( const MaterialWrapper & material ) {
+	unsigned int index = (unsigned int)materials.size();
+	materials.push_back( material );
+
+	//An earlier material with the same properties keeps the index, as the
+	//first match was found when searching the list
+	MaterialKey key = { { material.mat_prop, material.texing_prop, material.tex_prop, material.multi_prop, material.spec_prop, material.alpha_prop, material.stencil_prop } };
+	material_index.insert( make_pair( key, index ) );
+	return index;
+}
+
+unsigned int MatTexCollection::AddTexture( const TextureWrapper & texture ) {
+	unsigned int index = (unsigned int)textures.size();
+	textures.push_back( texture );
+	if ( texture.src_tex != NULL ) {
+		texture_index.insert( make_pair( (const void *)(NiSourceTexture *)texture.src_tex, index ) );
+	} else {
+		texture_index.insert( make_pair( (const void *)(NiImage *)texture.image, index ) );
+	}
+	return index;
+}
+
+bool MatTexCollection::MaterialKey::operator==( const MaterialKey & other ) const {
+	for ( int i = 0; i < 7; ++i ) {
+		if ( props[i] != other.props[i] ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t MatTexCollection::MaterialKeyHash::operator()( const MaterialKey & key ) const {
+	size_t h = 0;
+	for ( int i = 0; i < 7; ++i ) {
+		h ^= hash<const void *>()( key.props[i] ) + 0x9e3779b9 + ( h << 6 ) + ( h >> 2 );
+	}
+	return h;
 }
 
 unsigned int MatTexCollection::CreateTexture( unsigned int version ) {
@@ -222,18 +277,15 @@ unsigned int MatTexCollection::CreateTexture( unsigned int version ) {
 		//Old image object style
 		NiImageRef image = new NiImage;
 
-		//Create texture wrapper and add it to the array
-		textures.push_back( TextureWrapper( image ) );
+		//Create texture wrapper, add it to the array and return its index
+		return AddTexture( TextureWrapper( image ) );
 	} else {
 		//New iamge object style
 		NiSourceTextureRef src_tex = new NiSourceTexture;
 
-		//Create texture wrapper and add it to the array
-		textures.push_back( TextureWrapper( src_tex ) );
+		//Create texture wrapper, add it to the array and return its index
+		return AddTexture( TextureWrapper( src_tex ) );
 	}
-
-	//Return the index of the newly created texture
-	return textures.size() - 1;
 }
 
 unsigned int MatTexCollection::CreateMaterial( bool color, bool texture, bool multi_tex, bool specular, bool translucency, unsigned int version ) {
@@ -275,11 +327,230 @@ unsigned int MatTexCollection::CreateMaterial( bool color, bool texture, bool mu
 		}
 	}
 
-	//Create Material and add it to the array
-	materials.push_back( MaterialWrapper( mat, texing, tex, multi, spec, alpha, stencil, this ) );
+	//Create Material, add it to the array and return its index
+	return AddMaterial( MaterialWrapper( mat, texing, tex, multi, spec, alpha, stencil, this ) );
+}
+
+unsigned int MatTexCollection::ExternalizeTextures( TextureLibrary & library ) {
+	//Textures that share pixel data are only added once
+	map<NiPixelData *, string> names;
+	unsigned int count = 0;
+	for ( size_t i = 0; i < textures.size(); ++i ) {
+		NiSourceTextureRef src_tex = textures[i].src_tex;
+		if ( src_tex == NULL || src_tex->IsTextureExternal() ) {
+			continue;
+		}
+		NiPixelDataRef data = src_tex->GetPixelData();
+		if ( data == NULL ) {
+			continue;
+		}
+		map<NiPixelData *, string>::iterator it = names.find( data );
+		if ( it == names.end() ) {
+			it = names.insert( make_pair( (NiPixelData *)data, library.AddTexture( data, src_tex->GetTextureFileName() ) ) ).first;
+		}
+		src_tex->SetExternalTexture( it->second );
+		++count;
+	}
+	return count;
+}
+
+unsigned int MatTexCollection::InternalizeTextures( TextureLibrary & library ) {
+	//File names are not case sensitive, so textures that name the same file
+	//in different case share the pixel data too
+	map<string, NiPixelDataRef> loaded;
+	unsigned int count = 0;
+	for ( size_t i = 0; i < textures.size(); ++i ) {
+		NiSourceTextureRef src_tex = textures[i].src_tex;
+		if ( src_tex == NULL || !src_tex->IsTextureExternal() ) {
+			continue;
+		}
+		string file_name = src_tex->GetTextureFileName();
+		string key = file_name;
+		for ( size_t c = 0; c < key.size(); ++c ) {
+			key[c] = (char)tolower( (unsigned char)key[c] );
+		}
+		NiPixelDataRef & data = loaded[key];
+		if ( data == NULL ) {
+			data = library.LoadTexture( file_name );
+		}
+		src_tex->SetInternalTexture( file_name, data );
+		++count;
+	}
+	return count;
+}
+
+//The data an object would write to a file, with links written as ids that
+//stay the same for each object, used to find identical objects
+static string ContentKey( NiObject * obj, const NifInfo & info, bool ignore_name, map<NiObject *, unsigned int> & ids, unsigned int & size ) {
+	map<NiObjectRef, unsigned int> link_map;
+	list<NiObjectRef> refs = obj->GetRefs();
+	list<NiObject *> ptrs = obj->GetPtrs();
+	for ( list<NiObjectRef>::iterator it = refs.begin(); it != refs.end(); ++it ) {
+		ptrs.push_back( *it );
+	}
+	for ( list<NiObject *>::iterator it = ptrs.begin(); it != ptrs.end(); ++it ) {
+		if ( *it != NULL ) {
+			unsigned int id = (unsigned int)ids.size();
+			link_map[*it] = ids.insert( make_pair( *it, id ) ).first->second;
+		}
+	}
+
+	NiObjectNET * net = obj->IsDerivedType( NiObjectNET::TYPE ) ? static_cast<NiObjectNET *>(obj) : NULL;
+	string name;
+	if ( ignore_name && net != NULL ) {
+		name = net->GetName();
+		net->SetName( string() );
+	}
+
+	//Newer versions write strings as indices into the header, so the
+	//strings are added to the key separately
+	Header header;
+	stringstream out;
+	out << hdrInfo( &header );
+	list<NiObject *> missing_link_stack;
+	try {
+		obj->Write( out, link_map, missing_link_stack, info );
+	} catch ( ... ) {
+		if ( ignore_name && net != NULL ) {
+			net->SetName( name );
+		}
+		throw;
+	}
+	if ( ignore_name && net != NULL ) {
+		net->SetName( name );
+	}
+
+	string data = out.str();
+	size = (unsigned int)data.size();
+	string key = obj->GetType().GetTypeName();
+	key += '\0';
+	key += data;
+	for ( size_t i = 0; i < header.strings.size(); ++i ) {
+		key += '\0';
+		key += header.strings[i];
+	}
+	return key;
+}
+
+static Ref<BSShaderTextureSet> GetTextureSet( NiProperty * prop ) {
+	if ( prop->IsDerivedType( BSLightingShaderProperty::TYPE ) ) {
+		return static_cast<BSLightingShaderProperty *>(prop)->GetTextureSet();
+	} else if ( prop->IsDerivedType( BSShaderPPLightingProperty::TYPE ) ) {
+		return static_cast<BSShaderPPLightingProperty *>(prop)->GetTextureSet();
+	}
+	return NULL;
+}
+
+static void SetTextureSet( NiProperty * prop, BSShaderTextureSet * texture_set ) {
+	if ( prop->IsDerivedType( BSLightingShaderProperty::TYPE ) ) {
+		static_cast<BSLightingShaderProperty *>(prop)->SetTextureSet( texture_set );
+	} else if ( prop->IsDerivedType( BSShaderPPLightingProperty::TYPE ) ) {
+		static_cast<BSShaderPPLightingProperty *>(prop)->SetTextureSet( texture_set );
+	}
+}
+
+PropertyShareResult MatTexCollection::ShareProperties( NiAVObject * scene_root, const NifInfo & info, bool ignore_names ) {
+	if ( scene_root == NULL ) {
+		throw runtime_error( "MatTexCollection::ShareProperties was called on a NULL scene root." );
+	}
+	if ( info.version < VER_3_3_0_13 ) {
+		throw runtime_error( "Properties can only be compared for files of version 3.3.0.13 and later." );
+	}
+
+	//Find every property in the scene once
+	vector<NiAVObject *> objects;
+	CollectObjects( scene_root, objects );
+	vector<NiPropertyRef> props;
+	set<NiProperty *> seen;
+	for ( size_t n = 0; n < objects.size(); ++n ) {
+		vector<NiPropertyRef> list = objects[n]->GetProperties();
+		if ( objects[n]->IsDerivedType( NiGeometry::TYPE ) ) {
+			NiGeometry * geom = static_cast<NiGeometry *>(objects[n]);
+			list.push_back( geom->GetBSProperty(0) );
+			list.push_back( geom->GetBSProperty(1) );
+		}
+		for ( size_t i = 0; i < list.size(); ++i ) {
+			if ( list[i] != NULL && seen.insert( list[i] ).second ) {
+				props.push_back( list[i] );
+			}
+		}
+	}
+
+	PropertyShareResult result;
+	map<NiObject *, unsigned int> ids;
+	unsigned int size = 0;
+
+	//Texture sets first, so that shader properties with identical sets link
+	//the same one by the time they are compared
+	unordered_map<string, BSShaderTextureSet *> sets;
+	set<BSShaderTextureSet *> removed_sets;
+	for ( size_t i = 0; i < props.size(); ++i ) {
+		Ref<BSShaderTextureSet> texture_set = GetTextureSet( props[i] );
+		if ( texture_set == NULL ) {
+			continue;
+		}
+		BSShaderTextureSet * & shared = sets[ContentKey( texture_set, info, false, ids, size )];
+		if ( shared == NULL ) {
+			shared = texture_set;
+		} else if ( shared != texture_set ) {
+			SetTextureSet( props[i], shared );
+			if ( removed_sets.insert( texture_set ).second ) {
+				++result.textureSetsRemoved;
+				result.bytesSaved += size;
+			}
+		}
+	}
+
+	//Then the properties themselves
+	unordered_map<string, NiProperty *> unique;
+	map<NiProperty *, NiPropertyRef> replace;
+	for ( size_t i = 0; i < props.size(); ++i ) {
+		if ( !props[i]->GetControllers().empty() ) {
+			continue;
+		}
+		NiProperty * & shared = unique[ContentKey( props[i], info, ignore_names, ids, size )];
+		if ( shared == NULL ) {
+			shared = props[i];
+		} else {
+			replace[props[i]] = shared;
+			++result.propertiesRemoved;
+			result.bytesSaved += size;
+		}
+	}
+
+	//Point every object at the shared properties, keeping their order
+	for ( size_t n = 0; n < objects.size() && !replace.empty(); ++n ) {
+		NiAVObject * obj = objects[n];
+		vector<NiPropertyRef> list = obj->GetProperties();
+		bool changed = false;
+		for ( size_t i = 0; i < list.size(); ++i ) {
+			map<NiProperty *, NiPropertyRef>::iterator it = replace.find( list[i] );
+			if ( it != replace.end() ) {
+				list[i] = it->second;
+				changed = true;
+			}
+		}
+		if ( changed ) {
+			obj->ClearProperties();
+			for ( size_t i = 0; i < list.size(); ++i ) {
+				obj->AddProperty( list[i] );
+			}
+		}
+		if ( obj->IsDerivedType( NiGeometry::TYPE ) ) {
+			NiGeometry * geom = static_cast<NiGeometry *>(obj);
+			for ( short i = 0; i < 2; ++i ) {
+				map<NiProperty *, NiPropertyRef>::iterator it = replace.find( geom->GetBSProperty(i) );
+				if ( it != replace.end() ) {
+					geom->SetBSProperty( i, it->second );
+				}
+			}
+		}
+	}
 
-	//Return the index of the newly created material
-	return materials.size() - 1;
+	//The materials of the scene are made of different objects now
+	Clear();
+	GatherMaterials( scene_root );
+	return result;
 }
 
 //MaterialWrapper//////////////////////////////////////////////////////////////
@@ -567,6 +838,32 @@ void TextureWrapper::SetExternalTexture( const string & file_name ) {
 	}
 }
 
+Ref<NiPixelData> TextureWrapper::GetPixelData() {
+	if ( src_tex != NULL ) {
+		if ( src_tex->IsTextureExternal() ) {
+			return NULL;
+		}
+		return src_tex->GetPixelData();
+	} else if ( image != NULL ) {
+		//Old style image objects store NiRawImageData instead
+		return NULL;
+	} else {
+		//Texture not found
+		throw runtime_error("TextureWrapper holds no data.  This should not be able to happen.");
+	}
+}
+
+void TextureWrapper::SetInternalTexture( NiPixelData * pixel_data ) {
+	if ( src_tex != NULL ) {
+		src_tex->SetInternalTexture( src_tex->GetTextureFileName(), pixel_data );
+	} else if ( image != NULL ) {
+		throw runtime_error("Old style NiImage textures cannot store NiPixelData.");
+	} else {
+		//Texture not found
+		throw runtime_error("TextureWrapper holds no data.  This should not be able to happen.");
+	}
+}
+
 PixelLayout TextureWrapper::GetPixelLayout() {
 	if ( src_tex != NULL ) {
 		return src_tex->GetPixelLayout();
@@ -0,0 +1,493 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/MoppCode.h"
+#include "../include/obj/bhkMoppBvTreeShape.h"
+#include "../include/obj/bhkPackedNiTriStripsShape.h"
+#include "../include/obj/hkPackedNiTriStripsData.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+namespace Niflib {
+
+//Size of the MOPP space along the largest axis of the mesh
+static const float MOPP_RANGE = 256.0f * 256.0f * 254.0f;
+//Splits compare the top byte of the 24 bit MOPP coordinates
+static const float MOPP_BYTE = 256.0f * 256.0f;
+
+static inline float Axis( const Vector3 & v, int axis ) {
+	return axis == 0 ? v.x : ( axis == 1 ? v.y : v.z );
+}
+
+static inline int QuantizeByte( float c ) {
+	int b = int( floor( c / MOPP_BYTE ) );
+	return b < 0 ? 0 : ( b > 255 ? 255 : b );
+}
+
+//Byte bounds and centers of the triangles being compiled, in MOPP space
+struct MoppBuilder {
+	vector<int> lo;
+	vector<int> hi;
+	vector<float> center;
+	vector<unsigned int> ids;
+	//Leaf ids written for each triangle, or NULL to use its position
+	const vector<unsigned int> * leaves;
+
+	//Orders triangle ids by their centers along one axis
+	struct CenterLess {
+		const vector<float> * center;
+		int axis;
+		bool operator()( unsigned int a, unsigned int b ) const {
+			return (*center)[a * 3 + axis] < (*center)[b * 3 + axis];
+		}
+	};
+
+	static void AppendLeaf( unsigned int id, vector<byte> & out ) {
+		if ( id < 32 ) {
+			out.push_back( byte( 0x30 + id ) );
+		} else if ( id < 256 ) {
+			out.push_back( 0x50 );
+			out.push_back( byte( id ) );
+		} else if ( id < 65536 ) {
+			out.push_back( 0x51 );
+			out.push_back( byte( id >> 8 ) );
+			out.push_back( byte( id & 0xFF ) );
+		} else {
+			throw runtime_error("Too many triangles to compile into MOPP code.");
+		}
+	}
+
+	void Build( size_t begin, size_t end, vector<byte> & out ) {
+		if ( end - begin == 1 ) {
+			AppendLeaf( leaves != NULL ? (*leaves)[ids[begin]] : ids[begin], out );
+			return;
+		}
+
+		//Split at the median center along the longest axis of the centers
+		float cmin[3], cmax[3];
+		for ( int a = 0; a < 3; ++a ) {
+			cmin[a] = cmax[a] = center[ids[begin] * 3 + a];
+		}
+		for ( size_t i = begin; i < end; ++i ) {
+			for ( int a = 0; a < 3; ++a ) {
+				cmin[a] = min( cmin[a], center[ids[i] * 3 + a] );
+				cmax[a] = max( cmax[a], center[ids[i] * 3 + a] );
+			}
+		}
+		int axis = 0;
+		for ( int a = 1; a < 3; ++a ) {
+			if ( cmax[a] - cmin[a] > cmax[axis] - cmin[axis] ) {
+				axis = a;
+			}
+		}
+		size_t mid = begin + ( end - begin ) / 2;
+		CenterLess less;
+		less.center = &center;
+		less.axis = axis;
+		nth_element( ids.begin() + begin, ids.begin() + mid, ids.begin() + end, less );
+
+		//The lower side is reached at or below arg1, the upper at or above arg2
+		int arg1 = 0, arg2 = 255;
+		for ( size_t i = begin; i < mid; ++i ) {
+			arg1 = max( arg1, hi[ids[i] * 3 + axis] );
+		}
+		for ( size_t i = mid; i < end; ++i ) {
+			arg2 = min( arg2, lo[ids[i] * 3 + axis] );
+		}
+
+		vector<byte> lower, upper;
+		Build( begin, mid, lower );
+		Build( mid, end, upper );
+
+		if ( lower.size() <= 0xFF ) {
+			out.push_back( byte( 0x10 + axis ) );
+			out.push_back( byte( arg1 ) );
+			out.push_back( byte( arg2 ) );
+			out.push_back( byte( lower.size() ) );
+			out.insert( out.end(), lower.begin(), lower.end() );
+			out.insert( out.end(), upper.begin(), upper.end() );
+			return;
+		}
+
+		//Both jumps are explicit, so put the smaller side first to keep the
+		//jump over it short
+		bool lower_first = lower.size() <= upper.size();
+		size_t skip = lower_first ? lower.size() : upper.size();
+		if ( skip > 0xFFFF ) {
+			throw runtime_error("The mesh is too large to compile into MOPP code.");
+		}
+		unsigned int jump1 = lower_first ? 0 : (unsigned int)skip;
+		unsigned int jump2 = lower_first ? (unsigned int)skip : 0;
+		out.push_back( byte( 0x23 + axis ) );
+		out.push_back( byte( arg1 ) );
+		out.push_back( byte( arg2 ) );
+		out.push_back( byte( jump1 >> 8 ) );
+		out.push_back( byte( jump1 & 0xFF ) );
+		out.push_back( byte( jump2 >> 8 ) );
+		out.push_back( byte( jump2 & 0xFF ) );
+		if ( lower_first ) {
+			out.insert( out.end(), lower.begin(), lower.end() );
+			out.insert( out.end(), upper.begin(), upper.end() );
+		} else {
+			out.insert( out.end(), upper.begin(), upper.end() );
+			out.insert( out.end(), lower.begin(), lower.end() );
+		}
+	}
+};
+
+//Compiles the triangles, writing leaves[t] as the id of triangles[t] if given
+static MoppCode Compile( const vector<Vector3> & vertices, const vector<Triangle> & triangles, const vector<unsigned int> * leaves ) {
+	MoppCode mopp;
+	if ( triangles.empty() ) {
+		return mopp;
+	}
+	if ( triangles.size() > 65536 ) {
+		throw runtime_error("Too many triangles to compile into MOPP code.");
+	}
+
+	Vector3 lo, hi;
+	for ( size_t t = 0; t < triangles.size(); ++t ) {
+		const Triangle & tri = triangles[t];
+		if ( tri.v1 >= vertices.size() || tri.v2 >= vertices.size() || tri.v3 >= vertices.size() ) {
+			throw runtime_error("Triangle vertex index is out of range.");
+		}
+		unsigned short corners[3] = { tri.v1, tri.v2, tri.v3 };
+		for ( int j = 0; j < 3; ++j ) {
+			const Vector3 & v = vertices[corners[j]];
+			if ( t == 0 && j == 0 ) {
+				lo = hi = v;
+			}
+			lo.x = min( lo.x, v.x ); lo.y = min( lo.y, v.y ); lo.z = min( lo.z, v.z );
+			hi.x = max( hi.x, v.x ); hi.y = max( hi.y, v.y ); hi.z = max( hi.z, v.z );
+		}
+	}
+	float size = max( hi.x - lo.x, max( hi.y - lo.y, hi.z - lo.z ) );
+	mopp.origin = lo - Vector3( 0.1f, 0.1f, 0.1f );
+	mopp.scale = MOPP_RANGE / ( size + 0.2f );
+
+	MoppBuilder builder;
+	builder.leaves = leaves;
+	builder.lo.resize( triangles.size() * 3 );
+	builder.hi.resize( triangles.size() * 3 );
+	builder.center.resize( triangles.size() * 3 );
+	builder.ids.resize( triangles.size() );
+	for ( size_t t = 0; t < triangles.size(); ++t ) {
+		const Triangle & tri = triangles[t];
+		Vector3 q[3] = {
+			( vertices[tri.v1] - mopp.origin ) * mopp.scale,
+			( vertices[tri.v2] - mopp.origin ) * mopp.scale,
+			( vertices[tri.v3] - mopp.origin ) * mopp.scale
+		};
+		for ( int a = 0; a < 3; ++a ) {
+			float c0 = Axis( q[0], a ), c1 = Axis( q[1], a ), c2 = Axis( q[2], a );
+			builder.lo[t * 3 + a] = QuantizeByte( min( c0, min( c1, c2 ) ) );
+			builder.hi[t * 3 + a] = QuantizeByte( max( c0, max( c1, c2 ) ) );
+			builder.center[t * 3 + a] = ( c0 + c1 + c2 ) / 3.0f;
+		}
+		builder.ids[t] = (unsigned int)t;
+	}
+
+	//Reject everything outside the mesh before walking the tree
+	for ( int a = 0; a < 3; ++a ) {
+		int blo = 255, bhi = 0;
+		for ( size_t t = 0; t < triangles.size(); ++t ) {
+			blo = min( blo, builder.lo[t * 3 + a] );
+			bhi = max( bhi, builder.hi[t * 3 + a] );
+		}
+		mopp.code.push_back( byte( 0x26 + a ) );
+		mopp.code.push_back( byte( blo ) );
+		mopp.code.push_back( byte( bhi ) );
+	}
+	builder.Build( 0, triangles.size(), mopp.code );
+	return mopp;
+}
+
+MoppCode CompileMopp( const vector<Vector3> & vertices, const vector<Triangle> & triangles ) {
+	return Compile( vertices, triangles, NULL );
+}
+
+MoppCode CompileMopp( const hkPackedNiTriStripsData * data ) {
+	if ( data == NULL ) {
+		throw runtime_error("Cannot compile MOPP code for NULL packed data.");
+	}
+	//Leaves keep their index into the full triangle array, which is what
+	//Havok shape keys refer to, even when degenerate triangles are skipped
+	const vector<hkTriangle> & all = data->GetHavokTriangleArray();
+	vector<Triangle> triangles;
+	vector<unsigned int> leaves;
+	triangles.reserve( all.size() );
+	leaves.reserve( all.size() );
+	for ( size_t i = 0; i < all.size(); ++i ) {
+		const Triangle & t = all[i].triangle;
+		if ( t.v1 != t.v2 && t.v2 != t.v3 && t.v1 != t.v3 ) {
+			triangles.push_back( t );
+			leaves.push_back( (unsigned int)i );
+		}
+	}
+	return Compile( data->GetVertexArray(), triangles, &leaves );
+}
+
+void UpdateMoppCode( bhkMoppBvTreeShape * shape ) {
+	if ( shape == NULL ) {
+		throw runtime_error("Cannot update the MOPP code of a NULL shape.");
+	}
+	bhkPackedNiTriStripsShapeRef packed = DynamicCast<bhkPackedNiTriStripsShape>( shape->GetShape() );
+	if ( packed == NULL || packed->GetData() == NULL ) {
+		throw runtime_error("MOPP code can only be compiled for a bhkPackedNiTriStripsShape with data.");
+	}
+	MoppCode mopp = CompileMopp( packed->GetData() );
+	shape->SetMoppCode( mopp.code );
+	shape->SetMoppOrigin( mopp.origin );
+	shape->SetMoppScale( mopp.scale );
+}
+
+MoppCode GetMoppCode( const bhkMoppBvTreeShape * shape ) {
+	if ( shape == NULL ) {
+		throw runtime_error("Cannot read the MOPP code of a NULL shape.");
+	}
+	MoppCode mopp;
+	mopp.code = shape->GetMoppCode();
+	mopp.origin = shape->GetMoppOrigin();
+	mopp.scale = shape->GetMoppScale();
+	return mopp;
+}
+
+//A query against MOPP code, either a box or a segment, in MOPP space
+struct MoppQuery {
+	bool ray;
+	Vector3 min;
+	Vector3 max;
+	Vector3 start;
+	Vector3 delta;
+};
+
+//One pending branch of the walk.  The segment part of a ray query is
+//clipped to [t0, t1] by the planes passed on the way down.
+struct MoppBranch {
+	size_t pc;
+	unsigned int offset;
+	bool loose;
+	float t0;
+	float t1;
+};
+
+//Narrows a branch to the slab lo <= c < hi along one axis.  Returns false if
+//the query misses the slab.
+static bool ClipSlab( const MoppQuery & q, MoppBranch & b, int axis, float lo, float hi ) {
+	if ( b.loose ) {
+		return true;
+	}
+	//Allow for rounding in the code generator
+	lo -= 1.0f;
+	hi += 1.0f;
+	if ( !q.ray ) {
+		return Axis( q.max, axis ) >= lo && Axis( q.min, axis ) <= hi;
+	}
+	float s = Axis( q.start, axis );
+	float d = Axis( q.delta, axis );
+	if ( d == 0.0f ) {
+		return s >= lo && s <= hi;
+	}
+	float ta = ( lo - s ) / d;
+	float tb = ( hi - s ) / d;
+	if ( ta > tb ) {
+		swap( ta, tb );
+	}
+	b.t0 = max( b.t0, ta );
+	b.t1 = min( b.t1, tb );
+	return b.t0 <= b.t1;
+}
+
+static inline unsigned int ReadShort( const vector<byte> & code, size_t pc ) {
+	return ( (unsigned int)(code[pc]) << 8 ) | code[pc + 1];
+}
+
+static void RunMopp( const MoppCode & mopp, const MoppQuery & q, vector<unsigned int> & triangles ) {
+	triangles.clear();
+	const vector<byte> & code = mopp.code;
+	if ( code.empty() ) {
+		return;
+	}
+
+	vector<MoppBranch> stack;
+	MoppBranch start = { 0, 0, false, 0.0f, 1.0f };
+	stack.push_back( start );
+	while ( !stack.empty() ) {
+		MoppBranch b = stack.back();
+		stack.pop_back();
+		while ( true ) {
+			if ( b.pc >= code.size() ) {
+				throw runtime_error("MOPP code is truncated.");
+			}
+			unsigned int op = code[b.pc];
+			//Number of bytes taken by the opcode and its arguments
+			size_t len = 1;
+			if ( ( op >= 0x01 && op <= 0x04 ) || ( op >= 0x10 && op <= 0x1C ) ) {
+				len = 4;
+			} else if ( op == 0x05 || op == 0x09 || op == 0x50 ) {
+				len = 2;
+			} else if ( op == 0x06 || op == 0x0A || op == 0x51 || ( op >= 0x20 && op <= 0x22 ) || ( op >= 0x26 && op <= 0x28 ) ) {
+				len = 3;
+			} else if ( op == 0x52 ) {
+				len = 4;
+			} else if ( op == 0x0B || op == 0x53 ) {
+				len = 5;
+			} else if ( op >= 0x23 && op <= 0x25 ) {
+				len = 7;
+			} else if ( op < 0x30 || op > 0x4F ) {
+				throw runtime_error("Unknown MOPP opcode.");
+			}
+			if ( b.pc + len > code.size() ) {
+				throw runtime_error("MOPP code is truncated.");
+			}
+			const byte * arg = &code[b.pc + 1];
+
+			if ( op >= 0x30 && op <= 0x4F ) {
+				triangles.push_back( b.offset + op - 0x30 );
+				break;
+			} else if ( op == 0x50 ) {
+				triangles.push_back( b.offset + arg[0] );
+				break;
+			} else if ( op == 0x51 ) {
+				triangles.push_back( b.offset + ReadShort( code, b.pc + 1 ) );
+				break;
+			} else if ( op == 0x52 ) {
+				triangles.push_back( b.offset + ( (unsigned int)(arg[0]) << 16 | (unsigned int)(arg[1]) << 8 | arg[2] ) );
+				break;
+			} else if ( op == 0x53 ) {
+				triangles.push_back( b.offset + ( ReadShort( code, b.pc + 1 ) << 16 ) + ReadShort( code, b.pc + 3 ) );
+				break;
+			} else if ( op >= 0x01 && op <= 0x04 ) {
+				//Rescales the space for the code below, follow everything
+				b.loose = true;
+				b.pc += len;
+			} else if ( op == 0x05 ) {
+				b.pc += len + arg[0];
+			} else if ( op == 0x06 ) {
+				b.pc += len + ReadShort( code, b.pc + 1 );
+			} else if ( op == 0x09 ) {
+				b.offset += arg[0];
+				b.pc += len;
+			} else if ( op == 0x0A ) {
+				b.offset += ReadShort( code, b.pc + 1 );
+				b.pc += len;
+			} else if ( op == 0x0B ) {
+				b.offset = ( ReadShort( code, b.pc + 1 ) << 16 ) + ReadShort( code, b.pc + 3 );
+				b.pc += len;
+			} else if ( op >= 0x26 && op <= 0x28 ) {
+				if ( !ClipSlab( q, b, op - 0x26, arg[0] * MOPP_BYTE, ( arg[1] + 1 ) * MOPP_BYTE ) ) {
+					break;
+				}
+				b.pc += len;
+			} else {
+				//A split into a lower and an upper branch
+				int axis = 0;
+				float below = 0.0f, above = 0.0f;
+				size_t lower_pc = 0, upper_pc = 0;
+				bool diagonal = false;
+				if ( op >= 0x10 && op <= 0x1C ) {
+					diagonal = op > 0x12;
+					axis = diagonal ? 0 : op - 0x10;
+					below = ( arg[0] + 1 ) * MOPP_BYTE;
+					above = arg[1] * MOPP_BYTE;
+					lower_pc = b.pc + len;
+					upper_pc = b.pc + len + arg[2];
+				} else if ( op >= 0x20 && op <= 0x22 ) {
+					axis = op - 0x20;
+					below = ( arg[0] + 1 ) * MOPP_BYTE;
+					above = arg[0] * MOPP_BYTE;
+					lower_pc = b.pc + len;
+					upper_pc = b.pc + len + arg[1];
+				} else {
+					axis = op - 0x23;
+					below = ( arg[0] + 1 ) * MOPP_BYTE;
+					above = arg[1] * MOPP_BYTE;
+					lower_pc = b.pc + len + ReadShort( code, b.pc + 3 );
+					upper_pc = b.pc + len + ReadShort( code, b.pc + 5 );
+				}
+				MoppBranch lower = b, upper = b;
+				lower.pc = lower_pc;
+				upper.pc = upper_pc;
+				if ( diagonal ) {
+					lower.loose = upper.loose = true;
+				}
+				bool take_lower = ClipSlab( q, lower, axis, -MOPP_BYTE, below );
+				bool take_upper = ClipSlab( q, upper, axis, above, 256.0f * MOPP_BYTE );
+				if ( take_upper ) {
+					stack.push_back( upper );
+				}
+				if ( !take_lower ) {
+					break;
+				}
+				b = lower;
+			}
+		}
+	}
+
+	//Hand written code may reach a triangle along more than one path
+	sort( triangles.begin(), triangles.end() );
+	triangles.erase( unique( triangles.begin(), triangles.end() ), triangles.end() );
+}
+
+void QueryMoppAabb( const MoppCode & mopp, const Vector3 & box_min, const Vector3 & box_max, vector<unsigned int> & triangles ) {
+	MoppQuery q;
+	q.ray = false;
+	q.min = ( box_min - mopp.origin ) * mopp.scale;
+	q.max = ( box_max - mopp.origin ) * mopp.scale;
+	RunMopp( mopp, q, triangles );
+}
+
+void QueryMoppRay( const MoppCode & mopp, const Vector3 & from, const Vector3 & to, vector<unsigned int> & triangles ) {
+	MoppQuery q;
+	q.ray = true;
+	q.start = ( from - mopp.origin ) * mopp.scale;
+	q.delta = ( to - from ) * mopp.scale;
+	RunMopp( mopp, q, triangles );
+}
+
+int RayCastMopp( const MoppCode & mopp, const vector<Vector3> & vertices, const vector<Triangle> & triangles, const Vector3 & from, const Vector3 & to, float & fraction ) {
+	vector<unsigned int> candidates;
+	QueryMoppRay( mopp, from, to, candidates );
+
+	int best = -1;
+	fraction = 1.0f;
+	Vector3 dir = to - from;
+	for ( size_t i = 0; i < candidates.size(); ++i ) {
+		unsigned int id = candidates[i];
+		if ( id >= triangles.size() ) {
+			continue;
+		}
+		const Triangle & tri = triangles[id];
+		if ( tri.v1 >= vertices.size() || tri.v2 >= vertices.size() || tri.v3 >= vertices.size() ) {
+			continue;
+		}
+		//Moller-Trumbore, hitting either side of the triangle
+		Vector3 e1 = vertices[tri.v2] - vertices[tri.v1];
+		Vector3 e2 = vertices[tri.v3] - vertices[tri.v1];
+		Vector3 p = dir.CrossProduct( e2 );
+		float det = e1.DotProduct( p );
+		if ( fabs( det ) < 1e-12f ) {
+			continue;
+		}
+		float inv = 1.0f / det;
+		Vector3 s = from - vertices[tri.v1];
+		float u = s.DotProduct( p ) * inv;
+		if ( u < 0.0f || u > 1.0f ) {
+			continue;
+		}
+		Vector3 qv = s.CrossProduct( e1 );
+		float v = dir.DotProduct( qv ) * inv;
+		if ( v < 0.0f || u + v > 1.0f ) {
+			continue;
+		}
+		float t = e2.DotProduct( qv ) * inv;
+		if ( t >= 0.0f && t <= fraction ) {
+			fraction = t;
+			best = int( id );
+		}
+	}
+	return best;
+}
+
+} //End Niflib namespace
@@ -0,0 +1,169 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/MorphEvaluator.h"
+#include "../include/obj/NiMorphData.h"
+#include "../include/obj/NiObjectNET.h"
+#include "../include/obj/NiGeomMorpherController.h"
+#include "../include/obj/NiFloatInterpolator.h"
+#include "../include/obj/NiFloatData.h"
+#include "NifSimd.h"
+#include <stdexcept>
+
+namespace Niflib {
+
+//Gamebryo marks an unset interpolator value with -FLT_MAX
+static const float INVALID_VALUE = -3.0e38f;
+
+static const float DEFAULT_THRESHOLD = 0.0001f;
+
+MorphEvaluator::MorphEvaluator( NiMorphData * data ) {
+	Init( data, NULL );
+}
+
+MorphEvaluator::MorphEvaluator( NiGeomMorpherController * ctrl ) {
+	if ( ctrl == NULL ) {
+		throw runtime_error("Attempted to create a morph evaluator from a NULL controller.");
+	}
+	Init( ctrl->GetData(), ctrl );
+}
+
+MorphEvaluator::~MorphEvaluator() {}
+
+void MorphEvaluator::Init( NiMorphData * data, NiGeomMorpherController * ctrl ) {
+	if ( data == NULL ) {
+		throw runtime_error("Attempted to create a morph evaluator without morph data.");
+	}
+
+	numVertices = (unsigned int)data->GetVertexCount();
+	paddedVertices = SimdPadCount( numVertices );
+	relative = data->GetRelativeTargets();
+	threshold = DEFAULT_THRESHOLD;
+
+	unsigned int num_morphs = (unsigned int)data->GetMorphCount();
+
+	//Copy every target into its own padded block.  The padding stays zero so
+	//the accumulation loop never needs a scalar tail.
+	dx.assign( num_morphs * paddedVertices, 0.0f );
+	dy.assign( num_morphs * paddedVertices, 0.0f );
+	dz.assign( num_morphs * paddedVertices, 0.0f );
+	for ( unsigned int m = 0; m < num_morphs; ++m ) {
+		vector<Vector3> verts = data->GetMorphVerts( m );
+		if ( verts.size() < numVertices ) {
+			throw runtime_error("Morph target has fewer vertices than the morph data vertex count.");
+		}
+		float * px = &dx[m * paddedVertices];
+		float * py = &dy[m * paddedVertices];
+		float * pz = &dz[m * paddedVertices];
+		for ( unsigned int v = 0; v < numVertices; ++v ) {
+			px[v] = verts[v].x;
+			py[v] = verts[v].y;
+			pz[v] = verts[v].z;
+		}
+	}
+
+	vector< Ref<NiInterpolator> > interps;
+	if ( ctrl != NULL ) {
+		interps = ctrl->GetInterpolators();
+	}
+
+	channels.resize( num_morphs );
+	for ( unsigned int m = 0; m < num_morphs; ++m ) {
+		WeightChannel & ch = channels[m];
+		ch.constant = 0.0f;
+		ch.type = data->GetMorphKeyType( m );
+		ch.keys = data->GetMorphKeys( m );
+
+		//Newer files keep the weights in float interpolators instead of the
+		//morph data
+		if ( m < interps.size() ) {
+			NiFloatInterpolatorRef fi = DynamicCast<NiFloatInterpolator>( interps[m] );
+			if ( fi != NULL ) {
+				NiFloatDataRef fd = fi->GetData();
+				if ( fd != NULL ) {
+					ch.type = fd->GetKeyType();
+					ch.keys = fd->GetKeys();
+				} else if ( fi->GetFloatValue() > INVALID_VALUE ) {
+					ch.keys.clear();
+					ch.constant = fi->GetFloatValue();
+				}
+			}
+		}
+	}
+
+	ax.resize( paddedVertices );
+	ay.resize( paddedVertices );
+	az.resize( paddedVertices );
+}
+
+unsigned int MorphEvaluator::GetVertexCount() const {
+	return numVertices;
+}
+
+unsigned int MorphEvaluator::GetMorphCount() const {
+	return (unsigned int)channels.size();
+}
+
+void MorphEvaluator::SetWeightThreshold( float n ) {
+	threshold = n;
+}
+
+void MorphEvaluator::SampleWeights( float time, vector<float> & weights ) const {
+	weights.resize( channels.size() );
+	for ( size_t m = 0; m < channels.size(); ++m ) {
+		const WeightChannel & ch = channels[m];
+		weights[m] = InterpolateKeys( ch.keys, ch.type, time, ch.constant );
+	}
+	//The first target of relative morph data is the base shape
+	if ( relative && !weights.empty() ) {
+		weights[0] = 1.0f;
+	}
+}
+
+void MorphEvaluator::Evaluate( const vector<float> & weights, vector<Vector3> & out ) const {
+	out.resize( numVertices );
+	if ( numVertices == 0 ) {
+		return;
+	}
+
+	simd4f zero = SimdZero();
+	for ( unsigned int v = 0; v < paddedVertices; v += SIMD_WIDTH ) {
+		SimdStore( &ax[v], zero );
+		SimdStore( &ay[v], zero );
+		SimdStore( &az[v], zero );
+	}
+
+	unsigned int num_morphs = (unsigned int)channels.size();
+	for ( unsigned int m = 0; m < num_morphs; ++m ) {
+		float w = m < weights.size() ? weights[m] : 0.0f;
+		if ( relative && m == 0 ) {
+			w = 1.0f;
+		}
+		if ( w < threshold && w > -threshold ) {
+			continue;
+		}
+
+		simd4f sw = SimdSplat( w );
+		const float * px = &dx[m * paddedVertices];
+		const float * py = &dy[m * paddedVertices];
+		const float * pz = &dz[m * paddedVertices];
+		for ( unsigned int v = 0; v < paddedVertices; v += SIMD_WIDTH ) {
+			SimdStore( &ax[v], SimdMadd( sw, SimdLoad( px + v ), SimdLoad( &ax[v] ) ) );
+			SimdStore( &ay[v], SimdMadd( sw, SimdLoad( py + v ), SimdLoad( &ay[v] ) ) );
+			SimdStore( &az[v], SimdMadd( sw, SimdLoad( pz + v ), SimdLoad( &az[v] ) ) );
+		}
+	}
+
+	for ( unsigned int v = 0; v < numVertices; ++v ) {
+		out[v].x = ax[v];
+		out[v].y = ay[v];
+		out[v].z = az[v];
+	}
+}
+
+void MorphEvaluator::Evaluate( float time, vector<Vector3> & out ) const {
+	SampleWeights( time, scratchWeights );
+	Evaluate( scratchWeights, out );
+}
+
+} //End Niflib namespace
@@ -0,0 +1,238 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/NifDocument.h"
+#include "../include/NIF_IO.h"
+#include "../include/ObjectRegistry.h"
+#include "../include/obj/NiObject.h"
+#include "../include/gen/Footer.h"
+#include <sstream>
+#include <stdexcept>
+#include <map>
+#include <set>
+
+namespace Niflib {
+
+void EnsureObjectsRegistered();
+
+NifDocument::NifDocument( const string & file_name ) : materialized_count(0) {
+	EnsureObjectsRegistered();
+
+	in.open( file_name.c_str(), ifstream::binary );
+	if ( !in ) {
+		throw runtime_error( "Could not open " + file_name + " for reading." );
+	}
+
+	//Blocks are read with the header set on the stream, so that strings
+	//stored in the header can be found
+	hdrInfo hinfo( &header );
+	in >> hinfo;
+	info = header.Read( in );
+	if ( header.version < VER_3_3_0_13 ) {
+		throw runtime_error( "Files older than version 3.3.0.13 cannot be read one block at a time." );
+	}
+
+	unsigned int count = header.numBlocks;
+	offsets.resize( count );
+	block_types.resize( count );
+	blocks.resize( count );
+	materialized.resize( count, false );
+
+	if ( header.version >= VER_20_2_0_7 ) {
+		//The header has the type and size of every block
+		type_names = header.blockTypes;
+		streampos pos = in.tellg();
+		for ( unsigned int i = 0; i < count; ++i ) {
+			block_types[i] = header.blockTypeIndex[i];
+			offsets[i] = pos;
+			pos += header.blockSize[i];
+		}
+		in.seekg( pos );
+	} else {
+		//Skim through the blocks once to find where each starts.  The objects
+		//read are thrown away straight away.
+		map<string, unsigned int> type_map;
+		for ( unsigned int i = 0; i < count; ++i ) {
+			string type;
+			if ( header.version >= 0x05000001 ) {
+				if ( header.version <= VER_10_1_0_106 && ReadUInt( in ) != 0 ) {
+					stringstream err;
+					err << "Invalid check value before block " << i << " of " << file_name << ".";
+					throw runtime_error( err.str() );
+				}
+				type = header.blockTypes[ header.blockTypeIndex[i] ];
+			} else {
+				unsigned int length = ReadUInt( in );
+				if ( length > 30 || length < 6 ) {
+					stringstream err;
+					err << "Invalid type name length before block " << i << " of " << file_name << ".";
+					throw runtime_error( err.str() );
+				}
+				type.resize( length );
+				in.read( &type[0], length );
+			}
+			map<string, unsigned int>::iterator it = type_map.find( type );
+			if ( it == type_map.end() ) {
+				it = type_map.insert( make_pair( type, (unsigned int)type_names.size() ) ).first;
+				type_names.push_back( type );
+			}
+			block_types[i] = it->second;
+			offsets[i] = in.tellg();
+
+			NiObjectRef obj = ObjectRegistry::CreateObject( type );
+			if ( obj == NULL ) {
+				throw runtime_error( "Unknown object type encountered during file read:  " + type );
+			}
+			list<unsigned int> link_stack;
+			obj->Read( in, link_stack, info );
+			if ( in.fail() ) {
+				throw runtime_error( "End of file reached prematurely in " + file_name + "." );
+			}
+		}
+	}
+
+	//The footer lists the roots
+	Footer footer;
+	list<unsigned int> link_stack;
+	footer.Read( in, link_stack, info );
+	if ( !in.fail() ) {
+		roots.assign( link_stack.begin(), link_stack.end() );
+	}
+	in.clear();
+}
+
+NifDocument::~NifDocument() {}
+
+const NifInfo & NifDocument::GetInfo() const {
+	return info;
+}
+
+const Header & NifDocument::GetHeader() const {
+	return header;
+}
+
+unsigned int NifDocument::GetBlockCount() const {
+	return (unsigned int)blocks.size();
+}
+
+string NifDocument::GetBlockType( unsigned int index ) const {
+	if ( index >= blocks.size() ) {
+		throw runtime_error( "Block index is out of range." );
+	}
+	return type_names[ block_types[index] ];
+}
+
+NiObjectRef NifDocument::GetBlock( unsigned int index ) {
+	if ( index >= blocks.size() ) {
+		throw runtime_error( "Block index is out of range." );
+	}
+	if ( !materialized[index] ) {
+		ReadBlock( index );
+	}
+	return blocks[index];
+}
+
+NiObjectRef NifDocument::GetRoot() {
+	for ( size_t i = 0; i < roots.size(); ++i ) {
+		if ( roots[i] < blocks.size() ) {
+			return GetBlock( roots[i] );
+		}
+	}
+	if ( blocks.empty() ) {
+		return NULL;
+	}
+	return GetBlock( 0 );
+}
+
+void NifDocument::Materialize( NiObject * obj ) {
+	if ( obj == NULL || !obj->IsPlaceholder() ) {
+		return;
+	}
+	unsigned int index = (unsigned int)obj->internal_block_number;
+	if ( index >= blocks.size() || blocks[index] != obj ) {
+		throw runtime_error( "The placeholder does not belong to this document." );
+	}
+	ReadBlock( index );
+}
+
+void NifDocument::MaterializeTree( NiObject * root ) {
+	if ( root == NULL ) {
+		return;
+	}
+	vector<NiObject *> stack( 1, root );
+	set<NiObject *> seen;
+	seen.insert( root );
+	while ( !stack.empty() ) {
+		NiObject * obj = stack.back();
+		stack.pop_back();
+		Materialize( obj );
+		list<NiObjectRef> refs = obj->GetRefs();
+		for ( list<NiObjectRef>::iterator it = refs.begin(); it != refs.end(); ++it ) {
+			if ( *it != NULL && seen.insert( *it ).second ) {
+				stack.push_back( *it );
+			}
+		}
+	}
+}
+
+void NifDocument::MaterializeAll() {
+	for ( unsigned int i = 0; i < blocks.size(); ++i ) {
+		if ( !materialized[i] ) {
+			ReadBlock( i );
+		}
+	}
+}
+
+unsigned int NifDocument::GetMaterializedCount() const {
+	return materialized_count;
+}
+
+const ObjectArena & NifDocument::GetArena() const {
+	return arena;
+}
+
+NiObject * NifDocument::GetPlaceholder( unsigned int index ) {
+	if ( blocks[index] == NULL ) {
+		const string & type = type_names[ block_types[index] ];
+		ObjectArena::Scope scope( arena );
+		NiObject * obj = ObjectRegistry::CreateObject( type );
+		if ( obj == NULL ) {
+			throw runtime_error( "Unknown object type encountered during file read:  " + type );
+		}
+		obj->placeholder = true;
+		obj->internal_block_number = index;
+		blocks[index] = obj;
+	}
+	return blocks[index];
+}
+
+void NifDocument::ReadBlock( unsigned int index ) {
+	NiObject * obj = GetPlaceholder( index );
+
+	//Read the block into its placeholder, so that links fixed earlier see it
+	list<unsigned int> link_stack;
+	in.clear();
+	in.seekg( offsets[index] );
+	obj->Read( in, link_stack, info );
+	if ( in.fail() ) {
+		in.clear();
+		stringstream err;
+		err << "End of file reached prematurely while reading block " << index << ", a " << GetBlockType( index ) << ".";
+		throw runtime_error( err.str() );
+	}
+	obj->placeholder = false;
+	materialized[index] = true;
+	++materialized_count;
+
+	//Only the blocks this one links to are needed to fix its links
+	map<unsigned int, NiObjectRef> objects;
+	for ( list<unsigned int>::iterator it = link_stack.begin(); it != link_stack.end(); ++it ) {
+		if ( *it < blocks.size() ) {
+			objects[*it] = GetPlaceholder( *it );
+		}
+	}
+	list<NiObjectRef> missing_link_stack;
+	obj->FixLinks( objects, link_stack, missing_link_stack, info );
+}
+
+} //End Niflib namespace
@@ -0,0 +1,96 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _NIF_PARALLEL_H_
+#define _NIF_PARALLEL_H_
+
+// Internal helper for splitting independent work across threads.  Object
+// reference counts are not thread safe, so the work done by the function
+// passed to ParallelFor must not create or destroy Ref objects that point
+// to NIF objects shared with other threads.  Resolve everything that needs
+// a Ref on the calling thread first and hand plain pointers to the workers.
+
+#include <thread>
+#include <vector>
+#include <exception>
+
+namespace Niflib {
+
+/*!
+ * Picks the number of threads to use for a job.
+ * \param[in] requested The number of threads asked for by the caller, or
+ * zero to use one thread per hardware thread.
+ * \param[in] count The number of work items, no more threads than this are
+ * used.
+ */
+inline unsigned int ParallelThreadCount( unsigned int requested, size_t count ) {
+	unsigned int n = requested;
+	if ( n == 0 ) {
+		n = std::thread::hardware_concurrency();
+		if ( n == 0 ) {
+			n = 1;
+		}
+	}
+	if ( count < n ) {
+		n = (unsigned int)count;
+	}
+	return n > 0 ? n : 1;
+}
+
+/*!
+ * Calls func( begin, end ) on contiguous ranges that together cover
+ * [0, count), each range on its own thread.  The first exception thrown by
+ * any range is rethrown on the calling thread once all threads are done.
+ * \param[in] count The number of work items.
+ * \param[in] num_threads The number of threads to use, zero for one per
+ * hardware thread.
+ * \param[in] func The function to call for each range.
+ */
+template <class Func>
+void ParallelFor( size_t count, unsigned int num_threads, Func func ) {
+	unsigned int n = ParallelThreadCount( num_threads, count );
+	if ( n <= 1 ) {
+		if ( count > 0 ) {
+			func( size_t(0), count );
+		}
+		return;
+	}
+
+	std::vector<std::exception_ptr> errors( n );
+	std::vector<std::thread> threads;
+	threads.reserve( n - 1 );
+	size_t chunk = ( count + n - 1 ) / n;
+	for ( unsigned int t = 1; t < n; ++t ) {
+		size_t begin = t * chunk;
+		size_t end = begin + chunk < count ? begin + chunk : count;
+		if ( begin >= end ) {
+			break;
+		}
+		threads.push_back( std::thread( [&func, &errors, t, begin, end]() {
+			try {
+				func( begin, end );
+			} catch ( ... ) {
+				errors[t] = std::current_exception();
+			}
+		} ) );
+	}
+
+	//The calling thread takes the first range
+	try {
+		func( size_t(0), chunk < count ? chunk : count );
+	} catch ( ... ) {
+		errors[0] = std::current_exception();
+	}
+
+	for ( size_t t = 0; t < threads.size(); ++t ) {
+		threads[t].join();
+	}
+	for ( size_t t = 0; t < errors.size(); ++t ) {
+		if ( errors[t] ) {
+			std::rethrow_exception( errors[t] );
+		}
+	}
+}
+
+} //End Niflib namespace
+#endif
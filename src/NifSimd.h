@@ -0,0 +1,248 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#ifndef _NIF_SIMD_H_
+#define _NIF_SIMD_H_
+
+// Internal helpers for four-wide float arithmetic.  When the compiler
+// targets SSE2 the functions map straight onto intrinsics, otherwise a
+// plain scalar implementation with identical results is used.  Callers
+// lay their data out as structure-of-arrays padded to a multiple of four
+// so that every loop can run four lanes at a time without a scalar tail.
+// The half precision conversions work on the 16 bit float format used by
+// compressed vertex arrays, and the byte conversions on RGBA pixels.
+
+#if !defined(NIFLIB_NO_SIMD) && ( defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) )
+#  define NIFLIB_SIMD_SSE2
+#  include <emmintrin.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+namespace Niflib {
+
+/*! Number of float lanes processed by one simd4f operation. */
+const unsigned int SIMD_WIDTH = 4;
+
+/*! Rounds a count up to the next multiple of SIMD_WIDTH. */
+inline unsigned int SimdPadCount( unsigned int n ) {
+	return ( n + SIMD_WIDTH - 1 ) & ~( SIMD_WIDTH - 1 );
+}
+
+#ifdef NIFLIB_SIMD_SSE2
+
+typedef __m128 simd4f;
+
+inline simd4f SimdLoad( const float * p ) { return _mm_loadu_ps( p ); }
+inline void SimdStore( float * p, simd4f a ) { _mm_storeu_ps( p, a ); }
+inline simd4f SimdSplat( float f ) { return _mm_set1_ps( f ); }
+inline simd4f SimdZero() { return _mm_setzero_ps(); }
+inline simd4f SimdAdd( simd4f a, simd4f b ) { return _mm_add_ps( a, b ); }
+inline simd4f SimdSub( simd4f a, simd4f b ) { return _mm_sub_ps( a, b ); }
+inline simd4f SimdMul( simd4f a, simd4f b ) { return _mm_mul_ps( a, b ); }
+inline simd4f SimdDiv( simd4f a, simd4f b ) { return _mm_div_ps( a, b ); }
+inline simd4f SimdMin( simd4f a, simd4f b ) { return _mm_min_ps( a, b ); }
+inline simd4f SimdMax( simd4f a, simd4f b ) { return _mm_max_ps( a, b ); }
+inline simd4f SimdSqrt( simd4f a ) { return _mm_sqrt_ps( a ); }
+inline simd4f SimdAbs( simd4f a ) { return _mm_andnot_ps( _mm_set1_ps( -0.0f ), a ); }
+/*! Multiply-add: a * b + c */
+inline simd4f SimdMadd( simd4f a, simd4f b, simd4f c ) { return _mm_add_ps( _mm_mul_ps( a, b ), c ); }
+/*! Lane mask of a < b */
+inline simd4f SimdLess( simd4f a, simd4f b ) { return _mm_cmplt_ps( a, b ); }
+/*! Lane mask of a > b */
+inline simd4f SimdGreater( simd4f a, simd4f b ) { return _mm_cmpgt_ps( a, b ); }
+/*! Per lane mask ? a : b */
+inline simd4f SimdSelect( simd4f mask, simd4f a, simd4f b ) {
+	return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+}
+/*! Returns -a in the lanes where mask is set and a elsewhere. */
+inline simd4f SimdNegateIf( simd4f mask, simd4f a ) {
+	return _mm_xor_ps( a, _mm_and_ps( mask, _mm_set1_ps( -0.0f ) ) );
+}
+/*! Non-zero if any lane of the mask is set. */
+inline int SimdAnyTrue( simd4f mask ) { return _mm_movemask_ps( mask ); }
+
+/*! Converts four half precision floats to single precision. */
+inline void SimdHalfToFloat( const unsigned short * in, float * out ) {
+	__m128i h = _mm_unpacklo_epi16( _mm_loadl_epi64( (const __m128i *)in ), _mm_setzero_si128() );
+	__m128i expmant = _mm_and_si128( h, _mm_set1_epi32( 0x7fff ) );
+	__m128i sign = _mm_slli_epi32( _mm_xor_si128( h, expmant ), 16 );
+	//Moving the bits into place and scaling by 2^112 rebiases the exponent and handles denormals
+	__m128 scaled = _mm_mul_ps( _mm_castsi128_ps( _mm_slli_epi32( expmant, 13 ) ), _mm_castsi128_ps( _mm_set1_epi32( ( 254 - 15 ) << 23 ) ) );
+	__m128i infnan = _mm_and_si128( _mm_cmpgt_epi32( expmant, _mm_set1_epi32( 0x7bff ) ), _mm_set1_epi32( 255 << 23 ) );
+	_mm_storeu_ps( out, _mm_or_ps( scaled, _mm_castsi128_ps( _mm_or_si128( sign, infnan ) ) ) );
+}
+
+/*! Converts four single precision floats to half precision, rounding to nearest even. */
+inline void SimdFloatToHalf( const float * in, unsigned short * out ) {
+	__m128i f = _mm_castps_si128( _mm_loadu_ps( in ) );
+	__m128i sign = _mm_and_si128( f, _mm_set1_epi32( (int)0x80000000 ) );
+	f = _mm_xor_si128( f, sign );
+	//Too large for a half: infinity, or a quiet NaN
+	__m128i big = _mm_cmpgt_epi32( f, _mm_set1_epi32( ( ( 127 + 16 ) << 23 ) - 1 ) );
+	__m128i nan = _mm_cmpgt_epi32( f, _mm_set1_epi32( 255 << 23 ) );
+	__m128i special = _mm_or_si128( _mm_set1_epi32( 0x7c00 ), _mm_and_si128( nan, _mm_set1_epi32( 0x200 ) ) );
+	//Denormal results: adding a magic number lets the float unit round off the low bits
+	__m128i small = _mm_cmpgt_epi32( _mm_set1_epi32( 113 << 23 ), f );
+	__m128 magic = _mm_castsi128_ps( _mm_set1_epi32( ( ( 127 - 15 ) + ( 23 - 10 ) + 1 ) << 23 ) );
+	__m128i denorm = _mm_sub_epi32( _mm_castps_si128( _mm_add_ps( _mm_castsi128_ps( f ), magic ) ), _mm_castps_si128( magic ) );
+	//Normal results: rebias the exponent and round to even by hand
+	__m128i odd = _mm_and_si128( _mm_srli_epi32( f, 13 ), _mm_set1_epi32( 1 ) );
+	__m128i normal = _mm_srli_epi32( _mm_add_epi32( _mm_add_epi32( f, _mm_set1_epi32( 0xfff - ( 112 << 23 ) ) ), odd ), 13 );
+	__m128i h = _mm_or_si128( _mm_and_si128( small, denorm ), _mm_andnot_si128( small, normal ) );
+	h = _mm_or_si128( _mm_and_si128( big, special ), _mm_andnot_si128( big, h ) );
+	h = _mm_or_si128( h, _mm_srli_epi32( sign, 16 ) );
+	//Narrow to 16 bits through a signed pack, which cannot saturate once offset
+	__m128i packed = _mm_packs_epi32( _mm_sub_epi32( h, _mm_set1_epi32( 0x8000 ) ), _mm_setzero_si128() );
+	_mm_storel_epi64( (__m128i *)out, _mm_xor_si128( packed, _mm_set1_epi16( (short)0x8000 ) ) );
+}
+
+/*! Loads four bytes into the four lanes. */
+inline simd4f SimdLoadBytes( const unsigned char * p ) {
+	int bits;
+	memcpy( &bits, p, 4 );
+	__m128i zero = _mm_setzero_si128();
+	__m128i v = _mm_unpacklo_epi8( _mm_cvtsi32_si128( bits ), zero );
+	return _mm_cvtepi32_ps( _mm_unpacklo_epi16( v, zero ) );
+}
+
+/*! Rounds the four lanes to nearest even and stores them as bytes, clamped to 0 to 255. */
+inline void SimdStoreBytes( unsigned char * p, simd4f a ) {
+	__m128i v = _mm_cvtps_epi32( a );
+	v = _mm_packus_epi16( _mm_packs_epi32( v, v ), v );
+	int bits = _mm_cvtsi128_si32( v );
+	memcpy( p, &bits, 4 );
+}
+
+#else
+
+struct simd4f {
+	float v[4];
+};
+
+inline simd4f SimdLoad( const float * p ) { simd4f r; for ( int i = 0; i < 4; ++i ) r.v[i] = p[i]; return r; }
+inline void SimdStore( float * p, simd4f a ) { for ( int i = 0; i < 4; ++i ) p[i] = a.v[i]; }
+inline simd4f SimdSplat( float f ) { simd4f r; for ( int i = 0; i < 4; ++i ) r.v[i] = f; return r; }
+inline simd4f SimdZero() { return SimdSplat( 0.0f ); }
+inline simd4f SimdAdd( simd4f a, simd4f b ) { for ( int i = 0; i < 4; ++i ) a.v[i] += b.v[i]; return a; }
+inline simd4f SimdSub( simd4f a, simd4f b ) { for ( int i = 0; i < 4; ++i ) a.v[i] -= b.v[i]; return a; }
+inline simd4f SimdMul( simd4f a, simd4f b ) { for ( int i = 0; i < 4; ++i ) a.v[i] *= b.v[i]; return a; }
+inline simd4f SimdDiv( simd4f a, simd4f b ) { for ( int i = 0; i < 4; ++i ) a.v[i] /= b.v[i]; return a; }
+inline simd4f SimdMin( simd4f a, simd4f b ) { for ( int i = 0; i < 4; ++i ) a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline simd4f SimdMax( simd4f a, simd4f b ) { for ( int i = 0; i < 4; ++i ) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline simd4f SimdSqrt( simd4f a ) { for ( int i = 0; i < 4; ++i ) a.v[i] = sqrtf( a.v[i] ); return a; }
+inline simd4f SimdAbs( simd4f a ) { for ( int i = 0; i < 4; ++i ) a.v[i] = fabsf( a.v[i] ); return a; }
+inline simd4f SimdMadd( simd4f a, simd4f b, simd4f c ) { for ( int i = 0; i < 4; ++i ) a.v[i] = a.v[i] * b.v[i] + c.v[i]; return a; }
+// Masks use 1.0f for true and 0.0f for false in the scalar build
+inline simd4f SimdLess( simd4f a, simd4f b ) { for ( int i = 0; i < 4; ++i ) a.v[i] = a.v[i] < b.v[i] ? 1.0f : 0.0f; return a; }
+inline simd4f SimdGreater( simd4f a, simd4f b ) { for ( int i = 0; i < 4; ++i ) a.v[i] = a.v[i] > b.v[i] ? 1.0f : 0.0f; return a; }
+inline simd4f SimdSelect( simd4f mask, simd4f a, simd4f b ) { for ( int i = 0; i < 4; ++i ) a.v[i] = mask.v[i] != 0.0f ? a.v[i] : b.v[i]; return a; }
+inline simd4f SimdNegateIf( simd4f mask, simd4f a ) { for ( int i = 0; i < 4; ++i ) a.v[i] = mask.v[i] != 0.0f ? -a.v[i] : a.v[i]; return a; }
+inline int SimdAnyTrue( simd4f mask ) { return mask.v[0] != 0.0f || mask.v[1] != 0.0f || mask.v[2] != 0.0f || mask.v[3] != 0.0f; }
+
+inline simd4f SimdLoadBytes( const unsigned char * p ) { simd4f r; for ( int i = 0; i < 4; ++i ) r.v[i] = float( p[i] ); return r; }
+inline void SimdStoreBytes( unsigned char * p, simd4f a ) {
+	for ( int i = 0; i < 4; ++i ) {
+		float f = a.v[i] < 0.0f ? 0.0f : ( a.v[i] > 255.0f ? 255.0f : a.v[i] );
+		float whole = floorf( f );
+		float rest = f - whole;
+		int n = int( whole );
+		if ( rest > 0.5f || ( rest == 0.5f && ( n & 1 ) ) ) {
+			++n;
+		}
+		p[i] = (unsigned char)n;
+	}
+}
+
+inline void SimdHalfToFloat( const unsigned short * in, float * out ) {
+	for ( int i = 0; i < 4; ++i ) {
+		unsigned int expmant = in[i] & 0x7fffu;
+		unsigned int bits = expmant << 13;
+		float scaled;
+		memcpy( &scaled, &bits, 4 );
+		scaled *= 5.192296858534828e+33f; //2^112
+		memcpy( &bits, &scaled, 4 );
+		if ( expmant > 0x7bffu ) {
+			bits |= 255u << 23;
+		}
+		bits |= (unsigned int)( in[i] & 0x8000u ) << 16;
+		memcpy( &out[i], &bits, 4 );
+	}
+}
+
+inline void SimdFloatToHalf( const float * in, unsigned short * out ) {
+	for ( int i = 0; i < 4; ++i ) {
+		unsigned int f;
+		memcpy( &f, &in[i], 4 );
+		unsigned int sign = f & 0x80000000u;
+		f ^= sign;
+		unsigned int h;
+		if ( f >= ( 127u + 16u ) << 23 ) {
+			h = f > 255u << 23 ? 0x7e00u : 0x7c00u;
+		} else if ( f < 113u << 23 ) {
+			unsigned int magicBits = ( ( 127u - 15u ) + ( 23u - 10u ) + 1u ) << 23;
+			float value, magic;
+			memcpy( &value, &f, 4 );
+			memcpy( &magic, &magicBits, 4 );
+			value += magic;
+			memcpy( &h, &value, 4 );
+			h -= magicBits;
+		} else {
+			unsigned int odd = ( f >> 13 ) & 1u;
+			h = ( f + 0xfffu - ( 112u << 23 ) + odd ) >> 13;
+		}
+		out[i] = (unsigned short)( h | ( sign >> 16 ) );
+	}
+}
+
+#endif
+
+/*! Four-lane dot product of two structure-of-arrays 4-vectors. */
+inline simd4f SimdDot4( simd4f ax, simd4f ay, simd4f az, simd4f aw, simd4f bx, simd4f by, simd4f bz, simd4f bw ) {
+	return SimdMadd( ax, bx, SimdMadd( ay, by, SimdMadd( az, bz, SimdMul( aw, bw ) ) ) );
+}
+
+/*! Four-lane dot product of two structure-of-arrays 3-vectors. */
+inline simd4f SimdDot3( simd4f ax, simd4f ay, simd4f az, simd4f bx, simd4f by, simd4f bz ) {
+	return SimdMadd( ax, bx, SimdMadd( ay, by, SimdMul( az, bz ) ) );
+}
+
+/*!
+ * Converts an array of half precision floats to single precision, four at a
+ * time.  Any count is allowed.
+ */
+inline void HalfToFloatArray( const unsigned short * in, float * out, size_t count ) {
+	size_t i = 0;
+	for ( ; i + SIMD_WIDTH <= count; i += SIMD_WIDTH ) {
+		SimdHalfToFloat( in + i, out + i );
+	}
+	if ( i < count ) {
+		unsigned short h[SIMD_WIDTH] = { 0, 0, 0, 0 };
+		float f[SIMD_WIDTH];
+		memcpy( h, in + i, ( count - i ) * sizeof(unsigned short) );
+		SimdHalfToFloat( h, f );
+		memcpy( out + i, f, ( count - i ) * sizeof(float) );
+	}
+}
+
+/*!
+ * Converts an array of single precision floats to half precision, four at a
+ * time, rounding to nearest even.  Any count is allowed.
+ */
+inline void FloatToHalfArray( const float * in, unsigned short * out, size_t count ) {
+	size_t i = 0;
+	for ( ; i + SIMD_WIDTH <= count; i += SIMD_WIDTH ) {
+		SimdFloatToHalf( in + i, out + i );
+	}
+	if ( i < count ) {
+		float f[SIMD_WIDTH] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		unsigned short h[SIMD_WIDTH];
+		memcpy( f, in + i, ( count - i ) * sizeof(float) );
+		SimdFloatToHalf( f, h );
+		memcpy( out + i, h, ( count - i ) * sizeof(unsigned short) );
+	}
+}
+
+} //End Niflib namespace
+#endif
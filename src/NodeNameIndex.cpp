@@ -0,0 +1,64 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/NodeNameIndex.h"
+#include "../include/obj/NiNode.h"
+
+namespace Niflib {
+
+NodeNameIndex::NodeNameIndex( NiNode * root ) : root(root), valid(false), revision(0) {}
+
+NodeNameIndex::~NodeNameIndex() {}
+
+void NodeNameIndex::SetRoot( NiNode * n ) {
+	root = n;
+	valid = false;
+}
+
+Ref<NiNode> NodeNameIndex::GetRoot() const {
+	return root;
+}
+
+void NodeNameIndex::Invalidate() {
+	valid = false;
+}
+
+Ref<NiNode> NodeNameIndex::Find( const string & name ) const {
+	Update();
+	unordered_map<string,NiNode*>::const_iterator it = names.find( name );
+	if ( it == names.end() ) {
+		return NULL;
+	}
+	return it->second;
+}
+
+unsigned int NodeNameIndex::GetNameCount() const {
+	Update();
+	return (unsigned int)(names.size());
+}
+
+void NodeNameIndex::Update() const {
+	if ( valid && ( root == NULL || revision == root->GetHierarchyRevision() ) ) {
+		return;
+	}
+	names.clear();
+	if ( root != NULL ) {
+		AddNode( root );
+		revision = root->GetHierarchyRevision();
+	}
+	valid = true;
+}
+
+void NodeNameIndex::AddNode( NiNode * node ) const {
+	names[node->GetName()] = node;
+
+	vector<NiAVObjectRef> children = node->GetChildren();
+	for ( vector<NiAVObjectRef>::iterator it = children.begin(); it != children.end(); ++it ) {
+		NiNode * child = DynamicCast<NiNode>( *it );
+		if ( child != NULL ) {
+			AddNode( child );
+		}
+	}
+}
+
+} //End Niflib namespace
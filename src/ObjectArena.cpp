@@ -0,0 +1,112 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/ObjectArena.h"
+#include <atomic>
+#include <vector>
+#include <new>
+
+namespace Niflib {
+
+struct ArenaState {
+	/*! The live objects, plus one for the arena itself while it exists. */
+	atomic<size_t> refs;
+	vector<char *> blocks;
+	size_t block_size;
+	size_t bytes;
+	char * next;
+	char * end;
+};
+
+//Every allocation starts with a header naming the arena it came from, or
+//NULL for the heap, padded so that the object after it stays aligned
+union AllocHeader {
+	ArenaState * arena;
+	max_align_t align;
+};
+
+static const size_t HEADER_SIZE = sizeof(AllocHeader);
+
+static thread_local ArenaState * active_arena = NULL;
+
+static void Release( ArenaState * state ) {
+	if ( --state->refs == 0 ) {
+		for ( size_t i = 0; i < state->blocks.size(); ++i ) {
+			::operator delete( state->blocks[i] );
+		}
+		delete state;
+	}
+}
+
+ObjectArena::ObjectArena( size_t block_size ) {
+	state = new ArenaState;
+	state->refs = 1;
+	state->block_size = block_size;
+	state->bytes = 0;
+	state->next = NULL;
+	state->end = NULL;
+}
+
+ObjectArena::~ObjectArena() {
+	Release( state );
+}
+
+ObjectArena::Scope::Scope( ObjectArena & arena ) {
+	previous = active_arena;
+	active_arena = arena.state;
+}
+
+ObjectArena::Scope::~Scope() {
+	active_arena = previous;
+}
+
+size_t ObjectArena::GetObjectCount() const {
+	return state->refs - 1;
+}
+
+size_t ObjectArena::GetBytesAllocated() const {
+	return state->bytes;
+}
+
+void * ObjectArena::Allocate( size_t size ) {
+	ArenaState * state = active_arena;
+	char * p;
+	if ( state == NULL ) {
+		p = static_cast<char *>( ::operator new( HEADER_SIZE + size ) );
+	} else {
+		size_t total = HEADER_SIZE + ( size + HEADER_SIZE - 1 ) / HEADER_SIZE * HEADER_SIZE;
+		if ( total > state->block_size ) {
+			//Too big to share a block
+			p = static_cast<char *>( ::operator new( total ) );
+			state->blocks.push_back( p );
+			state->bytes += total;
+		} else {
+			if ( total > size_t( state->end - state->next ) ) {
+				state->next = static_cast<char *>( ::operator new( state->block_size ) );
+				state->end = state->next + state->block_size;
+				state->blocks.push_back( state->next );
+				state->bytes += state->block_size;
+			}
+			p = state->next;
+			state->next += total;
+		}
+		++state->refs;
+	}
+	reinterpret_cast<AllocHeader *>( p )->arena = state;
+	return p + HEADER_SIZE;
+}
+
+void ObjectArena::Free( void * p ) {
+	if ( p == NULL ) {
+		return;
+	}
+	char * start = static_cast<char *>( p ) - HEADER_SIZE;
+	ArenaState * state = reinterpret_cast<AllocHeader *>( start )->arena;
+	if ( state == NULL ) {
+		::operator delete( start );
+	} else {
+		Release( state );
+	}
+}
+
+} //End Niflib namespace
@@ -0,0 +1,773 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/PixelCodec.h"
+#include "NifSimd.h"
+#include "NifParallel.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+namespace Niflib {
+
+//Images smaller than this are not worth starting threads for
+static const size_t MIN_PARALLEL_PIXELS = 128 * 128;
+
+static bool IsBlockFormat( PixelFormat format ) {
+	return format == PX_FMT_DXT1 || format == PX_FMT_DXT5 || format == PX_FMT_DXT5_ALT;
+}
+
+static unsigned int BlockBytes( PixelFormat format ) {
+	return format == PX_FMT_DXT1 ? 8 : 16;
+}
+
+//The bytes per pixel of the uncompressed formats, or zero for others
+static unsigned int PixelBytes( PixelFormat format ) {
+	switch ( format ) {
+		case PX_FMT_RGB8: return 3;
+		case PX_FMT_RGBA8: return 4;
+		case PX_FMT_PAL8: return 1;
+		case PX_FMT_PALA8: return 1;
+		case PX_FMT_BUMP: return 2;
+		case PX_FMT_BUMPLUMA: return 3;
+		default: return 0;
+	}
+}
+
+unsigned int GetPixelImageSize( PixelFormat format, unsigned int width, unsigned int height ) {
+	if ( IsBlockFormat( format ) ) {
+		return ( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 ) * BlockBytes( format );
+	}
+	unsigned int bytes = PixelBytes( format );
+	if ( bytes == 0 ) {
+		throw runtime_error( "The pixel format is not supported." );
+	}
+	return width * height * bytes;
+}
+
+//--Uncompressed Formats--//
+
+//Finds the palette entry closest to a color
+static byte NearestPaletteEntry( const byte * palette, const byte * c, bool use_alpha ) {
+	int best = INT_MAX;
+	byte best_entry = 0;
+	for ( int i = 0; i < 256 && best > 0; ++i ) {
+		const byte * e = palette + i * 4;
+		int dr = int(c[0]) - int(e[0]);
+		int dg = int(c[1]) - int(e[1]);
+		int db = int(c[2]) - int(e[2]);
+		int d = dr * dr + dg * dg + db * db;
+		if ( use_alpha ) {
+			int da = int(c[3]) - int(e[3]);
+			d += da * da;
+		}
+		if ( d < best ) {
+			best = d;
+			best_entry = byte(i);
+		}
+	}
+	return best_entry;
+}
+
+static void DecodeRows( PixelFormat format, const PixelImage & img, unsigned int y0, unsigned int y1, const byte * palette ) {
+	size_t begin = size_t(y0) * img.width;
+	size_t end = size_t(y1) * img.width;
+	const byte * in = img.in;
+	byte * out = img.out;
+	switch ( format ) {
+		case PX_FMT_RGB8:
+			for ( size_t i = begin; i < end; ++i ) {
+				out[i * 4] = in[i * 3];
+				out[i * 4 + 1] = in[i * 3 + 1];
+				out[i * 4 + 2] = in[i * 3 + 2];
+				out[i * 4 + 3] = 255;
+			}
+			break;
+		case PX_FMT_RGBA8:
+			memcpy( out + begin * 4, in + begin * 4, ( end - begin ) * 4 );
+			break;
+		case PX_FMT_PAL8:
+			for ( size_t i = begin; i < end; ++i ) {
+				const byte * e = palette + in[i] * 4;
+				out[i * 4] = e[0];
+				out[i * 4 + 1] = e[1];
+				out[i * 4 + 2] = e[2];
+				out[i * 4 + 3] = 255;
+			}
+			break;
+		case PX_FMT_PALA8:
+			for ( size_t i = begin; i < end; ++i ) {
+				memcpy( out + i * 4, palette + in[i] * 4, 4 );
+			}
+			break;
+		case PX_FMT_BUMP:
+			//Flipping the top bit turns a signed byte into one offset by 128
+			for ( size_t i = begin; i < end; ++i ) {
+				out[i * 4] = in[i * 2] ^ 0x80;
+				out[i * 4 + 1] = in[i * 2 + 1] ^ 0x80;
+				out[i * 4 + 2] = 255;
+				out[i * 4 + 3] = 255;
+			}
+			break;
+		case PX_FMT_BUMPLUMA:
+			for ( size_t i = begin; i < end; ++i ) {
+				out[i * 4] = in[i * 3] ^ 0x80;
+				out[i * 4 + 1] = in[i * 3 + 1] ^ 0x80;
+				out[i * 4 + 2] = in[i * 3 + 2];
+				out[i * 4 + 3] = 255;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+static void EncodeRows( PixelFormat format, const PixelImage & img, unsigned int y0, unsigned int y1, const byte * palette ) {
+	size_t begin = size_t(y0) * img.width;
+	size_t end = size_t(y1) * img.width;
+	const byte * in = img.in;
+	byte * out = img.out;
+	switch ( format ) {
+		case PX_FMT_RGB8:
+			for ( size_t i = begin; i < end; ++i ) {
+				out[i * 3] = in[i * 4];
+				out[i * 3 + 1] = in[i * 4 + 1];
+				out[i * 3 + 2] = in[i * 4 + 2];
+			}
+			break;
+		case PX_FMT_RGBA8:
+			memcpy( out + begin * 4, in + begin * 4, ( end - begin ) * 4 );
+			break;
+		case PX_FMT_PAL8:
+		case PX_FMT_PALA8:
+		{
+			//Runs of the same color are common, so remember the last match
+			bool use_alpha = ( format == PX_FMT_PALA8 );
+			byte last[4] = { 0, 0, 0, 0 };
+			byte last_entry = NearestPaletteEntry( palette, last, use_alpha );
+			for ( size_t i = begin; i < end; ++i ) {
+				const byte * c = in + i * 4;
+				if ( memcmp( c, last, 4 ) != 0 ) {
+					memcpy( last, c, 4 );
+					last_entry = NearestPaletteEntry( palette, c, use_alpha );
+				}
+				out[i] = last_entry;
+			}
+			break;
+		}
+		case PX_FMT_BUMP:
+			for ( size_t i = begin; i < end; ++i ) {
+				out[i * 2] = in[i * 4] ^ 0x80;
+				out[i * 2 + 1] = in[i * 4 + 1] ^ 0x80;
+			}
+			break;
+		case PX_FMT_BUMPLUMA:
+			for ( size_t i = begin; i < end; ++i ) {
+				out[i * 3] = in[i * 4] ^ 0x80;
+				out[i * 3 + 1] = in[i * 4 + 1] ^ 0x80;
+				out[i * 3 + 2] = in[i * 4 + 2];
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+//--Block Compression--//
+
+static void Unpack565( unsigned int c, int * rgb ) {
+	int r = ( c >> 11 ) & 31;
+	int g = ( c >> 5 ) & 63;
+	int b = c & 31;
+	rgb[0] = ( r << 3 ) | ( r >> 2 );
+	rgb[1] = ( g << 2 ) | ( g >> 4 );
+	rgb[2] = ( b << 3 ) | ( b >> 2 );
+}
+
+static int Quantize( float f, int max ) {
+	int i = int( f * float(max) / 255.0f + 0.5f );
+	return i < 0 ? 0 : ( i > max ? max : i );
+}
+
+static unsigned int Pack565( const float * rgb ) {
+	return ( Quantize( rgb[0], 31 ) << 11 ) | ( Quantize( rgb[1], 63 ) << 5 ) | Quantize( rgb[2], 31 );
+}
+
+//The colors a pair of endpoints stands for.  The encoder and the decoder
+//share this so that the encoder measures what will actually be seen.
+static void BuildColorPalette( unsigned int c0, unsigned int c1, bool three_color, int pal[4][4] ) {
+	Unpack565( c0, pal[0] );
+	Unpack565( c1, pal[1] );
+	for ( int k = 0; k < 3; ++k ) {
+		if ( three_color ) {
+			pal[2][k] = ( pal[0][k] + pal[1][k] ) / 2;
+			pal[3][k] = 0;
+		} else {
+			pal[2][k] = ( 2 * pal[0][k] + pal[1][k] + 1 ) / 3;
+			pal[3][k] = ( pal[0][k] + 2 * pal[1][k] + 1 ) / 3;
+		}
+	}
+	pal[0][3] = pal[1][3] = pal[2][3] = 255;
+	pal[3][3] = three_color ? 0 : 255;
+}
+
+//BC3 blocks always use four colors, BC1 blocks use three when c0 <= c1
+static void DecodeColorBlock( const byte * in, byte * rgba, bool four_color_only ) {
+	unsigned int c0 = in[0] | ( in[1] << 8 );
+	unsigned int c1 = in[2] | ( in[3] << 8 );
+	int pal[4][4];
+	BuildColorPalette( c0, c1, !four_color_only && c0 <= c1, pal );
+	//Narrow the palette to RGBA bytes once so each pixel is a single copy
+	byte colors[4][4];
+	for ( int j = 0; j < 4; ++j ) {
+		for ( int k = 0; k < 4; ++k ) {
+			colors[j][k] = byte( pal[j][k] );
+		}
+	}
+	unsigned int bits = in[4] | ( in[5] << 8 ) | ( in[6] << 16 ) | ( (unsigned int)in[7] << 24 );
+	for ( int i = 0; i < 16; ++i ) {
+		memcpy( rgba + i * 4, colors[( bits >> ( 2 * i ) ) & 3], 4 );
+	}
+}
+
+static void DecodeAlphaBlock( const byte * in, byte * rgba ) {
+	int a0 = in[0];
+	int a1 = in[1];
+	int pal[8];
+	pal[0] = a0;
+	pal[1] = a1;
+	if ( a0 > a1 ) {
+		for ( int j = 1; j < 7; ++j ) {
+			pal[1 + j] = ( ( 7 - j ) * a0 + j * a1 + 3 ) / 7;
+		}
+	} else {
+		for ( int j = 1; j < 5; ++j ) {
+			pal[1 + j] = ( ( 5 - j ) * a0 + j * a1 + 2 ) / 5;
+		}
+		pal[6] = 0;
+		pal[7] = 255;
+	}
+	unsigned long long bits = 0;
+	for ( int i = 0; i < 6; ++i ) {
+		bits |= (unsigned long long)in[2 + i] << ( 8 * i );
+	}
+	for ( int i = 0; i < 16; ++i ) {
+		rgba[i * 4 + 3] = byte( pal[( bits >> ( 3 * i ) ) & 7] );
+	}
+}
+
+//Picks the closest palette color for each pixel, four pixels at a time,
+//and returns the weighted squared error
+static float FitIndices( const float * r, const float * g, const float * b, const float * weight, unsigned int c0, unsigned int c1, bool three_color, byte * indices ) {
+	int pal[4][4];
+	BuildColorPalette( c0, c1, three_color, pal );
+	int count = three_color ? 3 : 4;
+	simd4f total = SimdZero();
+	for ( int k = 0; k < 16; k += SIMD_WIDTH ) {
+		simd4f pr = SimdLoad( r + k );
+		simd4f pg = SimdLoad( g + k );
+		simd4f pb = SimdLoad( b + k );
+		simd4f best = SimdSplat( FLT_MAX );
+		simd4f best_index = SimdZero();
+		for ( int j = 0; j < count; ++j ) {
+			simd4f dr = SimdSub( pr, SimdSplat( float(pal[j][0]) ) );
+			simd4f dg = SimdSub( pg, SimdSplat( float(pal[j][1]) ) );
+			simd4f db = SimdSub( pb, SimdSplat( float(pal[j][2]) ) );
+			simd4f d = SimdDot3( dr, dg, db, dr, dg, db );
+			best_index = SimdSelect( SimdLess( d, best ), SimdSplat( float(j) ), best_index );
+			best = SimdMin( d, best );
+		}
+		total = SimdMadd( best, SimdLoad( weight + k ), total );
+		float f[SIMD_WIDTH];
+		SimdStore( f, best_index );
+		for ( unsigned int l = 0; l < SIMD_WIDTH; ++l ) {
+			indices[k + l] = byte( f[l] );
+		}
+	}
+	float t[SIMD_WIDTH];
+	SimdStore( t, total );
+	return t[0] + t[1] + t[2] + t[3];
+}
+
+//Finds the endpoints that best fit the pixels for the given indices in the
+//least squares sense.  Returns false when they are underdetermined.
+static bool SolveEndpoints( const float * r, const float * g, const float * b, const float * weight, const byte * indices, bool three_color, float * e0, float * e1 ) {
+	static const float weights4[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	static const float weights3[4] = { 1.0f, 0.0f, 0.5f, 0.0f };
+	const float * w = three_color ? weights3 : weights4;
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[3] = { 0.0f, 0.0f, 0.0f };
+	float bx[3] = { 0.0f, 0.0f, 0.0f };
+	for ( int i = 0; i < 16; ++i ) {
+		if ( weight[i] == 0.0f ) {
+			continue;
+		}
+		float a = w[indices[i]];
+		float c = 1.0f - a;
+		aa += a * a;
+		ab += a * c;
+		bb += c * c;
+		ax[0] += a * r[i]; ax[1] += a * g[i]; ax[2] += a * b[i];
+		bx[0] += c * r[i]; bx[1] += c * g[i]; bx[2] += c * b[i];
+	}
+	float det = aa * bb - ab * ab;
+	if ( fabs( det ) < 1e-4f ) {
+		return false;
+	}
+	for ( int k = 0; k < 3; ++k ) {
+		e0[k] = ( ax[k] * bb - bx[k] * ab ) / det;
+		e1[k] = ( bx[k] * aa - ax[k] * ab ) / det;
+	}
+	return true;
+}
+
+static void WriteColorBlock( byte * out, unsigned int c0, unsigned int c1, byte * indices, bool three_color, const float * weight ) {
+	//The order of the endpoints selects the mode, so swap them if needed
+	if ( three_color ? c0 > c1 : c0 < c1 ) {
+		swap( c0, c1 );
+		for ( int i = 0; i < 16; ++i ) {
+			if ( !three_color || indices[i] < 2 ) {
+				indices[i] ^= 1;
+			}
+		}
+	}
+	unsigned int bits = 0;
+	for ( int i = 0; i < 16; ++i ) {
+		unsigned int index = indices[i];
+		if ( weight[i] == 0.0f ) {
+			index = 3;
+		} else if ( c0 == c1 ) {
+			index = 0;
+		}
+		bits |= index << ( 2 * i );
+	}
+	out[0] = byte( c0 ); out[1] = byte( c0 >> 8 );
+	out[2] = byte( c1 ); out[3] = byte( c1 >> 8 );
+	out[4] = byte( bits ); out[5] = byte( bits >> 8 );
+	out[6] = byte( bits >> 16 ); out[7] = byte( bits >> 24 );
+}
+
+static void EncodeColorBlock( const byte * rgba, byte * out, bool punch_through ) {
+	float r[16], g[16], b[16], weight[16];
+	int opaque = 0;
+	for ( int i = 0; i < 16; ++i ) {
+		r[i] = rgba[i * 4];
+		g[i] = rgba[i * 4 + 1];
+		b[i] = rgba[i * 4 + 2];
+		weight[i] = ( punch_through && rgba[i * 4 + 3] < 128 ) ? 0.0f : 1.0f;
+		opaque += int( weight[i] );
+	}
+	if ( opaque == 0 ) {
+		//Three color mode with every pixel transparent
+		memset( out, 0, 4 );
+		memset( out + 4, 0xFF, 4 );
+		return;
+	}
+	bool three_color = opaque < 16;
+
+	//Mean and covariance of the pixels that count
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for ( int i = 0; i < 16; ++i ) {
+		mean[0] += weight[i] * r[i];
+		mean[1] += weight[i] * g[i];
+		mean[2] += weight[i] * b[i];
+	}
+	for ( int k = 0; k < 3; ++k ) {
+		mean[k] /= float(opaque);
+	}
+	float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for ( int i = 0; i < 16; ++i ) {
+		float dr = weight[i] * ( r[i] - mean[0] );
+		float dg = weight[i] * ( g[i] - mean[1] );
+		float db = weight[i] * ( b[i] - mean[2] );
+		cov[0] += dr * dr; cov[1] += dr * dg; cov[2] += dr * db;
+		cov[3] += dg * dg; cov[4] += dg * db; cov[5] += db * db;
+	}
+
+	//Principal axis by power iteration
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for ( int iter = 0; iter < 6; ++iter ) {
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float m = max( fabs( x ), max( fabs( y ), fabs( z ) ) );
+		if ( m < 1e-6f ) {
+			break;
+		}
+		axis[0] = x / m;
+		axis[1] = y / m;
+		axis[2] = z / m;
+	}
+
+	//The extreme pixels along the axis are the first guess at the endpoints
+	float lo = FLT_MAX, hi = -FLT_MAX;
+	int ilo = 0, ihi = 0;
+	for ( int i = 0; i < 16; ++i ) {
+		if ( weight[i] == 0.0f ) {
+			continue;
+		}
+		float p = r[i] * axis[0] + g[i] * axis[1] + b[i] * axis[2];
+		if ( p < lo ) {
+			lo = p;
+			ilo = i;
+		}
+		if ( p > hi ) {
+			hi = p;
+			ihi = i;
+		}
+	}
+	float e0[3] = { r[ihi], g[ihi], b[ihi] };
+	float e1[3] = { r[ilo], g[ilo], b[ilo] };
+	unsigned int c0 = Pack565( e0 );
+	unsigned int c1 = Pack565( e1 );
+	byte indices[16];
+	float error = FitIndices( r, g, b, weight, c0, c1, three_color, indices );
+
+	//One round of least squares refinement, kept only if it helps
+	if ( error > 0.0f && SolveEndpoints( r, g, b, weight, indices, three_color, e0, e1 ) ) {
+		unsigned int d0 = Pack565( e0 );
+		unsigned int d1 = Pack565( e1 );
+		byte refined[16];
+		float refined_error = FitIndices( r, g, b, weight, d0, d1, three_color, refined );
+		if ( refined_error < error ) {
+			c0 = d0;
+			c1 = d1;
+			memcpy( indices, refined, 16 );
+		}
+	}
+	WriteColorBlock( out, c0, c1, indices, three_color, weight );
+}
+
+static void EncodeAlphaBlock( const byte * rgba, byte * out ) {
+	int lo = 255, hi = 0;
+	for ( int i = 0; i < 16; ++i ) {
+		int a = rgba[i * 4 + 3];
+		lo = min( lo, a );
+		hi = max( hi, a );
+	}
+	//Eight alpha mode, where the codes run 1, 7, 6, ... 2, 0 from lo to hi
+	unsigned long long bits = 0;
+	if ( hi > lo ) {
+		int range = hi - lo;
+		for ( int i = 0; i < 16; ++i ) {
+			int t = ( ( rgba[i * 4 + 3] - lo ) * 14 + range ) / ( 2 * range );
+			unsigned long long code = t == 7 ? 0 : ( t == 0 ? 1 : 8 - t );
+			bits |= code << ( 3 * i );
+		}
+	}
+	out[0] = byte( hi );
+	out[1] = byte( lo );
+	for ( int i = 0; i < 6; ++i ) {
+		out[2 + i] = byte( bits >> ( 8 * i ) );
+	}
+}
+
+static void DecodeBlockRow( PixelFormat format, const PixelImage & img, unsigned int by ) {
+	unsigned int blocks = ( img.width + 3 ) / 4;
+	unsigned int block_bytes = BlockBytes( format );
+	const byte * in = img.in + size_t(by) * blocks * block_bytes;
+	unsigned int rows = min( 4u, img.height - by * 4 );
+	byte block[64];
+	for ( unsigned int bx = 0; bx < blocks; ++bx, in += block_bytes ) {
+		if ( format == PX_FMT_DXT1 ) {
+			DecodeColorBlock( in, block, false );
+		} else {
+			DecodeColorBlock( in + 8, block, true );
+			DecodeAlphaBlock( in, block );
+		}
+		//Copy the part of the block that lies inside the image
+		unsigned int cols = min( 4u, img.width - bx * 4 );
+		for ( unsigned int y = 0; y < rows; ++y ) {
+			memcpy( img.out + ( size_t( by * 4 + y ) * img.width + bx * 4 ) * 4, block + y * 16, cols * 4 );
+		}
+	}
+}
+
+static void EncodeBlockRow( PixelFormat format, const PixelImage & img, unsigned int by ) {
+	unsigned int blocks = ( img.width + 3 ) / 4;
+	unsigned int block_bytes = BlockBytes( format );
+	byte * out = img.out + size_t(by) * blocks * block_bytes;
+	byte block[64];
+	for ( unsigned int bx = 0; bx < blocks; ++bx, out += block_bytes ) {
+		//Partial blocks repeat the last row and column
+		for ( unsigned int y = 0; y < 4; ++y ) {
+			unsigned int yy = min( by * 4 + y, img.height - 1 );
+			for ( unsigned int x = 0; x < 4; ++x ) {
+				unsigned int xx = min( bx * 4 + x, img.width - 1 );
+				memcpy( block + ( y * 4 + x ) * 4, img.in + ( size_t(yy) * img.width + xx ) * 4, 4 );
+			}
+		}
+		if ( format == PX_FMT_DXT1 ) {
+			EncodeColorBlock( block, out, true );
+		} else {
+			EncodeAlphaBlock( block, out );
+			EncodeColorBlock( block, out + 8, false );
+		}
+	}
+}
+
+//--Dispatch--//
+
+//Calls func( image, row ) for rows [0, rows) of every image, where first
+//holds the running total of rows.  The threads share out the rows of all
+//the images at once, so small images do not leave threads idle.
+template <class Func>
+static void ForEachImageRow( const vector<size_t> & first, unsigned int num_threads, Func func ) {
+	ParallelFor( first.back(), num_threads, [&]( size_t begin, size_t end ) {
+		size_t image = upper_bound( first.begin(), first.end(), begin ) - first.begin() - 1;
+		for ( size_t item = begin; item < end; ++item ) {
+			while ( item >= first[image + 1] ) {
+				++image;
+			}
+			func( image, (unsigned int)( item - first[image] ) );
+		}
+	} );
+}
+
+static void ConvertImages( PixelFormat format, const vector<PixelImage> & images, const byte * palette, unsigned int num_threads, bool encode ) {
+	if ( !IsBlockFormat( format ) && PixelBytes( format ) == 0 ) {
+		throw runtime_error( "The pixel format is not supported." );
+	}
+	if ( ( format == PX_FMT_PAL8 || format == PX_FMT_PALA8 ) && palette == NULL ) {
+		throw runtime_error( "Palettized pixel formats need a palette." );
+	}
+
+	//Each work item is a row of blocks, or four rows of pixels
+	vector<size_t> first( images.size() + 1, 0 );
+	size_t pixels = 0;
+	for ( size_t i = 0; i < images.size(); ++i ) {
+		first[i + 1] = first[i] + ( images[i].height + 3 ) / 4;
+		pixels += size_t(images[i].width) * images[i].height;
+	}
+	if ( pixels < MIN_PARALLEL_PIXELS ) {
+		num_threads = 1;
+	}
+	bool blocks = IsBlockFormat( format );
+
+	ForEachImageRow( first, num_threads, [&]( size_t image, unsigned int row ) {
+		const PixelImage & img = images[image];
+		if ( blocks ) {
+			if ( encode ) {
+				EncodeBlockRow( format, img, row );
+			} else {
+				DecodeBlockRow( format, img, row );
+			}
+		} else {
+			unsigned int y0 = row * 4;
+			unsigned int y1 = min( y0 + 4, img.height );
+			if ( encode ) {
+				EncodeRows( format, img, y0, y1, palette );
+			} else {
+				DecodeRows( format, img, y0, y1, palette );
+			}
+		}
+	} );
+}
+
+void DecodePixelImages( PixelFormat format, const vector<PixelImage> & images, const byte * palette, unsigned int num_threads ) {
+	ConvertImages( format, images, palette, num_threads, false );
+}
+
+void EncodePixelImages( PixelFormat format, const vector<PixelImage> & images, const byte * palette, unsigned int num_threads ) {
+	ConvertImages( format, images, palette, num_threads, true );
+}
+
+void DecodePixels( PixelFormat format, const byte * in, unsigned int width, unsigned int height, byte * out, const byte * palette, unsigned int num_threads ) {
+	DecodePixelImages( format, vector<PixelImage>( 1, PixelImage( in, out, width, height ) ), palette, num_threads );
+}
+
+void EncodePixels( PixelFormat format, const byte * in, unsigned int width, unsigned int height, byte * out, const byte * palette, unsigned int num_threads ) {
+	EncodePixelImages( format, vector<PixelImage>( 1, PixelImage( in, out, width, height ) ), palette, num_threads );
+}
+
+//--Mipmap Filtering--//
+
+static const float KAISER_RADIUS = 3.0f;
+static const float KAISER_ALPHA = 4.0f;
+static const float PI = 3.14159265358979323846f;
+
+static double BesselI0( double x ) {
+	double sum = 1.0;
+	double term = 1.0;
+	for ( int k = 1; k < 50 && term > sum * 1e-12; ++k ) {
+		double t = x / ( 2.0 * k );
+		term *= t * t;
+		sum += term;
+	}
+	return sum;
+}
+
+//The Kaiser windowed sinc at a distance measured in new pixels
+static float KaiserWeight( float x ) {
+	if ( fabs( x ) >= KAISER_RADIUS ) {
+		return 0.0f;
+	}
+	float sinc = ( x == 0.0f ) ? 1.0f : sin( PI * x ) / ( PI * x );
+	float t = x / KAISER_RADIUS;
+	return sinc * float( BesselI0( KAISER_ALPHA * sqrt( 1.0f - t * t ) ) / BesselI0( KAISER_ALPHA ) );
+}
+
+//The source pixels and weights that make up each new pixel along one axis,
+//padded with zero weights to the same number of taps for every pixel
+struct FilterTaps {
+	unsigned int count;
+	vector<unsigned int> index;
+	vector<float> weight;
+};
+
+static void BuildTaps( unsigned int src, unsigned int dst, MipmapFilter filter, FilterTaps & taps ) {
+	taps.count = 0;
+	taps.index.clear();
+	taps.weight.clear();
+	if ( src == 0 || dst == 0 ) {
+		return;
+	}
+	float scale = float(src) / float(dst);
+	vector< vector< pair<unsigned int, float> > > lists( dst );
+	for ( unsigned int x = 0; x < dst; ++x ) {
+		vector< pair<unsigned int, float> > & list = lists[x];
+		if ( filter == MIPMAP_KAISER ) {
+			float center = ( x + 0.5f ) * scale;
+			float reach = KAISER_RADIUS * scale;
+			for ( int i = int( floor( center - reach ) ); i <= int( ceil( center + reach ) ); ++i ) {
+				float w = KaiserWeight( ( i + 0.5f - center ) / scale );
+				if ( w != 0.0f ) {
+					list.push_back( make_pair( (unsigned int)( i < 0 ? 0 : ( i >= int(src) ? int(src) - 1 : i ) ), w ) );
+				}
+			}
+		} else {
+			//The share of each source pixel inside the span of the new one
+			float lo = x * scale;
+			float hi = ( x + 1 ) * scale;
+			for ( int i = int( floor( lo ) ); i < int( ceil( hi ) ); ++i ) {
+				float w = min( hi, float( i + 1 ) ) - max( lo, float(i) );
+				if ( w > 0.0f ) {
+					list.push_back( make_pair( (unsigned int)( i >= int(src) ? int(src) - 1 : i ), w ) );
+				}
+			}
+		}
+		float total = 0.0f;
+		for ( size_t t = 0; t < list.size(); ++t ) {
+			total += list[t].second;
+		}
+		for ( size_t t = 0; t < list.size(); ++t ) {
+			list[t].second /= total;
+		}
+		taps.count = max( taps.count, (unsigned int)list.size() );
+	}
+	taps.index.assign( size_t(dst) * taps.count, 0 );
+	taps.weight.assign( size_t(dst) * taps.count, 0.0f );
+	for ( unsigned int x = 0; x < dst; ++x ) {
+		for ( size_t t = 0; t < lists[x].size(); ++t ) {
+			taps.index[x * taps.count + t] = lists[x][t].first;
+			taps.weight[x * taps.count + t] = lists[x][t].second;
+		}
+	}
+}
+
+//Lookup tables between sRGB bytes and linear light scaled to 0 to 255
+struct GammaTables {
+	float toLinear[256];
+	byte toSrgb[4096];
+
+	GammaTables() {
+		for ( int i = 0; i < 256; ++i ) {
+			float c = i / 255.0f;
+			toLinear[i] = 255.0f * ( c <= 0.04045f ? c / 12.92f : pow( ( c + 0.055f ) / 1.055f, 2.4f ) );
+		}
+		for ( int i = 0; i < 4096; ++i ) {
+			float l = i / 4095.0f;
+			float c = l <= 0.0031308f ? 12.92f * l : 1.055f * pow( l, 1.0f / 2.4f ) - 0.055f;
+			toSrgb[i] = byte( c * 255.0f + 0.5f );
+		}
+	}
+};
+
+static const GammaTables & Gamma() {
+	static const GammaTables tables;
+	return tables;
+}
+
+static simd4f LoadPixel( const byte * p, const GammaTables * gamma ) {
+	if ( gamma == NULL ) {
+		return SimdLoadBytes( p );
+	}
+	float f[4] = { gamma->toLinear[p[0]], gamma->toLinear[p[1]], gamma->toLinear[p[2]], float( p[3] ) };
+	return SimdLoad( f );
+}
+
+static void StorePixel( byte * p, simd4f v, const GammaTables * gamma ) {
+	SimdStoreBytes( p, v );
+	if ( gamma != NULL ) {
+		float f[4];
+		SimdStore( f, v );
+		for ( int k = 0; k < 3; ++k ) {
+			int i = int( f[k] * ( 4095.0f / 255.0f ) + 0.5f );
+			p[k] = gamma->toSrgb[i < 0 ? 0 : ( i > 4095 ? 4095 : i )];
+		}
+	}
+}
+
+void DownsamplePixelImages( const vector<PixelImage> & images, MipmapFilter filter, bool linear, unsigned int num_threads ) {
+	size_t count = images.size();
+	vector<FilterTaps> across( count ), down( count );
+	vector<unsigned int> widths( count );
+	vector< vector<float> > rows( count );
+	vector<size_t> first_in( count + 1, 0 ), first_out( count + 1, 0 );
+	size_t pixels = 0;
+	for ( size_t i = 0; i < count; ++i ) {
+		const PixelImage & img = images[i];
+		unsigned int w = img.width > 1 ? img.width / 2 : img.width;
+		unsigned int h = img.height > 1 ? img.height / 2 : img.height;
+		if ( w == 0 || h == 0 ) {
+			w = h = 0;
+		}
+		BuildTaps( img.width, w, filter, across[i] );
+		BuildTaps( img.height, h, filter, down[i] );
+		widths[i] = w;
+		rows[i].resize( size_t(w) * ( h > 0 ? img.height : 0 ) * 4 );
+		first_in[i + 1] = first_in[i] + ( h > 0 ? img.height : 0 );
+		first_out[i + 1] = first_out[i] + h;
+		pixels += size_t(img.width) * img.height;
+	}
+	if ( pixels < MIN_PARALLEL_PIXELS ) {
+		num_threads = 1;
+	}
+	const GammaTables * gamma = linear ? &Gamma() : NULL;
+
+	//Filter across each row into floats, then down each column of those
+	ForEachImageRow( first_in, num_threads, [&]( size_t image, unsigned int y ) {
+		const FilterTaps & taps = across[image];
+		const byte * src = images[image].in + size_t(y) * images[image].width * 4;
+		float * dst = &rows[image][size_t(y) * widths[image] * 4];
+		for ( unsigned int x = 0; x < widths[image]; ++x ) {
+			const unsigned int * index = &taps.index[x * taps.count];
+			const float * weight = &taps.weight[x * taps.count];
+			simd4f sum = SimdZero();
+			for ( unsigned int t = 0; t < taps.count; ++t ) {
+				sum = SimdMadd( LoadPixel( src + index[t] * 4, gamma ), SimdSplat( weight[t] ), sum );
+			}
+			SimdStore( dst + x * 4, sum );
+		}
+	} );
+	ForEachImageRow( first_out, num_threads, [&]( size_t image, unsigned int y ) {
+		const FilterTaps & taps = down[image];
+		unsigned int w = widths[image];
+		const float * src = rows[image].data();
+		const unsigned int * index = &taps.index[y * taps.count];
+		const float * weight = &taps.weight[y * taps.count];
+		byte * dst = images[image].out + size_t(y) * w * 4;
+		for ( unsigned int x = 0; x < w; ++x ) {
+			simd4f sum = SimdZero();
+			for ( unsigned int t = 0; t < taps.count; ++t ) {
+				sum = SimdMadd( SimdLoad( src + ( size_t(index[t]) * w + x ) * 4 ), SimdSplat( weight[t] ), sum );
+			}
+			StorePixel( dst + x * 4, sum, gamma );
+		}
+	} );
+}
+
+} //End Niflib namespace
@@ -0,0 +1,694 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/PoseBlender.h"
+#include "../include/Key.h"
+#include "../include/obj/NiObjectNET.h"
+#include "../include/obj/NiControllerSequence.h"
+#include "../include/obj/NiStringPalette.h"
+#include "../include/obj/NiTransformInterpolator.h"
+#include "../include/obj/NiTransformData.h"
+#include "../include/obj/NiKeyframeController.h"
+#include "../include/obj/NiKeyframeData.h"
+#include "NifSimd.h"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+namespace Niflib {
+
+//Gamebryo marks unused interpolator components with -FLT_MAX
+static const float INVALID_COMPONENT = -3.0e38f;
+
+//--PoseBuffer--//
+
+PoseBuffer::PoseBuffer() : numBones(0) {}
+
+PoseBuffer::PoseBuffer( unsigned int num_bones ) : numBones(0) {
+	Resize( num_bones );
+}
+
+void PoseBuffer::Resize( unsigned int num_bones ) {
+	unsigned int old_padded = SimdPadCount( numBones );
+	unsigned int padded = SimdPadCount( num_bones );
+
+	tx.resize( padded, 0.0f );
+	ty.resize( padded, 0.0f );
+	tz.resize( padded, 0.0f );
+	qw.resize( padded, 1.0f );
+	qx.resize( padded, 0.0f );
+	qy.resize( padded, 0.0f );
+	qz.resize( padded, 0.0f );
+	scale.resize( padded, 1.0f );
+	weight.resize( padded, 0.0f );
+
+	//Reset any padding which used to hold bones
+	for ( unsigned int i = num_bones; i < padded && i < old_padded; ++i ) {
+		tx[i] = ty[i] = tz[i] = 0.0f;
+		qw[i] = 1.0f;
+		qx[i] = qy[i] = qz[i] = 0.0f;
+		scale[i] = 1.0f;
+		weight[i] = 0.0f;
+	}
+
+	numBones = num_bones;
+}
+
+unsigned int PoseBuffer::GetNumBones() const {
+	return numBones;
+}
+
+void PoseBuffer::SetIdentity( float w ) {
+	unsigned int padded = SimdPadCount( numBones );
+	for ( unsigned int i = 0; i < padded; ++i ) {
+		tx[i] = ty[i] = tz[i] = 0.0f;
+		qw[i] = 1.0f;
+		qx[i] = qy[i] = qz[i] = 0.0f;
+		scale[i] = 1.0f;
+		weight[i] = ( i < numBones ) ? w : 0.0f;
+	}
+}
+
+void PoseBuffer::SetTransform( unsigned int bone, const Vector3 & translation, const Quaternion & rotation, float s, float w ) {
+	if ( bone >= numBones ) {
+		throw runtime_error("The bone index passed to PoseBuffer::SetTransform was out of range.");
+	}
+	tx[bone] = translation.x;
+	ty[bone] = translation.y;
+	tz[bone] = translation.z;
+	qw[bone] = rotation.w;
+	qx[bone] = rotation.x;
+	qy[bone] = rotation.y;
+	qz[bone] = rotation.z;
+	scale[bone] = s;
+	weight[bone] = w;
+}
+
+Vector3 PoseBuffer::GetTranslation( unsigned int bone ) const {
+	if ( bone >= numBones ) {
+		throw runtime_error("The bone index passed to PoseBuffer::GetTranslation was out of range.");
+	}
+	return Vector3( tx[bone], ty[bone], tz[bone] );
+}
+
+Quaternion PoseBuffer::GetRotation( unsigned int bone ) const {
+	if ( bone >= numBones ) {
+		throw runtime_error("The bone index passed to PoseBuffer::GetRotation was out of range.");
+	}
+	return Quaternion( qw[bone], qx[bone], qy[bone], qz[bone] );
+}
+
+float PoseBuffer::GetScale( unsigned int bone ) const {
+	if ( bone >= numBones ) {
+		throw runtime_error("The bone index passed to PoseBuffer::GetScale was out of range.");
+	}
+	return scale[bone];
+}
+
+float PoseBuffer::GetWeight( unsigned int bone ) const {
+	if ( bone >= numBones ) {
+		throw runtime_error("The bone index passed to PoseBuffer::GetWeight was out of range.");
+	}
+	return weight[bone];
+}
+
+Matrix44 PoseBuffer::GetLocalTransform( unsigned int bone ) const {
+	Quaternion q = GetRotation( bone );
+	return Matrix44( GetTranslation( bone ), q.AsMatrix(), scale[bone] );
+}
+
+//--SIMD Quaternion Helpers--//
+
+//Structure-of-arrays quaternion covering four bones
+struct QuatLanes {
+	simd4f w, x, y, z;
+};
+
+static inline void NormalizeLanes( QuatLanes & q ) {
+	simd4f len2 = SimdDot4( q.w, q.x, q.y, q.z, q.w, q.x, q.y, q.z );
+	//Degenerate lanes become the identity rotation
+	simd4f degenerate = SimdLess( len2, SimdSplat( 1.0e-12f ) );
+	simd4f inv = SimdDiv( SimdSplat( 1.0f ), SimdSqrt( SimdMax( len2, SimdSplat( 1.0e-12f ) ) ) );
+	q.w = SimdSelect( degenerate, SimdSplat( 1.0f ), SimdMul( q.w, inv ) );
+	q.x = SimdSelect( degenerate, SimdZero(), SimdMul( q.x, inv ) );
+	q.y = SimdSelect( degenerate, SimdZero(), SimdMul( q.y, inv ) );
+	q.z = SimdSelect( degenerate, SimdZero(), SimdMul( q.z, inv ) );
+}
+
+//Flips b into the same hemisphere as a and returns |a.b|
+static inline simd4f AlignLanes( const QuatLanes & a, QuatLanes & b ) {
+	simd4f d = SimdDot4( a.w, a.x, a.y, a.z, b.w, b.x, b.y, b.z );
+	simd4f flip = SimdLess( d, SimdZero() );
+	b.w = SimdNegateIf( flip, b.w );
+	b.x = SimdNegateIf( flip, b.x );
+	b.y = SimdNegateIf( flip, b.y );
+	b.z = SimdNegateIf( flip, b.z );
+	return SimdAbs( d );
+}
+
+//Adjusts an interpolation parameter so that nlerp closely follows slerp.
+//The polynomial fit keeps the angular error well below 0.001 radians.
+static inline simd4f SlerpCorrection( simd4f t, simd4f d ) {
+	simd4f half = SimdSplat( 0.5f );
+	simd4f one = SimdSplat( 1.0f );
+	simd4f a = SimdMadd( d, SimdMadd( d, SimdMadd( d, SimdSplat( -1.43519f ), SimdSplat( 3.55645f ) ), SimdSplat( -3.2452f ) ), SimdSplat( 1.0904f ) );
+	simd4f b = SimdMadd( d, SimdMadd( d, SimdSplat( 0.215638f ), SimdSplat( -1.06021f ) ), SimdSplat( 0.848013f ) );
+	simd4f tm = SimdSub( t, half );
+	simd4f k = SimdMadd( SimdMul( a, tm ), tm, b );
+	return SimdMadd( SimdMul( SimdMul( t, tm ), SimdSub( t, one ) ), k, t );
+}
+
+//Interpolates from a to b by t, b must already be aligned with a
+static inline QuatLanes LerpLanes( const QuatLanes & a, const QuatLanes & b, simd4f t ) {
+	QuatLanes r;
+	r.w = SimdMadd( SimdSub( b.w, a.w ), t, a.w );
+	r.x = SimdMadd( SimdSub( b.x, a.x ), t, a.x );
+	r.y = SimdMadd( SimdSub( b.y, a.y ), t, a.y );
+	r.z = SimdMadd( SimdSub( b.z, a.z ), t, a.z );
+	NormalizeLanes( r );
+	return r;
+}
+
+//Hamilton product a * b
+static inline QuatLanes MultiplyLanes( const QuatLanes & a, const QuatLanes & b ) {
+	QuatLanes r;
+	r.w = SimdSub( SimdSub( SimdSub( SimdMul( a.w, b.w ), SimdMul( a.x, b.x ) ), SimdMul( a.y, b.y ) ), SimdMul( a.z, b.z ) );
+	r.x = SimdSub( SimdAdd( SimdAdd( SimdMul( a.w, b.x ), SimdMul( a.x, b.w ) ), SimdMul( a.y, b.z ) ), SimdMul( a.z, b.y ) );
+	r.y = SimdAdd( SimdAdd( SimdSub( SimdMul( a.w, b.y ), SimdMul( a.x, b.z ) ), SimdMul( a.y, b.w ) ), SimdMul( a.z, b.x ) );
+	r.z = SimdAdd( SimdSub( SimdAdd( SimdMul( a.w, b.z ), SimdMul( a.x, b.y ) ), SimdMul( a.y, b.x ) ), SimdMul( a.z, b.w ) );
+	return r;
+}
+
+static inline QuatLanes LoadRotation( const PoseBuffer & p, unsigned int i ) {
+	QuatLanes q;
+	q.w = SimdLoad( &p.qw[i] );
+	q.x = SimdLoad( &p.qx[i] );
+	q.y = SimdLoad( &p.qy[i] );
+	q.z = SimdLoad( &p.qz[i] );
+	return q;
+}
+
+//--PoseBlender--//
+
+PoseBlender::PoseBlender( PoseBlendMode m ) : mode(m), reference(NULL) {}
+
+PoseBlender::~PoseBlender() {}
+
+void PoseBlender::SetReferencePose( const PoseBuffer * ref ) {
+	reference = ref;
+}
+
+void PoseBlender::AddLayer( const PoseBuffer & pose, float weight, int priority, bool additive ) {
+	Layer l;
+	l.pose = &pose;
+	l.weight = weight;
+	l.priority = priority;
+	l.additive = additive;
+	layers.push_back( l );
+}
+
+void PoseBlender::ClearLayers() {
+	layers.clear();
+}
+
+unsigned int PoseBlender::GetNumLayers() const {
+	return (unsigned int)layers.size();
+}
+
+//Orders blended layers from highest to lowest priority
+static bool BlendLayerOrder( const pair<int,unsigned int> & a, const pair<int,unsigned int> & b ) {
+	if ( a.first != b.first ) {
+		return a.first > b.first;
+	}
+	return a.second < b.second;
+}
+
+void PoseBlender::Blend( PoseBuffer & out ) const {
+	//Determine the pose size and make sure all layers agree
+	unsigned int num_bones = 0;
+	bool found = false;
+	if ( reference != NULL ) {
+		num_bones = reference->GetNumBones();
+		found = true;
+	}
+	for ( size_t i = 0; i < layers.size(); ++i ) {
+		if ( !found ) {
+			num_bones = layers[i].pose->GetNumBones();
+			found = true;
+		} else if ( layers[i].pose->GetNumBones() != num_bones ) {
+			throw runtime_error("PoseBlender::Blend was called with poses that have different numbers of bones.");
+		}
+	}
+
+	//Split layers into blended and additive, ordered by priority
+	vector< pair<int,unsigned int> > blended, additive;
+	for ( unsigned int i = 0; i < layers.size(); ++i ) {
+		if ( layers[i].weight <= 0.0f ) {
+			continue;
+		}
+		if ( layers[i].additive ) {
+			additive.push_back( pair<int,unsigned int>( layers[i].priority, i ) );
+		} else {
+			blended.push_back( pair<int,unsigned int>( layers[i].priority, i ) );
+		}
+	}
+	sort( blended.begin(), blended.end(), BlendLayerOrder );
+	//Additive layers are applied lowest priority first so higher ones end up on top
+	sort( additive.begin(), additive.end() );
+
+	out.Resize( num_bones );
+	unsigned int padded = SimdPadCount( num_bones );
+
+	const simd4f zero = SimdZero();
+	const simd4f one = SimdSplat( 1.0f );
+	const simd4f epsilon = SimdSplat( 1.0e-6f );
+
+	for ( unsigned int b = 0; b < padded; b += SIMD_WIDTH ) {
+		simd4f acc_tx = zero, acc_ty = zero, acc_tz = zero, acc_s = zero;
+		simd4f acc_w = zero;
+		simd4f remaining = one;
+		QuatLanes acc_q;
+		acc_q.w = acc_q.x = acc_q.y = acc_q.z = zero;
+
+		size_t g = 0;
+		while ( g < blended.size() ) {
+			//Find the extent of this priority group
+			size_t g_end = g;
+			while ( g_end < blended.size() && blended[g_end].first == blended[g].first ) {
+				++g_end;
+			}
+
+			//Sum the weights of the group
+			simd4f group_sum = zero;
+			for ( size_t j = g; j < g_end; ++j ) {
+				const Layer & l = layers[ blended[j].second ];
+				group_sum = SimdMadd( SimdLoad( &l.pose->weight[b] ), SimdSplat( l.weight ), group_sum );
+			}
+
+			//The group claims up to its summed weight of what is left
+			simd4f claim = SimdMul( SimdMin( group_sum, one ), remaining );
+			simd4f share = SimdDiv( claim, SimdMax( group_sum, epsilon ) );
+			remaining = SimdSub( remaining, claim );
+
+			for ( size_t j = g; j < g_end; ++j ) {
+				const Layer & l = layers[ blended[j].second ];
+				const PoseBuffer & p = *l.pose;
+				simd4f c = SimdMul( SimdMul( SimdLoad( &p.weight[b] ), SimdSplat( l.weight ) ), share );
+				if ( !SimdAnyTrue( SimdGreater( c, zero ) ) ) {
+					continue;
+				}
+
+				acc_tx = SimdMadd( SimdLoad( &p.tx[b] ), c, acc_tx );
+				acc_ty = SimdMadd( SimdLoad( &p.ty[b] ), c, acc_ty );
+				acc_tz = SimdMadd( SimdLoad( &p.tz[b] ), c, acc_tz );
+				acc_s = SimdMadd( SimdLoad( &p.scale[b] ), c, acc_s );
+
+				QuatLanes q = LoadRotation( p, b );
+				simd4f d = AlignLanes( acc_q, q );
+				if ( mode == POSE_BLEND_SLERP ) {
+					//Incremental slerp towards q by its share of the weight so far
+					simd4f total = SimdAdd( acc_w, c );
+					simd4f t = SimdDiv( c, SimdMax( total, epsilon ) );
+					simd4f first = SimdLess( acc_w, epsilon );
+					QuatLanes r = LerpLanes( acc_q, q, SlerpCorrection( t, d ) );
+					simd4f skip = SimdLess( c, epsilon );
+					acc_q.w = SimdSelect( skip, acc_q.w, SimdSelect( first, q.w, r.w ) );
+					acc_q.x = SimdSelect( skip, acc_q.x, SimdSelect( first, q.x, r.x ) );
+					acc_q.y = SimdSelect( skip, acc_q.y, SimdSelect( first, q.y, r.y ) );
+					acc_q.z = SimdSelect( skip, acc_q.z, SimdSelect( first, q.z, r.z ) );
+				} else {
+					acc_q.w = SimdMadd( q.w, c, acc_q.w );
+					acc_q.x = SimdMadd( q.x, c, acc_q.x );
+					acc_q.y = SimdMadd( q.y, c, acc_q.y );
+					acc_q.z = SimdMadd( q.z, c, acc_q.z );
+				}
+				acc_w = SimdAdd( acc_w, c );
+			}
+
+			g = g_end;
+		}
+
+		//Fill whatever weight is left from the reference pose
+		if ( reference != NULL ) {
+			const PoseBuffer & p = *reference;
+			simd4f c = remaining;
+			acc_tx = SimdMadd( SimdLoad( &p.tx[b] ), c, acc_tx );
+			acc_ty = SimdMadd( SimdLoad( &p.ty[b] ), c, acc_ty );
+			acc_tz = SimdMadd( SimdLoad( &p.tz[b] ), c, acc_tz );
+			acc_s = SimdMadd( SimdLoad( &p.scale[b] ), c, acc_s );
+			QuatLanes q = LoadRotation( p, b );
+			simd4f d = AlignLanes( acc_q, q );
+			if ( mode == POSE_BLEND_SLERP ) {
+				simd4f total = SimdAdd( acc_w, c );
+				simd4f t = SimdDiv( c, SimdMax( total, epsilon ) );
+				QuatLanes r = LerpLanes( acc_q, q, SlerpCorrection( t, d ) );
+				simd4f first = SimdLess( acc_w, epsilon );
+				simd4f skip = SimdLess( c, epsilon );
+				acc_q.w = SimdSelect( skip, acc_q.w, SimdSelect( first, q.w, r.w ) );
+				acc_q.x = SimdSelect( skip, acc_q.x, SimdSelect( first, q.x, r.x ) );
+				acc_q.y = SimdSelect( skip, acc_q.y, SimdSelect( first, q.y, r.y ) );
+				acc_q.z = SimdSelect( skip, acc_q.z, SimdSelect( first, q.z, r.z ) );
+			} else {
+				acc_q.w = SimdMadd( q.w, c, acc_q.w );
+				acc_q.x = SimdMadd( q.x, c, acc_q.x );
+				acc_q.y = SimdMadd( q.y, c, acc_q.y );
+				acc_q.z = SimdMadd( q.z, c, acc_q.z );
+			}
+			acc_w = SimdAdd( acc_w, c );
+		}
+
+		//Renormalize; bones nobody touched end up at the identity
+		simd4f untouched = SimdLess( acc_w, epsilon );
+		simd4f inv_w = SimdDiv( one, SimdMax( acc_w, epsilon ) );
+		simd4f out_tx = SimdSelect( untouched, zero, SimdMul( acc_tx, inv_w ) );
+		simd4f out_ty = SimdSelect( untouched, zero, SimdMul( acc_ty, inv_w ) );
+		simd4f out_tz = SimdSelect( untouched, zero, SimdMul( acc_tz, inv_w ) );
+		simd4f out_s = SimdSelect( untouched, one, SimdMul( acc_s, inv_w ) );
+		NormalizeLanes( acc_q );
+
+		//Apply additive layers on top
+		for ( size_t j = 0; j < additive.size(); ++j ) {
+			const Layer & l = layers[ additive[j].second ];
+			const PoseBuffer & p = *l.pose;
+			simd4f c = SimdMul( SimdLoad( &p.weight[b] ), SimdSplat( l.weight ) );
+			if ( !SimdAnyTrue( SimdGreater( c, zero ) ) ) {
+				continue;
+			}
+
+			out_tx = SimdMadd( SimdLoad( &p.tx[b] ), c, out_tx );
+			out_ty = SimdMadd( SimdLoad( &p.ty[b] ), c, out_ty );
+			out_tz = SimdMadd( SimdLoad( &p.tz[b] ), c, out_tz );
+			out_s = SimdMul( out_s, SimdMadd( SimdSub( SimdLoad( &p.scale[b] ), one ), c, one ) );
+
+			//Scale the delta rotation by interpolating from the identity
+			QuatLanes identity;
+			identity.w = one;
+			identity.x = identity.y = identity.z = zero;
+			QuatLanes delta = LoadRotation( p, b );
+			simd4f d = AlignLanes( identity, delta );
+			simd4f t = SimdMin( c, one );
+			if ( mode == POSE_BLEND_SLERP ) {
+				t = SlerpCorrection( t, d );
+			}
+			delta = LerpLanes( identity, delta, t );
+			acc_q = MultiplyLanes( delta, acc_q );
+			NormalizeLanes( acc_q );
+			untouched = SimdSelect( SimdGreater( c, zero ), zero, untouched );
+		}
+
+		SimdStore( &out.tx[b], out_tx );
+		SimdStore( &out.ty[b], out_ty );
+		SimdStore( &out.tz[b], out_tz );
+		SimdStore( &out.scale[b], out_s );
+		SimdStore( &out.qw[b], acc_q.w );
+		SimdStore( &out.qx[b], acc_q.x );
+		SimdStore( &out.qy[b], acc_q.y );
+		SimdStore( &out.qz[b], acc_q.z );
+		SimdStore( &out.weight[b], SimdSelect( untouched, zero, one ) );
+	}
+
+	//Padding lanes must stay weightless
+	for ( unsigned int i = num_bones; i < padded; ++i ) {
+		out.weight[i] = 0.0f;
+	}
+}
+
+void PoseBlender::MakeAdditive( const PoseBuffer & pose, const PoseBuffer & ref, PoseBuffer & out ) {
+	if ( pose.GetNumBones() != ref.GetNumBones() ) {
+		throw runtime_error("PoseBlender::MakeAdditive was called with poses that have different numbers of bones.");
+	}
+
+	unsigned int num_bones = pose.GetNumBones();
+	out.Resize( num_bones );
+	unsigned int padded = SimdPadCount( num_bones );
+
+	for ( unsigned int b = 0; b < padded; b += SIMD_WIDTH ) {
+		SimdStore( &out.tx[b], SimdSub( SimdLoad( &pose.tx[b] ), SimdLoad( &ref.tx[b] ) ) );
+		SimdStore( &out.ty[b], SimdSub( SimdLoad( &pose.ty[b] ), SimdLoad( &ref.ty[b] ) ) );
+		SimdStore( &out.tz[b], SimdSub( SimdLoad( &pose.tz[b] ), SimdLoad( &ref.tz[b] ) ) );
+
+		simd4f ref_s = SimdLoad( &ref.scale[b] );
+		simd4f safe = SimdGreater( SimdAbs( ref_s ), SimdSplat( 1.0e-6f ) );
+		simd4f ratio = SimdDiv( SimdLoad( &pose.scale[b] ), SimdSelect( safe, ref_s, SimdSplat( 1.0f ) ) );
+		SimdStore( &out.scale[b], SimdSelect( safe, ratio, SimdSplat( 1.0f ) ) );
+
+		//delta = pose * inverse(ref)
+		QuatLanes inv = LoadRotation( ref, b );
+		inv.x = SimdSub( SimdZero(), inv.x );
+		inv.y = SimdSub( SimdZero(), inv.y );
+		inv.z = SimdSub( SimdZero(), inv.z );
+		QuatLanes delta = MultiplyLanes( LoadRotation( pose, b ), inv );
+		NormalizeLanes( delta );
+		SimdStore( &out.qw[b], delta.w );
+		SimdStore( &out.qx[b], delta.x );
+		SimdStore( &out.qy[b], delta.y );
+		SimdStore( &out.qz[b], delta.z );
+
+		SimdStore( &out.weight[b], SimdLoad( &pose.weight[b] ) );
+	}
+}
+
+//--SequencePoseSampler--//
+
+struct SequencePoseSampler::Channel {
+	unsigned int bone;
+	Vector3 translation;
+	Quaternion rotation;
+	float scale;
+	KeyType rotateType;
+	KeyType translateType;
+	KeyType scaleType;
+	vector< Key<Quaternion> > quatKeys;
+	vector< Key<float> > xyzKeys[3];
+	KeyType xyzTypes[3];
+	vector< Key<Vector3> > translateKeys;
+	vector< Key<float> > scaleKeys;
+};
+
+static Quaternion SlerpQuat( const Quaternion & a, Quaternion b, float t ) {
+	float d = a.Dot( b );
+	if ( d < 0.0f ) {
+		b = b * -1.0f;
+		d = -d;
+	}
+	float ka, kb;
+	if ( d > 0.9995f ) {
+		ka = 1.0f - t;
+		kb = t;
+	} else {
+		float theta = acos( d );
+		float sin_theta = sin( theta );
+		ka = sin( ( 1.0f - t ) * theta ) / sin_theta;
+		kb = sin( t * theta ) / sin_theta;
+	}
+	Quaternion r = a * ka + b * kb;
+	float len = sqrt( r.Dot( r ) );
+	return ( len > 0.0f ) ? r * ( 1.0f / len ) : Quaternion( 1.0f, 0.0f, 0.0f, 0.0f );
+}
+
+static Quaternion InterpolateQuatKeys( const vector< Key<Quaternion> > & keys, KeyType type, float time, const Quaternion & default_value ) {
+	if ( keys.empty() ) {
+		return default_value;
+	}
+	float t;
+	size_t i = FindKeyInterval( keys, time, t );
+	if ( i + 1 >= keys.size() || t <= 0.0f || type == CONST_KEY ) {
+		return keys[i].data;
+	}
+	//Quadratic and TBC rotation keys carry no usable tangents, so they are
+	//interpolated spherically between the bracketing keys as well
+	return SlerpQuat( keys[i].data, keys[i + 1].data, t );
+}
+
+static Quaternion AxisAngle( float x, float y, float z, float angle ) {
+	float s = sin( angle * 0.5f );
+	return Quaternion( cos( angle * 0.5f ), x * s, y * s, z * s );
+}
+
+static Quaternion MultiplyQuat( const Quaternion & a, const Quaternion & b ) {
+	return Quaternion(
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+		a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+		a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w );
+}
+
+static bool IsValidComponent( float f ) {
+	return f > INVALID_COMPONENT;
+}
+
+SequencePoseSampler::SequencePoseSampler( NiControllerSequence * seq, const vector<string> & bone_names ) {
+	if ( seq == NULL ) {
+		throw runtime_error("SequencePoseSampler was constructed with a NULL sequence.");
+	}
+
+	numBones = (unsigned int)bone_names.size();
+	weight = seq->GetWeight();
+	startTime = seq->GetStartTime();
+	stopTime = seq->GetStopTime();
+	cycleType = seq->GetCycleType();
+	priority = 0;
+
+	map<string,unsigned int> bone_map;
+	for ( unsigned int i = 0; i < bone_names.size(); ++i ) {
+		bone_map[ bone_names[i] ] = i;
+	}
+
+	vector<ControllerLink> links = seq->GetControllerData();
+	channels.reserve( links.size() );
+	//The destructor does not run if the constructor throws, so free the
+	//channels made so far if copying the keys of a later one fails
+	try {
+		for ( size_t i = 0; i < links.size(); ++i ) {
+			const ControllerLink & link = links[i];
+
+			string node_name;
+			if ( link.stringPalette != NULL ) {
+				node_name = link.stringPalette->GetSubStr( link.nodeNameOffset );
+			} else if ( !link.nodeName.empty() ) {
+				node_name = link.nodeName;
+			} else {
+				node_name = link.targetName;
+			}
+
+			map<string,unsigned int>::iterator it = bone_map.find( node_name );
+			if ( it == bone_map.end() ) {
+				continue;
+			}
+
+			//Find the transform source of this channel
+			NiKeyframeDataRef data;
+			NiTransformInterpolatorRef interp = DynamicCast<NiTransformInterpolator>( link.interpolator );
+			if ( interp != NULL ) {
+				data = StaticCast<NiKeyframeData>( interp->GetData() );
+			} else {
+				NiKeyframeControllerRef ctlr = DynamicCast<NiKeyframeController>( link.controller );
+				if ( ctlr == NULL ) {
+					continue;
+				}
+				data = ctlr->GetData();
+				if ( data == NULL ) {
+					interp = DynamicCast<NiTransformInterpolator>( ctlr->GetInterpolator() );
+					if ( interp != NULL ) {
+						data = StaticCast<NiKeyframeData>( interp->GetData() );
+					}
+				}
+			}
+
+			//Owned by channels from here on, which cannot grow past its reserve
+			Channel * ch = new Channel;
+			channels.push_back( ch );
+			ch->bone = it->second;
+			ch->translation = Vector3();
+			ch->rotation = Quaternion( 1.0f, 0.0f, 0.0f, 0.0f );
+			ch->scale = 1.0f;
+			ch->rotateType = ch->translateType = ch->scaleType = LINEAR_KEY;
+
+			if ( interp != NULL ) {
+				Vector3 t = interp->GetTranslation();
+				if ( IsValidComponent( t.x ) ) {
+					ch->translation = t;
+				}
+				Quaternion q = interp->GetRotation();
+				if ( IsValidComponent( q.w ) ) {
+					ch->rotation = q;
+				}
+				float s = interp->GetScale();
+				if ( IsValidComponent( s ) ) {
+					ch->scale = s;
+				}
+			}
+
+			if ( data != NULL ) {
+				ch->rotateType = data->GetRotateType();
+				if ( ch->rotateType == XYZ_ROTATION_KEY ) {
+					ch->xyzKeys[0] = data->GetXRotateKeys();
+					ch->xyzKeys[1] = data->GetYRotateKeys();
+					ch->xyzKeys[2] = data->GetZRotateKeys();
+					ch->xyzTypes[0] = data->GetXRotateType();
+					ch->xyzTypes[1] = data->GetYRotateType();
+					ch->xyzTypes[2] = data->GetZRotateType();
+				} else {
+					ch->quatKeys = data->GetQuatRotateKeys();
+				}
+				ch->translateType = data->GetTranslateType();
+				ch->translateKeys = data->GetTranslateKeys();
+				ch->scaleType = data->GetScaleType();
+				ch->scaleKeys = data->GetScaleKeys();
+			}
+
+			priority = max( priority, (int)link.priority );
+		}
+	} catch ( ... ) {
+		for ( size_t i = 0; i < channels.size(); ++i ) {
+			delete channels[i];
+		}
+		throw;
+	}
+}
+
+SequencePoseSampler::~SequencePoseSampler() {
+	for ( size_t i = 0; i < channels.size(); ++i ) {
+		delete channels[i];
+	}
+}
+
+float SequencePoseSampler::GetWeight() const {
+	return weight;
+}
+
+int SequencePoseSampler::GetPriority() const {
+	return priority;
+}
+
+unsigned int SequencePoseSampler::GetNumChannels() const {
+	return (unsigned int)channels.size();
+}
+
+void SequencePoseSampler::Sample( float time, PoseBuffer & out ) const {
+	//Map the time into the range of the sequence
+	float length = stopTime - startTime;
+	if ( length > 0.0f ) {
+		float rel = time - startTime;
+		if ( cycleType == CYCLE_LOOP ) {
+			rel = fmod( rel, length );
+			if ( rel < 0.0f ) {
+				rel += length;
+			}
+		} else if ( cycleType == CYCLE_REVERSE ) {
+			rel = fmod( rel, 2.0f * length );
+			if ( rel < 0.0f ) {
+				rel += 2.0f * length;
+			}
+			if ( rel > length ) {
+				rel = 2.0f * length - rel;
+			}
+		} else {
+			rel = min( max( rel, 0.0f ), length );
+		}
+		time = startTime + rel;
+	}
+
+	out.Resize( numBones );
+	out.SetIdentity( 0.0f );
+
+	for ( size_t i = 0; i < channels.size(); ++i ) {
+		const Channel & ch = *channels[i];
+
+		Quaternion rot;
+		if ( ch.rotateType == XYZ_ROTATION_KEY ) {
+			float x = InterpolateKeys( ch.xyzKeys[0], ch.xyzTypes[0], time, 0.0f );
+			float y = InterpolateKeys( ch.xyzKeys[1], ch.xyzTypes[1], time, 0.0f );
+			float z = InterpolateKeys( ch.xyzKeys[2], ch.xyzTypes[2], time, 0.0f );
+			rot = MultiplyQuat( AxisAngle( 0.0f, 0.0f, 1.0f, z ), MultiplyQuat( AxisAngle( 0.0f, 1.0f, 0.0f, y ), AxisAngle( 1.0f, 0.0f, 0.0f, x ) ) );
+		} else {
+			rot = InterpolateQuatKeys( ch.quatKeys, ch.rotateType, time, ch.rotation );
+		}
+		Vector3 trans = InterpolateKeys( ch.translateKeys, ch.translateType, time, ch.translation );
+		float s = InterpolateKeys( ch.scaleKeys, ch.scaleType, time, ch.scale );
+
+		out.SetTransform( ch.bone, trans, rot, s, 1.0f );
+	}
+}
+
+} //End Niflib namespace
@@ -2,6 +2,7 @@
 All rights reserved.  Please see niflib.h for license. */
 
 #include "../include/RefObject.h"
+#include "../include/ObjectArena.h"
 using namespace Niflib;
 
 //Definition of TYPE constant
@@ -26,7 +27,7 @@ const Type & RefObject::GetType() const {
 }
 
 
-unsigned int RefObject::objectsInMemory = 0;
+atomic<unsigned int> RefObject::objectsInMemory( 0 );
 
 bool RefObject::IsSameType( const Type & compare_to) const {
 	return GetType().IsSameType( compare_to );
@@ -55,6 +56,14 @@ void RefObject::SubtractRef() const {
 	}
 }
 
+void * RefObject::operator new( size_t size ) {
+	return ObjectArena::Allocate( size );
+}
+
+void RefObject::operator delete( void * p ) {
+	ObjectArena::Free( p );
+}
+
 unsigned int RefObject::NumObjectsInMemory() {
 	return objectsInMemory;
 }
@@ -0,0 +1,297 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/TextureIndex.h"
+#include "../include/niflib.h"
+#include "../include/NIF_IO.h"
+#include "../include/gen/Header.h"
+#include "../include/obj/NiSourceTexture.h"
+#include "../include/obj/NiSourceCubeMap.h"
+#include "../include/obj/NiImage.h"
+#include "../include/obj/BSShaderTextureSet.h"
+#include "../include/obj/BSEffectShaderProperty.h"
+#include "../include/obj/BSSkyShaderProperty.h"
+#include "../include/obj/BSShaderNoLightingProperty.h"
+#include "../include/obj/SkyShaderProperty.h"
+#include "../include/obj/TallGrassShaderProperty.h"
+#include "../include/obj/TileShaderProperty.h"
+#include "NifParallel.h"
+#include <atomic>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <set>
+#include <cctype>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace Niflib {
+
+//The block types that can hold a texture path.  Only these are read when
+//the header gives the size of every block.
+struct TextureBlockType {
+	const char * name;
+	NiObject * (*create)();
+};
+
+static const TextureBlockType texture_block_types[] = {
+	{ "NiSourceTexture", NiSourceTexture::Create },
+	{ "NiSourceCubeMap", NiSourceCubeMap::Create },
+	{ "NiImage", NiImage::Create },
+	{ "BSShaderTextureSet", BSShaderTextureSet::Create },
+	{ "BSEffectShaderProperty", BSEffectShaderProperty::Create },
+	{ "BSSkyShaderProperty", BSSkyShaderProperty::Create },
+	{ "BSShaderNoLightingProperty", BSShaderNoLightingProperty::Create },
+	{ "SkyShaderProperty", SkyShaderProperty::Create },
+	{ "TallGrassShaderProperty", TallGrassShaderProperty::Create },
+	{ "TileShaderProperty", TileShaderProperty::Create }
+};
+
+static const TextureBlockType * FindTextureBlockType( const string & name ) {
+	for ( size_t i = 0; i < sizeof(texture_block_types) / sizeof(texture_block_types[0]); ++i ) {
+		if ( name == texture_block_types[i].name ) {
+			return &texture_block_types[i];
+		}
+	}
+	return NULL;
+}
+
+static string ToLower( string s ) {
+	for ( size_t i = 0; i < s.size(); ++i ) {
+		s[i] = (char)tolower( (unsigned char)s[i] );
+	}
+	return s;
+}
+
+//Adds a path to the list unless it is empty or already there
+static void AddPath( const string & path, vector<string> & textures, set<string> & seen ) {
+	if ( !path.empty() && seen.insert( ToLower( path ) ).second ) {
+		textures.push_back( path );
+	}
+}
+
+static void AddTextures( NiObject * obj, vector<string> & textures, set<string> & seen ) {
+	if ( obj->IsDerivedType( NiSourceTexture::TYPE ) ) {
+		NiSourceTexture * src = static_cast<NiSourceTexture *>(obj);
+		if ( src->IsTextureExternal() ) {
+			AddPath( src->GetTextureFileName(), textures, seen );
+		}
+	} else if ( obj->IsDerivedType( NiImage::TYPE ) ) {
+		NiImage * image = static_cast<NiImage *>(obj);
+		if ( image->IsTextureExternal() ) {
+			AddPath( image->GetTextureFileName(), textures, seen );
+		}
+	} else if ( obj->IsDerivedType( BSShaderTextureSet::TYPE ) ) {
+		vector<string> paths = static_cast<BSShaderTextureSet *>(obj)->GetTextures();
+		for ( size_t i = 0; i < paths.size(); ++i ) {
+			AddPath( paths[i], textures, seen );
+		}
+	} else if ( obj->IsDerivedType( BSEffectShaderProperty::TYPE ) ) {
+		BSEffectShaderProperty * effect = static_cast<BSEffectShaderProperty *>(obj);
+		AddPath( effect->GetSourceTexture(), textures, seen );
+		AddPath( effect->GetGreyscaleTexture(), textures, seen );
+	} else if ( obj->IsDerivedType( BSSkyShaderProperty::TYPE ) ) {
+		AddPath( static_cast<BSSkyShaderProperty *>(obj)->GetSourceTexture(), textures, seen );
+	} else if ( obj->IsDerivedType( BSShaderNoLightingProperty::TYPE ) ) {
+		AddPath( static_cast<BSShaderNoLightingProperty *>(obj)->GetFileName(), textures, seen );
+	} else if ( obj->IsDerivedType( SkyShaderProperty::TYPE ) ) {
+		AddPath( static_cast<SkyShaderProperty *>(obj)->GetFileName(), textures, seen );
+	} else if ( obj->IsDerivedType( TallGrassShaderProperty::TYPE ) ) {
+		AddPath( static_cast<TallGrassShaderProperty *>(obj)->GetFileName(), textures, seen );
+	} else if ( obj->IsDerivedType( TileShaderProperty::TYPE ) ) {
+		AddPath( static_cast<TileShaderProperty *>(obj)->GetFileName(), textures, seen );
+	}
+}
+
+//Reads the texture blocks of a file and skips the rest, or reads the whole
+//file if the header does not give the block sizes
+static vector<string> ReadTextureReferences( istream & in, unsigned int & blocks_read, unsigned int & blocks_total ) {
+	vector<string> textures;
+	set<string> seen;
+	streampos start = in.tellg();
+
+	Header header;
+	hdrInfo hinfo( &header );
+	in >> hinfo;
+	NifInfo info;
+	try {
+		info = header.Read( in );
+	} catch ( ... ) {
+		hdrInfo hinfo2( NULL );
+		in >> hinfo2;
+		throw;
+	}
+
+	if ( header.version < VER_20_2_0_7 ) {
+		hdrInfo hinfo2( NULL );
+		in >> hinfo2;
+		in.seekg( start );
+		vector<NiObjectRef> objects = ReadNifList( in );
+		for ( size_t i = 0; i < objects.size(); ++i ) {
+			AddTextures( objects[i], textures, seen );
+		}
+		blocks_read = blocks_total = (unsigned int)objects.size();
+		return textures;
+	}
+
+	blocks_read = 0;
+	blocks_total = header.numBlocks;
+	list<unsigned int> link_stack;
+	streampos pos = in.tellg();
+	try {
+		for ( unsigned int i = 0; i < header.numBlocks; ++i ) {
+			const TextureBlockType * type = FindTextureBlockType( header.blockTypes[ header.blockTypeIndex[i] ] );
+			if ( type != NULL ) {
+				in.seekg( pos );
+				NiObjectRef obj = type->create();
+				obj->Read( in, link_stack, info );
+				if ( in.fail() ) {
+					throw runtime_error( "End of file reached prematurely while reading a " + string(type->name) + "." );
+				}
+				AddTextures( obj, textures, seen );
+				++blocks_read;
+			}
+			pos += header.blockSize[i];
+		}
+	} catch ( ... ) {
+		hdrInfo hinfo2( NULL );
+		in >> hinfo2;
+		throw;
+	}
+
+	hdrInfo hinfo2( NULL );
+	in >> hinfo2;
+	return textures;
+}
+
+vector<string> ReadTextureReferences( istream & in, unsigned int * blocks_read ) {
+	unsigned int read = 0, total = 0;
+	vector<string> textures = ReadTextureReferences( in, read, total );
+	if ( blocks_read != NULL ) {
+		*blocks_read = read;
+	}
+	return textures;
+}
+
+vector<string> ReadTextureReferences( string const & file_name, unsigned int * blocks_read ) {
+	ifstream in( file_name.c_str(), ifstream::binary );
+	if ( !in ) {
+		throw runtime_error( "Could not open " + file_name + " for reading." );
+	}
+	return ReadTextureReferences( in, blocks_read );
+}
+
+//--Directory Search--//
+
+static bool HasExtension( const string & name, const string & extension ) {
+	return name.size() > extension.size() && ToLower( name.substr( name.size() - extension.size() ) ) == ToLower( extension );
+}
+
+static void FindFiles( const string & directory, const string & extension, vector<string> & files ) {
+	vector<string> dirs;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA( (directory + "\\*").c_str(), &data );
+	if ( find == INVALID_HANDLE_VALUE ) {
+		return;
+	}
+	do {
+		string name = data.cFileName;
+		if ( name == "." || name == ".." ) {
+			continue;
+		}
+		string path = directory + "\\" + name;
+		if ( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) {
+			dirs.push_back( path );
+		} else if ( HasExtension( name, extension ) ) {
+			files.push_back( path );
+		}
+	} while ( FindNextFileA( find, &data ) );
+	FindClose( find );
+#else
+	DIR * dir = opendir( directory.c_str() );
+	if ( dir == NULL ) {
+		return;
+	}
+	while ( dirent * entry = readdir( dir ) ) {
+		string name = entry->d_name;
+		if ( name == "." || name == ".." ) {
+			continue;
+		}
+		string path = directory + "/" + name;
+		struct stat st;
+		if ( stat( path.c_str(), &st ) != 0 ) {
+			continue;
+		}
+		if ( S_ISDIR( st.st_mode ) ) {
+			dirs.push_back( path );
+		} else if ( HasExtension( name, extension ) ) {
+			files.push_back( path );
+		}
+	}
+	closedir( dir );
+#endif
+	for ( size_t i = 0; i < dirs.size(); ++i ) {
+		FindFiles( dirs[i], extension, files );
+	}
+}
+
+vector<string> FindNifFiles( const string & directory, const string & extension ) {
+	vector<string> files;
+	FindFiles( directory, extension, files );
+	sort( files.begin(), files.end() );
+	return files;
+}
+
+//--Batch Scan--//
+
+unsigned int ScanTextureReferences( const vector<string> & files, vector<TextureReferences> & results, unsigned int num_threads ) {
+	results.assign( files.size(), TextureReferences() );
+
+	atomic<size_t> next( 0 );
+	unsigned int threads = ParallelThreadCount( num_threads, files.size() );
+	ParallelFor( threads, threads, [&]( size_t, size_t ) {
+		for ( size_t i = next++; i < files.size(); i = next++ ) {
+			TextureReferences & result = results[i];
+			result.file = files[i];
+			try {
+				ifstream in( files[i].c_str(), ifstream::binary );
+				if ( !in ) {
+					throw runtime_error( "Could not open " + files[i] + " for reading." );
+				}
+				result.textures = ReadTextureReferences( in, result.blocksRead, result.blocksTotal );
+			} catch ( exception & e ) {
+				result.textures.clear();
+				result.error = e.what();
+				if ( result.error.empty() ) {
+					result.error = "Unknown error";
+				}
+			}
+		}
+	} );
+
+	unsigned int failed = 0;
+	for ( size_t i = 0; i < results.size(); ++i ) {
+		if ( !results[i].error.empty() ) {
+			++failed;
+		}
+	}
+	return failed;
+}
+
+void WriteTextureIndex( ostream & out, const vector<TextureReferences> & results ) {
+	for ( size_t i = 0; i < results.size(); ++i ) {
+		if ( !results[i].error.empty() ) {
+			continue;
+		}
+		for ( size_t j = 0; j < results[i].textures.size(); ++j ) {
+			out << results[i].file << '\t' << results[i].textures[j] << '\n';
+		}
+	}
+}
+
+} //End Niflib namespace
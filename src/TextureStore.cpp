@@ -0,0 +1,404 @@
+/* Copyright (c) 2006, NIF File Format Library and Tools
+All rights reserved.  Please see niflib.h for license. */
+
+#include "../include/TextureStore.h"
+#include "../include/MatTexCollection.h"
+#include "../include/PixelCodec.h"
+#include "../include/NIF_IO.h"
+#include "../include/niflib.h"
+#include "../include/obj/NiPixelData.h"
+#include "../include/obj/NiAVObject.h"
+#include "NifParallel.h"
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cctype>
+
+namespace Niflib {
+
+//--DDS Files--//
+
+static const unsigned int DDS_MAGIC = 0x20534444; //"DDS "
+static const unsigned int DDS_HEADER_SIZE = 124;
+static const unsigned int DDS_PIXELFORMAT_SIZE = 32;
+
+static const unsigned int DDSD_CAPS = 0x1;
+static const unsigned int DDSD_HEIGHT = 0x2;
+static const unsigned int DDSD_WIDTH = 0x4;
+static const unsigned int DDSD_PITCH = 0x8;
+static const unsigned int DDSD_PIXELFORMAT = 0x1000;
+static const unsigned int DDSD_MIPMAPCOUNT = 0x20000;
+static const unsigned int DDSD_LINEARSIZE = 0x80000;
+
+static const unsigned int DDPF_ALPHAPIXELS = 0x1;
+static const unsigned int DDPF_FOURCC = 0x4;
+static const unsigned int DDPF_RGB = 0x40;
+
+static const unsigned int DDSCAPS_COMPLEX = 0x8;
+static const unsigned int DDSCAPS_TEXTURE = 0x1000;
+static const unsigned int DDSCAPS_MIPMAP = 0x400000;
+static const unsigned int DDSCAPS2_CUBEMAP = 0x200;
+static const unsigned int DDSCAPS2_CUBEMAP_ALLFACES = 0xFC00;
+
+static const unsigned int FOURCC_DXT1 = 0x31545844;
+static const unsigned int FOURCC_DXT5 = 0x35545844;
+static const unsigned int FOURCC_DX10 = 0x30315844;
+
+//The layout of the DDS header, in 32-bit words after the magic number
+enum DdsWord {
+	DDS_SIZE = 0, DDS_FLAGS = 1, DDS_HEIGHT = 2, DDS_WIDTH = 3, DDS_PITCH = 4,
+	DDS_MIPMAPS = 6, DDS_PF_SIZE = 18, DDS_PF_FLAGS = 19, DDS_PF_FOURCC = 20,
+	DDS_PF_BITS = 21, DDS_PF_RED = 22, DDS_PF_GREEN = 23, DDS_PF_BLUE = 24,
+	DDS_PF_ALPHA = 25, DDS_CAPS = 26, DDS_CAPS2 = 27, DDS_WORDS = 31
+};
+
+//The size of each mipmap in a chain, halving each side as NiPixelData does
+static vector<unsigned int> MipmapSizes( PixelFormat format, unsigned int width, unsigned int height, unsigned int levels ) {
+	vector<unsigned int> sizes;
+	for ( unsigned int i = 0; i < levels; ++i ) {
+		sizes.push_back( GetPixelImageSize( format, width, height ) );
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return sizes;
+}
+
+void WriteDds( ostream & out, NiPixelData * pixel_data ) {
+	if ( pixel_data == NULL ) {
+		throw runtime_error("Cannot write a DDS file for NULL pixel data.");
+	}
+	unsigned int width = pixel_data->GetWidth();
+	unsigned int height = pixel_data->GetHeight();
+	unsigned int levels = pixel_data->GetMipmapCount();
+	unsigned int faces = pixel_data->GetFaceCount();
+	PixelFormat format = pixel_data->GetPixelFormat();
+
+	//Formats DDS has no match for are written as RGBA8
+	bool copy = ( format == PX_FMT_RGB8 || format == PX_FMT_RGBA8 || format == PX_FMT_DXT1 || format == PX_FMT_DXT5 || format == PX_FMT_DXT5_ALT );
+	PixelFormat stored = copy ? format : PX_FMT_RGBA8;
+	bool compressed = ( stored == PX_FMT_DXT1 || stored == PX_FMT_DXT5 || stored == PX_FMT_DXT5_ALT );
+	vector<unsigned int> sizes = MipmapSizes( stored, width, height, levels );
+
+	unsigned int header[DDS_WORDS] = { 0 };
+	header[DDS_SIZE] = DDS_HEADER_SIZE;
+	header[DDS_FLAGS] = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | ( compressed ? DDSD_LINEARSIZE : DDSD_PITCH );
+	header[DDS_HEIGHT] = height;
+	header[DDS_WIDTH] = width;
+	header[DDS_PITCH] = compressed ? sizes[0] : width * ( stored == PX_FMT_RGB8 ? 3 : 4 );
+	header[DDS_PF_SIZE] = DDS_PIXELFORMAT_SIZE;
+	header[DDS_CAPS] = DDSCAPS_TEXTURE;
+	if ( levels > 1 ) {
+		header[DDS_FLAGS] |= DDSD_MIPMAPCOUNT;
+		header[DDS_MIPMAPS] = levels;
+		header[DDS_CAPS] |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	}
+	if ( faces == 6 ) {
+		header[DDS_CAPS] |= DDSCAPS_COMPLEX;
+		header[DDS_CAPS2] = DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES;
+	} else if ( faces != 1 ) {
+		throw runtime_error("DDS files can only store one face or a full cube map.");
+	}
+	if ( compressed ) {
+		header[DDS_PF_FLAGS] = DDPF_FOURCC;
+		header[DDS_PF_FOURCC] = ( stored == PX_FMT_DXT1 ) ? FOURCC_DXT1 : FOURCC_DXT5;
+	} else {
+		header[DDS_PF_FLAGS] = DDPF_RGB | ( stored == PX_FMT_RGBA8 ? DDPF_ALPHAPIXELS : 0 );
+		header[DDS_PF_BITS] = ( stored == PX_FMT_RGB8 ) ? 24 : 32;
+		header[DDS_PF_RED] = 0x000000FF;
+		header[DDS_PF_GREEN] = 0x0000FF00;
+		header[DDS_PF_BLUE] = 0x00FF0000;
+		header[DDS_PF_ALPHA] = ( stored == PX_FMT_RGBA8 ) ? 0xFF000000 : 0;
+	}
+
+	WriteUInt( DDS_MAGIC, out );
+	for ( int i = 0; i < DDS_WORDS; ++i ) {
+		WriteUInt( header[i], out );
+	}
+
+	//Faces follow one another, each with all of its mipmaps
+	for ( unsigned int f = 0; f < faces; ++f ) {
+		if ( copy ) {
+			const vector<byte> & data = pixel_data->GetRawPixels( f );
+			size_t total = 0;
+			for ( size_t i = 0; i < sizes.size(); ++i ) {
+				total += sizes[i];
+			}
+			if ( data.size() < total ) {
+				throw runtime_error("The pixel data is too short for the mipmap sizes.");
+			}
+			out.write( (const char *)data.data(), total );
+		} else {
+			vector< vector<byte> > rgba = pixel_data->GetMipmapPixels( f, 1 );
+			for ( size_t i = 0; i < rgba.size(); ++i ) {
+				out.write( (const char *)rgba[i].data(), rgba[i].size() );
+			}
+		}
+	}
+}
+
+Ref<NiPixelData> ReadDds( istream & in ) {
+	if ( ReadUInt( in ) != DDS_MAGIC ) {
+		throw runtime_error("The file is not a DDS file.");
+	}
+	unsigned int header[DDS_WORDS];
+	for ( int i = 0; i < DDS_WORDS; ++i ) {
+		header[i] = ReadUInt( in );
+	}
+	if ( !in || header[DDS_SIZE] != DDS_HEADER_SIZE || header[DDS_PF_SIZE] != DDS_PIXELFORMAT_SIZE ) {
+		throw runtime_error("The DDS header is damaged.");
+	}
+
+	unsigned int width = header[DDS_WIDTH];
+	unsigned int height = header[DDS_HEIGHT];
+	unsigned int levels = 1;
+	if ( ( header[DDS_FLAGS] & DDSD_MIPMAPCOUNT ) != 0 && header[DDS_MIPMAPS] > 1 ) {
+		levels = header[DDS_MIPMAPS];
+	}
+	unsigned int faces = 1;
+	if ( ( header[DDS_CAPS2] & DDSCAPS2_CUBEMAP ) != 0 ) {
+		if ( ( header[DDS_CAPS2] & DDSCAPS2_CUBEMAP_ALLFACES ) != DDSCAPS2_CUBEMAP_ALLFACES ) {
+			throw runtime_error("DDS cube maps without all six faces are not supported.");
+		}
+		faces = 6;
+	}
+
+	//Pick the pixel format, and whether red and blue need to be swapped
+	PixelFormat format;
+	bool swap_red_blue = false;
+	bool opaque = false;
+	unsigned int pf_flags = header[DDS_PF_FLAGS];
+	if ( ( pf_flags & DDPF_FOURCC ) != 0 ) {
+		if ( header[DDS_PF_FOURCC] == FOURCC_DXT1 ) {
+			format = PX_FMT_DXT1;
+		} else if ( header[DDS_PF_FOURCC] == FOURCC_DXT5 ) {
+			format = PX_FMT_DXT5;
+		} else if ( header[DDS_PF_FOURCC] == FOURCC_DX10 ) {
+			throw runtime_error("DDS files with DX10 headers are not supported.");
+		} else {
+			throw runtime_error("The DDS compression format is not supported.");
+		}
+	} else if ( ( pf_flags & DDPF_RGB ) != 0 && ( header[DDS_PF_BITS] == 24 || header[DDS_PF_BITS] == 32 ) && header[DDS_PF_GREEN] == 0x0000FF00 ) {
+		if ( header[DDS_PF_RED] == 0x00FF0000 && header[DDS_PF_BLUE] == 0x000000FF ) {
+			swap_red_blue = true;
+		} else if ( header[DDS_PF_RED] != 0x000000FF || header[DDS_PF_BLUE] != 0x00FF0000 ) {
+			throw runtime_error("The DDS pixel format is not supported.");
+		}
+		format = ( header[DDS_PF_BITS] == 24 ) ? PX_FMT_RGB8 : PX_FMT_RGBA8;
+		opaque = ( format == PX_FMT_RGBA8 && ( ( pf_flags & DDPF_ALPHAPIXELS ) == 0 || header[DDS_PF_ALPHA] != 0xFF000000 ) );
+	} else {
+		throw runtime_error("The DDS pixel format is not supported.");
+	}
+
+	vector<unsigned int> sizes = MipmapSizes( format, width, height, levels );
+	size_t total = 0;
+	for ( size_t i = 0; i < sizes.size(); ++i ) {
+		total += sizes[i];
+	}
+	vector< vector<byte> > data( faces, vector<byte>( total ) );
+	for ( unsigned int f = 0; f < faces; ++f ) {
+		in.read( (char *)data[f].data(), total );
+		if ( in.gcount() != streamsize(total) ) {
+			throw runtime_error("The DDS file ended early.");
+		}
+		if ( swap_red_blue || opaque ) {
+			size_t step = ( format == PX_FMT_RGB8 ) ? 3 : 4;
+			for ( size_t i = 0; i + step <= total; i += step ) {
+				if ( swap_red_blue ) {
+					swap( data[f][i], data[f][i + 2] );
+				}
+				if ( opaque ) {
+					data[f][i + 3] = 255;
+				}
+			}
+		}
+	}
+
+	NiPixelDataRef pixel_data = new NiPixelData;
+	pixel_data->Reset( width, height, format, faces );
+	pixel_data->SetRawPixels( data, levels );
+	return pixel_data;
+}
+
+//--Texture Library--//
+
+//64-bit FNV-1a
+static unsigned long long HashBytes( const string & bytes ) {
+	unsigned long long hash = 14695981039346656037ULL;
+	for ( size_t i = 0; i < bytes.size(); ++i ) {
+		hash ^= (unsigned char)bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static string JoinPath( const string & directory, const string & name ) {
+	if ( directory.empty() ) {
+		return name;
+	}
+	char last = directory[directory.size() - 1];
+	if ( last == '/' || last == '\\' ) {
+		return directory + name;
+	}
+	return directory + "/" + name;
+}
+
+//The file name of the original texture, without directory or extension,
+//kept to characters that are safe in any file system
+static string BaseName( const string & file_name ) {
+	size_t start = file_name.find_last_of( "/\\" );
+	start = ( start == string::npos ) ? 0 : start + 1;
+	size_t end = file_name.find_last_of( '.' );
+	if ( end == string::npos || end < start ) {
+		end = file_name.size();
+	}
+	string base;
+	for ( size_t i = start; i < end; ++i ) {
+		unsigned char c = (unsigned char)file_name[i];
+		base += ( isalnum( c ) || c == '-' || c == '_' ) ? char(c) : '_';
+	}
+	return base;
+}
+
+TextureLibrary::TextureLibrary( const string & directory, const string & path_prefix ) : directory(directory), prefix(path_prefix) {}
+
+TextureLibrary::~TextureLibrary() {}
+
+string TextureLibrary::AddTexture( NiPixelData * pixel_data, const string & name_hint ) {
+	//The file is built and hashed without holding the lock
+	stringstream dds;
+	WriteDds( dds, pixel_data );
+	string bytes = dds.str();
+	unsigned long long hash = HashBytes( bytes );
+
+	lock_guard<mutex> guard( lock );
+	map<unsigned long long, string>::iterator it = added.find( hash );
+	if ( it != added.end() ) {
+		return it->second;
+	}
+
+	//Written while holding the lock, so no file refers to a texture that is
+	//still being written
+	static const char hex[] = "0123456789abcdef";
+	string name = BaseName( name_hint );
+	if ( !name.empty() ) {
+		name += '_';
+	}
+	for ( int shift = 60; shift >= 0; shift -= 4 ) {
+		name += hex[( hash >> shift ) & 15];
+	}
+	name += ".dds";
+	string path = JoinPath( directory, name );
+	ofstream out( path.c_str(), ofstream::binary );
+	out.write( bytes.data(), bytes.size() );
+	out.close();
+	if ( !out ) {
+		throw runtime_error( "Could not write the texture file " + path + "." );
+	}
+	written.push_back( path );
+	return added[hash] = prefix + name;
+}
+
+Ref<NiPixelData> TextureLibrary::LoadTexture( const string & file_name ) {
+	//Strip the prefix, ignoring case like the file systems games run on
+	string name = file_name;
+	if ( name.size() >= prefix.size() ) {
+		bool match = true;
+		for ( size_t i = 0; i < prefix.size() && match; ++i ) {
+			match = ( tolower( (unsigned char)name[i] ) == tolower( (unsigned char)prefix[i] ) );
+		}
+		if ( match ) {
+			name = name.substr( prefix.size() );
+		}
+	}
+	for ( size_t i = 0; i < name.size(); ++i ) {
+		if ( name[i] == '\\' ) {
+			name[i] = '/';
+		}
+	}
+	string path = JoinPath( directory, name );
+
+	shared_ptr<const string> bytes;
+	{
+		lock_guard<mutex> guard( lock );
+		map< string, shared_ptr<const string> >::iterator it = loaded.find( path );
+		if ( it != loaded.end() ) {
+			bytes = it->second;
+		}
+	}
+	if ( bytes == NULL ) {
+		ifstream file( path.c_str(), ifstream::binary );
+		if ( !file ) {
+			throw runtime_error( "Could not open the texture file " + path + "." );
+		}
+		stringstream contents;
+		contents << file.rdbuf();
+		shared_ptr<const string> read( new string( contents.str() ) );
+
+		//Another thread may have read the same file in the meantime
+		lock_guard<mutex> guard( lock );
+		shared_ptr<const string> & entry = loaded[path];
+		if ( entry == NULL ) {
+			entry = read;
+		}
+		bytes = entry;
+	}
+
+	istringstream in( *bytes );
+	return ReadDds( in );
+}
+
+vector<string> TextureLibrary::GetWrittenFiles() const {
+	lock_guard<mutex> guard( lock );
+	return written;
+}
+
+//--Batch Conversion--//
+
+unsigned int ConvertTextureStorage( const vector<string> & in_files, const vector<string> & out_files, TextureLibrary & library, bool externalize, vector<TextureStoreResult> & results, unsigned int num_threads ) {
+	if ( in_files.size() != out_files.size() ) {
+		throw runtime_error("There must be one output file for every input file.");
+	}
+	results.assign( in_files.size(), TextureStoreResult() );
+
+	//Each thread takes the next file, which only it touches, so objects are
+	//never shared between threads.  Only the library is shared.
+	atomic<size_t> next( 0 );
+	unsigned int threads = ParallelThreadCount( num_threads, in_files.size() );
+	ParallelFor( threads, threads, [&]( size_t, size_t ) {
+		for ( size_t i = next++; i < in_files.size(); i = next++ ) {
+			TextureStoreResult & result = results[i];
+			result.file = in_files[i];
+			try {
+				NifInfo info;
+				Ref<NiObject> root = ReadNifTree( in_files[i], &info );
+				if ( root != NULL && root->IsDerivedType( NiAVObject::TYPE ) ) {
+					MatTexCollection collection( DynamicCast<NiAVObject>( root ) );
+					if ( externalize ) {
+						result.textures = collection.ExternalizeTextures( library );
+					} else {
+						result.textures = collection.InternalizeTextures( library );
+					}
+				}
+				if ( result.textures > 0 || out_files[i] != in_files[i] ) {
+					WriteNifTree( out_files[i], root, info );
+				}
+			} catch ( exception & e ) {
+				result.error = e.what();
+				if ( result.error.empty() ) {
+					result.error = "Unknown error";
+				}
+			}
+		}
+	} );
+
+	unsigned int failed = 0;
+	for ( size_t i = 0; i < results.size(); ++i ) {
+		if ( !results[i].error.empty() ) {
+			++failed;
+		}
+	}
+	return failed;
+}
+
+} //End Niflib namespace
@@ -3,7 +3,15 @@
 #include "../include/kfm.h"
 #include "../include/niflib.h"
 #include "../include/NIF_IO.h"
+#include "../include/NodeNameIndex.h"
 #include "../include/obj/NiObject.h"
+#include "../include/obj/NiNode.h"
+#include "../include/obj/NiControllerSequence.h"
+#include <fstream>
+#include <sstream>
+#include <list>
+#include <map>
+#include <thread>
 
 namespace Niflib {
 
@@ -119,27 +127,276 @@ void Kfm::Write( ostream & out, unsigned int version ) {
 };
 */
 
+//Joins a directory and a file name.  A forward slash is used since it is
+//understood on every platform.
+static string JoinPath( const string & path, const string & file_name ) {
+	if ( path.empty() ) {
+		return file_name;
+	}
+	char last = path[path.length() - 1];
+	if ( last == '/' || last == '\\' ) {
+		return path + file_name;
+	}
+	return path + '/' + file_name;
+}
+
+//Reads a whole file into memory.  Returns false if it cannot be opened.
+static bool ReadFileBytes( const string & file_name, string & out ) {
+	ifstream in( file_name.c_str(), ifstream::binary );
+	if ( !in.is_open() ) {
+		return false;
+	}
+	in.seekg( 0, ios_base::end );
+	streamoff size = in.tellg();
+	in.seekg( 0, ios_base::beg );
+	out.resize( size_t(size) );
+	if ( size > 0 ) {
+		in.read( &out[0], size );
+	}
+	return true;
+}
+
 Ref<NiObject> Kfm::MergeActions( string const & path ) {
 	// Read NIF file
-	NiObjectRef nif = ReadNifTree( path + '\\' + nif_filename);
-	
-	// Read Kf files
-	vector<NiObjectRef> kf;
-	for ( vector<KfmAction>::iterator it = actions.begin(); it != actions.end(); it++ ) {
-		string action_filename = path + '\\' + it->action_filename;
-		// Check if the file exists.
-		// Probably we should check some other field in the Kfm file to determine this...
-		bool exists = false;
-		fstream fin;
-		fin.open(action_filename.c_str(), ios::in);
-		if( fin.is_open() ) exists = true;
-		fin.close();
-		// Import it, if it exists.
-		if (exists) kf.push_back( ReadNifTree(action_filename) );
+	NifInfo info;
+	NiObjectRef nif = ReadNifTree( JoinPath( path, nif_filename ), &info );
+	NiNodeRef root = DynamicCast<NiNode>(nif);
+	if ( root == NULL ) {
+		throw runtime_error("The root of the KFM model file is not a NiNode, so actions cannot be merged into it.");
+	}
+
+	// Merge the Kf files one at a time.  A budget of one byte keeps only the
+	// most recent action in memory, while the next file is read ahead.
+	KfmActionLibrary library( *this, path );
+	library.SetMemoryBudget(1);
+	for ( unsigned int i = 0; i < actions.size(); ++i ) {
+		if ( i + 1 < actions.size() ) {
+			library.Prefetch( i + 1 );
+		}
+		library.MergeAction( root, i, info.version, info.userVersion );
 	};
-	
-	// TODO: merge everything into the nif file
+
 	return nif;
 }
 
+//--KfmActionLibrary--//
+
+struct KfmActionLibrary::Impl {
+	struct Entry {
+		Entry() : loaded(false), cost(0), buffered(false), found(false) {}
+
+		//Decoded sequences, valid if loaded is set
+		vector<NiControllerSequenceRef> sequences;
+		bool loaded;
+		//Estimated memory taken by the decoded sequences
+		size_t cost;
+		//Position in the least recently used list, valid if loaded is set
+		list<unsigned int>::iterator lru_pos;
+
+		//Background read.  The reader thread only touches the fields below,
+		//and they are only read by the owner after joining it.
+		thread reader;
+		string buffer;
+		bool buffered;
+		bool found;
+	};
+
+	Impl( const Kfm & k, const string & p ) : kfm(k), path(p), entries(k.actions.size()), budget(0), usage(0) {}
+
+	Kfm kfm;
+	string path;
+	map<string,unsigned int> names;
+	map<unsigned int,unsigned int> codes;
+	NiObjectRef skeleton;
+	//Kept between merges so the target tree is only walked once
+	NodeNameIndex index;
+	vector<Entry> entries;
+	//Most recently used action first
+	list<unsigned int> lru;
+	size_t budget;
+	size_t usage;
+
+	void Join( Entry & e ) {
+		if ( e.reader.joinable() ) {
+			e.reader.join();
+		}
+	}
+
+	void Evict( unsigned int action ) {
+		Entry & e = entries[action];
+		if ( !e.loaded ) {
+			return;
+		}
+		lru.erase( e.lru_pos );
+		e.sequences.clear();
+		e.loaded = false;
+		usage -= e.cost;
+		e.cost = 0;
+	}
+
+	void Trim() {
+		//Never drop the most recently used action, it was just asked for
+		while ( budget != 0 && usage > budget && lru.size() > 1 ) {
+			Evict( lru.back() );
+		}
+	}
+
+	void Load( unsigned int action ) {
+		Entry & e = entries[action];
+		Join( e );
+
+		string file_name = JoinPath( path, kfm.actions[action].action_filename );
+		if ( !e.buffered ) {
+			e.found = ReadFileBytes( file_name, e.buffer );
+		}
+
+		vector<NiObjectRef> objects;
+		if ( e.found ) {
+			istringstream in( e.buffer, istringstream::binary );
+			objects = ReadNifList( in );
+		}
+		e.cost = e.buffer.size();
+		string().swap( e.buffer );
+		e.buffered = false;
+
+		e.sequences.clear();
+		for ( vector<NiObjectRef>::iterator it = objects.begin(); it != objects.end(); ++it ) {
+			NiControllerSequenceRef seq = DynamicCast<NiControllerSequence>(*it);
+			if ( seq != NULL ) {
+				e.sequences.push_back( seq );
+			}
+		}
+
+		e.loaded = true;
+		lru.push_front( action );
+		e.lru_pos = lru.begin();
+		usage += e.cost;
+		Trim();
+	}
+};
+
+static void ReadActionFile( string file_name, string * buffer, bool * buffered, bool * found ) {
+	*found = ReadFileBytes( file_name, *buffer );
+	*buffered = true;
+}
+
+KfmActionLibrary::KfmActionLibrary( const Kfm & kfm, const string & path ) {
+	impl = new Impl( kfm, path );
+	for ( unsigned int i = 0; i < kfm.actions.size(); ++i ) {
+		//Keep the first action if several share a name or code
+		impl->names.insert( pair<string,unsigned int>( kfm.actions[i].action_name, i ) );
+		impl->codes.insert( pair<unsigned int,unsigned int>( kfm.actions[i].unk_int1, i ) );
+	}
+}
+
+KfmActionLibrary::~KfmActionLibrary() {
+	for ( unsigned int i = 0; i < impl->entries.size(); ++i ) {
+		impl->Join( impl->entries[i] );
+	}
+	delete impl;
+}
+
+unsigned int KfmActionLibrary::GetActionCount() const {
+	return (unsigned int)(impl->entries.size());
+}
+
+int KfmActionLibrary::FindAction( const string & name ) const {
+	map<string,unsigned int>::const_iterator it = impl->names.find( name );
+	if ( it == impl->names.end() ) {
+		return -1;
+	}
+	return int(it->second);
+}
+
+int KfmActionLibrary::FindActionByEventCode( unsigned int code ) const {
+	map<unsigned int,unsigned int>::const_iterator it = impl->codes.find( code );
+	if ( it == impl->codes.end() ) {
+		return -1;
+	}
+	return int(it->second);
+}
+
+const KfmAction & KfmActionLibrary::GetAction( unsigned int action ) const {
+	if ( action >= impl->entries.size() ) {
+		throw runtime_error("Invalid action index.");
+	}
+	return impl->kfm.actions[action];
+}
+
+Ref<NiObject> KfmActionLibrary::GetSkeleton() {
+	if ( impl->skeleton == NULL ) {
+		impl->skeleton = ReadNifTree( JoinPath( impl->path, impl->kfm.nif_filename ) );
+	}
+	return impl->skeleton;
+}
+
+vector< Ref<NiControllerSequence> > KfmActionLibrary::GetSequences( unsigned int action ) {
+	if ( action >= impl->entries.size() ) {
+		throw runtime_error("Invalid action index.");
+	}
+	Impl::Entry & e = impl->entries[action];
+	if ( e.loaded ) {
+		//Move to the front of the least recently used list
+		impl->lru.splice( impl->lru.begin(), impl->lru, e.lru_pos );
+		return e.sequences;
+	}
+	impl->Load( action );
+	//Trimming never evicts the action that was just loaded
+	return e.sequences;
+}
+
+Ref<NiControllerSequence> KfmActionLibrary::GetSequence( const string & name ) {
+	int action = FindAction( name );
+	if ( action < 0 ) {
+		return NULL;
+	}
+	vector<NiControllerSequenceRef> seqs = GetSequences( (unsigned int)action );
+	if ( seqs.empty() ) {
+		return NULL;
+	}
+	return seqs[0];
+}
+
+void KfmActionLibrary::Prefetch( unsigned int action ) {
+	if ( action >= impl->entries.size() ) {
+		throw runtime_error("Invalid action index.");
+	}
+	Impl::Entry & e = impl->entries[action];
+	//The reader thread writes buffered, so only look at it once no reader runs
+	if ( e.reader.joinable() || e.loaded || e.buffered ) {
+		return;
+	}
+	string file_name = JoinPath( impl->path, impl->kfm.actions[action].action_filename );
+	e.reader = thread( ReadActionFile, file_name, &e.buffer, &e.buffered, &e.found );
+}
+
+void KfmActionLibrary::MergeAction( NiNode * target, unsigned int action, unsigned version, unsigned user_version ) {
+	if ( target == NULL ) {
+		throw runtime_error("Attempted to merge an action into a NULL node.");
+	}
+	if ( impl->index.GetRoot() != target ) {
+		impl->index.SetRoot( target );
+	}
+	MergeNifTrees( target, GetSequences( action ), &impl->index, true, version, user_version );
+}
+
+void KfmActionLibrary::SetMemoryBudget( size_t bytes ) {
+	impl->budget = bytes;
+	impl->Trim();
+}
+
+size_t KfmActionLibrary::GetMemoryUsage() const {
+	return impl->usage;
+}
+
+bool KfmActionLibrary::IsCached( unsigned int action ) const {
+	return action < impl->entries.size() && impl->entries[action].loaded;
+}
+
+void KfmActionLibrary::ClearCache() {
+	while ( !impl->lru.empty() ) {
+		impl->Evict( impl->lru.back() );
+	}
+}
+
 }
@@ -11,6 +11,7 @@ All rights reserved.  Please see niflib.h for license. */
 #include "../include/NIF_IO.h"
 #include "../include/ObjectRegistry.h"
 #include "../include/kfm.h"
+#include "../include/NodeNameIndex.h"
 #include "../include/obj/NiObject.h"
 #include "../include/obj/NiNode.h"
 #include "../include/obj/NiAVObject.h"
@@ -34,12 +35,18 @@ All rights reserved.  Please see niflib.h for license. */
 #include "../include/obj/bhkConstraint.h"
 #include "../include/gen/Header.h"
 #include "../include/gen/Footer.h"
+#include <mutex>
 
 namespace Niflib {
 
 //Object Registration
-bool g_objects_registered = false;
 void RegisterObjects();
+static once_flag g_objects_registered;
+
+//Registers the object types on first use, even when files are read on several threads at once
+void EnsureObjectsRegistered() {
+	call_once( g_objects_registered, RegisterObjects );
+}
 
 //Utility Functions
 bool BlockChildBeforeParent( NiObject * root );
@@ -58,6 +65,8 @@ NiObjectRef GetObjectByType( NiObject * root, const Type & type );
  */
 static void SplitNifTree( NiObject * root_object, NiObjectRef& xnif_root, list<NiObjectRef> & xkf_roots, Kfm & kfm, int kf_type, const NifInfo & info );
 
+static vector<NiObjectRef> ReadNifObjects( istream & in, list<NiObjectRef> & missing_link_stack, NifInfo * info, const BlockFilter * filter );
+
 //--Function Bodies--//
 
 NiObjectRef ReadNifTree( istream & in, list<NiObjectRef> & missing_link_stack, NifInfo * info ) {
@@ -156,13 +165,28 @@ vector<NiObjectRef> ReadNifList( istream & in, NifInfo * info ) {
 	return ReadNifList(in, missing_link_stack, info);
 }
 
+vector<NiObjectRef> ReadNifList( string const & file_name, const BlockFilter & filter, NifInfo * info ) {
+	ifstream in( file_name.c_str(), ifstream::binary );
+	vector<NiObjectRef> ret = ReadNifList( in, filter, info );
+	in.close();
+	return ret;
+}
+
+vector<NiObjectRef> ReadNifList( istream & in, const BlockFilter & filter, NifInfo * info ) {
+	list<NiObjectRef> missing_link_stack;
+	return ReadNifObjects( in, missing_link_stack, info, &filter );
+}
+
 vector<NiObjectRef> ReadNifList( istream & in, list<NiObjectRef> & missing_link_stack, NifInfo * info ) {
+	return ReadNifObjects( in, missing_link_stack, info, NULL );
+}
+
+//Reads every block, or with a filter, only the wanted blocks and placeholders
+//for the rest
+static vector<NiObjectRef> ReadNifObjects( istream & in, list<NiObjectRef> & missing_link_stack, NifInfo * info, const BlockFilter * filter ) {
 
 	//Ensure that objects are registered
-	if ( g_objects_registered == false ) {
-		g_objects_registered = true;
-		RegisterObjects();
-	}
+	EnsureObjectsRegistered();
 
 	//--Read Header--//
 	Header header;
@@ -335,8 +359,15 @@ vector<NiObjectRef> ReadNifList( istream & in, list<NiObjectRef> & missing_link_
 			index = i;
 		}
 
-		//Read new object
-		new_obj->Read( in, link_stack, *info );
+		//Read new object, or skip it if the filter does not want it and the
+		//header says how big it is.  The placeholder keeps its type so that
+		//links to it can still be fixed.
+		if ( filter != NULL && header.version >= VER_20_2_0_7 && !(*filter)( new_obj->GetType() ) ) {
+			new_obj->placeholder = true;
+			in.seekg( startobjpos + (streamoff)header.blockSize[i] );
+		} else {
+			new_obj->Read( in, link_stack, *info );
+		}
 
 		//Add object to map
 		objects[index] = new_obj;
@@ -406,8 +437,11 @@ vector<NiObjectRef> ReadNifList( istream & in, list<NiObjectRef> & missing_link_
 #ifdef DEBUG_LINK_PHASE
 		cout << "   " << i << ":  " << obj_list[i] << endl;
 #endif
-		//Fix links & other pre-processing
-		obj_list[i]->FixLinks( objects, link_stack, missing_link_stack, *info );
+		//Fix links & other pre-processing.  Placeholders were not read, so
+		//they have no links on the stack.
+		if ( !obj_list[i]->placeholder ) {
+			obj_list[i]->FixLinks( objects, link_stack, missing_link_stack, *info );
+		}
 	}
 
 	//delete info if it was dynamically allocated
@@ -478,6 +512,13 @@ void WriteNifTree( ostream & out, list<NiObjectRef> const & roots, list<NiObject
 		types[it->second] = it->first;
 	}
 
+	//Placeholders hold none of the data of the blocks they stand in for
+	for ( unsigned int i = 0; i < objects.size(); ++i ) {
+		if ( objects[i]->placeholder ) {
+			throw runtime_error( "Cannot write the placeholder left for a " + objects[i]->GetType().GetTypeName() + " that was not read." );
+		}
+	}
+
         unsigned int version = info.version;
 
 	//--Write Header--//
@@ -1082,11 +1123,12 @@ void MergeNifTrees( NiNode * target, NiAVObject * right, unsigned version, unsig
 	MergeSceneGraph( name_map, target, new_tree );
 }
 
-//Version for merging KF Trees rooted by a NiControllerSequence
-void MergeNifTrees( NiNode * target, NiControllerSequence * right, unsigned version, unsigned user_version ) {
-	//Map the node names
-	map<string,NiNodeRef> name_map;
-	MapNodeNames( name_map, target );
+//Merges a single KF sequence, looking up target nodes through the index.
+//If clone is false the interpolators and controllers of the sequence are
+//attached directly instead of being copied.
+static void MergeSequence( NiNode * target, NiControllerSequence * right, const NodeNameIndex & index, bool clone, unsigned version, unsigned user_version ) {
+	//Ensure that objects are registered, missing controllers are created by name
+	EnsureObjectsRegistered();
 
 	//TODO:  Allow this to merge a KF sequence into a file that already has
 	//sequences in it by appending all the keyframe data to the end of
@@ -1121,21 +1163,24 @@ void MergeNifTrees( NiNode * target, NiControllerSequence * right, unsigned vers
 			ctlr_type = str_pal->GetSubStr( data[i].controllerTypeOffset );
 		}
 		//Make sure there is a node with this name in the target tree
-		if ( name_map.find( node_name ) != name_map.end() ) {
+		NiNodeRef node = index.Find( node_name );
+		if ( node != NULL ) {
 			//See if we're dealing with an interpolator or a controller
 			if ( data[i].controller != NULL ) {
 				//Clone the controller and attached data and
 				//add it to the named node
-				NiObjectRef clone = CloneNifTree( StaticCast<NiObject>(data[i].controller), version, user_version );
-				NiTimeControllerRef ctlr = DynamicCast<NiTimeController>(clone);
+				NiTimeControllerRef ctlr = data[i].controller;
+				if ( clone ) {
+					NiObjectRef copy = CloneNifTree( StaticCast<NiObject>(data[i].controller), version, user_version );
+					ctlr = DynamicCast<NiTimeController>(copy);
+				}
 				if ( ctlr != NULL ) {
-					name_map[node_name]->AddController( ctlr );
+					node->AddController( ctlr );
 				}
 			} else if ( data[i].interpolator != NULL ) {
 				//Clone the interpolator and attached data and
 				//attach it to the specific type of controller that's
 				//connected to the named node
-				NiNodeRef node = name_map[node_name];
 				list<NiTimeControllerRef> ctlrs = node->GetControllers();
 				NiSingleInterpControllerRef ctlr;
 				for ( list<NiTimeControllerRef>::iterator it = ctlrs.begin(); it != ctlrs.end(); ++it ) {
@@ -1160,8 +1205,11 @@ void MergeNifTrees( NiNode * target, NiControllerSequence * right, unsigned vers
 				//Clone the interpolator and attached data and
 				//add it to controller of matching type that was
 				//found
-				NiObjectRef clone = CloneNifTree( StaticCast<NiObject>(data[i].interpolator), version, user_version );
-				NiInterpolatorRef interp = DynamicCast<NiInterpolator>(clone);
+				NiInterpolatorRef interp = data[i].interpolator;
+				if ( clone ) {
+					NiObjectRef copy = CloneNifTree( StaticCast<NiObject>(data[i].interpolator), version, user_version );
+					interp = DynamicCast<NiInterpolator>(copy);
+				}
 				if ( interp != NULL ) {
 					ctlr->SetInterpolator( interp );
 
@@ -1189,6 +1237,31 @@ void MergeNifTrees( NiNode * target, NiControllerSequence * right, unsigned vers
 	}
 }
 
+//Version for merging KF Trees rooted by a NiControllerSequence
+void MergeNifTrees( NiNode * target, NiControllerSequence * right, unsigned version, unsigned user_version ) {
+	NodeNameIndex index( target );
+	MergeSequence( target, right, index, true, version, user_version );
+}
+
+void MergeNifTrees( NiNode * target, const vector< Ref<NiControllerSequence> > & sequences, NodeNameIndex * index, bool clone, unsigned version, unsigned user_version ) {
+	if ( target == NULL ) {
+		throw runtime_error("Attempted to merge sequences into a NULL node.");
+	}
+
+	//Reuse the caller's index if it covers the target tree
+	NodeNameIndex local_index;
+	if ( index == NULL || index->GetRoot() != target ) {
+		local_index.SetRoot( target );
+		index = &local_index;
+	}
+
+	for ( vector<NiControllerSequenceRef>::const_iterator it = sequences.begin(); it != sequences.end(); ++it ) {
+		if ( *it != NULL ) {
+			MergeSequence( target, *it, *index, clone, version, user_version );
+		}
+	}
+}
+
 //Version for merging KF Trees rooted by a NiSequenceStreamHelper
 void MergeNifTrees( NiNode * target, NiSequenceStreamHelper * right, unsigned version, unsigned user_version ) {
 	//Map the node names
@@ -2,88 +2,353 @@
 All rights reserved.  Please see niflib.h for license. */
 
 #include "../include/nifqhull.h"
+#include "NifParallel.h"
 #include <vector>
 #include <algorithm>
-#include <functional>
+#include <unordered_map>
+#include <queue>
+#include <stdexcept>
 #include <math.h>
 using namespace Niflib;
 
-extern "C"
-{
-#include "../qhull/src/libqhull/qhull_a.h"
-
-#include "../qhull/src/libqhull/libqhull.c"
-#include "../qhull/src/libqhull/mem.c"
-#include "../qhull/src/libqhull/qset.c"
-#include "../qhull/src/libqhull/geom.c"
-#include "../qhull/src/libqhull/merge.c"
-#include "../qhull/src/libqhull/poly.c"
-#include "../qhull/src/libqhull/io.c"
-#include "../qhull/src/libqhull/stat.c"
-#include "../qhull/src/libqhull/global.c"
-#include "../qhull/src/libqhull/user.c"
-#include "../qhull/src/libqhull/poly2.c"
-#include "../qhull/src/libqhull/geom2.c"
-#include "../qhull/src/libqhull/userprintf.c"
-#include "../qhull/src/libqhull/userprintf_rbox.c"
-#include "../qhull/src/libqhull/usermem.c"
-#include "../qhull/src/libqhull/random.c"
-#include "../qhull/src/libqhull/rboxlib.c"
+namespace {
+
+//Hull math is done in double precision so that the tolerance below only
+//has to cover the rounding of the float input
+struct HullPoint {
+	double x, y, z;
 };
 
-using namespace Niflib;
+inline HullPoint Sub( const HullPoint & a, const HullPoint & b ) {
+	HullPoint r = { a.x - b.x, a.y - b.y, a.z - b.z };
+	return r;
+}
 
-vector<Triangle> NifQHull::compute_convex_hull(const vector<Vector3>& verts)
-{  
-	vector<Triangle> tris;
+inline HullPoint Cross( const HullPoint & a, const HullPoint & b ) {
+	HullPoint r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	return r;
+}
+
+inline double Dot( const HullPoint & a, const HullPoint & b ) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+struct HullFace {
+	unsigned int v[3];
+	HullPoint normal;
+	double dist;
+	//Points above this face that are not yet on the hull, and the farthest of them
+	vector<unsigned int> outside;
+	unsigned int far_point;
+	double far_dist;
+	unsigned int mark;
+	bool live;
+};
+
+class QuickHull {
+public:
+	QuickHull( const vector<Vector3> & verts ) : mark(0) {
+		points.resize( verts.size() );
+		double scale = 0.0;
+		for ( size_t i = 0; i < verts.size(); ++i ) {
+			points[i].x = verts[i].x;
+			points[i].y = verts[i].y;
+			points[i].z = verts[i].z;
+			scale = max( scale, fabs( points[i].x ) + fabs( points[i].y ) + fabs( points[i].z ) );
+		}
+		//A few float epsilons relative to the size of the coordinates
+		eps = scale * 1e-6;
+	}
+
+	void Build( unsigned int max_vertices ) {
+		if ( !BuildSimplex() ) {
+			return;
+		}
+		unsigned int vertex_count = 4;
+		//Always add the point farthest outside the hull built so far.  A face
+		//is queued once, when its outside set is final, so entries only go
+		//stale by the face being replaced.
+		while ( !pending.empty() ) {
+			unsigned int fi = pending.top().second;
+			pending.pop();
+			if ( !faces[fi].live || faces[fi].outside.empty() ) {
+				continue;
+			}
+			if ( max_vertices != 0 && vertex_count >= max_vertices ) {
+				break;
+			}
+			AddPoint( faces[fi].far_point, fi );
+			++vertex_count;
+		}
+	}
+
+	void GetTriangles( vector<Triangle> & tris ) const {
+		for ( size_t i = 0; i < faces.size(); ++i ) {
+			const HullFace & f = faces[i];
+			if ( f.live ) {
+				tris.push_back( Triangle( (unsigned short)f.v[0], (unsigned short)f.v[1], (unsigned short)f.v[2] ) );
+			}
+		}
+	}
+
+private:
+	static unsigned long long EdgeKey( unsigned int a, unsigned int b ) {
+		return ( (unsigned long long)a << 32 ) | b;
+	}
+
+	//The face on the other side of the edge from a to b
+	unsigned int Neighbor( unsigned int a, unsigned int b ) const {
+		unordered_map<unsigned long long, unsigned int>::const_iterator it = edges.find( EdgeKey( b, a ) );
+		if ( it == edges.end() ) {
+			throw runtime_error("The convex hull lost track of the faces around an edge.");
+		}
+		return it->second;
+	}
+
+	//Queues faces that have points outside them
+	void QueueFaces( const vector<unsigned int> & candidates ) {
+		for ( size_t i = 0; i < candidates.size(); ++i ) {
+			const HullFace & f = faces[candidates[i]];
+			if ( !f.outside.empty() ) {
+				pending.push( make_pair( f.far_dist, candidates[i] ) );
+			}
+		}
+	}
+
+	double Distance( const HullFace & f, unsigned int p ) const {
+		return Dot( f.normal, points[p] ) - f.dist;
+	}
+
+	unsigned int AddFace( unsigned int a, unsigned int b, unsigned int c ) {
+		HullFace f;
+		f.v[0] = a;
+		f.v[1] = b;
+		f.v[2] = c;
+		f.normal = Cross( Sub( points[b], points[a] ), Sub( points[c], points[a] ) );
+		double len = sqrt( Dot( f.normal, f.normal ) );
+		if ( len > 0.0 ) {
+			f.normal.x /= len;
+			f.normal.y /= len;
+			f.normal.z /= len;
+		}
+		f.dist = Dot( f.normal, points[a] );
+		f.far_point = 0;
+		f.far_dist = 0.0;
+		f.mark = 0;
+		f.live = true;
+		unsigned int index = (unsigned int)faces.size();
+		faces.push_back( f );
+		edges[EdgeKey( a, b )] = index;
+		edges[EdgeKey( b, c )] = index;
+		edges[EdgeKey( c, a )] = index;
+		return index;
+	}
+
+	//Puts a point in the outside set of the face it is farthest above
+	void AssignPoint( unsigned int p, const vector<unsigned int> & candidates ) {
+		double best = eps;
+		unsigned int best_face = 0xFFFFFFFF;
+		for ( size_t i = 0; i < candidates.size(); ++i ) {
+			double d = Distance( faces[candidates[i]], p );
+			if ( d > best ) {
+				best = d;
+				best_face = candidates[i];
+			}
+		}
+		if ( best_face == 0xFFFFFFFF ) {
+			return;
+		}
+		HullFace & f = faces[best_face];
+		f.outside.push_back( p );
+		if ( best > f.far_dist ) {
+			f.far_dist = best;
+			f.far_point = p;
+		}
+	}
+
+	bool BuildSimplex() {
+		unsigned int n = (unsigned int)points.size();
+		if ( n < 4 ) {
+			return false;
+		}
+
+		//The two farthest apart of the extreme points along each axis
+		unsigned int extremes[6] = { 0, 0, 0, 0, 0, 0 };
+		for ( unsigned int i = 1; i < n; ++i ) {
+			const HullPoint & p = points[i];
+			if ( p.x < points[extremes[0]].x ) extremes[0] = i;
+			if ( p.x > points[extremes[1]].x ) extremes[1] = i;
+			if ( p.y < points[extremes[2]].y ) extremes[2] = i;
+			if ( p.y > points[extremes[3]].y ) extremes[3] = i;
+			if ( p.z < points[extremes[4]].z ) extremes[4] = i;
+			if ( p.z > points[extremes[5]].z ) extremes[5] = i;
+		}
+		unsigned int i0 = 0, i1 = 0;
+		double best = 0.0;
+		for ( int a = 0; a < 6; ++a ) {
+			for ( int b = a + 1; b < 6; ++b ) {
+				HullPoint d = Sub( points[extremes[b]], points[extremes[a]] );
+				double len = Dot( d, d );
+				if ( len > best ) {
+					best = len;
+					i0 = extremes[a];
+					i1 = extremes[b];
+				}
+			}
+		}
+		if ( sqrt( best ) <= eps ) {
+			return false;
+		}
+
+		//The point farthest from their line
+		HullPoint dir = Sub( points[i1], points[i0] );
+		unsigned int i2 = 0;
+		best = 0.0;
+		for ( unsigned int i = 0; i < n; ++i ) {
+			HullPoint c = Cross( Sub( points[i], points[i0] ), dir );
+			double len = Dot( c, c );
+			if ( len > best ) {
+				best = len;
+				i2 = i;
+			}
+		}
+		if ( sqrt( best / Dot( dir, dir ) ) <= eps ) {
+			return false;
+		}
+
+		//The point farthest from the plane of the three
+		HullPoint normal = Cross( dir, Sub( points[i2], points[i0] ) );
+		double normal_len = sqrt( Dot( normal, normal ) );
+		unsigned int i3 = 0;
+		double side = 0.0;
+		for ( unsigned int i = 0; i < n; ++i ) {
+			double d = Dot( normal, Sub( points[i], points[i0] ) ) / normal_len;
+			if ( fabs( d ) > fabs( side ) ) {
+				side = d;
+				i3 = i;
+			}
+		}
+		if ( fabs( side ) <= eps ) {
+			return false;
+		}
+
+		//Wind the base away from the apex so that all faces point outward
+		if ( side > 0.0 ) {
+			swap( i1, i2 );
+		}
+		AddFace( i0, i1, i2 );
+		AddFace( i1, i0, i3 );
+		AddFace( i2, i1, i3 );
+		AddFace( i0, i2, i3 );
 
-	int dim=3;	              /* dimension of points */
-	int numpoints=0;          /* number of points */
-	coordT *points=0;         /* array of coordinates for each point */ 
-	boolT ismalloc=0;         /* True if qhull should free points in qh_freeqhull() or reallocation */ 
-	char flags[]= "qhull i Qt"; /* option flags for qhull, see qh_opt.htm */
-	FILE *outfile= stdout;    /* output from qh_produce_output()			
-							  use NULL to skip qh_produce_output() */ 
-	FILE *errfile= stderr;    /* error messages from qhull code */ 
-	int exitcode;             /* 0 if no error from qhull */
-	facetT *facet;	          /* set by FORALLfacets */
-	int curlong, totlong;	  /* memory remaining after qh_memfreeshort */
-
-	vertexT *vertex, **vertexp;
-	setT *vertices;
-
-	numpoints = verts.size();
-	points = new coordT[3 * verts.size()];
-	for (int i=0, n=verts.size(); i<n; ++i) {
-		points[i*3 + 0] = verts[i].x;
-		points[i*3 + 1] = verts[i].y;
-		points[i*3 + 2] = verts[i].z;
+		vector<unsigned int> candidates;
+		for ( unsigned int f = 0; f < 4; ++f ) {
+			candidates.push_back( f );
+		}
+		for ( unsigned int i = 0; i < n; ++i ) {
+			if ( i != i0 && i != i1 && i != i2 && i != i3 ) {
+				AssignPoint( i, candidates );
+			}
+		}
+		QueueFaces( candidates );
+		return true;
 	}
 
-	/* initialize dim, numpoints, points[], ismalloc here */
-	exitcode= qh_new_qhull (dim, numpoints, points, ismalloc,
-		flags, outfile, errfile);
-	if (!exitcode) { /* if no error */ 
-		/* 'qh facet_list' contains the convex hull */
-		FORALLfacets {
-			vertices = qh_facet3vertex (facet);
-			if (qh_setsize (vertices) == 3) {
-				Triangle tri;
-				int i = 0;
-				FOREACHvertex_(vertices) {
-					tri[i++] = qh_pointid(vertex->point);
+	void AddPoint( unsigned int p, unsigned int start ) {
+		//Gather the connected faces that can see the point
+		++mark;
+		vector<unsigned int> visible;
+		vector<unsigned int> stack( 1, start );
+		faces[start].mark = mark;
+		while ( !stack.empty() ) {
+			unsigned int fi = stack.back();
+			stack.pop_back();
+			visible.push_back( fi );
+			for ( int e = 0; e < 3; ++e ) {
+				unsigned int a = faces[fi].v[e];
+				unsigned int b = faces[fi].v[( e + 1 ) % 3];
+				unsigned int nb = Neighbor( a, b );
+				if ( faces[nb].mark != mark && Distance( faces[nb], p ) > eps ) {
+					faces[nb].mark = mark;
+					stack.push_back( nb );
+				}
+			}
+		}
+
+		//Edges between visible and hidden faces form the horizon
+		vector<unsigned int> horizon;
+		for ( size_t i = 0; i < visible.size(); ++i ) {
+			const HullFace & f = faces[visible[i]];
+			for ( int e = 0; e < 3; ++e ) {
+				unsigned int a = f.v[e];
+				unsigned int b = f.v[( e + 1 ) % 3];
+				if ( faces[Neighbor( a, b )].mark != mark ) {
+					horizon.push_back( a );
+					horizon.push_back( b );
 				}
-				tris.push_back(tri);
 			}
-			qh_settempfree(&vertices);
 		}
+
+		vector<unsigned int> orphans;
+		for ( size_t i = 0; i < visible.size(); ++i ) {
+			HullFace & f = faces[visible[i]];
+			for ( size_t j = 0; j < f.outside.size(); ++j ) {
+				if ( f.outside[j] != p ) {
+					orphans.push_back( f.outside[j] );
+				}
+			}
+			vector<unsigned int>().swap( f.outside );
+			f.live = false;
+			for ( int e = 0; e < 3; ++e ) {
+				edges.erase( EdgeKey( f.v[e], f.v[( e + 1 ) % 3] ) );
+			}
+		}
+
+		vector<unsigned int> created;
+		for ( size_t i = 0; i < horizon.size(); i += 2 ) {
+			created.push_back( AddFace( horizon[i], horizon[i + 1], p ) );
+		}
+		for ( size_t i = 0; i < orphans.size(); ++i ) {
+			AssignPoint( orphans[i], created );
+		}
+		QueueFaces( created );
 	}
-	qh_freeqhull(!qh_ALL);  
-	qh_memfreeshort (&curlong, &totlong);
-	if (curlong || totlong)
-		fprintf (errfile, "qhull internal warning (main): did not free %d bytes of long memory (%d pieces)\n", 
-		totlong, curlong);
 
-	delete[] points;
-	return tris;
+	vector<HullPoint> points;
+	vector<HullFace> faces;
+	unordered_map<unsigned long long, unsigned int> edges;
+	//Faces with outside points, by the distance of their farthest point
+	priority_queue< pair<double, unsigned int> > pending;
+	double eps;
+	unsigned int mark;
 };
+
+} //End anonymous namespace
+
+vector<Triangle> NifQHull::compute_convex_hull(const vector<Vector3>& verts, unsigned int max_vertices)
+{
+	if ( verts.size() > 0x10000 ) {
+		throw runtime_error("Too many points for a convex hull, triangles can only index 65536 vertices.");
+	}
+	if ( max_vertices != 0 && max_vertices < 4 ) {
+		max_vertices = 4;
+	}
+
+	QuickHull hull( verts );
+	hull.Build( max_vertices );
+
+	vector<Triangle> tris;
+	hull.GetTriangles( tris );
+	return tris;
+}
+
+void NifQHull::compute_convex_hulls(const vector< vector<Vector3> >& point_sets, vector< vector<Triangle> >& hulls, unsigned int max_vertices, unsigned int num_threads)
+{
+	hulls.clear();
+	hulls.resize( point_sets.size() );
+	ParallelFor( point_sets.size(), num_threads, [&point_sets, &hulls, max_vertices]( size_t begin, size_t end ) {
+		for ( size_t i = begin; i < end; ++i ) {
+			hulls[i] = compute_convex_hull( point_sets[i], max_vertices );
+		}
+	} );
+}
@@ -278,4 +278,12 @@ std::list<NiObject *> ATextureRenderData::GetPtrs() const {
 
 //--BEGIN MISC CUSTOM CODE--//
 
+Ref<NiPalette> ATextureRenderData::GetPalette() const {
+	return palette;
+}
+
+void ATextureRenderData::SetPalette( NiPalette * value ) {
+	palette = value;
+}
+
 //--END CUSTOM CODE--//
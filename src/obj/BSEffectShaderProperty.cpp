@@ -146,4 +146,20 @@ std::list<NiObject *> BSEffectShaderProperty::GetPtrs() const {
 
 //--BEGIN MISC CUSTOM CODE--//
 
+string BSEffectShaderProperty::GetSourceTexture() const {
+	return sourceTexture;
+}
+
+void BSEffectShaderProperty::SetSourceTexture( const string & value ) {
+	sourceTexture = value;
+}
+
+string BSEffectShaderProperty::GetGreyscaleTexture() const {
+	return greyscaleTexture;
+}
+
+void BSEffectShaderProperty::SetGreyscaleTexture( const string & value ) {
+	greyscaleTexture = value;
+}
+
 //--END CUSTOM CODE--//
@@ -122,4 +122,12 @@ std::list<NiObject *> BSSkyShaderProperty::GetPtrs() const {
 
 //--BEGIN MISC CUSTOM CODE--//
 
+string BSSkyShaderProperty::GetSourceTexture() const {
+	return sourceTexture;
+}
+
+void BSSkyShaderProperty::SetSourceTexture( const string & value ) {
+	sourceTexture = value;
+}
+
 //--END CUSTOM CODE--//
@@ -475,8 +475,8 @@ void NiGeometry::GetSkinDeformation( vector<Vector3> & vertices, vector<Vector3>
 	}
 
 	//Get the vertices & bone nodes
-	vector<Vector3> in_verts = geom_data->GetVertices();
-	vector<Vector3> in_norms = geom_data->GetNormals();
+	const vector<Vector3> & in_verts = geom_data->GetVertexArray();
+	const vector<Vector3> & in_norms = geom_data->GetNormalArray();
 
 	vector<NiNodeRef> bone_nodes = skin_inst->GetBones();
 
@@ -490,7 +490,7 @@ void NiGeometry::GetSkinDeformation( vector<Vector3> & vertices, vector<Vector3>
 	for ( unsigned int i = 0; i < skin_data->GetBoneCount(); ++i ) {
 		Matrix44 bone_world = bone_nodes[i]->GetWorldTransform();
 		Matrix44 bone_offset = skin_data->GetBoneTransform(i);
-		vector<SkinWeight> weights = skin_data->GetBoneWeights(i);
+		const vector<SkinWeight> & weights = skin_data->GetBoneWeightArray(i);
 		Matrix44 vert_trans =  bone_offset * bone_world;
 		Matrix44 norm_trans = Matrix44( vert_trans.GetRotation() );
 		for ( unsigned int j = 0; j < weights.size(); ++j ) {
@@ -613,7 +613,7 @@ void NiGeometry::SetBoneWeights( unsigned int bone_index, const vector<SkinWeigh
 	}
 
 	//Get vertex array
-	vector<Vector3> vertices = geomData->GetVertices();
+	const vector<Vector3> & vertices = geomData->GetVertexArray();
 
    Vector3 center; float radius;
    //CalcCenteredSphere(n, vertices, center, radius);
@@ -649,7 +649,7 @@ void NiGeometry::SetBSProperty(short index, Niflib::Ref<NiProperty> value) {
 	}
 }
 
-array<2,Ref<NiProperty > > Niflib::NiGeometry::GetBSProperties() {
+Niflib::array<2,Ref<NiProperty > > Niflib::NiGeometry::GetBSProperties() {
 	return this->bsProperties;
 }
 
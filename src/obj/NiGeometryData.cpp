@@ -543,6 +543,22 @@ vector<int> NiGeometryData::GetVertexIndices() const {
 	return vertexIndices;
 }
 
+const vector<Vector3> & NiGeometryData::GetVertexArray() const {
+	return vertices;
+}
+
+const vector<Vector3> & NiGeometryData::GetNormalArray() const {
+	return normals;
+}
+
+const vector<Color4> & NiGeometryData::GetColorArray() const {
+	return vertexColors;
+}
+
+const vector<TexCoord> & NiGeometryData::GetUVSetArray( int index ) const {
+	return uvSets[index];
+}
+
 int NiGeometryData::GetUVSetIndex(int maxMapChannel) const
 {
 	if (uvSetMap.size() == 0) return -1;
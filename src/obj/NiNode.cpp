@@ -30,6 +30,8 @@ NiNode::NiNode() : numChildren((unsigned int)0), numEffects((unsigned int)0) {
 	//Set flag to default of 8: not a skin influence
 	flags = 8;
 
+	hierarchyRevision = 0;
+
 	//--END CUSTOM CODE--//
 }
 
@@ -229,6 +231,7 @@ void NiNode::AddChild( Ref<NiAVObject> obj ) {
 		throw runtime_error( "You have attempted to add a child to a NiNode which already is the child of another NiNode." );
 	}
 	obj->SetParent( this );
+	BumpHierarchyRevision();
 	//Sometimes NiTriBasedGeom with skins can be siblings of NiNodes that
 	//represent joints for that same skin.  When this is the case, NiTriBasedGeom
 	//must com first, so we enforce that by always adding NiTriBasedGeom to the
@@ -256,6 +259,7 @@ void NiNode::RemoveChild( Ref<NiAVObject> obj ) {
 		if ( *it == obj ) {
 			(*it)->SetParent(NULL);
 			it = children.erase( it );
+			BumpHierarchyRevision();
 		} else {
 			++it;
 		}
@@ -269,6 +273,18 @@ void NiNode::ClearChildren() {
 		}
 	}
 	children.clear();
+	BumpHierarchyRevision();
+}
+
+unsigned int NiNode::GetHierarchyRevision() const {
+	return hierarchyRevision;
+}
+
+void NiNode::BumpHierarchyRevision() {
+	//Every node on the way to the root now has a changed subtree
+	for ( NiNode * node = this; node != NULL; node = node->parent ) {
+		++node->hierarchyRevision;
+	}
 }
 
 vector< Ref<NiAVObject> > NiNode::GetChildren() const {
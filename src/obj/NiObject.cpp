@@ -22,6 +22,7 @@ const Type NiObject::TYPE("NiObject", &RefObject::TYPE );
 
 NiObject::NiObject() {
 	//--BEGIN CONSTRUCTOR CUSTOM CODE--//
+	placeholder = false;
 	//--END CUSTOM CODE--//
 }
 
@@ -97,6 +98,12 @@ std::list<NiObject *> NiObject::GetPtrs() const {
 //--BEGIN MISC CUSTOM CODE--//
 
 NiObjectRef NiObject::Clone( unsigned int version, unsigned int user_version ) {
+	//A placeholder holds none of the data of the block it stands in for, so
+	//its clone would be a writable object full of default values
+	if ( placeholder ) {
+		throw runtime_error( "Cannot clone the placeholder left for a " + GetType().GetTypeName() + " that was not read." );
+	}
+
 	//Create a string stream to temporarily hold the state-save of this object
 	stringstream tmp;
 
@@ -124,4 +131,8 @@ NiObjectRef NiObject::Clone( unsigned int version, unsigned int user_version ) {
 	return clone;
 };
 
+bool NiObject::IsPlaceholder() const {
+	return placeholder;
+}
+
 //--END CUSTOM CODE--//
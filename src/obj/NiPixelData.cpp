@@ -8,6 +8,10 @@ All rights reserved.  Please see niflib.h for license. */
 //-----------------------------------NOTICE----------------------------------//
 
 //--BEGIN FILE HEAD CUSTOM CODE--//
+#include "../../include/obj/NiPalette.h"
+#include "../../include/PixelCodec.h"
+#include <cstring>
+#include <climits>
 //--END CUSTOM CODE--//
 
 #include "../../include/FixLink.h"
@@ -172,18 +176,26 @@ PixelFormat NiPixelData::GetPixelFormat() const {
 	return pixelFormat;
 }
 
-void NiPixelData::Reset( int new_width, int new_height, PixelFormat px_fmt ) {
-	//Ensure that texture dimentions are powers of two
-	if ( (new_height & (new_height-1)) != 0 ) {
-		throw runtime_error("Texture height must be a power of two.  1, 2, 4, 8, 16, 32, 64, 256, 512, etc.");
+//Describes one channel of the pixel format, for files from 20.0.0.4 on
+static void SetChannel( ChannelData & channel, ChannelType type, ChannelConvention convention, byte bits ) {
+	channel.type = type;
+	channel.convention = convention;
+	channel.bitsPerChannel = bits;
+	channel.unknownByte1 = 0;
+}
+
+void NiPixelData::Reset( int new_width, int new_height, PixelFormat px_fmt, unsigned int num_faces ) {
+	if ( new_width < 0 || new_height < 0 ) {
+		throw runtime_error("Texture width and height cannot be negative.");
 	}
 
-	if ( (new_width & (new_width-1)) != 0 ) {
-		throw runtime_error("Texture width must be a power of two.  1, 2, 4, 8, 16, 32, 64, 256, 512, etc.");
+	if ( num_faces == 0 ) {
+		throw runtime_error("A texture must have at least one face.");
 	}
 	
 	//Delete any data that was previously held
 	pixelData.clear();
+	numFaces = num_faces;
 
 	mipmaps.resize(1);
 
@@ -195,6 +207,12 @@ void NiPixelData::Reset( int new_width, int new_height, PixelFormat px_fmt ) {
 
 	//Set up pixel format fields
 	pixelFormat = px_fmt;
+	for ( unsigned int i = 0; i < 4; ++i ) {
+		SetChannel( channels[i], CHNL_EMPTY, CC_EMPTY, 0 );
+	}
+	for ( unsigned int i = 0; i < 8; ++i ) {
+		unknown8Bytes[i] = 0;
+	}
 	switch(pixelFormat) {
 		case PX_FMT_RGB8:
 			redMask    = 0x000000FF;
@@ -210,6 +228,9 @@ void NiPixelData::Reset( int new_width, int new_height, PixelFormat px_fmt ) {
 			unknown8Bytes[5] = 65;
 			unknown8Bytes[6] = 0;
 			unknown8Bytes[7] = 0;
+			SetChannel( channels[0], CHNL_RED, CC_FIXED, 8 );
+			SetChannel( channels[1], CHNL_GREEN, CC_FIXED, 8 );
+			SetChannel( channels[2], CHNL_BLUE, CC_FIXED, 8 );
 			break;
 		case PX_FMT_RGBA8 :
 			redMask    = 0x000000FF;
@@ -225,8 +246,13 @@ void NiPixelData::Reset( int new_width, int new_height, PixelFormat px_fmt ) {
 			unknown8Bytes[5] = 65;
 			unknown8Bytes[6] = 12;
 			unknown8Bytes[7] = 0;
+			SetChannel( channels[0], CHNL_RED, CC_FIXED, 8 );
+			SetChannel( channels[1], CHNL_GREEN, CC_FIXED, 8 );
+			SetChannel( channels[2], CHNL_BLUE, CC_FIXED, 8 );
+			SetChannel( channels[3], CHNL_ALPHA, CC_FIXED, 8 );
 			break;	
 		case PX_FMT_PAL8 :
+		case PX_FMT_PALA8 :
 			redMask   = 0x00000000;
 			blueMask  = 0x00000000;
 			greenMask = 0x00000000;
@@ -240,211 +266,261 @@ void NiPixelData::Reset( int new_width, int new_height, PixelFormat px_fmt ) {
 			unknown8Bytes[5] = 65;
 			unknown8Bytes[6] = 12;
 			unknown8Bytes[7] = 0;
+			SetChannel( channels[0], CHNL_INDEX, CC_INDEX, 8 );
 			break;	
 		//[4,0,0,0,0,0,0,0] if 0 (?) bits per pixel
+		case PX_FMT_DXT1 :
+		case PX_FMT_DXT5 :
+		case PX_FMT_DXT5_ALT :
+			redMask   = 0x00000000;
+			blueMask  = 0x00000000;
+			greenMask = 0x00000000;
+			alphaMask = 0x00000000;
+			bitsPerPixel = ( pixelFormat == PX_FMT_DXT1 ) ? 4 : 8;
+			unknown8Bytes[0] = 4;
+			SetChannel( channels[0], CHNL_COMPRESSED, CC_COMPRESSED, 0 );
+			break;
+		case PX_FMT_BUMP :
+		case PX_FMT_BUMPLUMA :
+			redMask   = 0x000000FF;
+			greenMask = 0x0000FF00;
+			blueMask  = ( pixelFormat == PX_FMT_BUMPLUMA ) ? 0x00FF0000 : 0x00000000;
+			alphaMask = 0x00000000;
+			bitsPerPixel = ( pixelFormat == PX_FMT_BUMPLUMA ) ? 24 : 16;
+			SetChannel( channels[0], CHNL_RED, CC_FIXED, 8 );
+			SetChannel( channels[1], CHNL_GREEN, CC_FIXED, 8 );
+			if ( pixelFormat == PX_FMT_BUMPLUMA ) {
+				SetChannel( channels[2], CHNL_BLUE, CC_FIXED, 8 );
+			}
+			break;
 		default:
 			throw runtime_error("The pixel type you have requested is not currently supported.");
 	}
+	bytesPerPixel = bitsPerPixel / 8;
 }
 
-vector<Color4> NiPixelData::GetColors() const {
-	vector<Color4> pixels;
-
-	if ( mipmaps.size() == 0 ) {
-		//Return empty vector
-		return pixels;
+//The palette as 256 RGBA entries, or empty if there is none
+static vector<byte> PaletteBytes( NiPalette * palette ) {
+	vector<byte> bytes;
+	if ( palette == NULL ) {
+		return bytes;
+	}
+	vector<Color4> colors = palette->GetPalette();
+	bytes.resize( 256 * 4, 0 );
+	for ( unsigned int i = 0; i < colors.size() && i < 256; ++i ) {
+		const float c[4] = { colors[i].r, colors[i].g, colors[i].b, colors[i].a };
+		for ( unsigned int k = 0; k < 4; ++k ) {
+			float f = c[k] * 255.0f + 0.5f;
+			bytes[i * 4 + k] = byte( f < 0.0f ? 0.0f : ( f > 255.0f ? 255.0f : f ) );
+		}
 	}
+	return bytes;
+}
 
-	//Pack the pixel data from the first mipmap into a vector of
-	//Color4 based on the pixel format.
-	pixels.resize( mipmaps[0].width * mipmaps[0].height );
-	switch(pixelFormat) {
-		case PX_FMT_RGB8:
-			for ( unsigned int i = 0; i < pixels.size(); ++i ) {
-				pixels[i].r = float(pixelData[0][i * 3]) / 255.0f;
-				pixels[i].g = float(pixelData[0][i * 3 + 1]) / 255.0f;
-				pixels[i].b = float(pixelData[0][i * 3 + 2]) / 255.0f;
-				pixels[i].a = 1.0f;
-			}
-			break;
-		case PX_FMT_RGBA8:
-			for ( unsigned int i = 0; i < pixels.size(); ++i ) {
-				pixels[i].r = float(pixelData[0][i * 4]) / 255.0f;
-				pixels[i].g = float(pixelData[0][i * 4 + 1]) / 255.0f;
-				pixels[i].b = float(pixelData[0][i * 4 + 2]) / 255.0f;
-				pixels[i].a = float(pixelData[0][i * 4 + 3]) / 255.0f;
-			}
-			break;
-		default:
-			throw runtime_error("The GetColors function only supports the PX_FMT_RGB8 and PX_FMT_RGBA8 pixel formats.");
+//Lays out up to max_levels mipmaps after the first, halving each side until
+//both are one pixel, and returns the size of one face
+static unsigned int LayOutMipmaps( vector<MipMap> & mipmaps, PixelFormat format, unsigned int max_levels ) {
+	mipmaps.resize(1);
+	MipMap m = mipmaps[0];
+	while ( mipmaps.size() < max_levels && ( m.width > 1 || m.height > 1 ) ) {
+		m.width = m.width > 1 ? m.width / 2 : 1;
+		m.height = m.height > 1 ? m.height / 2 : 1;
+		mipmaps.push_back(m);
 	}
+	unsigned int size = 0;
+	for ( unsigned int i = 0; i < mipmaps.size(); ++i ) {
+		mipmaps[i].offset = size;
+		size += GetPixelImageSize( format, mipmaps[i].width, mipmaps[i].height );
+	}
+	return size;
+}
 
-#ifdef IM_DEBUG
+unsigned int NiPixelData::GetFaceCount() const {
+	return numFaces;
+}
 
-	imdebug("rgba b=32f rs=2 w=%d h=%d %p", mipmaps[0].width, mipmaps[0].height, &pixels[0] );
-	//delete [] img;
-	cout << "Showing image returned by GetColors function." << endl;
-	cin.get();
-#endif
+vector<byte> NiPixelData::GetPixels( unsigned int level, unsigned int face ) const {
+	if ( level >= mipmaps.size() ) {
+		throw runtime_error("The requested mipmap does not exist.");
+	}
+	if ( face >= pixelData.size() ) {
+		throw runtime_error("The requested face does not exist.");
+	}
 
-	return pixels;
+	const MipMap & m = mipmaps[level];
+	if ( size_t(m.offset) + GetPixelImageSize( pixelFormat, m.width, m.height ) > pixelData[face].size() ) {
+		throw runtime_error("The pixel data is too short for the mipmap sizes.");
+	}
+	vector<byte> pal = PaletteBytes( palette );
+	vector<byte> rgba( size_t(m.width) * m.height * 4 );
+	DecodePixels( pixelFormat, pixelData[face].data() + m.offset, m.width, m.height, rgba.data(), pal.empty() ? NULL : pal.data() );
+	return rgba;
 }
 
-void NiPixelData::SetColors( const vector<Color4> & new_pixels, bool generate_mipmaps ) {
-	//Ensure that compatible pixel format is being used
-	if ( pixelFormat != PX_FMT_RGB8 && pixelFormat != PX_FMT_RGBA8 ) {
-		throw runtime_error("The SetColors function only supports the PX_FMT_RGB8 and PX_FMT_RGBA8 pixel formats.");
+vector< vector<byte> > NiPixelData::GetMipmapPixels( unsigned int face, unsigned int num_threads ) const {
+	if ( face >= pixelData.size() ) {
+		throw runtime_error("The requested face does not exist.");
 	}
 
+	vector< vector<byte> > levels( mipmaps.size() );
+	vector<PixelImage> images( mipmaps.size() );
+	for ( unsigned int i = 0; i < mipmaps.size(); ++i ) {
+		const MipMap & m = mipmaps[i];
+		if ( size_t(m.offset) + GetPixelImageSize( pixelFormat, m.width, m.height ) > pixelData[face].size() ) {
+			throw runtime_error("The pixel data is too short for the mipmap sizes.");
+		}
+		levels[i].resize( size_t(m.width) * m.height * 4 );
+		images[i] = PixelImage( pixelData[face].data() + m.offset, levels[i].data(), m.width, m.height );
+	}
+	vector<byte> pal = PaletteBytes( palette );
+	DecodePixelImages( pixelFormat, images, pal.empty() ? NULL : pal.data(), num_threads );
+	return levels;
+}
+
+void NiPixelData::SetPixels( const vector<byte> & rgba, bool generate_mipmaps, MipmapFilter filter, bool linear, unsigned int num_threads ) {
 	//Ensure that there is size information in the mipmaps
 	if ( mipmaps.size() == 0 ) {
 		throw runtime_error("The size informatoin has not been set.  Call the IPixelData::Reset() function first.");
 	}
 
 	//Ensure that the right number of pixels for the dimentions set have been passed
-	if ( new_pixels.size() != mipmaps[0].height * mipmaps[0].width ) {
-		throw runtime_error("You must pass one color for every pixel in the image.  There should be height * width colors.");
+	size_t face_bytes = size_t(mipmaps[0].height) * mipmaps[0].width * 4;
+	if ( rgba.size() != face_bytes * numFaces ) {
+		throw runtime_error("You must pass four bytes for every pixel in the image.  There should be height * width * 4 bytes for each face.");
 	}
 
-	unsigned int size = 0;
-	mipmaps.resize(1);
-	size = (mipmaps[0].height * mipmaps[0].width * bitsPerPixel) / 8;
+	unsigned int size = LayOutMipmaps( mipmaps, pixelFormat, generate_mipmaps ? UINT_MAX : 1 );
+	pixelData.assign( numFaces, vector<byte>( size ) );
+
+	//Find where the RGBA pixels of each mipmap of each face live.  RGBA8
+	//mipmaps are filtered straight into the pixel data; other formats go
+	//through scratch images that are all encoded together at the end.
+	size_t levels = mipmaps.size();
+	bool direct = ( pixelFormat == PX_FMT_RGBA8 );
+	vector< vector<byte> > scratch( numFaces * levels );
+	vector<byte *> level_pixels( numFaces * levels );
+	for ( unsigned int f = 0; f < numFaces; ++f ) {
+		for ( size_t i = 0; i < levels; ++i ) {
+			if ( direct ) {
+				level_pixels[f * levels + i] = pixelData[f].data() + mipmaps[i].offset;
+			} else if ( i > 0 ) {
+				scratch[f * levels + i].resize( size_t(mipmaps[i].width) * mipmaps[i].height * 4 );
+				level_pixels[f * levels + i] = scratch[f * levels + i].data();
+			}
+		}
+		if ( direct ) {
+			memcpy( level_pixels[f * levels], rgba.data() + f * face_bytes, face_bytes );
+		}
+	}
 
-	//Deal with multiple mipmaps
-	if ( generate_mipmaps == true ) {
-		MipMap m;
-		m.height = mipmaps[0].height;
-		m.width = mipmaps[0].width;
+	//Each mipmap is filtered from the one before, all faces at once
+	for ( size_t i = 1; i < levels; ++i ) {
+		vector<PixelImage> images( numFaces );
+		for ( unsigned int f = 0; f < numFaces; ++f ) {
+			const byte * in = ( i == 1 && !direct ) ? rgba.data() + f * face_bytes : level_pixels[f * levels + i - 1];
+			images[f] = PixelImage( in, level_pixels[f * levels + i], mipmaps[i-1].width, mipmaps[i-1].height );
+		}
+		DownsamplePixelImages( images, filter, linear, num_threads );
+	}
 
-		size = (mipmaps[0].height * mipmaps[0].width * bitsPerPixel) / 8;
+	if ( !direct ) {
+		vector<PixelImage> images;
+		images.reserve( numFaces * levels );
+		for ( unsigned int f = 0; f < numFaces; ++f ) {
+			for ( size_t i = 0; i < levels; ++i ) {
+				const byte * in = ( i == 0 ) ? rgba.data() + f * face_bytes : level_pixels[f * levels + i];
+				images.push_back( PixelImage( in, pixelData[f].data() + mipmaps[i].offset, mipmaps[i].width, mipmaps[i].height ) );
+			}
+		}
+		vector<byte> pal = PaletteBytes( palette );
+		EncodePixelImages( pixelFormat, images, pal.empty() ? NULL : pal.data(), num_threads );
+	}
+}
+
+unsigned int NiPixelData::GetMipmapCount() const {
+	return (unsigned int)mipmaps.size();
+}
 
-		while ( m.width != 1 && m.height != 1 ) {
-			m.width /= 2;
-			m.height /= 2;
-			m.offset = size;
+const vector<byte> & NiPixelData::GetRawPixels( unsigned int face ) const {
+	if ( face >= pixelData.size() ) {
+		throw runtime_error("The requested face does not exist.");
+	}
+	return pixelData[face];
+}
 
-			size += (m.height * m.width * bitsPerPixel) / 8;
+void NiPixelData::SetRawPixels( const vector< vector<byte> > & faces, unsigned int num_mipmaps ) {
+	if ( mipmaps.size() == 0 ) {
+		throw runtime_error("The size informatoin has not been set.  Call the IPixelData::Reset() function first.");
+	}
+	if ( faces.size() != numFaces ) {
+		throw runtime_error("You must pass the pixel data of every face.");
+	}
+	if ( num_mipmaps == 0 ) {
+		throw runtime_error("A texture must have at least one mipmap.");
+	}
 
-			mipmaps.push_back(m);
+	unsigned int size = LayOutMipmaps( mipmaps, pixelFormat, num_mipmaps );
+	if ( mipmaps.size() != num_mipmaps ) {
+		throw runtime_error("The texture is too small for that many mipmaps.");
+	}
+	for ( size_t f = 0; f < faces.size(); ++f ) {
+		if ( faces[f].size() != size ) {
+			throw runtime_error("The pixel data does not match the size of the mipmaps.");
 		}
 	}
+	pixelData = faces;
+}
 
-	pixelData.resize(1);
-	pixelData[0].resize( size * bitsPerPixel / 8 );
-
-	//Copy pixels to Color4 C array
-	Color4 * tmp_image = new Color4[new_pixels.size()];
-
-	for (unsigned int i = 0; i < new_pixels.size(); ++i ) {
-		tmp_image[i] = new_pixels[i];
-	}
-
-	//Pack pixel data
-	for (unsigned int i = 0; i < mipmaps.size(); ++i ) {
-		if ( i > 0 ) {
-			//Allocate space to store re-sized image.
-			Color4 * resized = new Color4[ mipmaps[i].width * mipmaps[i].height ];
-
-			//Visit every other pixel in each row and column of the previous image
-			for ( unsigned int w = 0; w < mipmaps[i-1].width; w+=2 ) {
-				for ( unsigned int h = 0; h < mipmaps[i-1].height; h+=2 ) {
-					Color4 & av = resized[(h/2) * mipmaps[i].width + (w/2)];
-
-					//Start with the value of the current pixel
-					av = tmp_image[h * mipmaps[i-1].width + w];
-					float num_colors = 1.0f;
-
-					//Only process the pixel above if height is > 1
-					if ( h > 1 ) {
-						Color4 & px = tmp_image[(h+1) * mipmaps[i-1].width + w];
-						av.r += px.r;
-						av.g += px.g;
-						av.b += px.b;
-						av.a += px.a;
-						num_colors += 1.0f;
-					}
-
-					//Only process the pixel to the right if width > 1
-					if (w > 1 ) {
-						Color4 & px = tmp_image[h * mipmaps[i-1].width + (w+1)];
-						av.r += px.r;
-						av.g += px.g;
-						av.b += px.b;
-						av.a += px.a;
-						num_colors += 1.0f;
-					}
-
-					//Only process the pixel to the upper right if both width and height are > 1
-					if ( w > 1 && h >> 1 ) {
-						Color4 & px = tmp_image[(h+1) * mipmaps[i-1].width + (w+1)];
-						av.r += px.r;
-						av.g += px.g;
-						av.b += px.b;
-						av.a += px.a;
-						num_colors += 1.0f;
-					}
-
-					//Calculate average
-					av.r /= num_colors;
-					av.g /= num_colors;
-					av.b /= num_colors;
-					av.a /= num_colors;
-				}
-			}
-			//Resize is complete, set result to tmp_image
+vector<Color4> NiPixelData::GetColors() const {
+	vector<Color4> pixels;
 
-			//delete old tmp_image data
-			delete [] tmp_image;
+	if ( mipmaps.size() == 0 ) {
+		//Return empty vector
+		return pixels;
+	}
 
-			//Adjust pointer values
-			tmp_image = resized;
-			resized = NULL;
-		}
+	//Decode the first mipmap and spread the bytes out to floats
+	vector<byte> rgba = GetPixels( 0, 0 );
+	pixels.resize( mipmaps[0].width * mipmaps[0].height );
+	for ( unsigned int i = 0; i < pixels.size(); ++i ) {
+		pixels[i].r = float(rgba[i * 4]) / 255.0f;
+		pixels[i].g = float(rgba[i * 4 + 1]) / 255.0f;
+		pixels[i].b = float(rgba[i * 4 + 2]) / 255.0f;
+		pixels[i].a = float(rgba[i * 4 + 3]) / 255.0f;
+	}
 
-		//Data is ready to be packed into the byes of this mipmap
+#ifdef IM_DEBUG
 
-		#ifdef IM_DEBUG
-			cout << "Showing mipmap size " << mipmaps[i].width << " x " << mipmaps[i].height << "." << endl;
-			imdebug("rgba b=32f w=%d h=%d %p", mipmaps[i].width, mipmaps[i].height, &tmp_image[0] );
-			cin.get();
-		#endif
+	imdebug("rgba b=32f rs=2 w=%d h=%d %p", mipmaps[0].width, mipmaps[0].height, &pixels[0] );
+	//delete [] img;
+	cout << "Showing image returned by GetColors function." << endl;
+	cin.get();
+#endif
 
-		//Start at offset
-		byte * map = &pixelData[0][mipmaps[i].offset];
+	return pixels;
+}
 
-		switch(pixelFormat) {
-		case PX_FMT_RGB8:
-			for ( unsigned int j = 0; j < mipmaps[i].width * mipmaps[i].height; ++j ) {
-				map[j * 3] = int( tmp_image[j].r * 255.0f );
-				map[j * 3 + 1] = int( tmp_image[j].g * 255.0f );
-				map[j * 3 + 2] = int( tmp_image[j].b * 255.0f );
-			}
+void NiPixelData::SetColors( const vector<Color4> & new_pixels, bool generate_mipmaps ) {
+	//Ensure that there is size information in the mipmaps
+	if ( mipmaps.size() == 0 ) {
+		throw runtime_error("The size informatoin has not been set.  Call the IPixelData::Reset() function first.");
+	}
 
-			//#ifdef IM_DEBUG
-			//	cout << "Showing mipmap after being packed  - size " << mipmaps[i].width << " x " << mipmaps[i].height << "." << endl;
-			//	imdebug("rgb w=%d h=%d %p", mipmaps[i].width, mipmaps[i].height, &map[0] );
-			//	cin.get();
-			//#endif
-			break;
-		case PX_FMT_RGBA8:
-			for ( unsigned int j = 0; j < mipmaps[i].width * mipmaps[i].height; ++j ) {
-				map[j * 4] = int( tmp_image[j].r * 255.0f );
-				map[j * 4 + 1] = int( tmp_image[j].g * 255.0f );
-				map[j * 4 + 2] = int( tmp_image[j].b * 255.0f );
-				map[j * 4 + 3] = int( tmp_image[j].a * 255.0f );
-			}
+	//Ensure that the right number of pixels for the dimentions set have been passed
+	if ( new_pixels.size() != mipmaps[0].height * mipmaps[0].width * numFaces ) {
+		throw runtime_error("You must pass one color for every pixel in the image.  There should be height * width colors for each face.");
+	}
 
-			//#ifdef IM_DEBUG
-			//	cout << "Showing mipmap after being packed  - size " << mipmaps[i].width << " x " << mipmaps[i].height << "." << endl;
-			//	imdebug("rgba w=%d h=%d %p", mipmaps[i].width, mipmaps[i].height, &map[0] );
-			//	cin.get();
-			//#endif
-			break;
-		case PX_FMT_PAL8:
-			throw runtime_error("The SetColors function only supports the PX_FMT_RGB8 and PX_FMT_RGBA8 pixel formats.");
-			break;
+	//Round the colors to bytes and pass them on
+	vector<byte> rgba( new_pixels.size() * 4 );
+	for ( unsigned int i = 0; i < new_pixels.size(); ++i ) {
+		const float c[4] = { new_pixels[i].r, new_pixels[i].g, new_pixels[i].b, new_pixels[i].a };
+		for ( unsigned int k = 0; k < 4; ++k ) {
+			float f = c[k] * 255.0f + 0.5f;
+			rgba[i * 4 + k] = byte( f < 0.0f ? 0.0f : ( f > 255.0f ? 255.0f : f ) );
 		}
 	}
+	SetPixels( rgba, generate_mipmaps );
 }
 
 //--END CUSTOM CODE--//
@@ -267,6 +267,14 @@ vector<SkinWeight> NiSkinData::GetBoneWeights( unsigned int bone_index ) const {
 	return boneList[bone_index].vertexWeights;
 }
 
+const vector<SkinWeight> & NiSkinData::GetBoneWeightArray( unsigned int bone_index ) const {
+	if ( bone_index >= boneList.size() ) {
+		throw runtime_error( "The specified bone index was larger than the number of bones in this NiSkinData." );
+	}
+
+	return boneList[bone_index].vertexWeights;
+}
+
 void NiSkinData::SetBoneWeights( unsigned int bone_index, const vector<SkinWeight> & weights, Vector3 center, float radius ) {
 	if ( bone_index > boneList.size() ) {
 		throw runtime_error( "The specified bone index was larger than the number of bones in this NiSkinData." );
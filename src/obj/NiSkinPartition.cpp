@@ -557,6 +557,10 @@ vector<unsigned short> NiSkinPartition::GetVertexMap( int partition ) const {
    return skinPartitionBlocks.at(partition).vertexMap;
 }
 
+const vector<unsigned short> & NiSkinPartition::GetVertexMapArray( int partition ) const {
+   return skinPartitionBlocks.at(partition).vertexMap;
+}
+
 void NiSkinPartition::SetVertexMap( int partition, const vector<unsigned short>& vertexMap ) {
    SkinPartition& part = skinPartitionBlocks.at(partition);
    if (vertexMap.empty()) {
@@ -644,6 +648,10 @@ vector<unsigned short> NiSkinPartition::GetStrip( int partition, int index ) con
    return skinPartitionBlocks.at(partition).strips[index];
 }
 
+const vector<unsigned short> & NiSkinPartition::GetStripArray( int partition, int index ) const {
+   return skinPartitionBlocks.at(partition).strips[index];
+}
+
 void NiSkinPartition::SetStrip( int partition, int index, const vector<unsigned short> & in ) {
    SkinPartition& part = skinPartitionBlocks.at(partition);
    part.strips[index] = in;
@@ -743,7 +751,7 @@ NiSkinPartition::NiSkinPartition(Ref<NiTriBasedGeom> shape) {
    for (int i=0; i<totalBones; ++i) {
       boneMap[i] = i;
 
-      vector<SkinWeight> skinWeights = skinData->GetBoneWeights(i);
+      const vector<SkinWeight> & skinWeights = skinData->GetBoneWeightArray(i);
       for (vector<SkinWeight>::const_iterator skinWeight = skinWeights.begin(); skinWeight != skinWeights.end(); ++skinWeight) {
          WeightList& vertexWeight = vertexWeights[skinWeight->index];
          BoneList& boneIndex = boneIndexList[skinWeight->index];
@@ -790,7 +798,7 @@ NiSkinPartition::NiSkinPartition(Ref<NiTriBasedGeom> shape) {
       unsigned short nstrips = stripData->GetStripCount();
       SetStripCount(0, nstrips);
       for (int i=0; i<int(nstrips); ++i) {
-         SetStrip(0, i, stripData->GetStrip(i));
+         SetStrip(0, i, stripData->GetStripArray(i));
       }
    } else {
 
@@ -911,7 +919,7 @@ NiSkinPartition::NiSkinPartition(Ref<NiTriBasedGeom> shape, int maxBonesPerParti
    }
 
       // read in the weights from NiSkinData
-   vector<Vector3> verts = geomData->GetVertices();
+   const vector<Vector3> & verts = geomData->GetVertexArray();
    vector< BoneWeightList > weights;
    if (verts.empty()){
       throw runtime_error( "Attempted to generate a skin partition on a mesh with no vertices." );
@@ -927,7 +935,7 @@ NiSkinPartition::NiSkinPartition(Ref<NiTriBasedGeom> shape, int maxBonesPerParti
    int numBones = skinData->GetBoneCount();
    for ( int bone = 0; bone < numBones; bone++ )
    {
-      vector<SkinWeight> vertexWeights = skinData->GetBoneWeights(bone);
+      const vector<SkinWeight> & vertexWeights = skinData->GetBoneWeightArray(bone);
       for (int r = 0; r < int(vertexWeights.size()); ++r ){
          int vertex = vertexWeights[r].index;
          float weight = vertexWeights[r].weight;
@@ -1250,7 +1258,7 @@ NiSkinPartition::NiSkinPartition(Ref<NiTriBasedGeom> shape, int maxBonesPerParti
          int nstrips = data->GetStripCount();
          SetStripCount( p, nstrips );
          for ( int i=0; i<nstrips; ++i ) {
-            SetStrip(p, i, data->GetStrip(i));
+            SetStrip(p, i, data->GetStripArray(i));
          }
       }
       else
@@ -153,4 +153,8 @@ void NiTextKeyExtraData::SetKeys( vector< Key<string> > const & keys ) {
 	}
 }
 
+void NiTextKeyExtraData::NormalizeKeys( float phase, float frequency ) {
+	NormalizeKeyVector( this->textKeys, phase, frequency );
+}
+
 //--END CUSTOM CODE--//
@@ -210,13 +210,14 @@ void NiTimeController::SetPhase( float n ) {
 }
 
 void NiTimeController::NormalizeKeys() {
-	//Normalize the start and stop times
-	startTime = frequency * startTime + phase;
-	stopTime = frequency * stopTime + phase;
+	//Normalize the start and stop times the same way as the keys, which
+	//share their time line
+	startTime = ( startTime - phase ) / frequency;
+	stopTime = ( stopTime - phase ) / frequency;
 
 	//Set phase to 0 and frequency to 1
 	phase = 0.0f;
-	frequency = 0.0f;
+	frequency = 1.0f;
 }
 
 float NiTimeController::GetStartTime() const {
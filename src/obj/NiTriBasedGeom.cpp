@@ -152,10 +152,10 @@ void NiTriBasedGeom::UpdateTangentSpace(int method) {
 	}
 
 	//Get mesh data from data object
-	vector<Vector3> verts = niTriGeomData->GetVertices();
-	vector<Vector3> norms = niTriGeomData->GetNormals();
-	vector<Triangle> tris = niTriGeomData->GetTriangles();
-	vector<TexCoord> uvs = niTriGeomData->GetUVSet(0);
+	const vector<Vector3> & verts = niTriGeomData->GetVertexArray();
+	const vector<Vector3> & norms = niTriGeomData->GetNormalArray();
+	const vector<Triangle> & tris = niTriGeomData->GetTriangleArray();
+	const vector<TexCoord> & uvs = niTriGeomData->GetUVSetArray(0);
 
 	/* check for data validity */
 	if(
@@ -172,7 +172,10 @@ void NiTriBasedGeom::UpdateTangentSpace(int method) {
 	if ( method == 0 ) // Nifskope algorithm
 	{
 		for( int t = 0; t < (int)tris.size(); t++ ) {
-			Triangle & tri = tris[t];
+			const Triangle & tri = tris[t];
+			if ( tri[0] == tri[1] || tri[0] == tri[2] || tri[1] == tri[2] ) {
+				continue;
+			}
 
 			int i1 = tri[0];
 			int i2 = tri[1];
@@ -246,7 +249,10 @@ void NiTriBasedGeom::UpdateTangentSpace(int method) {
 	{
 		for ( unsigned int faceNo = 0; faceNo < tris.size(); ++faceNo )   // for each face
 		{
-			Triangle & t = tris[faceNo];  // get face
+			const Triangle & t = tris[faceNo];  // get face
+			if ( t[0] == t[1] || t[0] == t[2] || t[1] == t[2] ) {
+				continue;
+			}
 			int i0 = t[0], i1 = t[1], i2 = t[2];		// get vertex numbers
 			Vector3 side_0 = verts[i0] - verts[i1];
 			Vector3 side_1 = verts[i2] - verts[i1];
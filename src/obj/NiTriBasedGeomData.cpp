@@ -104,4 +104,9 @@ vector<Triangle> NiTriBasedGeomData::GetTriangles() const {
 	return vector<Triangle>();
 }
 
+const vector<Triangle> & NiTriBasedGeomData::GetTriangleArray() const {
+	static const vector<Triangle> none;
+	return none;
+}
+
 //--END CUSTOM CODE--//
@@ -267,6 +267,10 @@ vector<Triangle> NiTriShapeData::GetTriangles() const {
 	return good_triangles;
 }
 
+const vector<Triangle> & NiTriShapeData::GetTriangleArray() const {
+	return triangles;
+}
+
 void NiTriShapeData::SetTriangles( const vector<Triangle> & in ) {
 	if ( in.size() > 65535 || in.size() < 0 ) {
 		throw runtime_error("Invalid Triangle Count: must be between 0 and 65535.");
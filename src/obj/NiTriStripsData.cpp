@@ -34,6 +34,7 @@ const Type NiTriStripsData::TYPE("NiTriStripsData", &NiTriBasedGeomData::TYPE );
 
 NiTriStripsData::NiTriStripsData() : numStrips((unsigned short)0), hasPoints(false) {
 	//--BEGIN CONSTRUCTOR CUSTOM CODE--//
+	triangleCacheValid = false;
 	//--END CUSTOM CODE--//
 }
 
@@ -85,6 +86,7 @@ void NiTriStripsData::Read( istream& in, list<unsigned int> & link_stack, const
 	};
 
 	//--BEGIN POST-READ CUSTOM CODE--//
+	triangleCacheValid = false;
 	//--END CUSTOM CODE--//
 }
 
@@ -193,6 +195,7 @@ std::list<NiObject *> NiTriStripsData::GetPtrs() const {
 //--BEGIN MISC CUSTOM CODE--//
 
 NiTriStripsData::NiTriStripsData(const vector<Triangle> &tris, bool nvtristrips) {
+   triangleCacheValid = false;
    if (nvtristrips)
       SetNvTriangles(tris);
    else
@@ -207,6 +210,7 @@ void NiTriStripsData::SetStripCount(int n) {
 	points.resize( n );
    stripLengths.resize( n );
    hasPoints = (n != 0);
+   triangleCacheValid = false;
 
 	//Recalculate Triangle Count
 	numTriangles = CalcTriangleCount();
@@ -217,10 +221,24 @@ vector<unsigned short> NiTriStripsData::GetStrip( int index ) const {
 	return points[index];
 }
 
+const vector<unsigned short> & NiTriStripsData::GetStripArray( int index ) const {
+	return points[index];
+}
+
 vector<Triangle> NiTriStripsData::GetTriangles() const {
+	return GetTriangleArray();
+}
+
+const vector<Triangle> & NiTriStripsData::GetTriangleArray() const {
+	//Shared strips data may be measured by several threads at once
+	std::lock_guard<std::mutex> lock( triangleCacheLock );
+	if ( triangleCacheValid ) {
+		return triangleCache;
+	}
 
-	//Create a vector to hold the triangles
-	vector<Triangle> triangles;
+	//Rebuild the triangles from the strips
+	vector<Triangle> & triangles = triangleCache;
+	triangles.clear();
 	int n = 0; // Current triangle
 
 	//Cycle through all strips
@@ -257,12 +275,14 @@ vector<Triangle> NiTriStripsData::GetTriangles() const {
 		}
 	}
 
+	triangleCacheValid = true;
 	return triangles;
 }
 
 //Setter
 void NiTriStripsData::SetStrip( int index, const vector<unsigned short> & in ) {
 	points[index] = in;
+	triangleCacheValid = false;
 
 	//Recalculate Triangle Count
 	numTriangles = CalcTriangleCount();
@@ -290,6 +310,7 @@ void NiTriStripsData::SetNvTriangles( const vector<Triangle> & in ) {
    }
    points.clear();
    numTriangles = 0;
+   triangleCacheValid = false;
 
    unsigned short *data = new unsigned short[in.size() * 3 * 2];
    for (size_t i=0; i< in.size(); i++) {
@@ -334,6 +355,7 @@ void NiTriStripsData::SetTSTriangles( const vector<Triangle> & in ) {
 
    points.clear();
    numTriangles = 0;
+   triangleCacheValid = false;
 
    TriStrips strips;
    triangle_stripper::indices idcs(in.size()*3);
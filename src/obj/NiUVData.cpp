@@ -138,4 +138,11 @@ std::list<NiObject *> NiUVData::GetPtrs() const {
 }
 
 //--BEGIN MISC CUSTOM CODE--//
+
+void NiUVData::NormalizeKeys( float phase, float frequency ) {
+	for ( unsigned int i = 0; i < 4; ++i ) {
+		NormalizeKeyVector( uvGroups[i].keys, phase, frequency );
+	}
+}
+
 //--END CUSTOM CODE--//
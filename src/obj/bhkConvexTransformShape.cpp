@@ -94,9 +94,7 @@ std::list<NiObject *> bhkConvexTransformShape::GetPtrs() const {
 //--BEGIN MISC CUSTOM CODE--//
 void bhkConvexTransformShape::CalcMassProperties(float density, bool solid, float &mass, float &volume, Vector3 &center, InertiaMatrix& inertia)
 {
-	center = Vector3(0,0,0);
-	mass = 0.0f, volume = 0.0f;
-	inertia = InertiaMatrix::IDENTITY;
+	bhkTransformShape::CalcMassProperties(density, solid, mass, volume, center, inertia);
 }
 
 
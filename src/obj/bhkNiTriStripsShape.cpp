@@ -295,13 +295,12 @@ void bhkNiTriStripsShape::CalcMassProperties(float density, bool solid, float &m
 	vector<Triangle> tris;
 	for ( vector<NiTriStripsDataRef>::iterator itr = stripsData.begin(); itr != stripsData.end(); ++itr )
 	{
-		size_t nv = verts.size(), nt = tris.size();
-		vector<Vector3> v = (*itr)->GetVertices();
-		vector<Triangle> t = (*itr)->GetTriangles();
-		for (size_t i=0; i<nv; ++i)
-			verts.push_back( v[i] );
-		for (size_t i=0; i<nt; ++i)
-			tris.push_back( Triangle(t[i][0] + nt, t[i][1] + nt, t[i][2] + nt) );
+		size_t nv = verts.size();
+		const vector<Vector3> & v = (*itr)->GetVertexArray();
+		const vector<Triangle> & t = (*itr)->GetTriangleArray();
+		verts.insert( verts.end(), v.begin(), v.end() );
+		for (size_t i=0; i<t.size(); ++i)
+			tris.push_back( Triangle(t[i][0] + nv, t[i][1] + nv, t[i][2] + nv) );
 	}
 	Inertia::CalcMassPropertiesPolyhedron(verts, tris, density, solid, mass, volume, center, inertia);
 }
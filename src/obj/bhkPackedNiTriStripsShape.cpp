@@ -216,7 +216,7 @@ void bhkPackedNiTriStripsShape::CalcMassProperties(float density, bool solid, fl
 
 	if (data != NULL)
 	{
-		vector<Vector3> verts = data->GetVertices();
+		const vector<Vector3> & verts = data->GetVertexArray();
 		vector<Triangle> tris = data->GetTriangles();
 		Inertia::CalcMassPropertiesPolyhedron(verts, tris, density, solid, mass, volume, center, inertia);
 	}
@@ -8,6 +8,7 @@ All rights reserved.  Please see niflib.h for license. */
 //-----------------------------------NOTICE----------------------------------//
 
 //--BEGIN FILE HEAD CUSTOM CODE--//
+#include "../../include/Inertia.h"
 //--END CUSTOM CODE--//
 
 #include "../../include/FixLink.h"
@@ -188,13 +189,13 @@ void bhkTransformShape::CalcMassProperties(float density, bool solid, float &mas
 	inertia = InertiaMatrix::IDENTITY;
 	if (shape != NULL)
 	{
-		Matrix44 transform_transposed = transform.Transpose();
-		shape->CalcMassProperties(density, solid, mass, volume, center, inertia);
-		center = transform * center;
-
-		Matrix44 tm(inertia.Submatrix(0, 0));
-		Matrix44 im = transform_transposed * tm * transform;
-		inertia = InertiaMatrix(im.GetRotation());
+		float m; float v; Vector3 c; InertiaMatrix i;
+		shape->CalcMassProperties(density, solid, m, v, c, i);
+		Inertia::CombineMassProperties(
+			vector<float>(1, m), vector<float>(1, v), vector<Vector3>(1, c),
+			vector<InertiaMatrix>(1, i), vector<Matrix44>(1, transform),
+			mass, volume, center, inertia
+			);
 	}
 }
 //--END CUSTOM CODE--//
@@ -8,6 +8,7 @@ All rights reserved.  Please see niflib.h for license. */
 //-----------------------------------NOTICE----------------------------------//
 
 //--BEGIN FILE HEAD CUSTOM CODE--//
+#include "../NifSimd.h"
 //--END CUSTOM CODE--//
 
 #include "../../include/FixLink.h"
@@ -41,6 +42,11 @@ NiObject * hkPackedNiTriStripsData::Create() {
 
 void hkPackedNiTriStripsData::Read( istream& in, list<unsigned int> & link_stack, const NifInfo & info ) {
 	//--BEGIN PRE-READ CUSTOM CODE--//
+	//From 20.2.0.7 the vertices may be stored as half floats
+	if ( info.version >= 0x14020007 ) {
+		ReadCompressible( in, link_stack, info );
+		return;
+	}
 	//--END CUSTOM CODE--//
 
 	bhkShapeCollection::Read( in, link_stack, info );
@@ -79,6 +85,10 @@ void hkPackedNiTriStripsData::Read( istream& in, list<unsigned int> & link_stack
 
 void hkPackedNiTriStripsData::Write( ostream& out, const map<NiObjectRef,unsigned int> & link_map, list<NiObject *> & missing_link_stack, const NifInfo & info ) const {
 	//--BEGIN PRE-WRITE CUSTOM CODE--//
+	if ( ( info.version >= 0x14020007 ) && ( unknownByte1 != 0 ) ) {
+		WriteCompressed( out, link_map, missing_link_stack, info );
+		return;
+	}
 	//--END CUSTOM CODE--//
 
 	bhkShapeCollection::Write( out, link_map, missing_link_stack, info );
@@ -193,9 +203,86 @@ std::list<NiObject *> hkPackedNiTriStripsData::GetPtrs() const {
 
 //--BEGIN MISC CUSTOM CODE--//
 
+void hkPackedNiTriStripsData::ReadCompressible( istream& in, list<unsigned int> & link_stack, const NifInfo & info ) {
+	//The layout from 20.2.0.7 on, with the vertices stored either as floats
+	//or, when the byte before them is set, as half floats
+	bhkShapeCollection::Read( in, link_stack, info );
+	NifStream( numTriangles, in, info );
+	triangles.resize(numTriangles);
+	for (unsigned int i1 = 0; i1 < triangles.size(); i1++) {
+		NifStream( triangles[i1].triangle, in, info );
+		NifStream( triangles[i1].weldingInfo, in, info );
+	};
+	NifStream( numVertices, in, info );
+	NifStream( unknownByte1, in, info );
+	vertices.resize(numVertices);
+	if ( unknownByte1 != 0 ) {
+		vector<unsigned short> halves( vertices.size() * 3 );
+		for (unsigned int i1 = 0; i1 < halves.size(); i1++) {
+			NifStream( halves[i1], in, info );
+		};
+		vector<float> floats( halves.size() );
+		if ( !halves.empty() ) {
+			HalfToFloatArray( &halves[0], &floats[0], halves.size() );
+		};
+		for (unsigned int i1 = 0; i1 < vertices.size(); i1++) {
+			vertices[i1] = Vector3( floats[3 * i1], floats[3 * i1 + 1], floats[3 * i1 + 2] );
+		};
+	} else {
+		for (unsigned int i1 = 0; i1 < vertices.size(); i1++) {
+			NifStream( vertices[i1], in, info );
+		};
+	};
+	NifStream( numSubShapes, in, info );
+	subShapes.resize(numSubShapes);
+	for (unsigned int i2 = 0; i2 < subShapes.size(); i2++) {
+		NifStream( subShapes[i2].layer, in, info );
+		NifStream( subShapes[i2].colFilter, in, info );
+		NifStream( subShapes[i2].unknownShort, in, info );
+		NifStream( subShapes[i2].numVertices, in, info );
+		NifStream( subShapes[i2].material, in, info );
+	};
+}
+
+void hkPackedNiTriStripsData::WriteCompressed( ostream& out, const map<NiObjectRef,unsigned int> & link_map, list<NiObject *> & missing_link_stack, const NifInfo & info ) const {
+	bhkShapeCollection::Write( out, link_map, missing_link_stack, info );
+	numSubShapes = (unsigned short)(subShapes.size());
+	numVertices = (unsigned int)(vertices.size());
+	numTriangles = (unsigned int)(triangles.size());
+	NifStream( numTriangles, out, info );
+	for (unsigned int i1 = 0; i1 < triangles.size(); i1++) {
+		NifStream( triangles[i1].triangle, out, info );
+		NifStream( triangles[i1].weldingInfo, out, info );
+	};
+	NifStream( numVertices, out, info );
+	NifStream( unknownByte1, out, info );
+	vector<float> floats( vertices.size() * 3 );
+	for (unsigned int i1 = 0; i1 < vertices.size(); i1++) {
+		floats[3 * i1] = vertices[i1].x;
+		floats[3 * i1 + 1] = vertices[i1].y;
+		floats[3 * i1 + 2] = vertices[i1].z;
+	};
+	vector<unsigned short> halves( floats.size() );
+	if ( !floats.empty() ) {
+		FloatToHalfArray( &floats[0], &halves[0], floats.size() );
+	};
+	for (unsigned int i1 = 0; i1 < halves.size(); i1++) {
+		NifStream( halves[i1], out, info );
+	};
+	NifStream( numSubShapes, out, info );
+	for (unsigned int i2 = 0; i2 < subShapes.size(); i2++) {
+		NifStream( subShapes[i2].layer, out, info );
+		NifStream( subShapes[i2].colFilter, out, info );
+		NifStream( subShapes[i2].unknownShort, out, info );
+		NifStream( subShapes[i2].numVertices, out, info );
+		NifStream( subShapes[i2].material, out, info );
+	};
+}
+
 vector<Triangle> hkPackedNiTriStripsData::GetTriangles() const {
 	//Remove any bad triangles
 	vector<Triangle> good_triangles;
+	good_triangles.reserve( triangles.size() );
 	for ( unsigned i = 0; i < triangles.size(); ++i ) {
 		const Triangle & t = triangles[i].triangle;
 		if ( t.v1 != t.v2 && t.v2 != t.v3 && t.v1 != t.v3 ) {
@@ -208,6 +295,7 @@ vector<Triangle> hkPackedNiTriStripsData::GetTriangles() const {
 vector<hkTriangle> hkPackedNiTriStripsData::GetHavokTriangles() const {
 	//Remove any bad triangles
 	vector<hkTriangle> good_triangles;
+	good_triangles.reserve( triangles.size() );
 	for ( unsigned i = 0; i < triangles.size(); ++i ) {
 		const hkTriangle & t = triangles[i];
 		if ( t.triangle.v1 != t.triangle.v2 && t.triangle.v2 != t.triangle.v3 && t.triangle.v1 != t.triangle.v3 ) {
@@ -220,6 +308,7 @@ vector<hkTriangle> hkPackedNiTriStripsData::GetHavokTriangles() const {
 vector<Vector3> hkPackedNiTriStripsData::GetNormals() const {
 	//Remove any bad triangles
 	vector<Vector3> good_normals;
+	good_normals.reserve( triangles.size() );
 	for ( unsigned i = 0; i < triangles.size(); ++i ) {
 		const Vector3 & t = triangles[i].normal;
 		good_normals.push_back(t);
@@ -287,5 +376,25 @@ void hkPackedNiTriStripsData::SetSubShapes( vector<OblivionSubShape>& value ) {
 	subShapes = value;
 }
 
+const vector<Vector3> & hkPackedNiTriStripsData::GetVertexArray() const {
+	return vertices;
+}
+
+const vector<hkTriangle> & hkPackedNiTriStripsData::GetHavokTriangleArray() const {
+	return triangles;
+}
+
+const vector<OblivionSubShape> & hkPackedNiTriStripsData::GetSubShapeArray() const {
+	return subShapes;
+}
+
+bool hkPackedNiTriStripsData::GetCompressed() const {
+	return unknownByte1 != 0;
+}
+
+void hkPackedNiTriStripsData::SetCompressed( bool value ) {
+	unknownByte1 = value ? 1 : 0;
+}
+
 
 //--END CUSTOM CODE--//
@@ -0,0 +1,175 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <sstream> // stringstream
+#include <cstdio>  // remove
+
+#include "niflib.h"
+#include "CollisionCheck.h"
+#include "obj/NiNode.h"
+#include "obj/NiTriShape.h"
+#include "obj/NiTriShapeData.h"
+#include "obj/NiSkinInstance.h"
+#include "obj/bhkCollisionObject.h"
+#include "obj/bhkRigidBodyT.h"
+#include "obj/bhkBoxShape.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(collisioncheck_test_suite)
+
+// a scene root holding one node with a cube mesh from -7 to 7 and a box
+// collision of the given half size in Havok units
+static NiNodeRef make_scene(const Vector3 & half, bhkRigidBody * body, NiNodeRef & rock) {
+  vector<Vector3> verts;
+  for (int i = 0; i < 8; ++i)
+    verts.push_back(Vector3((i & 1) ? 7.0f : -7.0f, (i & 2) ? 7.0f : -7.0f, (i & 4) ? 7.0f : -7.0f));
+  NiTriShapeDataRef data = new NiTriShapeData;
+  data->SetVertices(verts);
+  NiTriShapeRef shape = new NiTriShape;
+  shape->SetData(data);
+
+  bhkBoxShapeRef box = new bhkBoxShape;
+  box->SetDimensions(half);
+  body->SetShape(box);
+  bhkCollisionObjectRef collision = new bhkCollisionObject;
+  collision->SetBody(body);
+
+  rock = new NiNode;
+  rock->SetName("Rock");
+  rock->AddChild(StaticCast<NiAVObject>(shape));
+  rock->SetCollisionObject(collision);
+
+  NiNodeRef root = new NiNode;
+  root->SetLocalTranslation(Vector3(100.0f, 0.0f, 0.0f));
+  root->AddChild(StaticCast<NiAVObject>(rock));
+  return root;
+}
+
+static vector<NiObjectRef> objects_of(NiObject * root) {
+  stringstream ss;
+  WriteNifTree(ss, root, NifInfo(VER_20_0_0_5, 11));
+  ss.seekg(0);
+  return ReadNifList(ss);
+}
+
+BOOST_AUTO_TEST_CASE(matching_bounds_test)
+{
+  NiNodeRef rock;
+  NiNodeRef root = make_scene(Vector3(1, 1, 1), new bhkRigidBody, rock);
+  vector<NiObjectRef> objects = objects_of(root);
+  vector<CollisionMismatch> mismatches;
+  BOOST_CHECK_EQUAL(CheckCollisionBounds(objects, NifInfo(VER_20_0_0_5, 11), mismatches), 1u);
+  BOOST_CHECK(mismatches.empty());
+
+  // the translation of a plain rigid body is ignored
+  bhkRigidBodyRef body = new bhkRigidBody;
+  body->SetTranslation(Vector4(5, 0, 0, 0));
+  root = make_scene(Vector3(1, 1, 1), body, rock);
+  BOOST_CHECK_EQUAL(CheckCollisionBounds(objects_of(root), NifInfo(VER_20_0_0_5, 11), mismatches), 1u);
+  BOOST_CHECK(mismatches.empty());
+}
+
+BOOST_AUTO_TEST_CASE(mismatched_bounds_test)
+{
+  NiNodeRef rock;
+  NiNodeRef root = make_scene(Vector3(2, 1, 1), new bhkRigidBody, rock);
+  vector<NiObjectRef> objects = objects_of(root);
+  vector<CollisionMismatch> mismatches;
+  BOOST_CHECK_EQUAL(CheckCollisionBounds(objects, NifInfo(VER_20_0_0_5, 11), mismatches), 1u);
+  BOOST_REQUIRE_EQUAL(mismatches.size(), 1u);
+  BOOST_CHECK_EQUAL(mismatches[0].name, "Rock");
+  BOOST_CHECK(objects[mismatches[0].block] != NULL);
+  BOOST_CHECK_CLOSE(mismatches[0].gap, 7.0f, 1e-3f);
+  BOOST_CHECK_CLOSE(mismatches[0].renderMin.x, 93.0f, 1e-3f);
+  BOOST_CHECK_CLOSE(mismatches[0].collisionMax.x, 114.0f, 1e-3f);
+
+  // within the tolerance
+  CollisionCheckParams loose;
+  loose.tolerance = 8.0f;
+  CheckCollisionBounds(objects, NifInfo(VER_20_0_0_5, 11), mismatches, loose);
+  BOOST_CHECK(mismatches.empty());
+
+  // a translated body is moved, in Havok units
+  bhkRigidBodyTRef moved = new bhkRigidBodyT;
+  moved->SetTranslation(Vector4(1, 0, 0, 0));
+  root = make_scene(Vector3(1, 1, 1), moved, rock);
+  CheckCollisionBounds(objects_of(root), NifInfo(VER_20_0_0_5, 11), mismatches);
+  BOOST_REQUIRE_EQUAL(mismatches.size(), 1u);
+  BOOST_CHECK_CLOSE(mismatches[0].collisionMin.x, 100.0f, 1e-3f);
+
+  // Skyrim files use a larger Havok scale
+  root = make_scene(Vector3(0.1f, 0.1f, 0.1f), new bhkRigidBody, rock);
+  objects = objects_of(root);
+  BOOST_CHECK_EQUAL(CheckCollisionBounds(objects, NifInfo(VER_20_0_0_5, 11), mismatches), 1u);
+  BOOST_CHECK_EQUAL(mismatches.size(), 1u);
+  CheckCollisionBounds(objects, NifInfo(VER_20_2_0_7, 12, 83), mismatches);
+  BOOST_CHECK(mismatches.empty());
+}
+
+BOOST_AUTO_TEST_CASE(skipped_objects_test)
+{
+  // skinned meshes do not count towards the render bounds
+  NiNodeRef rock;
+  NiNodeRef root = make_scene(Vector3(2, 1, 1), new bhkRigidBody, rock);
+  NiGeometryRef shape = DynamicCast<NiGeometry>(rock->GetChildren()[0]);
+  shape->SetSkinInstance(new NiSkinInstance);
+  vector<CollisionMismatch> mismatches;
+  vector<NiObjectRef> objects;
+  objects.push_back(StaticCast<NiObject>(rock));
+  BOOST_CHECK_EQUAL(CheckCollisionBounds(objects, NifInfo(VER_20_0_0_5, 11), mismatches), 0u);
+  BOOST_CHECK(mismatches.empty());
+}
+
+BOOST_AUTO_TEST_CASE(batch_test)
+{
+  NiNodeRef rock;
+  vector<string> files;
+  files.push_back("collisioncheck_good.nif");
+  files.push_back("collisioncheck_bad.nif");
+  files.push_back("collisioncheck_missing.nif");
+  WriteNifTree(files[0], make_scene(Vector3(1, 1, 1), new bhkRigidBody, rock), NifInfo(VER_20_0_0_5, 11));
+  WriteNifTree(files[1], make_scene(Vector3(2, 1, 1), new bhkRigidBody, rock), NifInfo(VER_20_0_0_5, 11));
+  remove(files[2].c_str());
+
+  CollisionCheckParams params;
+  params.numThreads = 2;
+  vector<CollisionCheckResult> results;
+  BOOST_CHECK_EQUAL(CheckCollisionBounds(files, results, params), 2u);
+  BOOST_REQUIRE_EQUAL(results.size(), 3u);
+  BOOST_CHECK_EQUAL(results[0].file, files[0]);
+  BOOST_CHECK(results[0].error.empty());
+  BOOST_CHECK_EQUAL(results[0].checked, 1u);
+  BOOST_CHECK(results[0].mismatches.empty());
+  BOOST_CHECK(results[1].error.empty());
+  BOOST_CHECK_EQUAL(results[1].mismatches.size(), 1u);
+  BOOST_CHECK(!results[2].error.empty());
+
+  stringstream report;
+  WriteCollisionCheckReport(report, results);
+  string line;
+  getline(report, line);
+  BOOST_CHECK_EQUAL(line, "{\"file\":\"collisioncheck_good.nif\",\"status\":\"ok\",\"checked\":1,\"mismatches\":[]}");
+  getline(report, line);
+  BOOST_CHECK(line.find("\"status\":\"mismatch\"") != string::npos);
+  BOOST_CHECK(line.find("\"name\":\"Rock\"") != string::npos);
+  BOOST_CHECK(line.find("\"collision\":[86,-7,-7,114,7,7]") != string::npos);
+  getline(report, line);
+  BOOST_CHECK(line.find("\"status\":\"error\",\"error\":\"") != string::npos);
+  BOOST_CHECK(!getline(report, line));
+
+  // quotes and control characters are escaped
+  vector<CollisionCheckResult> odd(1);
+  odd[0].file = "a\"b\\c\x01";
+  odd[0].error = "bad\n";
+  stringstream escaped;
+  WriteCollisionCheckReport(escaped, odd);
+  BOOST_CHECK_EQUAL(escaped.str(), "{\"file\":\"a\\\"b\\\\c\\u0001\",\"status\":\"error\",\"error\":\"bad\\n\"}\n");
+
+  remove(files[0].c_str());
+  remove(files[1].c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,215 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "CollisionQuery.h"
+#include "obj/bhkListShape.h"
+#include "obj/bhkMoppBvTreeShape.h"
+#include "obj/bhkTransformShape.h"
+#include "obj/bhkPackedNiTriStripsShape.h"
+#include "obj/hkPackedNiTriStripsData.h"
+#include "obj/bhkSphereShape.h"
+#include "obj/bhkBoxShape.h"
+#include "obj/bhkCapsuleShape.h"
+#include "obj/bhkConvexVerticesShape.h"
+#include <algorithm>
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(collisionquery_test_suite)
+
+struct CollisionFixture {
+  bhkListShapeRef list;
+  bhkPackedNiTriStripsShapeRef ground;
+  bhkBoxShapeRef box;
+  bhkSphereShapeRef sphere;
+  bhkCapsuleShapeRef capsule;
+  bhkConvexVerticesShapeRef convex;
+
+  // a 20 x 20 ground grid at z = 0 under a moved box, a sphere, a capsule
+  // and a convex unit cube
+  CollisionFixture() {
+    vector<Vector3> verts;
+    vector<Triangle> tris;
+    const int n = 20;
+    for (int y = 0; y <= n; ++y)
+      for (int x = 0; x <= n; ++x)
+        verts.push_back(Vector3(x - 10.0f, y - 10.0f, 0.0f));
+    for (int y = 0; y < n; ++y) {
+      for (int x = 0; x < n; ++x) {
+        unsigned short i = (unsigned short)(y * (n + 1) + x);
+        tris.push_back(Triangle(i, i + 1, i + n + 1));
+        tris.push_back(Triangle(i + 1, i + n + 2, i + n + 1));
+      }
+    }
+    hkPackedNiTriStripsDataRef data = new hkPackedNiTriStripsData;
+    data->SetVertices(verts);
+    data->SetNumFaces(int(tris.size()));
+    data->SetTriangles(tris);
+    ground = new bhkPackedNiTriStripsShape;
+    ground->SetData(data);
+    bhkMoppBvTreeShapeRef mopp = new bhkMoppBvTreeShape;
+    mopp->SetShape(ground);
+
+    box = new bhkBoxShape;
+    box->SetDimensions(Vector3(1.0f, 1.0f, 1.0f));
+    bhkTransformShapeRef moved = new bhkTransformShape;
+    moved->SetShape(box);
+    Matrix44 xf;
+    xf[3][0] = 5.0f;
+    xf[3][2] = 3.0f;
+    moved->SetTransform(xf);
+
+    sphere = new bhkSphereShape;
+    sphere->SetRadius(2.0f);
+
+    capsule = new bhkCapsuleShape;
+    capsule->SetFirstPoint(Vector3(-5.0f, 0.0f, 1.0f));
+    capsule->SetSecondPoint(Vector3(-5.0f, 4.0f, 1.0f));
+    capsule->SetRadius(0.5f);
+
+    convex = new bhkConvexVerticesShape;
+    vector<Vector3> cube;
+    for (int i = 0; i < 8; ++i)
+      cube.push_back(Vector3(i & 1 ? 1.0f : 0.0f, i & 2 ? 1.0f : 0.0f, i & 4 ? 6.0f : 5.0f));
+    convex->SetVertices(cube);
+    vector<Vector4> planes;
+    planes.push_back(Vector4(1, 0, 0, -1));
+    planes.push_back(Vector4(-1, 0, 0, 0));
+    planes.push_back(Vector4(0, 1, 0, -1));
+    planes.push_back(Vector4(0, -1, 0, 0));
+    planes.push_back(Vector4(0, 0, 1, -6));
+    planes.push_back(Vector4(0, 0, -1, 5));
+    convex->SetNormalsAndDist(planes);
+
+    list = new bhkListShape;
+    vector<bhkShapeRef> shapes;
+    shapes.push_back(StaticCast<bhkShape>(mopp));
+    shapes.push_back(StaticCast<bhkShape>(moved));
+    shapes.push_back(StaticCast<bhkShape>(sphere));
+    shapes.push_back(StaticCast<bhkShape>(capsule));
+    shapes.push_back(StaticCast<bhkShape>(convex));
+    list->SetSubShapes(shapes);
+  }
+
+  CollisionRay down(float x, float y) {
+    CollisionRay ray;
+    ray.from = Vector3(x, y, 10.0f);
+    ray.to = Vector3(x, y, -10.0f);
+    return ray;
+  }
+};
+
+BOOST_FIXTURE_TEST_CASE(collisionquery_ray_test, CollisionFixture)
+{
+  ShapeBvh bvh(list);
+  BOOST_CHECK_EQUAL(bvh.GetPrimitiveCount(), 804u);
+
+  CollisionHit hit;
+  // the ground
+  BOOST_REQUIRE(bvh.RayCast(down(-8.5f, 7.5f), hit));
+  BOOST_CHECK(hit.shape == ground);
+  BOOST_CHECK_CLOSE(hit.fraction, 0.5f, 0.01);
+  BOOST_CHECK_CLOSE(hit.normal.z, 1.0f, 0.01);
+  // the moved box has its top at z = 4
+  BOOST_REQUIRE(bvh.RayCast(down(5.5f, 0.5f), hit));
+  BOOST_CHECK(hit.shape == box);
+  BOOST_CHECK_CLOSE(hit.fraction, 0.3f, 0.01);
+  // the sphere, from the side
+  CollisionRay side;
+  side.from = Vector3(0.0f, -10.0f, 0.5f);
+  side.to = Vector3(0.0f, 10.0f, 0.5f);
+  BOOST_REQUIRE(bvh.RayCast(side, hit));
+  BOOST_CHECK(hit.shape == sphere);
+  BOOST_CHECK_CLOSE(hit.fraction, (10.0f - sqrt(3.75f)) / 20.0f, 0.01);
+  // the capsule's side is at z = 1.5
+  BOOST_REQUIRE(bvh.RayCast(down(-5.0f, 2.0f), hit));
+  BOOST_CHECK(hit.shape == capsule);
+  BOOST_CHECK_CLOSE(hit.fraction, 8.5f / 20.0f, 0.01);
+  // the convex cube has its top at z = 6
+  BOOST_REQUIRE(bvh.RayCast(down(0.5f, 0.5f), hit));
+  BOOST_CHECK(hit.shape == convex);
+  BOOST_CHECK_CLOSE(hit.fraction, 0.2f, 0.01);
+  // outside the ground
+  BOOST_CHECK(!bvh.RayCast(down(30.0f, 30.0f), hit));
+  BOOST_CHECK_EQUAL(hit.primitive, (unsigned int)CollisionHit::NO_HIT);
+}
+
+BOOST_FIXTURE_TEST_CASE(collisionquery_batch_test, CollisionFixture)
+{
+  ShapeBvh bvh(list);
+  vector<CollisionRay> rays;
+  for (int i = 0; i < 400; ++i)
+    rays.push_back(down(-9.9f + (i % 20), -9.9f + (i / 20)));
+  vector<CollisionHit> hits;
+  bvh.RayCast(rays, hits, 4);
+  BOOST_REQUIRE_EQUAL(hits.size(), rays.size());
+  for (size_t i = 0; i < rays.size(); ++i) {
+    CollisionHit single;
+    BOOST_CHECK(bvh.RayCast(rays[i], single));
+    BOOST_CHECK_EQUAL(hits[i].primitive, single.primitive);
+    BOOST_CHECK_EQUAL(hits[i].fraction, single.fraction);
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(collisionquery_aabb_test, CollisionFixture)
+{
+  ShapeBvh bvh(list);
+  vector<unsigned int> found;
+  // a box above the ground touching only the convex cube
+  bvh.QueryAabb(Vector3(0.2f, 0.2f, 5.5f), Vector3(0.4f, 0.4f, 7.0f), found);
+  BOOST_REQUIRE_EQUAL(found.size(), 1u);
+  unsigned int part = 0;
+  BOOST_CHECK(bvh.GetPrimitiveShape(found[0], part) == convex);
+
+  // a flat box on the ground away from the other shapes touches both
+  // triangles of two grid squares
+  bvh.QueryAabb(Vector3(-8.8f, -8.8f, -0.1f), Vector3(-7.2f, -8.2f, 0.1f), found);
+  BOOST_CHECK_EQUAL(found.size(), 4u);
+  for (size_t i = 0; i < found.size(); ++i)
+    BOOST_CHECK(bvh.GetPrimitiveShape(found[i], part) == ground);
+}
+
+BOOST_FIXTURE_TEST_CASE(collisionquery_degenerate_test, CollisionFixture)
+{
+  // parts index the stored triangles, so a degenerate one in the middle
+  // must not shift the ones after it
+  hkPackedNiTriStripsDataRef data = ground->GetData();
+  vector<hkTriangle> tris = data->GetHavokTriangleArray();
+  hkTriangle degenerate;
+  degenerate.triangle = Triangle(3, 3, 4);
+  tris.insert(tris.begin() + 10, degenerate);
+  data->SetHavokTriangles(tris);
+  data->SetNumFaces(int(tris.size()));
+
+  ShapeBvh bvh(ground);
+  BOOST_CHECK_EQUAL(bvh.GetPrimitiveCount(), 800u);
+  CollisionHit hit;
+  BOOST_REQUIRE(bvh.RayCast(down(-8.8f, 7.2f), hit));
+  BOOST_CHECK(hit.shape == ground);
+  BOOST_CHECK_EQUAL(hit.part, (17u * 20u + 1u) * 2u + 1u);
+  unsigned int part = 0;
+  BOOST_CHECK(bvh.GetPrimitiveShape(hit.primitive, part) == ground);
+  BOOST_CHECK_EQUAL(part, hit.part);
+  // triangles before the degenerate one keep their index
+  BOOST_REQUIRE(bvh.RayCast(down(-9.8f, -9.8f), hit));
+  BOOST_CHECK_EQUAL(hit.part, 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(collisionquery_cache_test, CollisionFixture)
+{
+  ShapeBvhCache cache;
+  shared_ptr<const ShapeBvh> a = cache.Get(list);
+  shared_ptr<const ShapeBvh> b = cache.Get(list);
+  BOOST_CHECK(a == b);
+  BOOST_CHECK_EQUAL(cache.GetSize(), 1u);
+  cache.Invalidate(list);
+  BOOST_CHECK_EQUAL(cache.GetSize(), 0u);
+  BOOST_CHECK(cache.Get(list) != a);
+  // dropped hierarchies stay usable
+  CollisionHit hit;
+  BOOST_CHECK(a->RayCast(down(-8.5f, 7.5f), hit));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
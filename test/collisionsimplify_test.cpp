@@ -0,0 +1,176 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "CollisionSimplify.h"
+#include "obj/hkPackedNiTriStripsData.h"
+#include "obj/bhkPackedNiTriStripsShape.h"
+#include <stdexcept>
+#include <cmath>
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(collisionsimplify_test_suite)
+
+// adds an n x n grid over [x0, x1] x [0, 1] with height h(x, y) as one sub shape
+static void add_grid(vector<Vector3> & verts, vector<hkTriangle> & tris, vector<OblivionSubShape> & subs,
+                     float x0, float x1, int n, bool bumpy, HavokMaterial material) {
+  unsigned short base = (unsigned short)verts.size();
+  for (int j = 0; j <= n; ++j) {
+    for (int i = 0; i <= n; ++i) {
+      float x = x0 + (x1 - x0) * i / n, y = float(j) / n;
+      verts.push_back(Vector3(x, y, bumpy ? 0.2f * sin(6.0f * x) * cos(5.0f * y) : 0.0f));
+    }
+  }
+  for (int j = 0; j < n; ++j) {
+    for (int i = 0; i < n; ++i) {
+      unsigned short v = (unsigned short)(base + j * (n + 1) + i);
+      hkTriangle t;
+      t.triangle = Triangle(v, v + 1, v + n + 2);
+      tris.push_back(t);
+      t.triangle = Triangle(v, v + n + 2, v + n + 1);
+      tris.push_back(t);
+    }
+  }
+  OblivionSubShape sub;
+  sub.material = material;
+  sub.numVertices = (n + 1) * (n + 1);
+  subs.push_back(sub);
+}
+
+static hkPackedNiTriStripsData * make_data(bool bumpy, int n = 16) {
+  vector<Vector3> verts;
+  vector<hkTriangle> tris;
+  vector<OblivionSubShape> subs;
+  add_grid(verts, tris, subs, 0.0f, 0.5f, n, bumpy, HAV_MAT_STONE);
+  add_grid(verts, tris, subs, 0.5f, 1.0f, n, bumpy, HAV_MAT_WOOD);
+  hkPackedNiTriStripsData * data = new hkPackedNiTriStripsData;
+  data->SetVertices(verts);
+  data->SetHavokTriangles(tris);
+  data->SetSubShapes(subs);
+  return data;
+}
+
+// checks that every triangle stays within one sub shape and returns the total area
+static float check_data(hkPackedNiTriStripsData * data) {
+  vector<Vector3> verts = data->GetVertices();
+  vector<hkTriangle> tris = data->GetHavokTriangles();
+  vector<OblivionSubShape> subs = data->GetSubShapes();
+  BOOST_REQUIRE_EQUAL(subs.size(), 2u);
+  BOOST_CHECK_EQUAL(subs[0].material, HAV_MAT_STONE);
+  BOOST_CHECK_EQUAL(subs[1].material, HAV_MAT_WOOD);
+  BOOST_CHECK_EQUAL(subs[0].numVertices + subs[1].numVertices, verts.size());
+
+  // the vertices where the materials meet are all kept, on both sides
+  unsigned int seam[2] = {0, 0};
+  for (size_t i = 0; i < verts.size(); ++i)
+    if (verts[i].x == 0.5f)
+      ++seam[i < subs[0].numVertices ? 0 : 1];
+  BOOST_CHECK_EQUAL(seam[0], 17u);
+  BOOST_CHECK_EQUAL(seam[1], 17u);
+
+  float area = 0.0f;
+  for (size_t i = 0; i < tris.size(); ++i) {
+    const Triangle & t = tris[i].triangle;
+    bool first = t.v1 < subs[0].numVertices;
+    BOOST_CHECK_EQUAL(t.v2 < subs[0].numVertices, first);
+    BOOST_CHECK_EQUAL(t.v3 < subs[0].numVertices, first);
+    for (int k = 0; k < 3; ++k) {
+      float x = verts[t[k]].x;
+      BOOST_CHECK(first ? x <= 0.5001f : x >= 0.4999f);
+    }
+    Vector3 n = (verts[t.v2] - verts[t.v1]).CrossProduct(verts[t.v3] - verts[t.v1]);
+    BOOST_CHECK(n.DotProduct(tris[i].normal) > 0.0f);
+    BOOST_CHECK_CLOSE(tris[i].normal.Magnitude(), 1.0f, 1e-3f);
+    area += n.Magnitude() * 0.5f;
+  }
+  return area;
+}
+
+BOOST_AUTO_TEST_CASE(flat_test) {
+  Ref<hkPackedNiTriStripsData> data = make_data(false);
+  BOOST_CHECK_EQUAL(data->GetNumFace(), 1024);
+  unsigned int removed = SimplifyCollisionMesh(data);
+  BOOST_CHECK_EQUAL(removed, 1024u - (unsigned int)data->GetNumFace());
+  BOOST_CHECK(data->GetNumFace() <= 80);
+  BOOST_CHECK_CLOSE(check_data(data), 1.0f, 1e-2f);
+
+  // flat inner edges are welded at no angle and the rest are open
+  vector<hkTriangle> tris = data->GetHavokTriangles();
+  unsigned int open = 0;
+  for (size_t i = 0; i < tris.size(); ++i) {
+    for (int k = 0; k < 3; ++k) {
+      unsigned int code = (tris[i].weldingInfo >> (5 * k)) & 31;
+      BOOST_CHECK(code == 15 || code == 31);
+      open += code == 31;
+    }
+  }
+  BOOST_CHECK(open >= 8u);
+}
+
+BOOST_AUTO_TEST_CASE(limits_test) {
+  // a tiny error bound leaves a curved surface alone
+  CollisionSimplifyParams params;
+  params.maxError = 1e-7f;
+  Ref<hkPackedNiTriStripsData> data = make_data(true);
+  BOOST_CHECK_EQUAL(SimplifyCollisionMesh(data, params), 0u);
+  BOOST_CHECK_EQUAL(data->GetVertices().size(), 578u);
+
+  // a looser one removes some, and the budget alone goes further
+  params.maxError = 0.005f;
+  unsigned int loose = SimplifyCollisionMesh(data, params);
+  BOOST_CHECK(loose > 0u);
+  float area = check_data(data);
+
+  params.maxError = -1.0f;
+  params.targetTriangles = 100;
+  SimplifyCollisionMesh(data, params);
+  BOOST_CHECK(data->GetNumFace() <= 100);
+  BOOST_CHECK(data->GetNumFace() >= 90);
+  BOOST_CHECK_CLOSE(check_data(data), area, 5.0f);
+}
+
+BOOST_AUTO_TEST_CASE(shape_test) {
+  // older files keep the sub shapes in the shape
+  Ref<hkPackedNiTriStripsData> data = make_data(false, 4);
+  bhkPackedNiTriStripsShapeRef shape = new bhkPackedNiTriStripsShape;
+  vector<OblivionSubShape> subs = data->GetSubShapes();
+  shape->SetSubShapes(subs);
+  vector<OblivionSubShape> none;
+  data->SetSubShapes(none);
+  shape->SetData(data);
+  BOOST_CHECK(SimplifyCollisionMesh(shape) > 0u);
+  subs = shape->GetSubShapes();
+  BOOST_REQUIRE_EQUAL(subs.size(), 2u);
+  BOOST_CHECK_EQUAL(subs[0].numVertices + subs[1].numVertices, data->GetVertices().size());
+  BOOST_CHECK(data->GetSubShapes().empty());
+
+  bhkPackedNiTriStripsShapeRef empty = new bhkPackedNiTriStripsShape;
+  BOOST_CHECK_THROW(SimplifyCollisionMesh(empty), runtime_error);
+
+  vector<hkTriangle> tris = data->GetHavokTriangles();
+  tris[0].triangle.v2 = 1000;
+  data->SetHavokTriangles(tris);
+  BOOST_CHECK_THROW(SimplifyCollisionMesh(data), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(batch_test) {
+  vector< Ref<hkPackedNiTriStripsData> > keep;
+  vector<hkPackedNiTriStripsData*> list;
+  for (int i = 0; i < 6; ++i) {
+    keep.push_back(make_data(i % 2 == 1));
+    list.push_back(keep.back());
+  }
+  list.push_back(keep[0]);
+
+  Ref<hkPackedNiTriStripsData> single = make_data(true);
+  unsigned int each = SimplifyCollisionMesh(single);
+
+  unsigned int total = SimplifyCollisionMeshes(list, CollisionSimplifyParams(), 4);
+  BOOST_CHECK(total > 3u * each);
+  for (size_t i = 1; i < keep.size(); i += 2)
+    BOOST_CHECK_EQUAL(keep[i]->GetNumFace(), single->GetNumFace());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,201 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "CompressedMesh.h"
+#include "obj/bhkCompressedMeshShapeData.h"
+#include <cmath>
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(compressedmesh_test_suite)
+
+struct CompressedMeshFixture {
+  bhkCompressedMeshShapeDataRef data;
+
+  // one chunk with a two triangle strip and a single list triangle, rotated
+  // a quarter turn about z, and one big triangle
+  CompressedMeshFixture() {
+    data = new bhkCompressedMeshShapeData;
+    data->SetError(0.001f);
+
+    vector<bhkCMSDMaterial> materials(2);
+    materials[0].skyrimMaterial = SKY_HAV_MAT_STONE;
+    materials[1].skyrimMaterial = SKY_HAV_MAT_SNOW;
+    data->SetChunkMaterials(materials);
+
+    vector<bhkCMSDTransform> transforms(1);
+    float s = sqrt(0.5f);
+    transforms[0].rotation.x = 0.0f;
+    transforms[0].rotation.y = 0.0f;
+    transforms[0].rotation.z = s;
+    transforms[0].rotation.w = s;
+    transforms[0].translation = Vector4(0.0f, 0.0f, 5.0f, 0.0f);
+    data->SetChunkTransforms(transforms);
+
+    vector<bhkCMSDChunk> chunks(1);
+    bhkCMSDChunk & c = chunks[0];
+    c.translation = Vector4(1.0f, 0.0f, 0.0f, 0.0f);
+    c.materialIndex = 0;
+    c.transformIndex = 0;
+    unsigned short quantized[] = {
+      0, 0, 0,  1000, 0, 0,  0, 1000, 0,  1000, 1000, 0,  0, 0, 1000 };
+    c.vertices.assign(quantized, quantized + 15);
+    unsigned short idx[] = { 0, 1, 2, 3, 0, 1, 4 };
+    c.indices.assign(idx, idx + 7);
+    c.strips.push_back(4);
+    data->SetChunks(chunks);
+
+    vector<Vector4> big_verts(3);
+    big_verts[1] = Vector4(10.0f, 0.0f, 0.0f, 0.0f);
+    big_verts[2] = Vector4(0.0f, 10.0f, 0.0f, 0.0f);
+    data->SetBigVerts(big_verts);
+    vector<bhkCMSDBigTris> big_tris(1);
+    big_tris[0].triangle1 = 0;
+    big_tris[0].triangle2 = 1;
+    big_tris[0].triangle3 = 2;
+    big_tris[0].unknownInt1 = 1;
+    data->SetBigTris(big_tris);
+  }
+};
+
+static void check_vector(const Vector3 & v, float x, float y, float z) {
+  BOOST_CHECK_SMALL(v.x - x, 1e-4f);
+  BOOST_CHECK_SMALL(v.y - y, 1e-4f);
+  BOOST_CHECK_SMALL(v.z - z, 1e-4f);
+}
+
+BOOST_FIXTURE_TEST_CASE(compressedmesh_decompress_test, CompressedMeshFixture)
+{
+  vector<Vector3> verts;
+  vector<unsigned int> indices;
+  vector<SkyrimHavokMaterial> materials;
+  DecompressMeshShapeData(data, verts, indices, materials, 2);
+  BOOST_CHECK_EQUAL(verts.size(), 8u);
+  BOOST_CHECK_EQUAL(indices.size(), 12u);
+  BOOST_REQUIRE_EQUAL(materials.size(), 4u);
+  // (1,0,0) + (1,0,0) rotated to (0,2,0), then moved up
+  check_vector(verts[1], 0.0f, 2.0f, 5.0f);
+  check_vector(verts[4], 0.0f, 1.0f, 6.0f);
+  // second strip triangle has its winding flipped
+  BOOST_CHECK_EQUAL(indices[3], 1u);
+  BOOST_CHECK_EQUAL(indices[4], 3u);
+  BOOST_CHECK_EQUAL(indices[5], 2u);
+  BOOST_CHECK_EQUAL(indices[9], 5u);
+  BOOST_CHECK_EQUAL(materials[0], SKY_HAV_MAT_STONE);
+  BOOST_CHECK_EQUAL(materials[3], SKY_HAV_MAT_SNOW);
+}
+
+static void count_triangle(const CompressedMeshTriangle & tri, void * user) {
+  BOOST_CHECK(tri.chunk == 0u || tri.chunk == 0xFFFFFFFFu);
+  ++*static_cast<int *>(user);
+}
+
+BOOST_FIXTURE_TEST_CASE(compressedmesh_iterator_test, CompressedMeshFixture)
+{
+  CompressedMeshTriangleIterator it(data);
+  CompressedMeshTriangle tri;
+  BOOST_REQUIRE(it.Next(tri));
+  check_vector(tri.vertices[1], 0.0f, 2.0f, 5.0f);
+  BOOST_CHECK_EQUAL(tri.chunk, 0u);
+  BOOST_REQUIRE(it.Next(tri));
+  BOOST_REQUIRE(it.Next(tri));
+  check_vector(tri.vertices[2], 0.0f, 1.0f, 6.0f);
+  BOOST_REQUIRE(it.Next(tri));
+  BOOST_CHECK_EQUAL(tri.chunk, 0xFFFFFFFFu);
+  BOOST_CHECK_EQUAL(tri.materialIndex, 1u);
+  check_vector(tri.vertices[1], 10.0f, 0.0f, 0.0f);
+  BOOST_CHECK(!it.Next(tri));
+
+  int count = 0;
+  ForEachCompressedMeshTriangle(data, count_triangle, &count);
+  BOOST_CHECK_EQUAL(count, 4);
+}
+
+BOOST_FIXTURE_TEST_CASE(compressedmesh_bad_index_test, CompressedMeshFixture)
+{
+  vector<bhkCMSDChunk> chunks = data->GetChunks();
+  chunks[0].indices[6] = 9;
+  data->SetChunks(chunks);
+  vector<Vector3> verts;
+  vector<unsigned int> indices;
+  vector<SkyrimHavokMaterial> materials;
+  BOOST_CHECK_THROW(DecompressMeshShapeData(data, verts, indices, materials), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(compressedmesh_build_test)
+{
+  // a 40 x 40 grid spanning 200 units, too wide for a single chunk, with
+  // two materials and one triangle too big for any chunk
+  const int n = 40;
+  vector<Vector3> verts;
+  for (int y = 0; y <= n; ++y)
+    for (int x = 0; x <= n; ++x)
+      verts.push_back(Vector3(x * 5.0f + 0.0123f * y, y * 5.0f, 0.37f * ((x * 7 + y * 3) % 11)));
+  vector<unsigned int> indices;
+  vector<SkyrimHavokMaterial> materials;
+  for (int y = 0; y < n; ++y) {
+    for (int x = 0; x < n; ++x) {
+      unsigned int i = y * (n + 1) + x;
+      unsigned int quad[6] = { i, i + 1, i + n + 1, i + 1, i + n + 2, i + n + 1 };
+      indices.insert(indices.end(), quad, quad + 6);
+      SkyrimHavokMaterial m = (x < n / 2) ? SKY_HAV_MAT_STONE : SKY_HAV_MAT_SNOW;
+      materials.push_back(m);
+      materials.push_back(m);
+    }
+  }
+  unsigned int base = (unsigned int)verts.size();
+  verts.push_back(Vector3(0.0f, 0.0f, 50.0f));
+  verts.push_back(Vector3(200.0f, 0.0f, 50.0f));
+  verts.push_back(Vector3(0.0f, 200.0f, 50.0f));
+  unsigned int big[3] = { base, base + 1, base + 2 };
+  indices.insert(indices.end(), big, big + 3);
+  materials.push_back(SKY_HAV_MAT_SNOW);
+
+  const float error = 0.001f;
+  bhkCompressedMeshShapeDataRef shape = CompressMeshShapeData(verts, indices, materials, error, 2);
+  BOOST_CHECK_EQUAL(shape->GetBitsPerIndex(), 17u);
+  BOOST_CHECK_EQUAL(shape->GetBitsPerWIndex(), 18u);
+  BOOST_CHECK_EQUAL(shape->GetMaskWIndex(), 0x3FFFFu);
+  BOOST_CHECK_EQUAL(shape->GetBigTris().size(), 1u);
+  BOOST_CHECK(shape->GetChunks().size() > 2);
+  size_t strips = 0;
+  for (size_t i = 0; i < shape->GetChunks().size(); ++i)
+    strips += shape->GetChunks()[i].strips.size();
+  BOOST_CHECK(strips > 0);
+
+  // every decoded triangle matches an input triangle corner for corner,
+  // with the same winding and material
+  vector<Vector3> centers;
+  for (unsigned int t = 0; t < materials.size(); ++t)
+    centers.push_back((verts[indices[t * 3]] + verts[indices[t * 3 + 1]] + verts[indices[t * 3 + 2]]) / 3.0f);
+  CompressedMeshTriangleIterator it(shape);
+  CompressedMeshTriangle tri;
+  size_t count = 0;
+  while (it.Next(tri)) {
+    ++count;
+    Vector3 c = (tri.vertices[0] + tri.vertices[1] + tri.vertices[2]) / 3.0f;
+    unsigned int t = 0;
+    for (unsigned int i = 1; i < centers.size(); ++i)
+      if ((centers[i] - c).Magnitude() < (centers[t] - c).Magnitude())
+        t = i;
+    BOOST_REQUIRE_SMALL((centers[t] - c).Magnitude(), 0.01f);
+    BOOST_CHECK_EQUAL(tri.material, materials[t]);
+    int rot = 0;
+    for (int r = 0; r < 3; ++r) {
+      Vector3 d = tri.vertices[0] - verts[indices[t * 3 + r]];
+      if (d.Magnitude() < 0.01f)
+        rot = r;
+    }
+    for (int j = 0; j < 3; ++j) {
+      const Vector3 & v = verts[indices[t * 3 + (j + rot) % 3]];
+      BOOST_CHECK_SMALL(tri.vertices[j].x - v.x, error * 0.51f);
+      BOOST_CHECK_SMALL(tri.vertices[j].y - v.y, error * 0.51f);
+      BOOST_CHECK_SMALL(tri.vertices[j].z - v.z, error * 0.51f);
+    }
+  }
+  BOOST_CHECK_EQUAL(count, materials.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
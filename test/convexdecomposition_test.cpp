@@ -0,0 +1,176 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "ConvexDecomposition.h"
+#include "obj/bhkListShape.h"
+#include "obj/bhkConvexVerticesShape.h"
+#include "obj/NiTriShape.h"
+#include "obj/NiTriShapeData.h"
+#include <stdexcept>
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(convexdecomposition_test_suite)
+
+// adds a closed box, with each face split into a 2 x 2 grid of quads
+static void add_box(vector<Vector3> & verts, vector<Triangle> & tris, const Vector3 & lo, const Vector3 & hi) {
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int side = 0; side < 2; ++side) {
+      unsigned short base = (unsigned short)verts.size();
+      for (int v = 0; v <= 2; ++v) {
+        for (int u = 0; u <= 2; ++u) {
+          float c[3];
+          c[axis] = side ? hi[axis] : lo[axis];
+          c[(axis + 1) % 3] = lo[(axis + 1) % 3] + (hi[(axis + 1) % 3] - lo[(axis + 1) % 3]) * u / 2.0f;
+          c[(axis + 2) % 3] = lo[(axis + 2) % 3] + (hi[(axis + 2) % 3] - lo[(axis + 2) % 3]) * v / 2.0f;
+          verts.push_back(Vector3(c[0], c[1], c[2]));
+        }
+      }
+      for (int v = 0; v < 2; ++v) {
+        for (int u = 0; u < 2; ++u) {
+          unsigned short i = (unsigned short)(base + v * 3 + u);
+          if (side) {
+            tris.push_back(Triangle(i, i + 1, i + 4));
+            tris.push_back(Triangle(i, i + 4, i + 3));
+          } else {
+            tris.push_back(Triangle(i, i + 4, i + 1));
+            tris.push_back(Triangle(i, i + 3, i + 4));
+          }
+        }
+      }
+    }
+  }
+}
+
+static bool inside(const ConvexPiece & piece, const Vector3 & p, float tolerance) {
+  for (size_t i = 0; i < piece.planes.size(); ++i) {
+    const Vector4 & pl = piece.planes[i];
+    if (pl.x * p.x + pl.y * p.y + pl.z * p.z + pl.w > tolerance)
+      return false;
+  }
+  return true;
+}
+
+struct LShapeFixture {
+  vector<Vector3> verts;
+  vector<Triangle> tris;
+
+  // an L made of two boxes, with a notch around (1.5, 1.5, 0.5)
+  LShapeFixture() {
+    add_box(verts, tris, Vector3(0.0f, 0.0f, 0.0f), Vector3(2.0f, 1.0f, 1.0f));
+    add_box(verts, tris, Vector3(0.0f, 1.0f, 0.0f), Vector3(1.0f, 2.0f, 1.0f));
+  }
+};
+
+BOOST_FIXTURE_TEST_CASE(lshape_test, LShapeFixture) {
+  ConvexDecompositionParams params;
+  params.numThreads = 3;
+  vector<ConvexPiece> pieces;
+  DecomposeConvex(verts, tris, pieces, params);
+  BOOST_CHECK_EQUAL(pieces.size(), 2u);
+
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    const ConvexPiece & piece = pieces[i];
+    BOOST_CHECK_EQUAL(piece.vertices.size(), 8u);
+    BOOST_CHECK_EQUAL(piece.planes.size(), 6u);
+    for (size_t j = 1; j < piece.vertices.size(); ++j)
+      BOOST_CHECK(piece.vertices[j - 1].x <= piece.vertices[j].x);
+    for (size_t j = 0; j < piece.vertices.size(); ++j)
+      BOOST_CHECK(inside(piece, piece.vertices[j], 1e-4f));
+    for (size_t j = 0; j < piece.planes.size(); ++j) {
+      const Vector4 & pl = piece.planes[j];
+      BOOST_CHECK_CLOSE(pl.x * pl.x + pl.y * pl.y + pl.z * pl.z, 1.0f, 1e-3f);
+    }
+    BOOST_CHECK(!inside(piece, Vector3(1.5f, 1.5f, 0.5f), 0.0f));
+  }
+
+  // every vertex of the mesh is covered
+  for (size_t j = 0; j < verts.size(); ++j) {
+    bool covered = false;
+    for (size_t i = 0; i < pieces.size(); ++i)
+      covered = covered || inside(pieces[i], verts[j], 1e-4f);
+    BOOST_CHECK(covered);
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(budget_test, LShapeFixture) {
+  ConvexDecompositionParams params;
+  params.maxHulls = 1;
+  vector<ConvexPiece> pieces;
+  DecomposeConvex(verts, tris, pieces, params);
+  BOOST_REQUIRE_EQUAL(pieces.size(), 1u);
+  BOOST_CHECK(inside(pieces[0], Vector3(1.5f, 1.5f, 0.5f), 1e-4f));
+
+  // a loose concavity budget accepts the whole L
+  params.maxHulls = 16;
+  params.maxConcavity = 0.5f;
+  DecomposeConvex(verts, tris, pieces, params);
+  BOOST_CHECK_EQUAL(pieces.size(), 1u);
+
+  params.maxHullVertices = 6;
+  DecomposeConvex(verts, tris, pieces, params);
+  BOOST_CHECK(pieces[0].vertices.size() <= 6u);
+}
+
+BOOST_FIXTURE_TEST_CASE(list_shape_test, LShapeFixture) {
+  ConvexDecompositionParams params;
+  params.material = HAV_MAT_WOOD;
+  params.radius = 0.05f;
+  Ref<bhkListShape> list = CreateConvexDecomposition(verts, tris, params);
+  vector< Ref<bhkShape> > shapes = list->GetSubShapes();
+  BOOST_REQUIRE_EQUAL(shapes.size(), 2u);
+  BOOST_CHECK_EQUAL(list->GetMaterial(), HAV_MAT_WOOD);
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    Ref<bhkConvexVerticesShape> shape = DynamicCast<bhkConvexVerticesShape>(shapes[i]);
+    BOOST_REQUIRE(shape != NULL);
+    BOOST_CHECK_EQUAL(shape->GetVertices().size(), 8u);
+    BOOST_CHECK_EQUAL(shape->GetNormalsAndDist().size(), 6u);
+    BOOST_CHECK_EQUAL(shape->GetMaterial(), HAV_MAT_WOOD);
+    BOOST_CHECK_CLOSE(shape->GetRadius(), 0.05f, 1e-4f);
+  }
+
+  // the same from a shape, scaled to Havok units
+  NiTriShapeRef geom = new NiTriShape;
+  NiTriShapeDataRef data = new NiTriShapeData;
+  data->SetVertices(verts);
+  data->SetTriangles(tris);
+  geom->SetData(data);
+  list = CreateConvexDecomposition(geom, params, 0.5f);
+  shapes = list->GetSubShapes();
+  BOOST_REQUIRE_EQUAL(shapes.size(), 2u);
+  vector<Vector3> piece = DynamicCast<bhkConvexVerticesShape>(shapes[0])->GetVertices();
+  for (size_t j = 0; j < piece.size(); ++j)
+    BOOST_CHECK(piece[j].x <= 1.0f && piece[j].y <= 1.0f && piece[j].z <= 0.5f);
+
+  BOOST_CHECK_THROW(CreateConvexDecomposition(new NiTriShape, params), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(flat_test) {
+  vector<Vector3> verts;
+  vector<Triangle> tris;
+  verts.push_back(Vector3(0.0f, 0.0f, 0.0f));
+  verts.push_back(Vector3(4.0f, 0.0f, 0.0f));
+  verts.push_back(Vector3(4.0f, 4.0f, 0.0f));
+  verts.push_back(Vector3(0.0f, 4.0f, 0.0f));
+  tris.push_back(Triangle(0, 1, 2));
+  tris.push_back(Triangle(0, 2, 3));
+  vector<ConvexPiece> pieces;
+  DecomposeConvex(verts, tris, pieces);
+  BOOST_REQUIRE_EQUAL(pieces.size(), 1u);
+  BOOST_CHECK_EQUAL(pieces[0].vertices.size(), 8u);
+  BOOST_CHECK(inside(pieces[0], Vector3(2.0f, 2.0f, 0.0f), 0.0f));
+  BOOST_CHECK(!inside(pieces[0], Vector3(2.0f, 2.0f, 0.1f), 0.0f));
+
+  // a sliver and a bad index
+  tris.assign(1, Triangle(0, 1, 1));
+  BOOST_CHECK_THROW(DecomposeConvex(verts, tris, pieces), runtime_error);
+  tris.assign(1, Triangle(0, 1, 9));
+  BOOST_CHECK_THROW(DecomposeConvex(verts, tris, pieces), runtime_error);
+
+  verts.resize(3);
+  BOOST_CHECK_THROW(CreateConvexVerticesShape(verts), runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,98 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "niflib.h"
+#include "kfm.h"
+#include "obj/NiNode.h"
+#include "obj/NiControllerSequence.h"
+#include "obj/NiTransformController.h"
+#include "obj/NiTransformInterpolator.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(kfm_test_suite)
+
+static KfmAction make_action(const string & name, const string & file_name, unsigned int code)
+{
+  KfmAction action;
+  action.action_name = name;
+  action.action_filename = file_name;
+  action.unk_int1 = code;
+  action.unk_int2 = 0;
+  return action;
+}
+
+// writes a skeleton with a single bone and one action for it, and
+// returns a kfm which refers to them plus an action without a file
+static Kfm make_kfm()
+{
+  NifInfo info(VER_20_2_0_7, 11);
+
+  NiNodeRef root = new NiNode;
+  root->SetName("Scene Root");
+  NiNodeRef bone = new NiNode;
+  bone->SetName("Bone");
+  root->AddChild(StaticCast<NiAVObject>(bone));
+  WriteNifTree("kfm_test_skeleton.nif", root, info);
+
+  NiControllerSequenceRef seq = new NiControllerSequence;
+  seq->SetName("Walk");
+  NiTransformInterpolatorRef interp = new NiTransformInterpolator;
+  seq->AddGenericInterpolator(interp, bone, "NiTransformController", 0, false);
+  WriteNifTree("kfm_test_walk.kf", seq, info);
+
+  Kfm kfm;
+  kfm.version = VER_KFM_2_0_0_0b;
+  kfm.nif_filename = "kfm_test_skeleton.nif";
+  kfm.actions.push_back(make_action("Walk", "kfm_test_walk.kf", 7));
+  kfm.actions.push_back(make_action("Run", "kfm_test_run.kf", 9));
+  return kfm;
+}
+
+BOOST_AUTO_TEST_CASE(kfm_library_test)
+{
+  Kfm kfm = make_kfm();
+  KfmActionLibrary library(kfm, ".");
+  BOOST_CHECK_EQUAL(library.GetActionCount(), 2u);
+  BOOST_CHECK_EQUAL(library.FindAction("Walk"), 0);
+  BOOST_CHECK_EQUAL(library.FindAction("Jump"), -1);
+  BOOST_CHECK_EQUAL(library.FindActionByEventCode(9), 1);
+
+  // nothing is read until a sequence is requested
+  BOOST_CHECK(!library.IsCached(0));
+  BOOST_CHECK_EQUAL(library.GetMemoryUsage(), 0u);
+
+  library.Prefetch(0);
+  NiControllerSequenceRef seq = library.GetSequence("Walk");
+  BOOST_REQUIRE(seq != NULL);
+  BOOST_CHECK_EQUAL(seq->GetName(), "Walk");
+  BOOST_CHECK(library.IsCached(0));
+  BOOST_CHECK(library.GetMemoryUsage() > 0);
+
+  // missing files give no sequences
+  BOOST_CHECK(library.GetSequences(1).empty());
+  BOOST_CHECK(library.GetSequence("Run") == NULL);
+
+  // a tiny budget keeps only the most recently used action
+  library.SetMemoryBudget(1);
+  BOOST_CHECK(!library.IsCached(0));
+  BOOST_CHECK(library.IsCached(1));
+  library.ClearCache();
+  BOOST_CHECK_EQUAL(library.GetMemoryUsage(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(kfm_merge_test)
+{
+  Kfm kfm = make_kfm();
+  NiNodeRef root = DynamicCast<NiNode>(kfm.MergeActions("."));
+  BOOST_REQUIRE(root != NULL);
+  vector<NiAVObjectRef> children = root->GetChildren();
+  BOOST_REQUIRE_EQUAL(children.size(), 1u);
+  list<NiTimeControllerRef> ctlrs = children[0]->GetControllers();
+  BOOST_REQUIRE_EQUAL(ctlrs.size(), 1u);
+  BOOST_CHECK(ctlrs.front()->IsDerivedType(NiTransformController::TYPE));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,246 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "niflib.h"
+#include "Inertia.h"
+#include "obj/NiNode.h"
+#include "obj/bhkCollisionObject.h"
+#include "obj/bhkRigidBody.h"
+#include "obj/bhkListShape.h"
+#include "obj/bhkTransformShape.h"
+#include "obj/bhkConvexVerticesShape.h"
+#include "obj/bhkNiTriStripsShape.h"
+#include "obj/NiTriStripsData.h"
+#include <stdexcept>
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(massproperties_test_suite)
+
+// an outward facing box from lo to hi
+static void make_box(const Vector3 & lo, const Vector3 & hi, vector<Vector3> & verts, vector<Triangle> & tris) {
+  verts.clear();
+  for (int i = 0; i < 8; ++i)
+    verts.push_back(Vector3((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z));
+  static const unsigned short faces[12][3] = {
+    {0, 2, 1}, {1, 2, 3}, {4, 5, 6}, {5, 7, 6},
+    {0, 1, 4}, {1, 5, 4}, {2, 6, 3}, {3, 6, 7},
+    {0, 4, 2}, {2, 4, 6}, {1, 3, 5}, {3, 7, 5}
+  };
+  tris.clear();
+  for (int i = 0; i < 12; ++i)
+    tris.push_back(Triangle(faces[i][0], faces[i][1], faces[i][2]));
+}
+
+static void check_cube(float mass, float volume, const Vector3 & center, const InertiaMatrix & inertia,
+                       float expect_mass, float expect_volume, const Vector3 & expect_center, float expect_inertia) {
+  BOOST_CHECK_CLOSE(mass, expect_mass, 1e-3f);
+  BOOST_CHECK_CLOSE(volume, expect_volume, 1e-3f);
+  BOOST_CHECK_SMALL((center - expect_center).Magnitude(), 1e-4f);
+  for (int r = 0; r < 3; ++r) {
+    for (int c = 0; c < 3; ++c) {
+      if (r == c)
+        BOOST_CHECK_CLOSE(inertia[r][c], expect_inertia, 1e-2f);
+      else
+        BOOST_CHECK_SMALL(inertia[r][c], 1e-4f);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(solid_box_test) {
+  vector<Vector3> verts;
+  vector<Triangle> tris;
+  float mass, volume;
+  Vector3 center;
+  InertiaMatrix inertia;
+
+  // a unit cube weighs its density and has inertia m / 6
+  make_box(Vector3(0, 0, 0), Vector3(1, 1, 1), verts, tris);
+  Inertia::CalcMassPropertiesPolyhedron(&verts[0], 8, &tris[0], 12, 3.0f, true, mass, volume, center, inertia);
+  check_cube(mass, volume, center, inertia, 3.0f, 1.0f, Vector3(0.5f, 0.5f, 0.5f), 0.5f);
+
+  // far from the origin
+  make_box(Vector3(1000, 2000, 3000), Vector3(1001, 2001, 3001), verts, tris);
+  Inertia::CalcMassPropertiesPolyhedron(verts, tris, 3.0f, true, mass, volume, center, inertia);
+  check_cube(mass, volume, center, inertia, 3.0f, 1.0f, Vector3(1000.5f, 2000.5f, 3000.5f), 0.5f);
+
+  // wound inside out
+  for (size_t i = 0; i < tris.size(); ++i)
+    swap(tris[i].v2, tris[i].v3);
+  Inertia::CalcMassPropertiesPolyhedron(verts, tris, 3.0f, true, mass, volume, center, inertia);
+  check_cube(mass, volume, center, inertia, 3.0f, 1.0f, Vector3(1000.5f, 2000.5f, 3000.5f), 0.5f);
+
+  // the hull of the corners is used when there are no triangles
+  tris.clear();
+  Inertia::CalcMassPropertiesPolyhedron(verts, tris, 3.0f, true, mass, volume, center, inertia);
+  check_cube(mass, volume, center, inertia, 3.0f, 1.0f, Vector3(1000.5f, 2000.5f, 3000.5f), 0.5f);
+
+  // a 2 x 1 x 1 box
+  make_box(Vector3(-1, 0, 0), Vector3(1, 1, 1), verts, tris);
+  Inertia::CalcMassPropertiesPolyhedron(verts, tris, 1.0f, true, mass, volume, center, inertia);
+  BOOST_CHECK_CLOSE(mass, 2.0f, 1e-3f);
+  BOOST_CHECK_CLOSE(inertia[0][0], 2.0f * (1.0f + 1.0f) / 12.0f, 1e-2f);
+  BOOST_CHECK_CLOSE(inertia[1][1], 2.0f * (4.0f + 1.0f) / 12.0f, 1e-2f);
+  BOOST_CHECK_CLOSE(inertia[2][2], 2.0f * (4.0f + 1.0f) / 12.0f, 1e-2f);
+
+  tris[5].v2 = 8;
+  BOOST_CHECK_THROW(Inertia::CalcMassPropertiesPolyhedron(verts, tris, 1.0f, true, mass, volume, center, inertia), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(hollow_box_test) {
+  vector<Vector3> verts;
+  vector<Triangle> tris;
+  float mass, volume;
+  Vector3 center;
+  InertiaMatrix inertia;
+
+  // a hollow cube of side a has inertia 5 / 18 m a^2
+  make_box(Vector3(0, 0, 0), Vector3(2, 2, 2), verts, tris);
+  Inertia::CalcMassPropertiesPolyhedron(verts, tris, 1.0f, false, mass, volume, center, inertia);
+  check_cube(mass, volume, center, inertia, 24.0f, 8.0f, Vector3(1, 1, 1), 5.0f / 18.0f * 24.0f * 4.0f);
+}
+
+BOOST_AUTO_TEST_CASE(many_triangles_test) {
+  // a unit cube with each face split into a fine grid
+  const int n = 40;
+  vector<Vector3> verts;
+  vector<Triangle> tris;
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int side = 0; side < 2; ++side) {
+      unsigned short base = (unsigned short)verts.size();
+      for (int v = 0; v <= n; ++v) {
+        for (int u = 0; u <= n; ++u) {
+          float c[3];
+          c[axis] = float(side);
+          c[(axis + 1) % 3] = float(u) / n;
+          c[(axis + 2) % 3] = float(v) / n;
+          verts.push_back(Vector3(c[0] + 50.0f, c[1], c[2]));
+        }
+      }
+      for (int v = 0; v < n; ++v) {
+        for (int u = 0; u < n; ++u) {
+          unsigned short i = (unsigned short)(base + v * (n + 1) + u);
+          if (side) {
+            tris.push_back(Triangle(i, i + 1, i + n + 2));
+            tris.push_back(Triangle(i, i + n + 2, i + n + 1));
+          } else {
+            tris.push_back(Triangle(i, i + n + 2, i + 1));
+            tris.push_back(Triangle(i, i + n + 1, i + n + 2));
+          }
+        }
+      }
+    }
+  }
+  float mass, volume;
+  Vector3 center;
+  InertiaMatrix inertia;
+  Inertia::CalcMassPropertiesPolyhedron(verts, tris, 1.0f, true, mass, volume, center, inertia);
+  check_cube(mass, volume, center, inertia, 1.0f, 1.0f, Vector3(50.5f, 0.5f, 0.5f), 1.0f / 6.0f);
+}
+
+// a rigid body made of two unit cubes centered at x = -1 and x = 1
+static bhkRigidBodyRef make_body() {
+  vector<Vector3> verts;
+  vector<Triangle> tris;
+  make_box(Vector3(-0.5f, -0.5f, -0.5f), Vector3(0.5f, 0.5f, 0.5f), verts, tris);
+  bhkConvexVerticesShapeRef cube = new bhkConvexVerticesShape;
+  cube->SetVertices(verts);
+
+  vector<bhkShapeRef> subs;
+  for (int i = 0; i < 2; ++i) {
+    Matrix44 xf;
+    xf[3][0] = i ? 1.0f : -1.0f;
+    bhkTransformShapeRef moved = new bhkTransformShape;
+    moved->SetShape(cube);
+    moved->SetTransform(xf);
+    subs.push_back(StaticCast<bhkShape>(moved));
+  }
+  bhkListShapeRef list = new bhkListShape;
+  list->SetSubShapes(subs);
+
+  bhkRigidBodyRef body = new bhkRigidBody;
+  body->SetShape(list);
+  return body;
+}
+
+BOOST_AUTO_TEST_CASE(rigid_body_test) {
+  bhkRigidBodyRef single = make_body();
+  single->UpdateMassProperties(2.0f);
+  BOOST_CHECK_CLOSE(single->GetMass(), 4.0f, 1e-3f);
+  BOOST_CHECK_SMALL(single->GetCenter().x, 1e-4f);
+  InertiaMatrix inertia = single->GetInertia();
+  BOOST_CHECK_CLOSE(inertia[0][0], 4.0f / 6.0f, 1e-2f);
+  BOOST_CHECK_CLOSE(inertia[1][1], 4.0f / 6.0f + 4.0f, 1e-2f);
+  BOOST_CHECK_CLOSE(inertia[2][2], 4.0f / 6.0f + 4.0f, 1e-2f);
+
+  // the same through the batch update, with bodies under a scene
+  NiNodeRef root = new NiNode;
+  vector<bhkRigidBodyRef> bodies;
+  for (int i = 0; i < 5; ++i) {
+    NiNodeRef child = new NiNode;
+    bhkCollisionObjectRef collision = new bhkCollisionObject;
+    bodies.push_back(make_body());
+    collision->SetBody(bodies.back());
+    child->SetCollisionObject(collision);
+    root->AddChild(StaticCast<NiAVObject>(child));
+  }
+  BOOST_CHECK_EQUAL(UpdateMassProperties(root, 2.0f, true, false, 3), 5u);
+  for (size_t i = 0; i < bodies.size(); ++i) {
+    BOOST_CHECK_CLOSE(bodies[i]->GetMass(), single->GetMass(), 1e-3f);
+    InertiaMatrix batch = bodies[i]->GetInertia();
+    for (int r = 0; r < 3; ++r)
+      for (int c = 0; c < 3; ++c)
+        BOOST_CHECK_SMALL(batch[r][c] - inertia[r][c], 1e-4f);
+  }
+
+  // keeping the mass scales the inertia to it
+  bodies[0]->SetMass(10.0f);
+  UpdateMassProperties(bodies[0], 1.0f, true, true);
+  BOOST_CHECK_CLOSE(bodies[0]->GetMass(), 10.0f, 1e-3f);
+  BOOST_CHECK_CLOSE(bodies[0]->GetInertia()[0][0], inertia[0][0] * 2.5f, 1e-2f);
+
+  BOOST_CHECK_THROW(UpdateMassProperties(NULL), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(shared_strips_test) {
+  // one strips shape used by many bodies, measured on several threads
+  vector<Vector3> verts;
+  vector<Triangle> tris;
+  make_box(Vector3(-0.5f, -0.5f, -0.5f), Vector3(0.5f, 0.5f, 0.5f), verts, tris);
+  NiTriStripsDataRef data = new NiTriStripsData;
+  data->SetVertices(verts);
+  data->SetStripCount(int(tris.size()));
+  bhkNiTriStripsShapeRef shape = new bhkNiTriStripsShape;
+  shape->SetNumStripsData(1);
+  shape->SetStripsData(0, data);
+
+  NiNodeRef root = new NiNode;
+  vector<bhkRigidBodyRef> bodies;
+  for (int i = 0; i < 32; ++i) {
+    NiNodeRef child = new NiNode;
+    bhkCollisionObjectRef collision = new bhkCollisionObject;
+    bodies.push_back(new bhkRigidBody);
+    bodies.back()->SetShape(shape);
+    collision->SetBody(bodies.back());
+    child->SetCollisionObject(collision);
+    root->AddChild(StaticCast<NiAVObject>(child));
+  }
+  for (int round = 0; round < 20; ++round) {
+    // setting the strips again leaves the triangle list to be rebuilt
+    for (size_t t = 0; t < tris.size(); ++t) {
+      vector<unsigned short> strip(3);
+      for (int v = 0; v < 3; ++v)
+        strip[v] = tris[t][v];
+      data->SetStrip(int(t), strip);
+    }
+    BOOST_REQUIRE_EQUAL(UpdateMassProperties(root, 2.0f, true, false, 8), 32u);
+    for (size_t i = 0; i < bodies.size(); ++i) {
+      BOOST_CHECK_CLOSE(bodies[i]->GetMass(), 2.0f, 1e-3f);
+      BOOST_CHECK_SMALL(bodies[i]->GetCenter().Magnitude(), 1e-4f);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,186 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "niflib.h"
+#include "MatTexCollection.h"
+#include "obj/NiNode.h"
+#include "obj/NiTriShape.h"
+#include "obj/NiMaterialProperty.h"
+#include "obj/NiTexturingProperty.h"
+#include "obj/NiAlphaProperty.h"
+#include "obj/NiTextureProperty.h"
+#include "obj/NiMultiTextureProperty.h"
+#include "obj/NiSpecularProperty.h"
+#include "obj/NiStencilProperty.h"
+#include "obj/NiPixelData.h"
+#include "obj/NiSourceTexture.h"
+#include "obj/NiImage.h"
+#include "obj/NiMaterialColorController.h"
+#include "obj/BSLightingShaderProperty.h"
+#include "obj/BSShaderTextureSet.h"
+#include <sstream>
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(mattexcollection_test_suite)
+
+BOOST_AUTO_TEST_CASE(gather_test)
+{
+  // many shapes sharing a few materials, some with alpha
+  vector<NiMaterialPropertyRef> mats;
+  vector<NiTexturingPropertyRef> texings;
+  vector<NiSourceTextureRef> sources;
+  for (int i = 0; i < 10; ++i) {
+    mats.push_back(new NiMaterialProperty);
+    sources.push_back(new NiSourceTexture);
+    TexDesc desc;
+    desc.source = sources[i % 4];
+    texings.push_back(new NiTexturingProperty);
+    texings[i]->SetTexture(BASE_MAP, desc);
+  }
+  NiAlphaPropertyRef alpha = new NiAlphaProperty;
+  NiNodeRef root = new NiNode;
+  for (int i = 0; i < 1000; ++i) {
+    NiTriShapeRef shape = new NiTriShape;
+    shape->AddProperty(mats[i % 10]);
+    shape->AddProperty(texings[i % 10]);
+    if (i % 20 == 0)
+      shape->AddProperty(alpha);
+    root->AddChild(StaticCast<NiAVObject>(shape));
+  }
+
+  MatTexCollection collection(root);
+  BOOST_CHECK_EQUAL(collection.GetNumMaterials(), 11u);
+  BOOST_CHECK_EQUAL(collection.GetNumTextures(), 4u);
+  for (int i = 0; i < 4; ++i) {
+    unsigned int index = collection.GetTextureIndex(sources[i]);
+    BOOST_REQUIRE(index != NO_TEXTURE);
+    BOOST_CHECK_EQUAL(collection.GetTexture(index).GetPixelData(), (NiPixelData *)NULL);
+  }
+  BOOST_CHECK_EQUAL(collection.GetTextureIndex(sources[5]), NO_TEXTURE);
+  BOOST_CHECK_EQUAL(collection.GetTextureIndex((NiSourceTexture *)NULL), NO_TEXTURE);
+
+  unsigned int plain = collection.GetMaterialIndex(mats[3], texings[3], NULL, NULL, NULL, NULL, NULL);
+  unsigned int blended = collection.GetMaterialIndex(mats[0], texings[0], NULL, NULL, NULL, alpha, NULL);
+  BOOST_CHECK(plain != NO_MATERIAL);
+  BOOST_CHECK(blended != NO_MATERIAL);
+  BOOST_CHECK_EQUAL(collection.GetMaterialIndex(root->GetChildren()[0]), collection.GetMaterialIndex(root->GetChildren()[10]));
+  BOOST_CHECK_EQUAL(collection.GetMaterialIndex(mats[3], texings[4], NULL, NULL, NULL, NULL, NULL), NO_MATERIAL);
+  BOOST_CHECK(collection.GetMaterial(blended).GetTranslucencyInfo() == alpha);
+
+  // gathering the same scene again finds nothing new
+  collection.GatherMaterials(root);
+  BOOST_CHECK_EQUAL(collection.GetNumMaterials(), 11u);
+}
+
+BOOST_AUTO_TEST_CASE(create_test)
+{
+  MatTexCollection collection;
+  unsigned int tex = collection.CreateTexture(VER_20_0_0_5);
+  unsigned int image = collection.CreateTexture(VER_3_1);
+  BOOST_CHECK_EQUAL(tex, 0u);
+  BOOST_CHECK_EQUAL(image, 1u);
+  unsigned int mat = collection.CreateMaterial(true, true, false, false, true, VER_20_0_0_5);
+  BOOST_CHECK_EQUAL(mat, 0u);
+
+  MaterialWrapper wrapper = collection.GetMaterial(mat);
+  wrapper.SetTextureIndex(BASE_MAP, tex);
+  BOOST_CHECK_EQUAL(wrapper.GetTextureIndex(BASE_MAP), tex);
+  vector<NiPropertyRef> props = wrapper.GetProperties();
+  BOOST_CHECK_EQUAL(collection.GetMaterialIndex(props), mat);
+
+  collection.Clear();
+  BOOST_CHECK_EQUAL(collection.GetMaterialIndex(props), NO_MATERIAL);
+  BOOST_CHECK_EQUAL(collection.CreateTexture(VER_20_0_0_5), 0u);
+}
+
+static size_t file_size(NiObject * root, const NifInfo & info) {
+  stringstream ss;
+  WriteNifTree(ss, root, info);
+  return ss.str().size();
+}
+
+BOOST_AUTO_TEST_CASE(share_test)
+{
+  // every shape gets its own copy of the same properties
+  NiNodeRef root = new NiNode;
+  NiMaterialPropertyRef animated;
+  for (int i = 0; i < 7; ++i) {
+    NiMaterialPropertyRef mat = new NiMaterialProperty;
+    mat->SetName(i == 4 ? "Other" : "Stone");
+    mat->SetGlossiness(i == 5 ? 20.0f : 10.0f);
+    mat->SetAmbientColor(Color3(0.5f, 0.5f, 0.5f));
+    mat->SetDiffuseColor(Color3(0.8f, 0.7f, 0.6f));
+    mat->SetSpecularColor(Color3(1.0f, 1.0f, 1.0f));
+    mat->SetEmissiveColor(Color3(0.0f, 0.0f, 0.0f));
+    if (i == 6) {
+      mat->AddController(new NiMaterialColorController);
+      animated = mat;
+    }
+    NiTriShapeRef shape = new NiTriShape;
+    shape->AddProperty(new NiAlphaProperty);
+    shape->AddProperty(mat);
+    root->AddChild(StaticCast<NiAVObject>(shape));
+  }
+  NifInfo info(VER_20_0_0_5, 11);
+  size_t before = file_size(root, info);
+
+  MatTexCollection collection(root);
+  BOOST_CHECK_EQUAL(collection.GetNumMaterials(), 7u);
+  PropertyShareResult result = collection.ShareProperties(root, info);
+  BOOST_CHECK_EQUAL(result.propertiesRemoved, 9u);
+  BOOST_CHECK_EQUAL(result.textureSetsRemoved, 0u);
+  BOOST_CHECK_GT(result.bytesSaved, 0u);
+  BOOST_CHECK_GE(before - file_size(root, info), result.bytesSaved);
+  BOOST_CHECK_EQUAL(collection.GetNumMaterials(), 4u);
+
+  // property order is kept, and the animated material is left alone;
+  // shapes are put at the front of the children, so the last one is first
+  vector<NiAVObjectRef> children = root->GetChildren();
+  vector<NiPropertyRef> props = children[0]->GetProperties();
+  BOOST_REQUIRE_EQUAL(props.size(), 2u);
+  BOOST_CHECK(props[0]->IsSameType(NiAlphaProperty::TYPE));
+  BOOST_CHECK(props[0] == children[6]->GetProperties()[0]);
+  BOOST_CHECK(children[0]->GetProperties()[1] == animated);
+
+  // names can be ignored
+  result = collection.ShareProperties(root, info, true);
+  BOOST_CHECK_EQUAL(result.propertiesRemoved, 1u);
+  BOOST_CHECK_EQUAL(collection.GetNumMaterials(), 3u);
+  BOOST_CHECK_THROW(collection.ShareProperties(root, NifInfo(VER_3_1)), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(share_shader_test)
+{
+  // Skyrim shapes keep their shaders in the BSProperty slots
+  NiNodeRef root = new NiNode;
+  for (int i = 0; i < 4; ++i) {
+    BSShaderTextureSetRef textures = new BSShaderTextureSet;
+    vector<string> paths(9);
+    paths[0] = (i == 3) ? "textures\\moss.dds" : "textures\\rock.dds";
+    textures->SetTextures(paths);
+    BSLightingShaderPropertyRef shader = new BSLightingShaderProperty;
+    shader->SetTextureSet(textures);
+    shader->SetEmissiveColor(Color3(0.0f, 0.0f, 0.0f));
+    shader->SetSpecularColor(Color3(1.0f, 1.0f, 1.0f));
+    NiTriShapeRef shape = new NiTriShape;
+    shape->SetBSProperty(0, StaticCast<NiProperty>(shader));
+    root->AddChild(StaticCast<NiAVObject>(shape));
+  }
+  NifInfo info(VER_20_2_0_7, 12, 83);
+  size_t before = file_size(root, info);
+
+  MatTexCollection collection;
+  PropertyShareResult result = collection.ShareProperties(root, info);
+  BOOST_CHECK_EQUAL(result.textureSetsRemoved, 2u);
+  BOOST_CHECK_EQUAL(result.propertiesRemoved, 2u);
+  BOOST_CHECK_GE(before - file_size(root, info), result.bytesSaved);
+  vector<NiAVObjectRef> children = root->GetChildren();
+  NiPropertyRef rock = DynamicCast<NiGeometry>(children[3])->GetBSProperty(0);
+  BOOST_CHECK(DynamicCast<NiGeometry>(children[1])->GetBSProperty(0) == rock);
+  BOOST_CHECK(DynamicCast<NiGeometry>(children[0])->GetBSProperty(0) != rock);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
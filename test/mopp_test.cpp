@@ -0,0 +1,172 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "MoppCode.h"
+#include "obj/bhkMoppBvTreeShape.h"
+#include "obj/bhkPackedNiTriStripsShape.h"
+#include "obj/hkPackedNiTriStripsData.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(mopp_test_suite)
+
+struct MoppFixture {
+  vector<Vector3> verts;
+  vector<Triangle> tris;
+
+  // a bumpy 30 x 30 grid of unit squares
+  MoppFixture() {
+    const int n = 30;
+    for (int y = 0; y <= n; ++y)
+      for (int x = 0; x <= n; ++x)
+        verts.push_back(Vector3(float(x), float(y), 0.25f * ((x * 5 + y * 3) % 4)));
+    for (int y = 0; y < n; ++y) {
+      for (int x = 0; x < n; ++x) {
+        unsigned short i = (unsigned short)(y * (n + 1) + x);
+        tris.push_back(Triangle(i, i + 1, i + n + 1));
+        tris.push_back(Triangle(i + 1, i + n + 2, i + n + 1));
+      }
+    }
+  }
+
+  bool overlaps(const Triangle & t, const Vector3 & lo, const Vector3 & hi) {
+    const Vector3 & a = verts[t.v1];
+    const Vector3 & b = verts[t.v2];
+    const Vector3 & c = verts[t.v3];
+    return max(a.x, max(b.x, c.x)) >= lo.x && min(a.x, min(b.x, c.x)) <= hi.x
+        && max(a.y, max(b.y, c.y)) >= lo.y && min(a.y, min(b.y, c.y)) <= hi.y
+        && max(a.z, max(b.z, c.z)) >= lo.z && min(a.z, min(b.z, c.z)) <= hi.z;
+  }
+};
+
+BOOST_FIXTURE_TEST_CASE(mopp_aabb_test, MoppFixture)
+{
+  MoppCode mopp = CompileMopp(verts, tris);
+  BOOST_REQUIRE(!mopp.code.empty());
+  BOOST_CHECK_EQUAL(mopp.code[0], 0x26);
+  BOOST_CHECK_CLOSE(mopp.origin.x, -0.1f, 0.01);
+  BOOST_CHECK_CLOSE(mopp.scale, 256.0f * 256.0f * 254.0f / 30.2f, 0.01);
+
+  Vector3 lo(10.2f, 4.5f, -1.0f), hi(12.7f, 6.1f, 1.0f);
+  vector<unsigned int> found;
+  QueryMoppAabb(mopp, lo, hi, found);
+  size_t expected = 0;
+  for (unsigned int t = 0; t < tris.size(); ++t) {
+    if (overlaps(tris[t], lo, hi)) {
+      ++expected;
+      BOOST_CHECK(binary_search(found.begin(), found.end(), t));
+    }
+  }
+  BOOST_CHECK(expected > 0);
+  // the tree has to actually cull most of the mesh
+  BOOST_CHECK(found.size() < tris.size() / 4);
+
+  QueryMoppAabb(mopp, Vector3(50, 50, 50), Vector3(60, 60, 60), found);
+  BOOST_CHECK(found.empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(mopp_ray_test, MoppFixture)
+{
+  MoppCode mopp = CompileMopp(verts, tris);
+  float fraction = 0.0f;
+  // straight down onto the flat corner of the square at (7, 11)
+  int hit = RayCastMopp(mopp, verts, tris, Vector3(7.2f, 11.3f, 5.0f), Vector3(7.2f, 11.3f, -5.0f), fraction);
+  BOOST_CHECK_EQUAL(hit, (11 * 30 + 7) * 2);
+  BOOST_CHECK(fraction > 0.4f && fraction < 0.5f);
+
+  vector<unsigned int> found;
+  QueryMoppRay(mopp, Vector3(7.2f, 11.3f, 5.0f), Vector3(7.2f, 11.3f, -5.0f), found);
+  BOOST_CHECK(found.size() < 20);
+
+  hit = RayCastMopp(mopp, verts, tris, Vector3(-5, -5, 5), Vector3(-5, -5, -5), fraction);
+  BOOST_CHECK_EQUAL(hit, -1);
+}
+
+BOOST_FIXTURE_TEST_CASE(mopp_shape_test, MoppFixture)
+{
+  hkPackedNiTriStripsDataRef data = new hkPackedNiTriStripsData;
+  data->SetVertices(verts);
+  data->SetNumFaces(int(tris.size()));
+  data->SetTriangles(tris);
+  bhkPackedNiTriStripsShapeRef packed = new bhkPackedNiTriStripsShape;
+  packed->SetData(data);
+  bhkMoppBvTreeShapeRef shape = new bhkMoppBvTreeShape;
+  shape->SetShape(packed);
+  UpdateMoppCode(shape);
+
+  MoppCode mopp = GetMoppCode(shape);
+  BOOST_CHECK(mopp.code == CompileMopp(verts, tris).code);
+  vector<unsigned int> found;
+  QueryMoppAabb(mopp, Vector3(0, 0, 0), Vector3(0.5f, 0.5f, 0.5f), found);
+  BOOST_CHECK(binary_search(found.begin(), found.end(), 0u));
+}
+
+BOOST_FIXTURE_TEST_CASE(mopp_degenerate_test, MoppFixture)
+{
+  // leaves must keep their index into the stored triangles, degenerate ones included
+  vector<Triangle> stored(tris);
+  stored.insert(stored.begin() + 100, Triangle(5, 5, 6));
+  hkPackedNiTriStripsDataRef data = new hkPackedNiTriStripsData;
+  data->SetVertices(verts);
+  data->SetNumFaces(int(stored.size()));
+  data->SetTriangles(stored);
+
+  MoppCode mopp = CompileMopp(data);
+  Vector3 lo(29.6f, 29.6f, -1.0f), hi(30.5f, 30.5f, 1.0f);
+  vector<unsigned int> found;
+  QueryMoppAabb(mopp, lo, hi, found);
+  BOOST_CHECK(binary_search(found.begin(), found.end(), (unsigned int)(stored.size() - 1)));
+  BOOST_CHECK(!binary_search(found.begin(), found.end(), 100u));
+  for (size_t i = 0; i < found.size(); ++i)
+    BOOST_CHECK(found[i] < stored.size());
+
+  QueryMoppAabb(mopp, Vector3(-1, -1, -1), Vector3(40, 40, 40), found);
+  BOOST_CHECK_EQUAL(found.size(), tris.size());
+  BOOST_CHECK(!binary_search(found.begin(), found.end(), 100u));
+}
+
+BOOST_AUTO_TEST_CASE(mopp_opcode_test)
+{
+  MoppCode mopp;
+  mopp.scale = 256.0f * 256.0f;
+  // byte jump over a triangle, then a triangle offset and a byte leaf
+  byte code[] = { 0x05, 0x01, 0x31, 0x09, 0x10, 0x50, 0x02 };
+  mopp.code.assign(code, code + sizeof(code));
+  vector<unsigned int> found;
+  QueryMoppAabb(mopp, Vector3(0, 0, 0), Vector3(1, 1, 1), found);
+  BOOST_REQUIRE_EQUAL(found.size(), 1u);
+  BOOST_CHECK_EQUAL(found[0], 18u);
+
+  mopp.code.push_back(0x07);
+  mopp.code[1] = 0x05;
+  BOOST_CHECK_THROW(QueryMoppAabb(mopp, Vector3(0, 0, 0), Vector3(1, 1, 1), found), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(mopp_long_leaf_test)
+{
+  MoppCode mopp;
+  mopp.scale = 256.0f * 256.0f;
+  // a 24 bit leaf, then the same behind a byte offset
+  byte code[] = { 0x52, 0x01, 0x02, 0x03 };
+  mopp.code.assign(code, code + sizeof(code));
+  vector<unsigned int> found;
+  QueryMoppAabb(mopp, Vector3(0, 0, 0), Vector3(1, 1, 1), found);
+  BOOST_REQUIRE_EQUAL(found.size(), 1u);
+  BOOST_CHECK_EQUAL(found[0], 0x010203u);
+
+  byte offset_code[] = { 0x09, 0x05, 0x52, 0x01, 0x00, 0x00 };
+  mopp.code.assign(offset_code, offset_code + sizeof(offset_code));
+  QueryMoppRay(mopp, Vector3(0, 0, 0), Vector3(1, 1, 1), found);
+  BOOST_REQUIRE_EQUAL(found.size(), 1u);
+  BOOST_CHECK_EQUAL(found[0], 0x010005u);
+
+  // truncated arguments
+  mopp.code.pop_back();
+  BOOST_CHECK_THROW(QueryMoppAabb(mopp, Vector3(0, 0, 0), Vector3(1, 1, 1), found), runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
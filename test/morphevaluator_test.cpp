@@ -0,0 +1,104 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "niflib.h"
+#include "MorphEvaluator.h"
+#include "obj/NiMorphData.h"
+#include "obj/NiObjectNET.h"
+#include "obj/NiGeomMorpherController.h"
+#include "obj/NiFloatInterpolator.h"
+#include "obj/NiFloatData.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(morphevaluator_test_suite)
+
+// base shape plus two relative targets, with five vertices so that the
+// last simd block is only partially used
+static NiMorphDataRef make_morph_data()
+{
+  NiMorphDataRef data = new NiMorphData;
+  data->SetMorphCount(3);
+  data->SetVertexCount(5);
+  vector<Vector3> base(5), up(5), right(5);
+  for (unsigned int i = 0; i < 5; ++i) {
+    base[i] = Vector3(float(i), 0, 0);
+    up[i] = Vector3(0, 1, 0);
+    right[i] = Vector3(2, 0, 0);
+  }
+  data->SetMorphVerts(0, base);
+  data->SetMorphVerts(1, up);
+  data->SetMorphVerts(2, right);
+
+  vector< Key<float> > keys(2);
+  keys[0].time = 0.0f;
+  keys[0].data = 0.0f;
+  keys[1].time = 1.0f;
+  keys[1].data = 1.0f;
+  data->SetMorphKeyType(1, LINEAR_KEY);
+  data->SetMorphKeys(1, keys);
+  return data;
+}
+
+BOOST_AUTO_TEST_CASE(morphevaluator_keys_test)
+{
+  NiMorphDataRef data = make_morph_data();
+  MorphEvaluator eval(data);
+  BOOST_CHECK_EQUAL(eval.GetVertexCount(), 5u);
+  BOOST_CHECK_EQUAL(eval.GetMorphCount(), 3u);
+
+  vector<float> weights;
+  eval.SampleWeights(0.25f, weights);
+  BOOST_CHECK_EQUAL(weights[0], 1.0f);
+  BOOST_CHECK_CLOSE(weights[1], 0.25f, 0.01);
+  BOOST_CHECK_EQUAL(weights[2], 0.0f);
+
+  vector<Vector3> verts;
+  eval.Evaluate(0.25f, verts);
+  BOOST_REQUIRE_EQUAL(verts.size(), 5u);
+  for (unsigned int i = 0; i < 5; ++i) {
+    BOOST_CHECK_CLOSE(verts[i].x, float(i), 0.01);
+    BOOST_CHECK_CLOSE(verts[i].y, 0.25f, 0.01);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(morphevaluator_weights_test)
+{
+  NiMorphDataRef data = make_morph_data();
+  MorphEvaluator eval(data);
+  vector<float> weights(3);
+  weights[1] = 0.5f;
+  weights[2] = 0.5f;
+  vector<Vector3> verts;
+  eval.Evaluate(weights, verts);
+  BOOST_CHECK_CLOSE(verts[4].x, 5.0f, 0.01);
+  BOOST_CHECK_CLOSE(verts[4].y, 0.5f, 0.01);
+  // weights below the threshold are skipped
+  weights[1] = 0.00001f;
+  eval.Evaluate(weights, verts);
+  BOOST_CHECK_EQUAL(verts[4].y, 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE(morphevaluator_controller_test)
+{
+  NiMorphDataRef data = make_morph_data();
+  NiGeomMorpherControllerRef ctrl = new NiGeomMorpherController;
+  ctrl->SetData(data);
+
+  // constant interpolator overrides the keys of the second target
+  vector< Ref<NiInterpolator> > interps(3);
+  NiFloatInterpolatorRef constant = new NiFloatInterpolator;
+  constant->SetFloatValue(1.0f);
+  interps[2] = constant;
+  ctrl->SetInterpolators(interps);
+
+  MorphEvaluator eval(ctrl);
+  vector<Vector3> verts;
+  eval.Evaluate(0.0f, verts);
+  BOOST_CHECK_CLOSE(verts[1].x, 3.0f, 0.01);
+  BOOST_CHECK_SMALL(verts[1].y, 0.0001f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
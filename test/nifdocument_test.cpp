@@ -0,0 +1,103 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <sstream> // stringstream
+#include <fstream>
+#include <cstdio>  // remove
+#include <stdexcept>
+
+#include "niflib.h"
+#include "NifDocument.h"
+#include "obj/NiNode.h"
+#include "obj/NiTriShape.h"
+#include "obj/NiTriShapeData.h"
+#include "obj/NiMaterialProperty.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(nifdocument_test_suite)
+
+// a root with ten child nodes, each holding a shape with its own data and
+// all sharing one material
+static void write_scene(const string & file_name, const NifInfo & info) {
+  NiNodeRef root = new NiNode;
+  root->SetName("Scene Root");
+  NiMaterialPropertyRef mat = new NiMaterialProperty;
+  mat->SetName("Shared");
+  for (int i = 0; i < 10; ++i) {
+    stringstream name;
+    name << "Node " << i;
+    NiNodeRef node = new NiNode;
+    node->SetName(name.str());
+    root->AddChild(StaticCast<NiAVObject>(node));
+    NiTriShapeDataRef data = new NiTriShapeData;
+    data->SetVertices(vector<Vector3>(3, Vector3(float(i), 0.0f, 0.0f)));
+    NiTriShapeRef shape = new NiTriShape;
+    shape->SetData(data);
+    shape->AddProperty(mat);
+    node->AddChild(StaticCast<NiAVObject>(shape));
+  }
+  WriteNifTree(file_name, root, info);
+}
+
+static string file_contents(const string & file_name) {
+  ifstream in(file_name.c_str(), ifstream::binary);
+  stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+BOOST_AUTO_TEST_CASE(lazy_test)
+{
+  NifInfo infos[2] = { NifInfo(VER_20_2_0_7, 11), NifInfo(VER_20_0_0_5, 11) };
+  for (int v = 0; v < 2; ++v) {
+    write_scene("nifdocument_test.nif", infos[v]);
+    NifDocument doc("nifdocument_test.nif");
+    BOOST_CHECK_EQUAL(doc.GetInfo().version, infos[v].version);
+    BOOST_REQUIRE_EQUAL(doc.GetBlockCount(), 32u);
+    BOOST_CHECK_EQUAL(doc.GetMaterializedCount(), 0u);
+
+    // reading the root leaves its children as placeholders
+    NiNodeRef root = DynamicCast<NiNode>(doc.GetRoot());
+    BOOST_REQUIRE(root != NULL);
+    BOOST_CHECK_EQUAL(root->GetName(), "Scene Root");
+    BOOST_CHECK_EQUAL(doc.GetMaterializedCount(), 1u);
+    vector<NiAVObjectRef> children = root->GetChildren();
+    BOOST_REQUIRE_EQUAL(children.size(), 10u);
+    BOOST_CHECK(children[3]->IsPlaceholder());
+    BOOST_CHECK(children[3]->GetParent() == root);
+    BOOST_CHECK_EQUAL(doc.GetBlockType(children[3]->internal_block_number), "NiNode");
+
+    // walking down reads one block at a time, into the same objects
+    NiNodeRef node = DynamicCast<NiNode>(doc.Load(children[3]));
+    BOOST_REQUIRE(node != NULL);
+    BOOST_CHECK(!node->IsPlaceholder());
+    BOOST_CHECK_EQUAL(node->GetName(), "Node 3");
+    BOOST_CHECK(node == root->GetChildren()[3]);
+    NiTriShapeRef shape = DynamicCast<NiTriShape>(doc.Load(node->GetChildren()[0]));
+    BOOST_REQUIRE(shape != NULL);
+    NiGeometryDataRef data = doc.Load(shape->GetData());
+    BOOST_CHECK_EQUAL(data->GetVertices()[0].x, 3.0f);
+    BOOST_CHECK_EQUAL(doc.GetMaterializedCount(), 4u);
+    BOOST_CHECK(doc.GetBlock(data->internal_block_number) == data);
+    BOOST_CHECK_EQUAL(doc.GetMaterializedCount(), 4u);
+
+    // a whole tree can be read and written back as it was
+    stringstream out;
+    BOOST_CHECK_THROW(WriteNifTree(out, root, infos[v]), runtime_error);
+    doc.MaterializeTree(root);
+    BOOST_CHECK_EQUAL(doc.GetMaterializedCount(), 32u);
+    WriteNifTree(out, root, infos[v]);
+    BOOST_CHECK(out.str() == file_contents("nifdocument_test.nif"));
+
+    BOOST_CHECK_THROW(doc.GetBlock(32), runtime_error);
+    NiNodeRef other = new NiNode;
+    BOOST_CHECK_NO_THROW(doc.Materialize(other));
+  }
+  remove("nifdocument_test.nif");
+  BOOST_CHECK_THROW(NifDocument("nifdocument_missing.nif"), runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,10 @@
 
 #include "niflib.h"
 #include "obj/NiNode.h"
+#include "obj/NiControllerSequence.h"
+#include "obj/NiTransformInterpolator.h"
+#include "obj/NiTimeController.h"
+#include "NodeNameIndex.h"
 
 using namespace Niflib;
 using namespace std;
@@ -37,4 +41,72 @@ BOOST_AUTO_TEST_CASE(ninode_test)
 {
 }
 
+BOOST_AUTO_TEST_CASE(ninode_name_index_test)
+{
+  NiNodeRef root = new NiNode;
+  root->SetName("Root");
+  NiNodeRef arm = new NiNode;
+  arm->SetName("Arm");
+  root->AddChild(StaticCast<NiAVObject>(arm));
+
+  NodeNameIndex index(root);
+  BOOST_CHECK_EQUAL(index.GetNameCount(), 2u);
+  BOOST_CHECK(index.Find("Arm") == arm);
+  BOOST_CHECK(index.Find("Hand") == NULL);
+
+  // structural edits are picked up on the next lookup
+  NiNodeRef hand = new NiNode;
+  hand->SetName("Hand");
+  arm->AddChild(StaticCast<NiAVObject>(hand));
+  BOOST_CHECK(index.Find("Hand") == hand);
+  arm->RemoveChild(StaticCast<NiAVObject>(hand));
+  BOOST_CHECK(index.Find("Hand") == NULL);
+
+  // renames need an explicit invalidation
+  arm->SetName("LeftArm");
+  index.Invalidate();
+  BOOST_CHECK(index.Find("LeftArm") == arm);
+
+  // edits to another tree leave the index alone, so an unnoticed rename
+  // stays unnoticed until this tree changes
+  unsigned int revision = root->GetHierarchyRevision();
+  NiNodeRef other = new NiNode;
+  other->AddChild(StaticCast<NiAVObject>(new NiNode));
+  BOOST_CHECK_EQUAL(root->GetHierarchyRevision(), revision);
+  arm->SetName("RightArm");
+  BOOST_CHECK(index.Find("RightArm") == NULL);
+  hand->AddChild(StaticCast<NiAVObject>(new NiNode));
+  BOOST_CHECK(index.Find("RightArm") == NULL);
+
+  // but an edit deep inside the tree is seen at the root
+  arm->AddChild(StaticCast<NiAVObject>(hand));
+  BOOST_CHECK(root->GetHierarchyRevision() != revision);
+  BOOST_CHECK(index.Find("RightArm") == arm);
+  BOOST_CHECK(index.Find("Hand") == hand);
+}
+
+BOOST_AUTO_TEST_CASE(ninode_merge_batch_test)
+{
+  NiNodeRef root = new NiNode;
+  root->SetName("Root");
+  NiNodeRef arm = new NiNode;
+  arm->SetName("Arm");
+  root->AddChild(StaticCast<NiAVObject>(arm));
+
+  vector<NiControllerSequenceRef> seqs;
+  for (int i = 0; i < 3; ++i) {
+    NiControllerSequenceRef seq = new NiControllerSequence;
+    NiTransformInterpolatorRef interp = new NiTransformInterpolator;
+    seq->AddGenericInterpolator(interp, arm, "NiTransformController", 0, false);
+    seqs.push_back(seq);
+  }
+
+  NodeNameIndex index(root);
+  MergeNifTrees(root, seqs, &index, false);
+  // every sequence drives the same controller, the last one wins
+  list<NiTimeControllerRef> ctlrs = arm->GetControllers();
+  BOOST_CHECK_EQUAL(ctlrs.size(), 1u);
+  BOOST_CHECK_EQUAL(index.GetNameCount(), 2u);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,110 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <sstream> // stringstream
+#include <cstdio>  // remove
+
+#include "niflib.h"
+#include "ObjectArena.h"
+#include "NifDocument.h"
+#include "obj/NiNode.h"
+#include "obj/NiTriShape.h"
+#include "obj/NiTriShapeData.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(objectarena_test_suite)
+
+BOOST_AUTO_TEST_CASE(scope_test)
+{
+  ObjectArena arena(64 * 1024);
+  vector<NiNodeRef> nodes;
+  {
+    ObjectArena::Scope scope(arena);
+    for (int i = 0; i < 1000; ++i)
+      nodes.push_back(new NiNode);
+  }
+  BOOST_CHECK_EQUAL(arena.GetObjectCount(), 1000u);
+  size_t bytes = arena.GetBytesAllocated();
+  BOOST_CHECK_GE(bytes, 1000 * sizeof(NiNode));
+  BOOST_CHECK_EQUAL(bytes % (64 * 1024), 0u);
+
+  // objects made outside the scope come from the heap
+  NiNodeRef outside = new NiNode;
+  BOOST_CHECK_EQUAL(arena.GetObjectCount(), 1000u);
+
+  // the innermost scope wins
+  ObjectArena inner;
+  {
+    ObjectArena::Scope scope(arena);
+    {
+      ObjectArena::Scope scope2(inner);
+      nodes.push_back(new NiNode);
+    }
+    nodes.push_back(new NiNode);
+  }
+  BOOST_CHECK_EQUAL(inner.GetObjectCount(), 1u);
+  BOOST_CHECK_EQUAL(arena.GetObjectCount(), 1001u);
+
+  nodes.clear();
+  BOOST_CHECK_EQUAL(arena.GetObjectCount(), 0u);
+  BOOST_CHECK_EQUAL(inner.GetObjectCount(), 0u);
+  BOOST_CHECK_EQUAL(arena.GetBytesAllocated(), bytes);
+}
+
+BOOST_AUTO_TEST_CASE(detached_test)
+{
+  // objects can outlive their arena; each is too big to share a block here
+  NiNodeRef kept;
+  {
+    ObjectArena arena(16);
+    ObjectArena::Scope scope(arena);
+    kept = new NiNode;
+    kept->SetName("Kept");
+    kept->AddChild(new NiNode);
+    BOOST_CHECK_EQUAL(arena.GetObjectCount(), 2u);
+  }
+  BOOST_CHECK_EQUAL(kept->GetName(), "Kept");
+  BOOST_CHECK_EQUAL(kept->GetChildren().size(), 1u);
+  kept = NULL;
+}
+
+BOOST_AUTO_TEST_CASE(read_test)
+{
+  stringstream ss;
+  NiNodeRef root = new NiNode;
+  for (int i = 0; i < 20; ++i) {
+    NiTriShapeRef shape = new NiTriShape;
+    shape->SetData(new NiTriShapeData);
+    root->AddChild(StaticCast<NiAVObject>(shape));
+  }
+  WriteNifTree(ss, root, NifInfo(VER_20_2_0_7, 11));
+
+  ObjectArena arena;
+  vector<NiObjectRef> objects;
+  {
+    ObjectArena::Scope scope(arena);
+    objects = ReadNifList(ss);
+  }
+  BOOST_CHECK_EQUAL(objects.size(), 41u);
+  BOOST_CHECK_EQUAL(arena.GetObjectCount(), 41u);
+  objects.clear();
+  BOOST_CHECK_EQUAL(arena.GetObjectCount(), 0u);
+
+  // documents allocate their blocks from their own arena
+  WriteNifTree("objectarena_test.nif", root, NifInfo(VER_20_2_0_7, 11));
+  NiObjectRef first;
+  {
+    NifDocument doc("objectarena_test.nif");
+    first = doc.GetRoot();
+    BOOST_CHECK_EQUAL(doc.GetArena().GetObjectCount(), 21u);
+    doc.MaterializeAll();
+    BOOST_CHECK_EQUAL(doc.GetArena().GetObjectCount(), 41u);
+  }
+  BOOST_CHECK_EQUAL(DynamicCast<NiNode>(first)->GetChildren().size(), 20u);
+  remove("objectarena_test.nif");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
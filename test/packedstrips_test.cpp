@@ -0,0 +1,119 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <sstream> // stringstream
+#include <cmath>
+
+#include "niflib.h"
+#include "obj/hkPackedNiTriStripsData.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(packedstrips_test_suite)
+
+static Ref<hkPackedNiTriStripsData> round_trip(hkPackedNiTriStripsData * data, unsigned int version) {
+  stringstream ss;
+  WriteNifTree(ss, data, NifInfo(version));
+  ss.seekg(0);
+  return DynamicCast<hkPackedNiTriStripsData>(ReadNifTree(ss));
+}
+
+BOOST_AUTO_TEST_CASE(compressed_vertices_test)
+{
+  vector<Vector3> verts;
+  verts.push_back(Vector3(1.5f, -2.25f, 0.0f));
+  verts.push_back(Vector3(65504.0f, -0.0f, 1.0f / 1048576.0f)); // largest half and a denormal
+  verts.push_back(Vector3(1.0001f, 1.00048f, 1.0015f) );         // rounded to the nearest half
+  verts.push_back(Vector3(70000.0f, -70000.0f, 0.1f));          // out of range
+  verts.push_back(Vector3(-3.0f, 1024.0f, 2049.0f));            // a tie, rounded to even
+  Ref<hkPackedNiTriStripsData> data = new hkPackedNiTriStripsData;
+  data->SetVertices(verts);
+  data->SetCompressed(true);
+
+  Ref<hkPackedNiTriStripsData> read = round_trip(data, VER_20_2_0_7);
+  BOOST_REQUIRE(read != NULL);
+  BOOST_CHECK(read->GetCompressed());
+  const vector<Vector3> & out = read->GetVertexArray();
+  BOOST_REQUIRE_EQUAL(out.size(), verts.size());
+  BOOST_CHECK_EQUAL(out[0].x, 1.5f);
+  BOOST_CHECK_EQUAL(out[0].y, -2.25f);
+  BOOST_CHECK_EQUAL(out[0].z, 0.0f);
+  BOOST_CHECK_EQUAL(out[1].x, 65504.0f);
+  BOOST_CHECK(out[1].y == 0.0f && signbit(out[1].y));
+  BOOST_CHECK_EQUAL(out[1].z, 1.0f / 1048576.0f);
+  BOOST_CHECK_EQUAL(out[2].x, 1.0f);
+  BOOST_CHECK_EQUAL(out[2].y, 1.0f);
+  BOOST_CHECK_EQUAL(out[2].z, 1.0f + 2.0f / 1024.0f);
+  BOOST_CHECK(isinf(out[3].x) && out[3].x > 0.0f);
+  BOOST_CHECK(isinf(out[3].y) && out[3].y < 0.0f);
+  BOOST_CHECK_CLOSE(out[3].z, 0.1f, 0.05f);
+  BOOST_CHECK_EQUAL(out[4].x, -3.0f);
+  BOOST_CHECK_EQUAL(out[4].y, 1024.0f);
+  BOOST_CHECK_EQUAL(out[4].z, 2048.0f);
+
+  // decoded values encode back to the same bits
+  Ref<hkPackedNiTriStripsData> again = round_trip(read, VER_20_2_0_7);
+  const vector<Vector3> & out2 = again->GetVertexArray();
+  for (size_t i = 0; i < out.size(); ++i)
+    for (int k = 0; k < 3; ++k)
+      BOOST_CHECK_EQUAL(out2[i][k], out[i][k]);
+
+  // uncompressed data, and older versions, keep full floats
+  data->SetCompressed(false);
+  read = round_trip(data, VER_20_2_0_7);
+  BOOST_CHECK(!read->GetCompressed());
+  BOOST_CHECK_EQUAL(read->GetVertexArray()[2].x, 1.0001f);
+  data->SetCompressed(true);
+  read = round_trip(data, VER_20_0_0_5);
+  BOOST_CHECK_EQUAL(read->GetVertexArray()[2].x, 1.0001f);
+}
+
+BOOST_AUTO_TEST_CASE(compressed_layout_test)
+{
+  // the rest of a compressed block reads back unchanged
+  Ref<hkPackedNiTriStripsData> data = new hkPackedNiTriStripsData;
+  vector<hkTriangle> tris(2);
+  tris[0].triangle = Triangle(0, 1, 2);
+  tris[0].weldingInfo = 7;
+  tris[1].triangle = Triangle(2, 1, 3);
+  data->SetHavokTriangles(tris);
+  data->SetVertices(vector<Vector3>(4, Vector3(0.5f, 1.0f, 2.0f)));
+  vector<OblivionSubShape> subs(2);
+  subs[1].colFilter = 3;
+  subs[1].numVertices = 4;
+  data->SetSubShapes(subs);
+  data->SetCompressed(true);
+
+  Ref<hkPackedNiTriStripsData> read = round_trip(data, VER_20_2_0_7);
+  BOOST_REQUIRE(read != NULL);
+  BOOST_REQUIRE_EQUAL(read->GetHavokTriangleArray().size(), 2u);
+  BOOST_CHECK_EQUAL(read->GetHavokTriangleArray()[0].weldingInfo, 7);
+  BOOST_CHECK_EQUAL(read->GetHavokTriangleArray()[1].triangle.v3, 3);
+  BOOST_CHECK_EQUAL(read->GetVertexArray()[3].z, 2.0f);
+  BOOST_REQUIRE_EQUAL(read->GetSubShapeArray().size(), 2u);
+  BOOST_CHECK_EQUAL(read->GetSubShapeArray()[1].colFilter, 3);
+  BOOST_CHECK_EQUAL(read->GetSubShapeArray()[1].numVertices, 4u);
+}
+
+BOOST_AUTO_TEST_CASE(array_access_test)
+{
+  Ref<hkPackedNiTriStripsData> data = new hkPackedNiTriStripsData;
+  vector<hkTriangle> tris(2);
+  tris[0].triangle = Triangle(0, 1, 2);
+  tris[1].triangle = Triangle(0, 0, 1);
+  data->SetHavokTriangles(tris);
+
+  // the arrays are shared rather than copied, and keep degenerate triangles
+  BOOST_CHECK_EQUAL(&data->GetHavokTriangleArray(), &data->GetHavokTriangleArray());
+  BOOST_CHECK_EQUAL(data->GetHavokTriangleArray().size(), 2u);
+  BOOST_CHECK_EQUAL(data->GetHavokTriangles().size(), 1u);
+  BOOST_CHECK_EQUAL(&data->GetVertexArray(), &data->GetVertexArray());
+
+  vector<OblivionSubShape> subs(3);
+  data->SetSubShapes(subs);
+  BOOST_CHECK_EQUAL(data->GetSubShapeArray().size(), 3u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
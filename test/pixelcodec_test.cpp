@@ -0,0 +1,320 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <sstream> // stringstream
+#include <cstdlib>
+#include <stdexcept>
+
+#include "niflib.h"
+#include "PixelCodec.h"
+#include "obj/NiPixelData.h"
+#include "obj/NiPalette.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(pixelcodec_test_suite)
+
+// a smooth image with an alpha ramp, so block compression has something to fit
+static vector<byte> make_image(unsigned int width, unsigned int height) {
+  vector<byte> rgba(width * height * 4);
+  for (unsigned int y = 0; y < height; ++y) {
+    for (unsigned int x = 0; x < width; ++x) {
+      byte * p = &rgba[(y * width + x) * 4];
+      p[0] = byte(16 + x * 4);
+      p[1] = byte(32 + y * 3);
+      p[2] = byte(128 + (x + y) % 8);
+      p[3] = byte((x * 7 + y * 3) % 256);
+    }
+  }
+  return rgba;
+}
+
+static int max_difference(const vector<byte> & a, const vector<byte> & b, int channel) {
+  int worst = 0;
+  for (size_t i = channel; i < a.size(); i += 4)
+    worst = max(worst, abs(int(a[i]) - int(b[i])));
+  return worst;
+}
+
+static vector<byte> round_trip(PixelFormat format, const vector<byte> & rgba, unsigned int width, unsigned int height, const byte * palette = NULL) {
+  vector<byte> packed(GetPixelImageSize(format, width, height));
+  EncodePixels(format, &rgba[0], width, height, &packed[0], palette);
+  vector<byte> out(rgba.size());
+  DecodePixels(format, &packed[0], width, height, &out[0], palette);
+  return out;
+}
+
+BOOST_AUTO_TEST_CASE(uncompressed_test)
+{
+  vector<byte> rgba = make_image(5, 3);
+  BOOST_CHECK(round_trip(PX_FMT_RGBA8, rgba, 5, 3) == rgba);
+
+  vector<byte> rgb = round_trip(PX_FMT_RGB8, rgba, 5, 3);
+  BOOST_CHECK_EQUAL(max_difference(rgb, rgba, 0), 0);
+  BOOST_CHECK_EQUAL(max_difference(rgb, rgba, 2), 0);
+  BOOST_CHECK_EQUAL(rgb[3], 255);
+
+  // bump maps store signed bytes
+  byte bump[3] = { 0x80, 0x7F, 0x40 };
+  byte out[4];
+  DecodePixels(PX_FMT_BUMPLUMA, bump, 1, 1, out);
+  BOOST_CHECK_EQUAL(out[0], 0);
+  BOOST_CHECK_EQUAL(out[1], 255);
+  BOOST_CHECK_EQUAL(out[2], 0x40);
+  vector<byte> bumps = round_trip(PX_FMT_BUMP, rgba, 5, 3);
+  BOOST_CHECK_EQUAL(max_difference(bumps, rgba, 1), 0);
+
+  BOOST_CHECK_EQUAL(GetPixelImageSize(PX_FMT_RGB8, 5, 3), 45u);
+  BOOST_CHECK_EQUAL(GetPixelImageSize(PX_FMT_DXT1, 5, 3), 16u);
+  BOOST_CHECK_EQUAL(GetPixelImageSize(PX_FMT_DXT5, 8, 8), 64u);
+  BOOST_CHECK_THROW(GetPixelImageSize(PixelFormat(7), 4, 4), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(palette_test)
+{
+  vector<byte> palette(256 * 4, 0);
+  for (int i = 0; i < 256; ++i) {
+    palette[i * 4] = byte(i);
+    palette[i * 4 + 3] = byte(255 - i);
+  }
+  vector<byte> rgba = make_image(6, 2);
+  vector<byte> out = round_trip(PX_FMT_PALA8, rgba, 6, 2, &palette[0]);
+  for (size_t i = 0; i < out.size(); i += 4)
+    BOOST_CHECK_EQUAL(int(out[i + 3]), 255 - int(out[i]));
+
+  // without alpha the red ramp is matched exactly
+  out = round_trip(PX_FMT_PAL8, rgba, 6, 2, &palette[0]);
+  BOOST_CHECK_EQUAL(max_difference(out, rgba, 0), 0);
+  BOOST_CHECK_EQUAL(out[3], 255);
+
+  byte index = 0;
+  BOOST_CHECK_THROW(DecodePixels(PX_FMT_PAL8, &index, 1, 1, &out[0]), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(bc1_test)
+{
+  // red and blue endpoints, in four and three color modes
+  byte block[8] = { 0x00, 0xF8, 0x1F, 0x00, 0xE4, 0, 0, 0 };
+  byte out[64];
+  DecodePixels(PX_FMT_DXT1, block, 4, 4, out);
+  BOOST_CHECK(out[0] == 255 && out[1] == 0 && out[2] == 0 && out[3] == 255);
+  BOOST_CHECK(out[4] == 0 && out[5] == 0 && out[6] == 255);
+  BOOST_CHECK(out[8] == 170 && out[10] == 85);
+  BOOST_CHECK(out[12] == 85 && out[14] == 170);
+  swap(block[0], block[2]);
+  swap(block[1], block[3]);
+  DecodePixels(PX_FMT_DXT1, block, 4, 4, out);
+  BOOST_CHECK(out[8] == 127 && out[10] == 127);
+  BOOST_CHECK(out[12] == 0 && out[13] == 0 && out[14] == 0 && out[15] == 0);
+
+  // a single color survives up to 5:6:5 precision
+  vector<byte> flat(16 * 4);
+  for (size_t i = 0; i < flat.size(); i += 4) {
+    flat[i] = 200; flat[i + 1] = 100; flat[i + 2] = 50; flat[i + 3] = 255;
+  }
+  vector<byte> decoded = round_trip(PX_FMT_DXT1, flat, 4, 4);
+  for (int c = 0; c < 3; ++c)
+    BOOST_CHECK_LE(max_difference(decoded, flat, c), 4);
+
+  // a smooth image with a partial block at the edges
+  vector<byte> rgba = make_image(13, 7);
+  for (size_t i = 3; i < rgba.size(); i += 4)
+    rgba[i] = 255;
+  decoded = round_trip(PX_FMT_DXT1, rgba, 13, 7);
+  for (int c = 0; c < 3; ++c)
+    BOOST_CHECK_LE(max_difference(decoded, rgba, c), 16);
+  BOOST_CHECK_EQUAL(max_difference(decoded, rgba, 3), 0);
+
+  // pixels with low alpha are punched through
+  rgba[3] = 0;
+  rgba[7] = 100;
+  decoded = round_trip(PX_FMT_DXT1, rgba, 13, 7);
+  BOOST_CHECK_EQUAL(decoded[3], 0);
+  BOOST_CHECK_EQUAL(decoded[7], 0);
+  BOOST_CHECK_EQUAL(decoded[11], 255);
+  BOOST_CHECK_LE(abs(int(decoded[8]) - int(rgba[8])), 16);
+}
+
+BOOST_AUTO_TEST_CASE(bc3_test)
+{
+  vector<byte> rgba = make_image(16, 12);
+  vector<byte> decoded = round_trip(PX_FMT_DXT5, rgba, 16, 12);
+  for (int c = 0; c < 3; ++c)
+    BOOST_CHECK_LE(max_difference(decoded, rgba, c), 16);
+  BOOST_CHECK_LE(max_difference(decoded, rgba, 3), 10);
+
+  // constant alpha is exact
+  for (size_t i = 3; i < rgba.size(); i += 4)
+    rgba[i] = 77;
+  decoded = round_trip(PX_FMT_DXT5_ALT, rgba, 16, 12);
+  BOOST_CHECK_EQUAL(max_difference(decoded, rgba, 3), 0);
+}
+
+BOOST_AUTO_TEST_CASE(threads_test)
+{
+  // every thread count gives the same bytes
+  vector<byte> rgba = make_image(256, 192);
+  vector<byte> one(GetPixelImageSize(PX_FMT_DXT5, 256, 192));
+  vector<byte> four(one.size());
+  EncodePixels(PX_FMT_DXT5, &rgba[0], 256, 192, &one[0], NULL, 1);
+  EncodePixels(PX_FMT_DXT5, &rgba[0], 256, 192, &four[0], NULL, 4);
+  BOOST_CHECK(one == four);
+
+  // several images in one call
+  vector<byte> small = make_image(8, 8);
+  vector<byte> big_out(rgba.size()), small_out(small.size());
+  vector<PixelImage> images;
+  images.push_back(PixelImage(&four[0], &big_out[0], 256, 192));
+  images.push_back(PixelImage(NULL, NULL, 0, 0));
+  vector<byte> small_packed(GetPixelImageSize(PX_FMT_DXT5, 8, 8));
+  EncodePixels(PX_FMT_DXT5, &small[0], 8, 8, &small_packed[0]);
+  images.push_back(PixelImage(&small_packed[0], &small_out[0], 8, 8));
+  DecodePixelImages(PX_FMT_DXT5, images, NULL, 3);
+  vector<byte> expect(rgba.size());
+  DecodePixels(PX_FMT_DXT5, &four[0], 256, 192, &expect[0], NULL, 1);
+  BOOST_CHECK(big_out == expect);
+  BOOST_CHECK(small_out == round_trip(PX_FMT_DXT5, small, 8, 8));
+}
+
+BOOST_AUTO_TEST_CASE(pixel_data_test)
+{
+  vector<byte> rgba = make_image(16, 16);
+  NiPixelDataRef data = new NiPixelData;
+  data->Reset(16, 16, PX_FMT_DXT5);
+  data->SetPixels(rgba, true);
+  vector< vector<byte> > levels = data->GetMipmapPixels();
+  BOOST_REQUIRE_EQUAL(levels.size(), 5u);
+  BOOST_CHECK_EQUAL(levels[4].size(), 4u);
+  BOOST_CHECK(levels[0] == data->GetPixels(0));
+  BOOST_CHECK(levels[2] == data->GetPixels(2));
+  BOOST_CHECK_LE(max_difference(levels[0], rgba, 0), 16);
+
+  // the data survives being written and read back
+  stringstream ss;
+  WriteNifTree(ss, data, NifInfo(VER_20_0_0_5, 11));
+  ss.seekg(0);
+  NiPixelDataRef read = DynamicCast<NiPixelData>(ReadNifTree(ss));
+  BOOST_REQUIRE(read != NULL);
+  BOOST_CHECK_EQUAL(read->GetPixelFormat(), PX_FMT_DXT5);
+  BOOST_CHECK(read->GetPixels(1) == levels[1]);
+  vector<Color4> colors = read->GetColors();
+  BOOST_REQUIRE_EQUAL(colors.size(), 256u);
+  BOOST_CHECK_CLOSE(colors[5].a, levels[0][23] / 255.0f, 1e-4f);
+
+  // colors go through the same path
+  data->Reset(4, 4, PX_FMT_RGB8);
+  vector<Color4> in(16, Color4(1.0f, 0.5f, 0.0f, 1.0f));
+  data->SetColors(in, false);
+  vector<byte> px = data->GetPixels();
+  BOOST_CHECK(px[0] == 255 && px[1] == 128 && px[2] == 0 && px[3] == 255);
+
+  // palettized data needs a palette
+  data->Reset(4, 4, PX_FMT_PAL8);
+  BOOST_CHECK_THROW(data->SetColors(in, false), runtime_error);
+  NiPaletteRef palette = new NiPalette;
+  vector<Color4> entries(256, Color4(0.0f, 0.0f, 0.0f, 1.0f));
+  entries[9] = Color4(1.0f, 0.5f, 0.0f, 1.0f);
+  palette->SetPalette(entries);
+  data->SetPalette(palette);
+  data->SetColors(in, false);
+  BOOST_CHECK_CLOSE(data->GetColors()[3].r, 1.0f, 1e-4f);
+
+  BOOST_CHECK_THROW(data->GetPixels(1), runtime_error);
+  BOOST_CHECK_THROW(data->SetPixels(vector<byte>(3), false), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(downsample_test)
+{
+  // a box filter averages each 2x2 square
+  byte square[16] = { 0, 0, 0, 0,  4, 8, 0, 255,  8, 0, 0, 0,  0, 8, 0, 255 };
+  byte out[4];
+  vector<PixelImage> images(1, PixelImage(square, out, 2, 2));
+  DownsamplePixelImages(images);
+  BOOST_CHECK(out[0] == 3 && out[1] == 4 && out[2] == 0 && out[3] == 128);
+
+  // odd sizes share the middle pixel
+  byte row[12] = { 0, 0, 0, 0,  90, 0, 0, 0,  180, 0, 0, 0 };
+  images[0] = PixelImage(row, out, 3, 1);
+  DownsamplePixelImages(images);
+  BOOST_CHECK_EQUAL(out[0], 90);
+
+  // in linear light black and white average brighter than half
+  byte pair[8] = { 0, 0, 0, 255,  255, 255, 255, 255 };
+  images[0] = PixelImage(pair, out, 2, 1);
+  DownsamplePixelImages(images, MIPMAP_BOX, true);
+  BOOST_CHECK(out[0] > 180 && out[0] < 192);
+  BOOST_CHECK_EQUAL(out[3], 255);
+
+  // every filter keeps a flat color
+  vector<byte> flat(9 * 6 * 4);
+  for (size_t i = 0; i < flat.size(); i += 4) {
+    flat[i] = 200; flat[i + 1] = 100; flat[i + 2] = 50; flat[i + 3] = 30;
+  }
+  vector<byte> small(4 * 3 * 4);
+  images[0] = PixelImage(&flat[0], &small[0], 9, 6);
+  for (int linear = 0; linear < 2; ++linear) {
+    DownsamplePixelImages(images, MIPMAP_KAISER, linear != 0);
+    BOOST_CHECK_LE(max_difference(small, vector<byte>(flat.begin(), flat.begin() + small.size()), 0), 1);
+    BOOST_CHECK_LE(max_difference(small, vector<byte>(flat.begin(), flat.begin() + small.size()), 3), 0);
+  }
+
+  // every thread count gives the same bytes
+  vector<byte> rgba = make_image(256, 192);
+  vector<byte> one(128 * 96 * 4), four(one.size());
+  images[0] = PixelImage(&rgba[0], &one[0], 256, 192);
+  DownsamplePixelImages(images, MIPMAP_KAISER, false, 1);
+  images[0].out = &four[0];
+  DownsamplePixelImages(images, MIPMAP_KAISER, false, 4);
+  BOOST_CHECK(one == four);
+}
+
+BOOST_AUTO_TEST_CASE(mipmap_chain_test)
+{
+  // non-square and odd sizes go all the way down to one pixel
+  NiPixelDataRef data = new NiPixelData;
+  data->Reset(16, 4, PX_FMT_RGBA8);
+  data->SetPixels(make_image(16, 4), true);
+  BOOST_CHECK_EQUAL(data->GetMipmapPixels().size(), 5u);
+  BOOST_CHECK_EQUAL(data->GetPixels(4).size(), 4u);
+  data->Reset(6, 3, PX_FMT_DXT1);
+  data->SetPixels(make_image(6, 3), true, MIPMAP_KAISER);
+  BOOST_CHECK_EQUAL(data->GetMipmapPixels().size(), 3u);
+  BOOST_CHECK_EQUAL(data->GetPixels(1).size(), 3u * 4u);
+
+  // the mipmaps of other formats match filtering the RGBA8 chain
+  vector<byte> rgba = make_image(12, 10);
+  data->Reset(12, 10, PX_FMT_RGBA8);
+  data->SetPixels(rgba, true, MIPMAP_BOX, true);
+  vector< vector<byte> > expect = data->GetMipmapPixels();
+  data->Reset(12, 10, PX_FMT_RGB8);
+  data->SetPixels(rgba, true, MIPMAP_BOX, true);
+  vector< vector<byte> > levels = data->GetMipmapPixels();
+  BOOST_REQUIRE_EQUAL(levels.size(), expect.size());
+  for (size_t i = 0; i < levels.size(); ++i)
+    BOOST_CHECK_EQUAL(max_difference(levels[i], expect[i], 1), 0);
+
+  // cube maps keep each face
+  vector<byte> faces;
+  for (int f = 0; f < 6; ++f) {
+    vector<byte> face(8 * 8 * 4, byte(f * 40));
+    faces.insert(faces.end(), face.begin(), face.end());
+  }
+  data->Reset(8, 8, PX_FMT_DXT5, 6);
+  BOOST_CHECK_EQUAL(data->GetFaceCount(), 6u);
+  BOOST_CHECK_THROW(data->SetPixels(make_image(8, 8), true), runtime_error);
+  data->SetPixels(faces, true);
+  stringstream ss;
+  WriteNifTree(ss, data, NifInfo(VER_20_0_0_5, 11));
+  ss.seekg(0);
+  NiPixelDataRef read = DynamicCast<NiPixelData>(ReadNifTree(ss));
+  BOOST_REQUIRE(read != NULL);
+  BOOST_CHECK_EQUAL(read->GetFaceCount(), 6u);
+  BOOST_CHECK_EQUAL(read->GetMipmapPixels(5).size(), 4u);
+  BOOST_CHECK_LE(abs(int(read->GetPixels(3, 5)[0]) - 200), 4);
+  BOOST_CHECK_EQUAL(read->GetPixels(0, 2)[3], 80);
+  BOOST_CHECK_THROW(data->Reset(8, 8, PX_FMT_RGBA8, 0), runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,250 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+
+#include "niflib.h"
+#include "PoseBlender.h"
+#include "obj/NiNode.h"
+#include "obj/NiControllerSequence.h"
+#include "obj/NiTransformInterpolator.h"
+#include "obj/NiTransformData.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(poseblender_test_suite)
+
+// quaternion rotating by angle around the z axis
+static Quaternion zrot(float angle)
+{
+  return Quaternion(cos(angle / 2), 0, 0, sin(angle / 2));
+}
+
+BOOST_AUTO_TEST_CASE(poseblender_equal_weights_test)
+{
+  // five bones, so that the last simd block is only partially used
+  PoseBuffer a(5), b(5), out;
+  a.SetIdentity(1.0f);
+  b.SetIdentity(1.0f);
+  for (unsigned int i = 0; i < 5; ++i) {
+    a.SetTransform(i, Vector3(0, 0, 0), zrot(0), 1.0f);
+    b.SetTransform(i, Vector3(2, 4, 6), zrot(1.0f), 3.0f);
+  }
+  PoseBlender blender;
+  blender.AddLayer(a, 0.5f);
+  blender.AddLayer(b, 0.5f);
+  blender.Blend(out);
+  BOOST_CHECK_EQUAL(out.GetNumBones(), 5u);
+  for (unsigned int i = 0; i < 5; ++i) {
+    BOOST_CHECK_CLOSE(out.GetTranslation(i).y, 2.0f, 0.01);
+    BOOST_CHECK_CLOSE(out.GetScale(i), 2.0f, 0.01);
+    // halfway rotation is exact for two equal weights, even with nlerp
+    BOOST_CHECK_CLOSE(out.GetRotation(i).z, sin(0.25f), 0.01);
+    BOOST_CHECK_EQUAL(out.GetWeight(i), 1.0f);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(poseblender_priority_test)
+{
+  PoseBuffer low(2), high(2), out;
+  low.SetTransform(0, Vector3(1, 0, 0), zrot(0), 1.0f);
+  low.SetTransform(1, Vector3(1, 0, 0), zrot(0), 1.0f);
+  // high priority only animates bone 0
+  high.SetTransform(0, Vector3(5, 0, 0), zrot(0), 1.0f);
+  PoseBlender blender;
+  blender.AddLayer(low, 1.0f, 0);
+  blender.AddLayer(high, 1.0f, 10);
+  blender.Blend(out);
+  BOOST_CHECK_CLOSE(out.GetTranslation(0).x, 5.0f, 0.01);
+  BOOST_CHECK_CLOSE(out.GetTranslation(1).x, 1.0f, 0.01);
+}
+
+BOOST_AUTO_TEST_CASE(poseblender_slerp_test)
+{
+  PoseBuffer a(1), b(1), out;
+  a.SetTransform(0, Vector3(), zrot(0), 1.0f);
+  b.SetTransform(0, Vector3(), zrot(2.0f), 1.0f);
+  PoseBlender blender(POSE_BLEND_SLERP);
+  blender.AddLayer(a, 0.75f);
+  blender.AddLayer(b, 0.25f);
+  blender.Blend(out);
+  // slerp keeps the angular velocity constant: a quarter of the way is 0.5 rad
+  Quaternion q = out.GetRotation(0);
+  BOOST_CHECK_SMALL(2.0f * atan2(q.z, q.w) - 0.5f, 0.002f);
+}
+
+BOOST_AUTO_TEST_CASE(poseblender_additive_test)
+{
+  PoseBuffer base(1), pose(1), ref(1), delta, out;
+  base.SetTransform(0, Vector3(1, 1, 1), zrot(0.5f), 2.0f);
+  ref.SetTransform(0, Vector3(0, 0, 0), zrot(0), 1.0f);
+  pose.SetTransform(0, Vector3(0, 0, 3), zrot(0.25f), 1.5f);
+  PoseBlender::MakeAdditive(pose, ref, delta);
+  PoseBlender blender;
+  blender.AddLayer(base, 1.0f);
+  blender.AddLayer(delta, 1.0f, 0, true);
+  blender.Blend(out);
+  BOOST_CHECK_CLOSE(out.GetTranslation(0).z, 4.0f, 0.01);
+  BOOST_CHECK_CLOSE(out.GetScale(0), 3.0f, 0.01);
+  Quaternion q = out.GetRotation(0);
+  BOOST_CHECK_CLOSE(2.0f * atan2(q.z, q.w), 0.75f, 0.01);
+}
+
+BOOST_AUTO_TEST_CASE(poseblender_reference_test)
+{
+  PoseBuffer ref(1), half(1), out;
+  ref.SetTransform(0, Vector3(0, 0, 0), zrot(0), 1.0f);
+  half.SetTransform(0, Vector3(4, 0, 0), zrot(0), 1.0f);
+  PoseBlender blender;
+  blender.SetReferencePose(&ref);
+  blender.AddLayer(half, 0.25f);
+  blender.Blend(out);
+  // the remaining three quarters come from the reference pose
+  BOOST_CHECK_CLOSE(out.GetTranslation(0).x, 1.0f, 0.01);
+}
+
+template <class T>
+static Key<T> key(float time, const T & data)
+{
+  Key<T> k;
+  k.time = time;
+  k.data = data;
+  return k;
+}
+
+// a one second sequence animating "Arm" through keys found by its palette
+// offset, "Leg" through interpolator values only, and a node that is not
+// one of the bones
+struct SamplerFixture {
+  NiControllerSequenceRef seq;
+  NiTransformDataRef data;
+  vector<string> bones;
+
+  static NiNodeRef node(const string & name) {
+    NiNodeRef n = new NiNode;
+    n->SetName(name);
+    return n;
+  }
+
+  SamplerFixture() {
+    bones.push_back("Root");
+    bones.push_back("Arm");
+    bones.push_back("Leg");
+
+    data = new NiTransformData;
+    data->SetRotateType(LINEAR_KEY);
+    vector< Key<Quaternion> > rot;
+    rot.push_back(key(0.0f, zrot(0.0f)));
+    rot.push_back(key(1.0f, zrot(1.0f)));
+    data->SetQuatRotateKeys(rot);
+    data->SetTranslateType(LINEAR_KEY);
+    vector< Key<Vector3> > trans;
+    trans.push_back(key(0.0f, Vector3(0, 0, 0)));
+    trans.push_back(key(1.0f, Vector3(2, 0, 0)));
+    data->SetTranslateKeys(trans);
+    data->SetScaleType(LINEAR_KEY);
+    vector< Key<float> > scale;
+    scale.push_back(key(0.0f, 1.0f));
+    scale.push_back(key(1.0f, 3.0f));
+    data->SetScaleKeys(scale);
+
+    NiTransformInterpolatorRef arm = new NiTransformInterpolator;
+    arm->SetData(data);
+    NiTransformInterpolatorRef leg = new NiTransformInterpolator;
+    leg->SetTranslation(Vector3(7, 0, 0));
+    leg->SetRotation(zrot(0.3f));
+    leg->SetScale(2.0f);
+
+    seq = new NiControllerSequence;
+    seq->AddGenericInterpolator(arm, node("Arm"), "NiTransformController", 5, true);
+    seq->AddGenericInterpolator(leg, node("Leg"), "NiTransformController", 2, false);
+    seq->AddGenericInterpolator(new NiTransformInterpolator, node("Tail"), "NiTransformController", 9, false);
+    seq->SetStartTime(0.0f);
+    seq->SetStopTime(1.0f);
+    seq->SetCycleType(CYCLE_LOOP);
+  }
+};
+
+BOOST_FIXTURE_TEST_CASE(sampler_keys_test, SamplerFixture)
+{
+  SequencePoseSampler sampler(seq, bones);
+  BOOST_CHECK_EQUAL(sampler.GetNumChannels(), 2u);
+  BOOST_CHECK_EQUAL(sampler.GetPriority(), 5);
+
+  PoseBuffer out;
+  // on the first key
+  sampler.Sample(0.0f, out);
+  BOOST_REQUIRE_EQUAL(out.GetNumBones(), 3u);
+  BOOST_CHECK_SMALL(out.GetTranslation(1).x, 1e-5f);
+  BOOST_CHECK_CLOSE(out.GetScale(1), 1.0f, 0.01);
+  // between the keys, with the rotation slerped
+  sampler.Sample(0.5f, out);
+  BOOST_CHECK_EQUAL(out.GetWeight(0), 0.0f);
+  BOOST_CHECK_EQUAL(out.GetWeight(1), 1.0f);
+  BOOST_CHECK_CLOSE(out.GetTranslation(1).x, 1.0f, 0.01);
+  BOOST_CHECK_CLOSE(out.GetScale(1), 2.0f, 0.01);
+  Quaternion q = out.GetRotation(1);
+  BOOST_CHECK_CLOSE(2.0f * atan2(q.z, q.w), 0.5f, 0.01);
+  // a channel without keys falls back to the interpolator pose
+  BOOST_CHECK_EQUAL(out.GetWeight(2), 1.0f);
+  BOOST_CHECK_CLOSE(out.GetTranslation(2).x, 7.0f, 0.01);
+  BOOST_CHECK_CLOSE(out.GetScale(2), 2.0f, 0.01);
+  q = out.GetRotation(2);
+  BOOST_CHECK_CLOSE(2.0f * atan2(q.z, q.w), 0.3f, 0.01);
+  // just before the last key
+  sampler.Sample(0.999f, out);
+  BOOST_CHECK_CLOSE(out.GetTranslation(1).x, 1.998f, 0.01);
+  // looping wraps around to the start
+  sampler.Sample(1.25f, out);
+  BOOST_CHECK_CLOSE(out.GetTranslation(1).x, 0.5f, 0.01);
+  sampler.Sample(-0.25f, out);
+  BOOST_CHECK_CLOSE(out.GetTranslation(1).x, 1.5f, 0.01);
+}
+
+BOOST_FIXTURE_TEST_CASE(sampler_cycle_test, SamplerFixture)
+{
+  PoseBuffer out;
+  // reverse plays back down from the end
+  seq->SetCycleType(CYCLE_REVERSE);
+  SequencePoseSampler reverse(seq, bones);
+  reverse.Sample(1.25f, out);
+  BOOST_CHECK_CLOSE(out.GetTranslation(1).x, 1.5f, 0.01);
+  reverse.Sample(2.25f, out);
+  BOOST_CHECK_CLOSE(out.GetTranslation(1).x, 0.5f, 0.01);
+  // clamp holds the end keys
+  seq->SetCycleType(CYCLE_CLAMP);
+  SequencePoseSampler clamp(seq, bones);
+  clamp.Sample(3.0f, out);
+  BOOST_CHECK_CLOSE(out.GetTranslation(1).x, 2.0f, 0.01);
+  BOOST_CHECK_CLOSE(out.GetScale(1), 3.0f, 0.01);
+  clamp.Sample(-1.0f, out);
+  BOOST_CHECK_SMALL(out.GetTranslation(1).x, 1e-5f);
+}
+
+BOOST_FIXTURE_TEST_CASE(sampler_xyz_test, SamplerFixture)
+{
+  // a fixed half radian around x, then a keyed turn around z
+  data->SetRotateType(XYZ_ROTATION_KEY);
+  vector< Key<float> > x, z;
+  x.push_back(key(0.0f, 0.5f));
+  z.push_back(key(0.0f, 0.0f));
+  z.push_back(key(1.0f, 1.0f));
+  data->SetXRotateType(LINEAR_KEY);
+  data->SetXRotateKeys(x);
+  data->SetZRotateType(LINEAR_KEY);
+  data->SetZRotateKeys(z);
+  SequencePoseSampler sampler(seq, bones);
+  PoseBuffer out;
+  sampler.Sample(0.5f, out);
+  Quaternion q = out.GetRotation(1);
+  // z * x for a quarter radian half angle around each axis
+  float c = cos(0.25f), s = sin(0.25f);
+  BOOST_CHECK_CLOSE(q.w, c * c, 0.01);
+  BOOST_CHECK_CLOSE(q.x, c * s, 0.01);
+  BOOST_CHECK_CLOSE(q.y, s * s, 0.01);
+  BOOST_CHECK_CLOSE(q.z, s * c, 0.01);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,201 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "nifqhull.h"
+#include <set>
+#include <stdexcept>
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(qhull_test_suite)
+
+// checks that every point lies behind every hull triangle and that the hull is
+// closed, with each edge used once in each direction
+static void check_hull(const vector<Vector3> & verts, const vector<Triangle> & tris) {
+  BOOST_REQUIRE(!tris.empty());
+  multiset< pair<unsigned short, unsigned short> > edges;
+  for (size_t i = 0; i < tris.size(); ++i) {
+    const Triangle & t = tris[i];
+    Vector3 n = (verts[t.v2] - verts[t.v1]) ^ (verts[t.v3] - verts[t.v1]);
+    BOOST_CHECK(n.Magnitude() > 0.0f);
+    n = n.Normalized();
+    for (size_t j = 0; j < verts.size(); ++j)
+      BOOST_CHECK((verts[j] - verts[t.v1]) * n < 1e-4f);
+    edges.insert(make_pair(t.v1, t.v2));
+    edges.insert(make_pair(t.v2, t.v3));
+    edges.insert(make_pair(t.v3, t.v1));
+  }
+  for (multiset< pair<unsigned short, unsigned short> >::const_iterator it = edges.begin(); it != edges.end(); ++it) {
+    BOOST_CHECK_EQUAL(edges.count(*it), 1u);
+    BOOST_CHECK_EQUAL(edges.count(make_pair(it->second, it->first)), 1u);
+  }
+}
+
+static set<unsigned short> hull_vertices(const vector<Triangle> & tris) {
+  set<unsigned short> result;
+  for (size_t i = 0; i < tris.size(); ++i) {
+    result.insert(tris[i].v1);
+    result.insert(tris[i].v2);
+    result.insert(tris[i].v3);
+  }
+  return result;
+}
+
+// a unit cube with a grid of points inside and on its faces
+static vector<Vector3> cube_points() {
+  vector<Vector3> verts;
+  for (int x = 0; x <= 4; ++x)
+    for (int y = 0; y <= 4; ++y)
+      for (int z = 0; z <= 4; ++z)
+        verts.push_back(Vector3(x * 0.25f, y * 0.25f, z * 0.25f));
+  return verts;
+}
+
+// points on a sphere, all of which are on the hull
+static vector<Vector3> sphere_points(int rings, int segments, float radius) {
+  vector<Vector3> verts;
+  verts.push_back(Vector3(0.0f, 0.0f, radius));
+  verts.push_back(Vector3(0.0f, 0.0f, -radius));
+  for (int r = 1; r < rings; ++r) {
+    float theta = 3.14159265f * r / rings;
+    for (int s = 0; s < segments; ++s) {
+      float phi = 2.0f * 3.14159265f * s / segments;
+      verts.push_back(Vector3(radius * sin(theta) * cos(phi), radius * sin(theta) * sin(phi), radius * cos(theta)));
+    }
+  }
+  return verts;
+}
+
+BOOST_AUTO_TEST_CASE(tetrahedron_test) {
+  vector<Vector3> verts;
+  verts.push_back(Vector3(0.0f, 0.0f, 0.0f));
+  verts.push_back(Vector3(1.0f, 0.0f, 0.0f));
+  verts.push_back(Vector3(0.0f, 1.0f, 0.0f));
+  verts.push_back(Vector3(0.0f, 0.0f, 1.0f));
+  verts.push_back(Vector3(0.1f, 0.1f, 0.1f));
+  vector<Triangle> tris = NifQHull::compute_convex_hull(verts);
+  BOOST_CHECK_EQUAL(tris.size(), 4u);
+  BOOST_CHECK_EQUAL(hull_vertices(tris).count(4), 0u);
+  check_hull(verts, tris);
+}
+
+BOOST_AUTO_TEST_CASE(cube_test) {
+  vector<Vector3> verts = cube_points();
+  vector<Triangle> tris = NifQHull::compute_convex_hull(verts);
+  check_hull(verts, tris);
+  // only the corners are hull vertices, points on the faces are skipped
+  set<unsigned short> used = hull_vertices(tris);
+  BOOST_CHECK_EQUAL(used.size(), 8u);
+  for (set<unsigned short>::const_iterator it = used.begin(); it != used.end(); ++it) {
+    const Vector3 & v = verts[*it];
+    BOOST_CHECK(v.x == 0.0f || v.x == 1.0f);
+    BOOST_CHECK(v.y == 0.0f || v.y == 1.0f);
+    BOOST_CHECK(v.z == 0.0f || v.z == 1.0f);
+  }
+  BOOST_CHECK_EQUAL(tris.size(), 12u);
+}
+
+BOOST_AUTO_TEST_CASE(degenerate_test) {
+  vector<Vector3> verts;
+  BOOST_CHECK(NifQHull::compute_convex_hull(verts).empty());
+  // all on one plane
+  for (int i = 0; i < 10; ++i)
+    verts.push_back(Vector3(float(i % 3), float(i / 3), 2.0f));
+  BOOST_CHECK(NifQHull::compute_convex_hull(verts).empty());
+  verts.assign(0x10001, Vector3());
+  BOOST_CHECK_THROW(NifQHull::compute_convex_hull(verts), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(simplify_test) {
+  vector<Vector3> verts = sphere_points(12, 24, 2.0f);
+  vector<Triangle> full = NifQHull::compute_convex_hull(verts);
+  check_hull(verts, full);
+  BOOST_CHECK_EQUAL(hull_vertices(full).size(), verts.size());
+
+  vector<Triangle> tris = NifQHull::compute_convex_hull(verts, 20);
+  BOOST_CHECK_EQUAL(hull_vertices(tris).size(), 20u);
+  // a closed, outward facing hull of its own vertices
+  vector<Vector3> used;
+  set<unsigned short> ids = hull_vertices(tris);
+  for (set<unsigned short>::const_iterator it = ids.begin(); it != ids.end(); ++it)
+    used.push_back(verts[*it]);
+  for (size_t i = 0; i < tris.size(); ++i) {
+    const Triangle & t = tris[i];
+    Vector3 n = ((verts[t.v2] - verts[t.v1]) ^ (verts[t.v3] - verts[t.v1])).Normalized();
+    for (size_t j = 0; j < used.size(); ++j)
+      BOOST_CHECK((used[j] - verts[t.v1]) * n < 1e-4f);
+    // the simplified hull still reaches most of the way out
+    BOOST_CHECK(verts[t.v1] * n > 1.0f);
+  }
+
+  // limits below four still give a tetrahedron
+  BOOST_CHECK_EQUAL(NifQHull::compute_convex_hull(verts, 1).size(), 4u);
+}
+
+BOOST_AUTO_TEST_CASE(farthest_first_test) {
+  unsigned int seed = 12345;
+  for (int cloud = 0; cloud < 20; ++cloud) {
+    vector<Vector3> verts;
+    for (int i = 0; i < 200; ++i) {
+      float c[3];
+      for (int k = 0; k < 3; ++k) {
+        seed = seed * 1664525u + 1013904223u;
+        c[k] = float(seed >> 8) / float(1 << 24) - 0.5f;
+      }
+      verts.push_back(Vector3(c[0], c[1], c[2]));
+    }
+
+    // the point farthest outside the starting tetrahedron
+    vector<Triangle> tet = NifQHull::compute_convex_hull(verts, 4);
+    BOOST_REQUIRE_EQUAL(tet.size(), 4u);
+    size_t farthest = 0;
+    float best = 0.0f;
+    for (size_t j = 0; j < verts.size(); ++j) {
+      for (size_t i = 0; i < tet.size(); ++i) {
+        const Triangle & t = tet[i];
+        Vector3 n = ((verts[t.v2] - verts[t.v1]) ^ (verts[t.v3] - verts[t.v1])).Normalized();
+        float d = (verts[j] - verts[t.v1]) * n;
+        if (d > best) {
+          best = d;
+          farthest = j;
+        }
+      }
+    }
+
+    // is the one added next
+    set<unsigned short> ids = hull_vertices(NifQHull::compute_convex_hull(verts, 5));
+    BOOST_CHECK_EQUAL(ids.size(), 5u);
+    BOOST_CHECK(ids.count((unsigned short)farthest) == 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(batch_test) {
+  vector< vector<Vector3> > sets;
+  for (int i = 0; i < 20; ++i) {
+    if (i % 2 == 0) {
+      sets.push_back(cube_points());
+    } else {
+      sets.push_back(sphere_points(4 + i, 8 + i, 1.0f + i));
+    }
+  }
+  vector< vector<Triangle> > hulls;
+  NifQHull::compute_convex_hulls(sets, hulls, 0, 4);
+  BOOST_REQUIRE_EQUAL(hulls.size(), sets.size());
+  for (size_t i = 0; i < sets.size(); ++i) {
+    vector<Triangle> single = NifQHull::compute_convex_hull(sets[i]);
+    BOOST_REQUIRE_EQUAL(hulls[i].size(), single.size());
+    for (size_t j = 0; j < single.size(); ++j) {
+      BOOST_CHECK_EQUAL(hulls[i][j].v1, single[j].v1);
+      BOOST_CHECK_EQUAL(hulls[i][j].v2, single[j].v2);
+      BOOST_CHECK_EQUAL(hulls[i][j].v3, single[j].v3);
+    }
+  }
+
+  NifQHull::compute_convex_hulls(sets, hulls, 10, 3);
+  for (size_t i = 0; i < sets.size(); ++i)
+    BOOST_CHECK(hull_vertices(hulls[i]).size() <= 10u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "niflib.h"
+#include "obj/NiNode.h"
+#include "obj/NiTransformController.h"
+#include "obj/NiTransformInterpolator.h"
+#include "obj/NiTransformData.h"
+#include "obj/NiBSplineCompTransformInterpolator.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(retime_test_suite)
+
+struct RetimeFixture {
+  NiNodeRef root;
+  NiTransformControllerRef ctlr1, ctlr2;
+  NiTransformDataRef data;
+
+  // two nodes animated by controllers which share the same key data
+  RetimeFixture() {
+    root = new NiNode;
+    data = new NiTransformData;
+    vector< Key<Vector3> > keys(3);
+    for (int i = 0; i < 3; ++i) {
+      keys[i].time = float(i);
+      keys[i].data = Vector3(float(i), 0, 0);
+    }
+    data->SetTranslateKeys(keys);
+    NiTransformInterpolatorRef interp = new NiTransformInterpolator;
+    interp->SetData(data);
+
+    ctlr1 = new NiTransformController;
+    ctlr2 = new NiTransformController;
+    NiTransformControllerRef ctlrs[2] = { ctlr1, ctlr2 };
+    for (int i = 0; i < 2; ++i) {
+      NiNodeRef node = new NiNode;
+      root->AddChild(StaticCast<NiAVObject>(node));
+      ctlrs[i]->SetInterpolator(interp);
+      ctlrs[i]->SetStartTime(0.0f);
+      ctlrs[i]->SetStopTime(2.0f);
+      ctlrs[i]->SetPhase(1.0f);
+      ctlrs[i]->SetFrequency(2.0f);
+      node->AddController(StaticCast<NiTimeController>(ctlrs[i]));
+    }
+  }
+};
+
+BOOST_FIXTURE_TEST_CASE(retime_scale_test, RetimeFixture)
+{
+  RetimeResult result = RetimeNifTree(root, 2.0f, 1.0f, 2);
+  BOOST_CHECK_EQUAL(result.controllers, 2u);
+  // the shared data is only retimed once
+  BOOST_CHECK_EQUAL(result.dataBlocks, 1u);
+  vector< Key<Vector3> > keys = data->GetTranslateKeys();
+  BOOST_CHECK_CLOSE(keys[0].time, 1.0f, 0.01);
+  BOOST_CHECK_CLOSE(keys[2].time, 5.0f, 0.01);
+  BOOST_CHECK_CLOSE(ctlr1->GetStopTime(), 5.0f, 0.01);
+  BOOST_CHECK_CLOSE(ctlr2->GetStopTime(), 5.0f, 0.01);
+}
+
+BOOST_FIXTURE_TEST_CASE(retime_normalize_test, RetimeFixture)
+{
+  RetimeResult result = NormalizeNifTreeKeys(root);
+  BOOST_CHECK_EQUAL(result.controllers, 2u);
+  BOOST_CHECK_EQUAL(result.dataBlocks, 1u);
+  BOOST_CHECK_EQUAL(result.skippedControllers, 0u);
+  vector< Key<Vector3> > keys = data->GetTranslateKeys();
+  // (t - phase) / frequency, applied once
+  BOOST_CHECK_CLOSE(keys[0].time, -0.5f, 0.01);
+  BOOST_CHECK_CLOSE(keys[2].time, 0.5f, 0.01);
+  BOOST_CHECK_EQUAL(ctlr1->GetPhase(), 0.0f);
+  BOOST_CHECK_EQUAL(ctlr1->GetFrequency(), 1.0f);
+  BOOST_CHECK_CLOSE(ctlr2->GetStopTime(), 0.5f, 0.01);
+}
+
+BOOST_FIXTURE_TEST_CASE(retime_normalize_conflict_test, RetimeFixture)
+{
+  // the controllers disagree about the time line of their shared data
+  ctlr2->SetPhase(0.0f);
+  RetimeResult result = NormalizeNifTreeKeys(root);
+  BOOST_CHECK_EQUAL(result.skippedControllers, 2u);
+  BOOST_CHECK_EQUAL(result.dataBlocks, 0u);
+  BOOST_CHECK_EQUAL(data->GetTranslateKeys()[2].time, 2.0f);
+  BOOST_CHECK_EQUAL(ctlr1->GetPhase(), 1.0f);
+}
+
+BOOST_AUTO_TEST_CASE(retime_bspline_test)
+{
+  // compressed B-spline animation is timed by its interpolator
+  NiNodeRef root = new NiNode;
+  NiBSplineCompTransformInterpolatorRef interp = new NiBSplineCompTransformInterpolator;
+  interp->SetStartTime(0.0f);
+  interp->SetStopTime(2.0f);
+  NiTransformControllerRef ctlr = new NiTransformController;
+  ctlr->SetInterpolator(interp);
+  ctlr->SetStartTime(0.0f);
+  ctlr->SetStopTime(2.0f);
+  root->AddController(StaticCast<NiTimeController>(ctlr));
+
+  RetimeResult result = RetimeNifTree(root, 2.0f, 1.0f);
+  BOOST_CHECK_EQUAL(result.dataBlocks, 1u);
+  BOOST_CHECK_CLOSE(interp->GetStartTime(), 1.0f, 0.01);
+  BOOST_CHECK_CLOSE(interp->GetStopTime(), 5.0f, 0.01);
+  BOOST_CHECK_CLOSE(ctlr->GetStopTime(), 5.0f, 0.01);
+
+  // normalizing moves it along with its controller
+  ctlr->SetPhase(1.0f);
+  ctlr->SetFrequency(2.0f);
+  result = NormalizeNifTreeKeys(root);
+  BOOST_CHECK_EQUAL(result.dataBlocks, 1u);
+  BOOST_CHECK_SMALL(interp->GetStartTime(), 1e-5f);
+  BOOST_CHECK_CLOSE(interp->GetStopTime(), 2.0f, 0.01);
+  BOOST_CHECK_CLOSE(ctlr->GetStopTime(), 2.0f, 0.01);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
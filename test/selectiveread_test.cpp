@@ -0,0 +1,117 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <sstream> // stringstream
+#include <stdexcept>
+
+#include "niflib.h"
+#include "obj/NiNode.h"
+#include "obj/NiTriShape.h"
+#include "obj/NiTriShapeData.h"
+#include "obj/BSXFlags.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(selectiveread_test_suite)
+
+// a root with BSX flags, a child node, and a shape under the child
+static void write_scene(ostream & out, const NifInfo & info) {
+  NiNodeRef root = new NiNode;
+  root->SetName("Scene Root");
+  BSXFlagsRef flags = new BSXFlags;
+  flags->SetData(0x83);
+  root->AddExtraData(StaticCast<NiExtraData>(flags), info.version);
+  NiNodeRef child = new NiNode;
+  child->SetName("Child");
+  child->SetLocalTranslation(Vector3(1.0f, 2.0f, 3.0f));
+  root->AddChild(StaticCast<NiAVObject>(child));
+  NiTriShapeRef shape = new NiTriShape;
+  NiTriShapeDataRef data = new NiTriShapeData;
+  data->SetVertices(vector<Vector3>(3, Vector3(1.0f, 1.0f, 1.0f)));
+  shape->SetData(data);
+  child->AddChild(StaticCast<NiAVObject>(shape));
+  WriteNifTree(out, root, info);
+}
+
+static bool only_nodes(const Type & type) {
+  return type.IsDerivedType(NiNode::TYPE);
+}
+
+BOOST_AUTO_TEST_CASE(nodes_test)
+{
+  stringstream ss;
+  write_scene(ss, NifInfo(VER_20_2_0_7, 12, 83));
+  vector<NiObjectRef> all = ReadNifList(ss);
+  ss.clear();
+  ss.seekg(0);
+  vector<NiObjectRef> objects = ReadNifList(ss, only_nodes);
+  BOOST_REQUIRE_EQUAL(objects.size(), all.size());
+
+  // nodes are read and the rest are placeholders of the right type
+  unsigned int placeholders = 0;
+  for (size_t i = 0; i < objects.size(); ++i) {
+    BOOST_CHECK(objects[i]->GetType().IsSameType(all[i]->GetType()));
+    BOOST_CHECK_EQUAL(objects[i]->IsPlaceholder(), !objects[i]->IsDerivedType(NiNode::TYPE));
+    if (objects[i]->IsPlaceholder())
+      ++placeholders;
+  }
+  BOOST_CHECK_EQUAL(placeholders, 3u);
+
+  // the nodes can be navigated down to the placeholder shape
+  NiNodeRef root = DynamicCast<NiNode>(objects[0]);
+  BOOST_REQUIRE(root != NULL);
+  BOOST_CHECK_EQUAL(root->GetName(), "Scene Root");
+  BOOST_REQUIRE_EQUAL(root->GetChildren().size(), 1u);
+  NiNodeRef child = DynamicCast<NiNode>(root->GetChildren()[0]);
+  BOOST_REQUIRE(child != NULL);
+  BOOST_CHECK_EQUAL(child->GetLocalTranslation().z, 3.0f);
+  BOOST_REQUIRE_EQUAL(child->GetChildren().size(), 1u);
+  NiAVObjectRef shape = child->GetChildren()[0];
+  BOOST_CHECK(shape->IsSameType(NiTriShape::TYPE));
+  BOOST_CHECK(shape->IsPlaceholder());
+  BOOST_CHECK(root->GetExtraData().front()->IsPlaceholder());
+
+  // placeholders cannot be written
+  stringstream out;
+  BOOST_CHECK_THROW(WriteNifTree(out, root, NifInfo(VER_20_2_0_7, 12, 83)), runtime_error);
+  // nor cloned into ordinary objects that could
+  BOOST_CHECK_THROW(shape->Clone(), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(flags_test)
+{
+  stringstream ss;
+  write_scene(ss, NifInfo(VER_20_2_0_7, 12, 83));
+  NifInfo info;
+  vector<NiObjectRef> objects = ReadNifList(ss, [](const Type & type) {
+    return type.IsSameType(BSXFlags::TYPE);
+  }, &info);
+  BOOST_CHECK_EQUAL(info.version, VER_20_2_0_7);
+  unsigned int read = 0;
+  for (size_t i = 0; i < objects.size(); ++i) {
+    if (!objects[i]->IsPlaceholder()) {
+      BSXFlagsRef flags = DynamicCast<BSXFlags>(objects[i]);
+      BOOST_REQUIRE(flags != NULL);
+      BOOST_CHECK_EQUAL(flags->GetData(), 0x83u);
+      ++read;
+    }
+  }
+  BOOST_CHECK_EQUAL(read, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(old_version_test)
+{
+  // without block sizes every block is read
+  stringstream ss;
+  write_scene(ss, NifInfo(VER_20_0_0_5, 11));
+  vector<NiObjectRef> objects = ReadNifList(ss, only_nodes);
+  BOOST_REQUIRE_EQUAL(objects.size(), 5u);
+  for (size_t i = 0; i < objects.size(); ++i)
+    BOOST_CHECK(!objects[i]->IsPlaceholder());
+  stringstream out;
+  BOOST_CHECK_NO_THROW(WriteNifTree(out, objects[0], NifInfo(VER_20_0_0_5, 11)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
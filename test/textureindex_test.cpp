@@ -0,0 +1,163 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <sstream> // stringstream
+#include <fstream>
+#include <cstdio>  // remove
+#include <algorithm>
+#include <stdexcept>
+#ifdef _WIN32
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+#include "niflib.h"
+#include "TextureIndex.h"
+#include "obj/NiNode.h"
+#include "obj/NiTriShape.h"
+#include "obj/NiTexturingProperty.h"
+#include "obj/NiSourceTexture.h"
+#include "obj/NiPixelData.h"
+#include "obj/BSShaderTextureSet.h"
+#include "obj/BSLightingShaderProperty.h"
+#include "obj/BSEffectShaderProperty.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(textureindex_test_suite)
+
+// a node with three shapes: one with an external and an internal texture,
+// one with a Skyrim texture set and one with an effect shader
+static NiNodeRef make_scene(const string & base) {
+  NiNodeRef root = new NiNode;
+
+  NiSourceTextureRef external = new NiSourceTexture;
+  external->SetExternalTexture("textures\\" + base + ".dds");
+  NiSourceTextureRef internal = new NiSourceTexture;
+  internal->SetInternalTexture("textures\\embedded.tga", new NiPixelData);
+  TexDesc desc;
+  desc.source = external;
+  NiTexturingPropertyRef texing = new NiTexturingProperty;
+  texing->SetTexture(BASE_MAP, desc);
+  desc.source = internal;
+  texing->SetTexture(DETAIL_MAP, desc);
+  NiTriShapeRef shape = new NiTriShape;
+  shape->AddProperty(texing);
+  root->AddChild(StaticCast<NiAVObject>(shape));
+
+  BSShaderTextureSetRef textures = new BSShaderTextureSet;
+  vector<string> paths(9);
+  paths[0] = "Textures\\" + base + ".dds";
+  paths[1] = "textures\\" + base + "_n.dds";
+  textures->SetTextures(paths);
+  BSLightingShaderPropertyRef shader = new BSLightingShaderProperty;
+  shader->SetTextureSet(textures);
+  shape = new NiTriShape;
+  shape->SetBSProperty(0, StaticCast<NiProperty>(shader));
+  root->AddChild(StaticCast<NiAVObject>(shape));
+
+  BSEffectShaderPropertyRef effect = new BSEffectShaderProperty;
+  effect->SetSourceTexture("textures\\glow.dds");
+  effect->SetGreyscaleTexture("textures\\palette.dds");
+  shape = new NiTriShape;
+  shape->SetBSProperty(0, StaticCast<NiProperty>(effect));
+  root->AddChild(StaticCast<NiAVObject>(shape));
+  return root;
+}
+
+BOOST_AUTO_TEST_CASE(read_test)
+{
+  // only the texture blocks are read when the header has the block sizes
+  stringstream ss;
+  WriteNifTree(ss, make_scene("rock"), NifInfo(VER_20_2_0_7, 12, 83));
+  unsigned int blocks_read = 0;
+  vector<string> textures = ReadTextureReferences(ss, &blocks_read);
+  BOOST_CHECK_EQUAL(blocks_read, 4u);
+  // rock.dds is listed once, in whichever case was found first
+  BOOST_REQUIRE_EQUAL(textures.size(), 4u);
+  for (size_t i = 0; i < textures.size(); ++i)
+    textures[i][0] = 't';
+  vector<string> expected;
+  expected.push_back("textures\\rock.dds");
+  expected.push_back("textures\\rock_n.dds");
+  expected.push_back("textures\\glow.dds");
+  expected.push_back("textures\\palette.dds");
+  for (size_t i = 0; i < expected.size(); ++i)
+    BOOST_CHECK(find(textures.begin(), textures.end(), expected[i]) != textures.end());
+
+  // older files are read in full
+  stringstream old;
+  NiNodeRef root = new NiNode;
+  NiSourceTextureRef source = new NiSourceTexture;
+  source->SetExternalTexture("textures\\old.dds");
+  TexDesc desc;
+  desc.source = source;
+  NiTexturingPropertyRef texing = new NiTexturingProperty;
+  texing->SetTexture(BASE_MAP, desc);
+  root->AddProperty(texing);
+  WriteNifTree(old, root, NifInfo(VER_20_0_0_5, 11));
+  textures = ReadTextureReferences(old, &blocks_read);
+  BOOST_CHECK_EQUAL(blocks_read, 3u);
+  BOOST_REQUIRE_EQUAL(textures.size(), 1u);
+  BOOST_CHECK_EQUAL(textures[0], "textures\\old.dds");
+
+  stringstream junk("not a nif file at all");
+  BOOST_CHECK_THROW(ReadTextureReferences(junk), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(scan_test)
+{
+  make_dir("textureindex_dir");
+  make_dir("textureindex_dir/sub");
+  vector<string> written;
+  written.push_back("textureindex_dir/a.nif");
+  written.push_back("textureindex_dir/sub/b.NIF");
+  written.push_back("textureindex_dir/sub/c.nif");
+  WriteNifTree(written[0], make_scene("rock"), NifInfo(VER_20_2_0_7, 12, 83));
+  WriteNifTree(written[1], make_scene("moss"), NifInfo(VER_20_2_0_7, 12, 83));
+  {
+    ofstream bad(written[2].c_str(), ofstream::binary);
+    bad << "Gamebryo File Format, Version 20.2.0.7\n";
+  }
+  written.push_back("textureindex_dir/sub/notes.txt");
+  {
+    ofstream notes(written[3].c_str());
+    notes << "not a nif\n";
+  }
+
+  vector<string> files = FindNifFiles("textureindex_dir");
+  BOOST_REQUIRE_EQUAL(files.size(), 3u);
+  BOOST_CHECK_EQUAL(files[0], written[0]);
+
+  vector<TextureReferences> results;
+  BOOST_CHECK_EQUAL(ScanTextureReferences(files, results, 2), 1u);
+  BOOST_REQUIRE_EQUAL(results.size(), 3u);
+  BOOST_CHECK_EQUAL(results[0].textures.size(), 4u);
+  BOOST_CHECK_EQUAL(results[0].blocksRead, 4u);
+  BOOST_CHECK_GT(results[0].blocksTotal, results[0].blocksRead);
+  BOOST_CHECK(find(results[1].textures.begin(), results[1].textures.end(), "textures\\moss_n.dds") != results[1].textures.end());
+  BOOST_CHECK(!results[2].error.empty());
+
+  stringstream index;
+  WriteTextureIndex(index, results);
+  string line;
+  unsigned int lines = 0;
+  while (getline(index, line)) {
+    BOOST_CHECK_EQUAL(line.find(written[2]), string::npos);
+    ++lines;
+  }
+  BOOST_CHECK_EQUAL(lines, 8u);
+  BOOST_CHECK_EQUAL(index.str().substr(0, written[0].size() + 1), written[0] + "\t");
+
+  for (size_t i = 0; i < written.size(); ++i)
+    remove(written[i].c_str());
+  remove("textureindex_dir/sub");
+  remove("textureindex_dir");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
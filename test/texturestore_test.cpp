@@ -0,0 +1,198 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <sstream> // stringstream
+#include <cstdio>  // remove
+#include <stdexcept>
+
+#include "niflib.h"
+#include "TextureStore.h"
+#include "MatTexCollection.h"
+#include "obj/NiNode.h"
+#include "obj/NiTriShape.h"
+#include "obj/NiTriShapeData.h"
+#include "obj/NiTexturingProperty.h"
+#include "obj/NiSourceTexture.h"
+#include "obj/NiPixelData.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(texturestore_test_suite)
+
+static NiPixelDataRef make_pixels(PixelFormat format, unsigned int width, unsigned int height, byte seed, unsigned int faces = 1) {
+  vector<byte> rgba(width * height * 4 * faces);
+  for (size_t i = 0; i < rgba.size(); ++i)
+    rgba[i] = byte(seed + i * 5);
+  NiPixelDataRef data = new NiPixelData;
+  data->Reset(width, height, format, faces);
+  data->SetPixels(rgba, true);
+  return data;
+}
+
+static NiPixelDataRef round_trip(NiPixelData * data) {
+  stringstream ss;
+  WriteDds(ss, data);
+  ss.seekg(0);
+  return ReadDds(ss);
+}
+
+// a node with two shapes, each textured with its own NiSourceTexture;
+// shapes are put at the front of the children, so add the last one first
+static NiNodeRef make_scene(NiPixelData * first, NiPixelData * second) {
+  NiNodeRef root = new NiNode;
+  NiPixelData * pixels[2] = { first, second };
+  for (int i = 1; i >= 0; --i) {
+    NiSourceTextureRef source = new NiSourceTexture;
+    source->SetInternalTexture(i == 0 ? "textures\\rock.tga" : "textures\\moss.tga", pixels[i]);
+    TexDesc desc;
+    desc.source = source;
+    NiTexturingPropertyRef texing = new NiTexturingProperty;
+    texing->SetTexture(BASE_MAP, desc);
+    NiTriShapeRef shape = new NiTriShape;
+    shape->SetData(new NiTriShapeData);
+    shape->AddProperty(texing);
+    root->AddChild(StaticCast<NiAVObject>(shape));
+  }
+  return root;
+}
+
+static NiSourceTextureRef source_of(NiNode * root, int child) {
+  NiAVObjectRef shape = root->GetChildren()[child];
+  NiTexturingPropertyRef texing = DynamicCast<NiTexturingProperty>(shape->GetPropertyByType(NiTexturingProperty::TYPE));
+  return texing->GetTexture(BASE_MAP).source;
+}
+
+BOOST_AUTO_TEST_CASE(dds_test)
+{
+  // formats DDS can hold are copied exactly, with every mipmap and face
+  NiPixelDataRef data = make_pixels(PX_FMT_RGBA8, 12, 5, 3);
+  NiPixelDataRef read = round_trip(data);
+  BOOST_CHECK_EQUAL(read->GetPixelFormat(), PX_FMT_RGBA8);
+  BOOST_CHECK_EQUAL(read->GetWidth(), 12);
+  BOOST_CHECK_EQUAL(read->GetMipmapCount(), 4u);
+  BOOST_CHECK(read->GetRawPixels() == data->GetRawPixels());
+
+  data = make_pixels(PX_FMT_DXT5, 8, 8, 40, 6);
+  read = round_trip(data);
+  BOOST_CHECK_EQUAL(read->GetPixelFormat(), PX_FMT_DXT5);
+  BOOST_REQUIRE_EQUAL(read->GetFaceCount(), 6u);
+  BOOST_CHECK(read->GetRawPixels(5) == data->GetRawPixels(5));
+
+  data = make_pixels(PX_FMT_RGB8, 3, 3, 9);
+  data->SetRawPixels(vector< vector<byte> >(1, data->GetRawPixels()), 2);
+  read = round_trip(data);
+  BOOST_CHECK_EQUAL(read->GetMipmapCount(), 2u);
+  BOOST_CHECK(read->GetRawPixels() == data->GetRawPixels());
+
+  // bump maps are decoded on the way out
+  data = make_pixels(PX_FMT_BUMPLUMA, 4, 4, 1);
+  read = round_trip(data);
+  BOOST_CHECK_EQUAL(read->GetPixelFormat(), PX_FMT_RGBA8);
+  BOOST_CHECK(read->GetPixels(2) == data->GetPixels(2));
+
+  stringstream junk("not a dds file at all, not even close to one");
+  BOOST_CHECK_THROW(ReadDds(junk), runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(library_test)
+{
+  TextureLibrary library("", "textures\\");
+  NiPixelDataRef rock = make_pixels(PX_FMT_DXT1, 16, 16, 7);
+  NiPixelDataRef copy = round_trip(rock);
+  string name = library.AddTexture(rock, "textures\\Rock Face.tga");
+  BOOST_CHECK_EQUAL(name.substr(0, 19), "textures\\Rock_Face_");
+  BOOST_CHECK_EQUAL(name.substr(name.size() - 4), ".dds");
+
+  // the same contents are only written once
+  BOOST_CHECK_EQUAL(library.AddTexture(copy, "other.tga"), name);
+  vector<string> written = library.GetWrittenFiles();
+  BOOST_REQUIRE_EQUAL(written.size(), 1u);
+  BOOST_CHECK_EQUAL(written[0], name.substr(9));
+
+  NiPixelDataRef loaded = library.LoadTexture(name);
+  BOOST_CHECK(loaded->GetRawPixels() == rock->GetRawPixels());
+  BOOST_CHECK(library.LoadTexture("TEXTURES\\" + name.substr(9)) != loaded);
+  BOOST_CHECK_THROW(library.LoadTexture("textures\\missing.dds"), runtime_error);
+  remove(written[0].c_str());
+}
+
+BOOST_AUTO_TEST_CASE(collection_test)
+{
+  // two textures sharing one image are written once
+  NiPixelDataRef shared = make_pixels(PX_FMT_RGBA8, 8, 4, 11);
+  NiNodeRef root = make_scene(shared, shared);
+  TextureLibrary library("");
+  MatTexCollection collection(root);
+  BOOST_CHECK_EQUAL(collection.ExternalizeTextures(library), 2u);
+  BOOST_CHECK_EQUAL(collection.ExternalizeTextures(library), 0u);
+  NiSourceTextureRef first = source_of(root, 0);
+  NiSourceTextureRef second = source_of(root, 1);
+  BOOST_CHECK(first->IsTextureExternal());
+  BOOST_CHECK_EQUAL(first->GetTextureFileName(), second->GetTextureFileName());
+  BOOST_CHECK_EQUAL(library.GetWrittenFiles().size(), 1u);
+
+  // and packed back in as one image
+  BOOST_CHECK_EQUAL(collection.InternalizeTextures(library), 2u);
+  BOOST_CHECK(!first->IsTextureExternal());
+  BOOST_CHECK(first->GetPixelData() == second->GetPixelData());
+  BOOST_CHECK(first->GetPixelData()->GetRawPixels() == shared->GetRawPixels());
+  remove(library.GetWrittenFiles()[0].c_str());
+}
+
+BOOST_AUTO_TEST_CASE(batch_test)
+{
+  NiPixelDataRef rock = make_pixels(PX_FMT_DXT5, 8, 8, 1);
+  NiPixelDataRef moss = make_pixels(PX_FMT_RGB8, 4, 2, 2);
+  vector<string> in_files, out_files;
+  for (int i = 0; i < 3; ++i) {
+    stringstream name;
+    name << "texturestore_" << i << ".nif";
+    in_files.push_back(name.str());
+    WriteNifTree(in_files[i], make_scene(rock, i == 2 ? moss : rock), NifInfo(VER_20_0_0_5, 11));
+  }
+  in_files.push_back("texturestore_missing.nif");
+  remove(in_files[3].c_str());
+  out_files = in_files;
+
+  TextureLibrary library("", "textures\\");
+  vector<TextureStoreResult> results;
+  BOOST_CHECK_EQUAL(ConvertTextureStorage(in_files, out_files, library, true, results, 2), 1u);
+  BOOST_REQUIRE_EQUAL(results.size(), 4u);
+  BOOST_CHECK_EQUAL(results[0].textures, 2u);
+  BOOST_CHECK_EQUAL(results[2].textures, 2u);
+  BOOST_CHECK(results[1].error.empty());
+  BOOST_CHECK(!results[3].error.empty());
+  vector<string> written = library.GetWrittenFiles();
+  BOOST_CHECK_EQUAL(written.size(), 2u);
+
+  NiNodeRef external = DynamicCast<NiNode>(ReadNifTree(in_files[2]));
+  BOOST_REQUIRE(external != NULL);
+  BOOST_CHECK(source_of(external, 1)->IsTextureExternal());
+  NiNodeRef other = DynamicCast<NiNode>(ReadNifTree(in_files[0]));
+  BOOST_REQUIRE(other != NULL);
+  BOOST_CHECK_EQUAL(source_of(external, 0)->GetTextureFileName(), source_of(other, 1)->GetTextureFileName());
+  BOOST_CHECK(source_of(external, 0)->GetTextureFileName() != source_of(external, 1)->GetTextureFileName());
+
+  // packing them back in gives the original pixels
+  vector<string> packed;
+  for (int i = 0; i < 3; ++i)
+    packed.push_back("texturestore_packed_" + in_files[i]);
+  in_files.pop_back();
+  BOOST_CHECK_EQUAL(ConvertTextureStorage(in_files, packed, library, false, results, 2), 0u);
+  BOOST_CHECK_EQUAL(results[2].textures, 2u);
+  NiNodeRef internal = DynamicCast<NiNode>(ReadNifTree(packed[2]));
+  BOOST_REQUIRE(internal != NULL);
+  BOOST_CHECK(source_of(internal, 0)->GetPixelData()->GetRawPixels() == rock->GetRawPixels());
+  BOOST_CHECK(source_of(internal, 1)->GetPixelData()->GetRawPixels() == moss->GetRawPixels());
+
+  for (size_t i = 0; i < written.size(); ++i)
+    remove(written[i].c_str());
+  for (int i = 0; i < 3; ++i) {
+    remove(in_files[i].c_str());
+    remove(packed[i].c_str());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
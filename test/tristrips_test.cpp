@@ -0,0 +1,117 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <sstream> // stringstream
+
+#include "niflib.h"
+#include "ComplexShape.h"
+#include "obj/NiNode.h"
+#include "obj/NiProperty.h"
+#include "obj/NiTriShape.h"
+#include "obj/NiTriShapeData.h"
+#include "obj/NiTriStripsData.h"
+
+using namespace Niflib;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(tristrips_test_suite)
+
+static bool same_triangles(const vector<Triangle> & a, const vector<Triangle> & b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i)
+    if (a[i].v1 != b[i].v1 || a[i].v2 != b[i].v2 || a[i].v3 != b[i].v3)
+      return false;
+  return true;
+}
+
+static vector<unsigned short> make_strip(const unsigned short * idx, size_t n) {
+  return vector<unsigned short>(idx, idx + n);
+}
+
+BOOST_AUTO_TEST_CASE(triangle_cache_test)
+{
+  // two triangles, then a repeated index stitching in a third
+  const unsigned short s0[] = { 0, 1, 2, 3, 3, 4, 5 };
+  NiTriStripsDataRef data = new NiTriStripsData;
+  data->SetStripCount(1);
+  data->SetStrip(0, make_strip(s0, 7));
+
+  const vector<Triangle> & tris = data->GetTriangleArray();
+  BOOST_REQUIRE_EQUAL(tris.size(), 3u);
+  BOOST_CHECK_EQUAL(tris[0].v1, 0);
+  BOOST_CHECK_EQUAL(tris[1].v1, 3);
+  BOOST_CHECK_EQUAL(tris[1].v3, 1);
+  BOOST_CHECK(&data->GetTriangleArray() == &tris);
+  BOOST_CHECK(same_triangles(data->GetTriangles(), tris));
+  BOOST_CHECK(&data->GetStripArray(0) == &data->GetStripArray(0));
+  BOOST_CHECK(data->GetStripArray(0) == make_strip(s0, 7));
+
+  // changing a strip rebuilds the list
+  const unsigned short s1[] = { 4, 5, 6 };
+  data->SetStrip(0, make_strip(s1, 3));
+  BOOST_REQUIRE_EQUAL(data->GetTriangleArray().size(), 1u);
+  BOOST_CHECK_EQUAL(data->GetTriangleArray()[0].v1, 4);
+  data->SetStripCount(2);
+  data->SetStrip(1, make_strip(s0, 4));
+  BOOST_CHECK_EQUAL(data->GetTriangleArray().size(), 3u);
+
+  // and so does replacing the triangles
+  vector<Triangle> in;
+  in.push_back(Triangle(0, 1, 2));
+  data->SetTriangles(in);
+  BOOST_REQUIRE_EQUAL(data->GetTriangleArray().size(), 1u);
+  BOOST_CHECK_EQUAL(data->GetTriangleArray()[0].v3, 2);
+
+  // a block read from a file starts without a cached list
+  data->SetStrip(0, make_strip(s0, 7));
+  data->SetVertices(vector<Vector3>(6));
+  stringstream ss;
+  WriteNifTree(ss, data, NifInfo(VER_20_0_0_5));
+  NiTriStripsDataRef read = DynamicCast<NiTriStripsData>(ReadNifTree(ss));
+  BOOST_REQUIRE(read != NULL);
+  BOOST_CHECK(same_triangles(read->GetTriangleArray(), data->GetTriangleArray()));
+}
+
+BOOST_AUTO_TEST_CASE(geometry_array_test)
+{
+  NiTriShapeDataRef data = new NiTriShapeData;
+  vector<Vector3> verts;
+  verts.push_back(Vector3(0, 0, 0));
+  verts.push_back(Vector3(1, 0, 0));
+  verts.push_back(Vector3(0, 1, 0));
+  verts.push_back(Vector3(1, 1, 0));
+  data->SetVertices(verts);
+  data->SetNormals(vector<Vector3>(4, Vector3(0, 0, 1)));
+  data->SetVertexColors(vector<Color4>(4, Color4(1, 0, 0, 1)));
+  data->SetUVSetCount(1);
+  data->SetUVSet(0, vector<TexCoord>(4, TexCoord(0.5f, 0.5f)));
+  vector<Triangle> tris;
+  tris.push_back(Triangle(0, 1, 2));
+  tris.push_back(Triangle(1, 1, 2));
+  tris.push_back(Triangle(1, 3, 2));
+  data->SetTriangles(tris);
+
+  BOOST_CHECK(data->GetVertexArray() == data->GetVertices());
+  BOOST_CHECK(&data->GetVertexArray() == &data->GetVertexArray());
+  BOOST_CHECK(data->GetNormalArray() == data->GetNormals());
+  BOOST_CHECK_EQUAL(data->GetColorArray().size(), 4u);
+  BOOST_CHECK_EQUAL(data->GetUVSetArray(0)[3].u, 0.5f);
+
+  // shapes give their triangles as stored, degenerate ones included
+  BOOST_CHECK_EQUAL(data->GetTriangleArray().size(), 3u);
+  BOOST_CHECK_EQUAL(data->GetTriangles().size(), 2u);
+
+  // merging still leaves the degenerate triangle out
+  NiNodeRef root = new NiNode;
+  NiTriShapeRef shape = new NiTriShape;
+  shape->SetData(data);
+  root->AddChild(StaticCast<NiAVObject>(shape));
+  ComplexShape cs;
+  cs.Merge(root);
+  BOOST_CHECK_EQUAL(cs.GetFaces().size(), 2u);
+  BOOST_CHECK_EQUAL(cs.GetVertices().size(), 4u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()